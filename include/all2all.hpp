@@ -0,0 +1,400 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    all2all.hpp
+ * @brief   All2all(v) with automatic selection of the communication
+ *          algorithm, used by all bulk exchanges.
+ *
+ * The algorithm is chosen based on the send counts of all processors:
+ *  - sparse:       point-to-point messages, if each processor only
+ *                  communicates with a few others (e.g., shifts, late
+ *                  rounds of `construct_msgs`, `bulk_rmq`)
+ *  - Bruck:        log(p) rounds of combined messages, if all messages are
+ *                  tiny (e.g., exchanging send counts)
+ *  - hierarchical: two-level exchange via node leaders, see hier_all2all.hpp
+ *  - dense:        the flat `mxx::all2allv()`
+ *
+ * The `auto_*` functions are drop-in replacements for the corresponding
+ * `mxx::all2all*` functions. Each exchange is reported as timer section
+ * named after the chosen algorithm, and counted in `all2all_stats()`.
+ *
+ * `async_all2allv` is a non-blocking point-to-point exchange, which allows
+ * overlapping local work with several exchanges in flight (e.g., the
+ * pipelined suffix tree construction).
+ */
+#ifndef ALL2ALL_HPP
+#define ALL2ALL_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/datatypes.hpp>
+#include <mxx/algos.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+#include "hier_all2all.hpp"
+
+constexpr int all2all_dense = 0;
+constexpr int all2all_sparse = 1;
+constexpr int all2all_bruck = 2;
+constexpr int all2all_hierarchical = 3;
+
+/// maximum number of communication partners of any processor for the sparse algorithm
+constexpr std::size_t all2all_sparse_max_partners = 8;
+/// maximum size (in bytes) of any message for the Bruck algorithm
+constexpr std::size_t all2all_bruck_max_bytes = 256;
+
+inline const char* all2all_name(int algo) {
+    switch (algo) {
+        case all2all_sparse:
+            return "sparse";
+        case all2all_bruck:
+            return "bruck";
+        case all2all_hierarchical:
+            return "hierarchical";
+        default:
+            return "dense";
+    }
+}
+
+/// number of exchanges and bytes sent per algorithm
+struct all2all_counters {
+    std::size_t calls[4];
+    std::size_t bytes[4];
+};
+
+/// returns the (process-wide) counters of all exchanges
+inline all2all_counters& all2all_stats() {
+    static all2all_counters counters = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+    return counters;
+}
+
+/**
+ * @brief   Selects the all2allv algorithm for the given send and receive
+ *          counts of this processor (collective call).
+ *
+ * @param max_count Set to the global maximum of all send counts.
+ */
+inline int select_all2allv(const std::vector<size_t>& send_counts, const std::vector<size_t>& recv_counts,
+                           std::size_t type_size, std::size_t& max_count, const mxx::comm& comm) {
+    std::size_t send_partners = 0;
+    std::size_t recv_partners = 0;
+    std::size_t local_max = 0;
+    for (int i = 0; i < comm.size(); ++i) {
+        if (i != comm.rank()) {
+            send_partners += (send_counts[i] > 0);
+            recv_partners += (recv_counts[i] > 0);
+        }
+        local_max = std::max(local_max, send_counts[i]);
+    }
+    std::vector<size_t> stats = {std::max(send_partners, recv_partners), local_max};
+    stats = mxx::allreduce(stats, mxx::max<size_t>(), comm);
+    max_count = stats[1];
+
+    // sparse if each processor talks to at most a quarter of the others
+    std::size_t sparse_partners = std::max<std::size_t>(1, std::min<std::size_t>(all2all_sparse_max_partners, comm.size() / 4));
+    if (stats[0] <= sparse_partners && max_count <= static_cast<std::size_t>(std::numeric_limits<int>::max()))
+        return all2all_sparse;
+    if (max_count * type_size <= all2all_bruck_max_bytes)
+        return all2all_bruck;
+    if (hier_comm::get(comm).is_hierarchical())
+        return all2all_hierarchical;
+    return all2all_dense;
+}
+
+/**
+ * @brief   All2allv via point-to-point messages between communicating
+ *          processors only (collective call).
+ */
+template <typename T>
+void sparse_all2allv(const T* msgs, const std::vector<size_t>& send_counts, const std::vector<size_t>& send_displs,
+                     T* out, const std::vector<size_t>& recv_counts, const std::vector<size_t>& recv_displs, const mxx::comm& comm) {
+    const int tag = 2016;
+    mxx::datatype dt = mxx::get_datatype<T>();
+    std::vector<MPI_Request> reqs;
+    for (int i = 0; i < comm.size(); ++i) {
+        if (i != comm.rank() && recv_counts[i] > 0) {
+            reqs.emplace_back();
+            MPI_Irecv(out + recv_displs[i], recv_counts[i], dt.type(), i, tag, comm, &reqs.back());
+        }
+    }
+    for (int i = 0; i < comm.size(); ++i) {
+        if (i != comm.rank() && send_counts[i] > 0) {
+            reqs.emplace_back();
+            MPI_Isend(const_cast<T*>(msgs + send_displs[i]), send_counts[i], dt.type(), i, tag, comm, &reqs.back());
+        }
+    }
+    std::copy(msgs + send_displs[comm.rank()], msgs + send_displs[comm.rank()] + send_counts[comm.rank()], out + recv_displs[comm.rank()]);
+    MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+}
+
+/**
+ * @brief   All2all of `m` elements per processor pair via the Bruck
+ *          algorithm in ceil(log(p)) rounds (collective call).
+ */
+template <typename T>
+void bruck_all2all(const T* msgs, std::size_t m, T* out, const mxx::comm& comm) {
+    const int tag = 2016;
+    int p = comm.size();
+    int r = comm.rank();
+    mxx::datatype dt = mxx::get_datatype<T>();
+
+    // rotate, such that block `i` is destined for processor `r+i`
+    std::vector<T> buf(p*m);
+    for (int i = 0; i < p; ++i) {
+        std::copy(msgs + ((r+i) % p)*m, msgs + ((r+i) % p + 1)*m, buf.begin() + i*m);
+    }
+    // in round `k`, all blocks with bit `k` set move `k` processors forward
+    std::vector<T> send_buf;
+    std::vector<T> recv_buf;
+    for (int k = 1; k < p; k <<= 1) {
+        send_buf.clear();
+        for (int i = k; i < p; ++i) {
+            if (i & k)
+                send_buf.insert(send_buf.end(), buf.begin() + i*m, buf.begin() + (i+1)*m);
+        }
+        recv_buf.resize(send_buf.size());
+        MPI_Sendrecv(send_buf.data(), send_buf.size(), dt.type(), (r + k) % p, tag,
+                     recv_buf.data(), recv_buf.size(), dt.type(), (r - k + p) % p, tag, comm, MPI_STATUS_IGNORE);
+        std::size_t pos = 0;
+        for (int i = k; i < p; ++i) {
+            if (i & k) {
+                std::copy(recv_buf.begin() + pos, recv_buf.begin() + pos + m, buf.begin() + i*m);
+                pos += m;
+            }
+        }
+    }
+    // block `i` now originates from processor `r-i`
+    for (int i = 0; i < p; ++i) {
+        std::copy(buf.begin() + i*m, buf.begin() + (i+1)*m, out + ((r - i + p) % p)*m);
+    }
+}
+
+/**
+ * @brief   All2allv via the Bruck algorithm, with all messages padded to
+ *          the maximum message size `max_count` (collective call).
+ */
+template <typename T>
+void bruck_all2allv(const T* msgs, const std::vector<size_t>& send_counts, const std::vector<size_t>& send_displs,
+                    T* out, const std::vector<size_t>& recv_counts, const std::vector<size_t>& recv_displs,
+                    std::size_t max_count, const mxx::comm& comm) {
+    std::vector<T> send_buf(comm.size()*max_count);
+    for (int i = 0; i < comm.size(); ++i) {
+        std::copy(msgs + send_displs[i], msgs + send_displs[i] + send_counts[i], send_buf.begin() + i*max_count);
+    }
+    std::vector<T> recv_buf(send_buf.size());
+    bruck_all2all(send_buf.data(), max_count, recv_buf.data(), comm);
+    for (int i = 0; i < comm.size(); ++i) {
+        std::copy(recv_buf.begin() + i*max_count, recv_buf.begin() + i*max_count + recv_counts[i], out + recv_displs[i]);
+    }
+}
+
+/**
+ * @brief   All2allv with automatic algorithm selection, drop-in replacement
+ *          for `mxx::all2allv()` on buffers with displacements
+ *          (collective call).
+ */
+template <typename T>
+void auto_all2allv(const T* msgs, const std::vector<size_t>& send_counts, const std::vector<size_t>& send_displs,
+                   T* out, const std::vector<size_t>& recv_counts, const std::vector<size_t>& recv_displs, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    std::size_t max_count;
+    int algo = select_all2allv(send_counts, recv_counts, sizeof(T), max_count, comm);
+    if (algo == all2all_sparse) {
+        sparse_all2allv(msgs, send_counts, send_displs, out, recv_counts, recv_displs, comm);
+    } else if (algo == all2all_bruck) {
+        bruck_all2allv(msgs, send_counts, send_displs, out, recv_counts, recv_displs, max_count, comm);
+    } else if (algo == all2all_hierarchical) {
+        std::vector<T> send_buf;
+        for (int i = 0; i < comm.size(); ++i) {
+            send_buf.insert(send_buf.end(), msgs + send_displs[i], msgs + send_displs[i] + send_counts[i]);
+        }
+        std::vector<size_t> counts;
+        std::vector<T> recv_buf = hier_all2allv(send_buf, send_counts, counts, hier_comm::get(comm), comm);
+        MXX_ASSERT(counts == recv_counts);
+        std::size_t pos = 0;
+        for (int i = 0; i < comm.size(); ++i) {
+            std::copy(recv_buf.begin() + pos, recv_buf.begin() + pos + recv_counts[i], out + recv_displs[i]);
+            pos += recv_counts[i];
+        }
+    } else {
+        mxx::all2allv(msgs, send_counts, send_displs, out, recv_counts, recv_displs, comm);
+    }
+
+    std::size_t bytes = 0;
+    for (std::size_t c : send_counts)
+        bytes += c * sizeof(T);
+    ++all2all_stats().calls[algo];
+    all2all_stats().bytes[algo] += bytes;
+    t.end_section(std::string("all2allv: ") + all2all_name(algo));
+}
+
+/**
+ * @brief   Drop-in replacement for `mxx::all2allv()` with known receive
+ *          counts (collective call).
+ */
+template <typename T>
+std::vector<T> auto_all2allv(const std::vector<T>& msgs, const std::vector<size_t>& send_counts, const std::vector<size_t>& recv_counts, const mxx::comm& comm) {
+    std::size_t recv_size = 0;
+    for (std::size_t c : recv_counts)
+        recv_size += c;
+    std::vector<T> result(recv_size);
+    auto_all2allv(msgs.data(), send_counts, mxx::local_exscan(send_counts), result.data(), recv_counts, mxx::local_exscan(recv_counts), comm);
+    return result;
+}
+
+/**
+ * @brief   Drop-in replacement for `mxx::all2all()` (collective call).
+ */
+template <typename T>
+std::vector<T> auto_all2all(const std::vector<T>& msgs, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    std::size_t m = msgs.size() / comm.size();
+    std::vector<T> result(msgs.size());
+    // the message size is the same on all processors
+    int algo = all2all_dense;
+    if (comm.size() > 1 && m * sizeof(T) <= all2all_bruck_max_bytes) {
+        algo = all2all_bruck;
+        bruck_all2all(msgs.data(), m, result.data(), comm);
+    } else if (hier_comm::get(comm).is_hierarchical()) {
+        algo = all2all_hierarchical;
+        std::vector<size_t> counts(comm.size(), m);
+        std::vector<size_t> recv_counts;
+        result = hier_all2allv(msgs, counts, recv_counts, hier_comm::get(comm), comm);
+    } else {
+        result = mxx::all2all(msgs, comm);
+    }
+    ++all2all_stats().calls[algo];
+    all2all_stats().bytes[algo] += msgs.size() * sizeof(T);
+    t.end_section(std::string("all2all: ") + all2all_name(algo));
+    return result;
+}
+
+/**
+ * @brief   Drop-in replacement for `mxx::all2allv()` (collective call).
+ */
+template <typename T>
+std::vector<T> auto_all2allv(const std::vector<T>& msgs, const std::vector<size_t>& send_counts, const mxx::comm& comm) {
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+    return auto_all2allv(msgs, send_counts, recv_counts, comm);
+}
+
+/**
+ * @brief   Drop-in replacement for `mxx::all2all_func()` (collective call).
+ */
+template <typename T, typename Func>
+void auto_all2all_func(std::vector<T>& msgs, Func target_func, const mxx::comm& comm) {
+    std::vector<size_t> send_counts = mxx::bucketing(msgs, target_func, comm.size());
+    msgs = auto_all2allv(msgs, send_counts, comm);
+}
+
+/**
+ * @brief   Non-blocking all2allv via point-to-point messages.
+ *
+ * `start()` takes ownership of the (bucketed) messages and posts all sends
+ * and receives; `wait()` completes the exchange and returns the received
+ * messages, ordered by source rank. Only the exchange of the send counts in
+ * `start()` is collective. Multiple exchanges may be in flight at the same
+ * time, as long as they use distinct tags (other than the tag 2016 of the
+ * blocking exchanges).
+ */
+template <typename T>
+class async_all2allv {
+public:
+    async_all2allv() : started(false) {}
+
+    // pending requests refer to the buffers
+    async_all2allv(const async_all2allv&) = delete;
+    async_all2allv& operator=(const async_all2allv&) = delete;
+
+    ~async_all2allv() {
+        if (started)
+            MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    }
+
+    /// starts the exchange with known receive counts
+    void start(std::vector<T>&& msgs, const std::vector<size_t>& send_counts, const std::vector<size_t>& recv_counts, int tag, const mxx::comm& comm) {
+        MXX_ASSERT(!started);
+        send_buf = std::move(msgs);
+        rcounts = recv_counts;
+        std::vector<size_t> send_displs = mxx::local_exscan(send_counts);
+        std::vector<size_t> recv_displs = mxx::local_exscan(recv_counts);
+        recv_buf = std::vector<T>(recv_displs.back() + recv_counts.back());
+
+        mxx::datatype dt = mxx::get_datatype<T>();
+        reqs.clear();
+        std::size_t bytes = 0;
+        for (int i = 0; i < comm.size(); ++i) {
+            if (i != comm.rank() && recv_counts[i] > 0) {
+                MXX_ASSERT(recv_counts[i] <= static_cast<std::size_t>(std::numeric_limits<int>::max()));
+                reqs.emplace_back();
+                MPI_Irecv(&recv_buf[recv_displs[i]], recv_counts[i], dt.type(), i, tag, comm, &reqs.back());
+            }
+        }
+        for (int i = 0; i < comm.size(); ++i) {
+            if (i != comm.rank() && send_counts[i] > 0) {
+                MXX_ASSERT(send_counts[i] <= static_cast<std::size_t>(std::numeric_limits<int>::max()));
+                reqs.emplace_back();
+                MPI_Isend(&send_buf[send_displs[i]], send_counts[i], dt.type(), i, tag, comm, &reqs.back());
+            }
+            bytes += send_counts[i] * sizeof(T);
+        }
+        std::copy(send_buf.begin() + send_displs[comm.rank()], send_buf.begin() + send_displs[comm.rank()] + send_counts[comm.rank()], recv_buf.begin() + recv_displs[comm.rank()]);
+        ++all2all_stats().calls[all2all_sparse];
+        all2all_stats().bytes[all2all_sparse] += bytes;
+        started = true;
+    }
+
+    /// starts the exchange, the receive counts are exchanged first (collective call)
+    void start(std::vector<T>&& msgs, const std::vector<size_t>& send_counts, int tag, const mxx::comm& comm) {
+        std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+        start(std::move(msgs), send_counts, recv_counts, tag, comm);
+    }
+
+    /// whether the exchange was started and not yet completed
+    bool active() const {
+        return started;
+    }
+
+    /// the number of messages received from each processor
+    const std::vector<size_t>& recv_counts() const {
+        return rcounts;
+    }
+
+    /// completes the exchange and returns the received messages
+    std::vector<T> wait() {
+        MXX_ASSERT(started);
+        MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+        started = false;
+        send_buf = std::vector<T>();
+        return std::move(recv_buf);
+    }
+
+private:
+    bool started;
+    std::vector<T> send_buf;
+    std::vector<T> recv_buf;
+    std::vector<size_t> rcounts;
+    std::vector<MPI_Request> reqs;
+};
+
+#endif // ALL2ALL_HPP
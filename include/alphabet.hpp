@@ -20,6 +20,7 @@
 #include <string>
 #include <algorithm>
 #include <mxx/comm.hpp>
+#include <mxx/partition.hpp>
 
 #include "bitops.hpp"
 
@@ -41,6 +42,18 @@ std::string rand_dna(std::size_t size, int seed) {
     return str;
 }
 
+/**
+ * @brief   Generates the local block of a block decomposed random DNA string
+ *          of global size `n`.
+ *
+ * Each processor draws its block from its own seed, derived from `seed` and
+ * its rank.
+ */
+inline std::string rand_dna(std::size_t n, int seed, const mxx::comm& comm) {
+    mxx::partition::block_decomposition_buffered<std::size_t> part(n, comm.size(), comm.rank());
+    return rand_dna(part.local_size(), seed * comm.size() + comm.rank());
+}
+
 template<typename T, typename Iterator>
 std::vector<T> get_histogram(Iterator begin, Iterator end, std::size_t size = 0) {
     if (size == 0)
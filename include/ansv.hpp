@@ -19,6 +19,7 @@
 
 #include <vector>
 #include <deque>
+#include <algorithm>
 #include <cxx-prettyprint/prettyprint.hpp>
 
 #include <mxx/comm.hpp>
@@ -27,6 +28,8 @@
 
 #include "ansv_common.hpp"
 #include "ansv_merge.hpp"
+#include "all2all.hpp"
+#include "dvector.hpp"
 
 // for debugging
 //#define SDEBUG(x) mxx::sync_cerr(comm) << "[" << comm.rank() << "]: " #x " = " << (x) << std::endl
@@ -609,13 +612,13 @@ size_t ansv_communicate_allpairs(const std::vector<std::pair<T,size_t>>& lr_mins
     ansv_comm_allpairs_params<T, left_type, right_type>(lr_mins, n_left_mins, send_counts, send_displs, comm);
 
     // exchange lr_mins via all2all
-    std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
     std::vector<size_t> recv_displs = mxx::impl::get_displacements(recv_counts);
     size_t recv_size = recv_counts.back() + recv_displs.back();
     remote_seqs = std::vector<std::pair<T, size_t>>(recv_size);
 
     t.end_section("ANSV: calc comm params");
-    mxx::all2allv(&lr_mins[0], send_counts, send_displs, &remote_seqs[0], recv_counts, recv_displs, comm);
+    auto_all2allv(&lr_mins[0], send_counts, send_displs, &remote_seqs[0], recv_counts, recv_displs, comm);
     t.end_section("ANSV: all2allv");
 
     // solve locally given the exchanged values (by prefilling min-queue before running locally)
@@ -919,7 +922,7 @@ void my_ansv_minpair(const std::vector<T>& in, std::vector<size_t>& left_nsv, st
     ansv_comm_allpairs_params<T, furthest_eq, furthest_eq>(lr_mins, n_left_mins, send_counts, send_displs, comm);
     // determine min/max for each communication pair
     std::vector<size_t> min_send_counts(send_counts.begin(), send_counts.end());
-    std::vector<size_t> min_recv_counts = mxx::all2all(min_send_counts, comm);
+    std::vector<size_t> min_recv_counts = auto_all2all(min_send_counts, comm);
     // TODO: modify send/recv counts by selecting the minimum partner
     for (int i = 0; i < comm.size(); ++i) {
         if (min_recv_counts[i] != 0 && min_send_counts[i] != 0) {
@@ -949,7 +952,7 @@ void my_ansv_minpair(const std::vector<T>& in, std::vector<size_t>& left_nsv, st
     recved = std::vector<std::pair<T, size_t>>(recv_size);
     // communicate through an all2all TODO: replace by send/recv + barrier?
     t.end_section("ANSV: calc comm params");
-    mxx::all2allv(&lr_mins[0], min_send_counts, send_displs, &recved[0], min_recv_counts, recv_displs, comm);
+    auto_all2allv(&lr_mins[0], min_send_counts, send_displs, &recved[0], min_recv_counts, recv_displs, comm);
     t.end_section("ANSV: all2allv");
 
 
@@ -995,7 +998,7 @@ void my_ansv_minpair(const std::vector<T>& in, std::vector<size_t>& left_nsv, st
     }
 
     // get receive counts via all2all
-    std::vector<size_t> ret_recv_counts = mxx::all2all(ret_send_counts, comm);
+    std::vector<size_t> ret_recv_counts = auto_all2all(ret_send_counts, comm);
     std::vector<size_t> ret_recv_displs(send_displs);
 
     // re-calculate the receive displacementsjjj
@@ -1004,7 +1007,7 @@ void my_ansv_minpair(const std::vector<T>& in, std::vector<size_t>& left_nsv, st
     }
 
     // return the solved elements via a all2all
-    mxx::all2allv(&recved[0], ret_send_counts, ret_send_displs, &lr_mins[0], ret_recv_counts, ret_recv_displs, comm);
+    auto_all2allv(&recved[0], ret_send_counts, ret_send_displs, &lr_mins[0], ret_recv_counts, ret_recv_displs, comm);
 
     // local to global indexing transformation
     for (size_t i = 0; i < in.size(); ++i) {
@@ -1301,6 +1304,128 @@ constexpr int berkman = 3;
 constexpr int left = 4;
 // TODO: add more: e.g. minimize computation?
 
+/**
+ * @brief   Returns the received elements in `lr_mins[tail_begin, tail_end)`
+ *          which are the `furthest_eq` match of any local element.
+ *
+ * Only these matches can still have a further equal element on another
+ * processor, all other received elements are never used as a match.
+ */
+template <typename T, int indexing_type>
+std::vector<size_t> ansv_furthest_eq_matched(const std::vector<T>& in, const std::vector<std::pair<T,size_t>>& lr_mins, size_t tail_begin, size_t tail_end, const std::vector<size_t>& nsv, size_t nonsv) {
+    size_t local_size = in.size();
+    std::vector<bool> matched(tail_end - tail_begin, false);
+    // global indexes of the received elements (only needed for global indexing)
+    std::vector<std::pair<size_t, size_t>> tail_idx;
+    if (indexing_type == global_indexing) {
+        for (size_t j = tail_begin; j < tail_end; ++j)
+            tail_idx.emplace_back(lr_mins[j].second, j);
+        std::sort(tail_idx.begin(), tail_idx.end());
+    }
+    for (size_t i = 0; i < local_size; ++i) {
+        size_t t = nsv[i];
+        if (t == nonsv)
+            continue;
+        if (indexing_type == local_indexing) {
+            size_t j = t - local_size;
+            if (t >= local_size && tail_begin <= j && j < tail_end)
+                matched[j - tail_begin] = true;
+        } else {
+            // all received elements which were replaced by the same match
+            std::vector<std::pair<size_t, size_t>>::const_iterator it = std::lower_bound(tail_idx.begin(), tail_idx.end(), std::pair<size_t, size_t>(t, 0));
+            for (; it != tail_idx.end() && it->first == t; ++it)
+                matched[it->second - tail_begin] = true;
+        }
+    }
+    std::vector<size_t> result;
+    for (size_t j = tail_begin; j < tail_end; ++j)
+        if (matched[j - tail_begin] && lr_mins[j].second != nonsv)
+            result.push_back(j);
+    return result;
+}
+
+/**
+ * @brief   Follows the chains of equal elements for the `furthest_eq` matches
+ *          of the local elements across processor boundaries (collective
+ *          call).
+ *
+ * The merge of a bidirectional pair of processors only sees the equal
+ * elements within their exchanged ranges, such that the match of a local
+ * element can be an equal element on a remote processor, which itself
+ * has a furthest equal element still further away. This asks the owner
+ * of each matched element `lr_mins[j]`, `j` in `matched`, for its own
+ * furthest equal element and replaces the match accordingly.
+ *
+ * @return  Whether any of the local matches changed.
+ */
+template <typename T, int indexing_type>
+bool ansv_furthest_eq_jump(const std::vector<T>& in, std::vector<std::pair<T,size_t>>& lr_mins, const std::vector<size_t>& matched, const std::vector<size_t>& nsv, const gen_dist& part, size_t nonsv, const mxx::comm& comm) {
+    size_t local_size = in.size();
+    size_t prefix = part.eprefix();
+    // bucket the requests by the owner of the matched element
+    std::vector<size_t> send_counts(comm.size(), 0);
+    std::vector<int> owner(matched.size());
+    for (size_t k = 0; k < matched.size(); ++k) {
+        owner[k] = part.rank_of(lr_mins[matched[k]].second);
+        ++send_counts[owner[k]];
+    }
+    std::vector<size_t> send_displs = mxx::local_exscan(send_counts);
+    std::vector<size_t> requests(matched.size());
+    std::vector<size_t> offset = send_displs;
+    for (size_t k = 0; k < matched.size(); ++k) {
+        requests[offset[owner[k]]++] = lr_mins[matched[k]].second;
+    }
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+    requests = auto_all2allv(requests, send_counts, recv_counts, comm);
+
+    // the values of the received elements, sorted by their global index
+    // (only needed for global indexing)
+    std::vector<std::pair<size_t, T>> remote_values;
+    if (indexing_type == global_indexing) {
+        for (size_t j = 0; j < lr_mins.size(); ++j) {
+            if (lr_mins[j].second != nonsv)
+                remote_values.emplace_back(lr_mins[j].second, lr_mins[j].first);
+        }
+        std::sort(remote_values.begin(), remote_values.end());
+    }
+    // answer with the furthest equal element of each requested element
+    for (size_t& g : requests) {
+        size_t idx = g - prefix;
+        size_t t = nsv[idx];
+        if (indexing_type == local_indexing) {
+            if (t < local_size) {
+                if (in[t] == in[idx])
+                    g = prefix + t;
+            } else if (t != nonsv && t - local_size < lr_mins.size()) {
+                const std::pair<T, size_t>& m = lr_mins[t - local_size];
+                if (m.second != nonsv && m.first == in[idx])
+                    g = m.second;
+            }
+        } else {
+            if (prefix <= t && t < prefix + local_size) {
+                if (in[t - prefix] == in[idx])
+                    g = t;
+            } else if (t != nonsv) {
+                typename std::vector<std::pair<size_t, T>>::const_iterator it = std::lower_bound(remote_values.begin(), remote_values.end(), t,
+                    [](const std::pair<size_t, T>& x, size_t y) { return x.first < y; });
+                if (it != remote_values.end() && it->first == t && it->second == in[idx])
+                    g = t;
+            }
+        }
+    }
+    requests = auto_all2allv(requests, recv_counts, send_counts, comm);
+
+    bool changed = false;
+    for (size_t k = 0; k < matched.size(); ++k) {
+        size_t g = requests[send_displs[owner[k]]++];
+        if (g != lr_mins[matched[k]].second) {
+            lr_mins[matched[k]].second = g;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
 template <typename T, int left_type, int right_type, int indexing_type, int pair_type = left>
 void gansv_impl(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::vector<size_t>& right_nsv, std::vector<std::pair<T,size_t> >& lr_mins, const mxx::comm& comm, size_t nonsv = 0) {
     mxx::section_timer t(std::cerr, comm);
@@ -1359,9 +1484,9 @@ void gansv_impl(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::ve
     SDEBUG(ub_displs);
 
     // all2all communicate the send counts
-    std::vector<size_t> lb_recv_counts = mxx::all2all(lb_counts, comm);
-    std::vector<size_t> in_recv_counts = mxx::all2all(in_counts, comm);
-    std::vector<size_t> ub_recv_counts = mxx::all2all(ub_counts, comm);
+    std::vector<size_t> lb_recv_counts = auto_all2all(lb_counts, comm);
+    std::vector<size_t> in_recv_counts = auto_all2all(in_counts, comm);
+    std::vector<size_t> ub_recv_counts = auto_all2all(ub_counts, comm);
 
 
     // TODO: dynamically set whether we solve in duplex
@@ -1434,11 +1559,11 @@ void gansv_impl(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::ve
 
 
     // lb communication
-    mxx::all2allv(&lr_mins[0], lb_counts, lb_displs,
+    auto_all2allv(&lr_mins[0], lb_counts, lb_displs,
                   &recved[0], lb_recv_counts, lb_recv_displs, comm);
 
     // in+ub communication
-    mxx::all2allv(&lr_mins[0], inub_send_counts, inub_send_displs,
+    auto_all2allv(&lr_mins[0], inub_send_counts, inub_send_displs,
                   &recved[0], inub_recv_counts, inub_recv_displs, comm);
 
 
@@ -1621,7 +1746,7 @@ void gansv_impl(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::ve
             min_recv_counts[i] = 0;
         }
     }
-    mxx::all2allv(&recved[0], min_recv_counts, in_recv_displs, &lr_mins[0], min_send_counts, in_displs, comm);
+    auto_all2allv(&recved[0], min_recv_counts, in_recv_displs, &lr_mins[0], min_send_counts, in_displs, comm);
 
     t.end_section("ANSV: all2all back");
     SDEBUG(lr_mins);
@@ -1675,6 +1800,45 @@ void gansv_impl(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::ve
             right_upper = lr_mins.size();
         ansv_local_finish_furthest_eq<T, dir_right, dir_left, indexing_type>(in, lr_mins.begin()+right_upper, lr_mins.end(), prefix, right_upper, nonsv, right_nsv);
     }
+    // follow chains of equal elements which span more than two processors:
+    // costs one allreduce if no local element is matched to a received
+    // element, otherwise an allgather of the local sizes plus, per round,
+    // one request/reply exchange (three all2alls) and one allreduce
+    if ((left_type == furthest_eq || right_type == furthest_eq) && comm.size() > 1) {
+        std::vector<size_t> left_matched;
+        std::vector<size_t> right_matched;
+        if (left_type == furthest_eq)
+            left_matched = ansv_furthest_eq_matched<T, indexing_type>(in, lr_mins, 0, left_upper, left_nsv, nonsv);
+        if (right_type == furthest_eq)
+            right_matched = ansv_furthest_eq_matched<T, indexing_type>(in, lr_mins, right_upper, lr_mins.size(), right_nsv, nonsv);
+        if (mxx::any_of(!left_matched.empty() || !right_matched.empty(), comm)) {
+            gen_dist part(comm, local_size);
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                if (left_type == furthest_eq) {
+                    if (ansv_furthest_eq_jump<T, indexing_type>(in, lr_mins, left_matched, left_nsv, part, nonsv, comm)) {
+                        ansv_local_finish_furthest_eq<T, dir_left, dir_right, indexing_type>(in, lr_mins.begin(), lr_mins.begin()+left_upper, prefix, 0, nonsv, left_nsv);
+                        changed = true;
+                    }
+                }
+                if (right_type == furthest_eq) {
+                    if (ansv_furthest_eq_jump<T, indexing_type>(in, lr_mins, right_matched, right_nsv, part, nonsv, comm)) {
+                        ansv_local_finish_furthest_eq<T, dir_right, dir_left, indexing_type>(in, lr_mins.begin()+right_upper, lr_mins.end(), prefix, right_upper, nonsv, right_nsv);
+                        changed = true;
+                    }
+                }
+                changed = mxx::any_of(changed, comm);
+                if (changed) {
+                    if (left_type == furthest_eq)
+                        left_matched = ansv_furthest_eq_matched<T, indexing_type>(in, lr_mins, 0, left_upper, left_nsv, nonsv);
+                    if (right_type == furthest_eq)
+                        right_matched = ansv_furthest_eq_matched<T, indexing_type>(in, lr_mins, right_upper, lr_mins.size(), right_nsv, nonsv);
+                }
+            }
+        }
+        t.end_section("ANSV: furthest_eq chains");
+    }
 
 
     /*********************************************************************
@@ -1793,7 +1957,7 @@ void hh_ansv_comm_params(const std::vector<std::pair<T,size_t>>& lr_mins,
 
 template <typename T>
 size_t hh_ansv_comm(const std::vector<std::pair<T, size_t>>& lr_mins, const std::vector<size_t>& send_counts, const std::vector<size_t>& send_offsets, const mxx::comm& comm, std::vector<std::pair<T, size_t>>& recved) {
-    std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
 
     SDEBUG(send_counts);
     SDEBUG(send_offsets);
@@ -2009,7 +2173,7 @@ void hh_ansv(const std::vector<T>& in, std::vector<size_t>& left_nsv, std::vecto
     SDEBUG(return_recv_counts);
     SDEBUG(return_recv_displs);
     // FIXME: replace all2all with send/recv
-    mxx::all2allv(&recved[0], return_send_counts, return_send_displs, &lr_mins[0], return_recv_counts, return_recv_displs, comm);
+    auto_all2allv(&recved[0], return_send_counts, return_send_displs, &lr_mins[0], return_recv_counts, return_recv_displs, comm);
     SDEBUG(lr_mins);
     t.end_section("ANSV: return comm");
 
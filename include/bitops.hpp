@@ -23,6 +23,8 @@
 #define BITOPS_HPP
 
 #include <cstdint>
+#include <cstddef>
+#include <type_traits>
 #include <assert.h>
 
 /**
@@ -36,7 +38,7 @@
  * @precondition x != 0
  * @return      The number of trailing zeros in the integer.
  */
-inline unsigned int trailing_zeros(uint64_t x) {
+inline unsigned int trailing_zeros_debruijn(uint64_t x) {
     static const unsigned int index64[64] = {
         0,  1,  48,  2, 57, 49, 28,  3,
         61, 58, 50, 42, 38, 29, 17,  4,
@@ -52,6 +54,20 @@ inline unsigned int trailing_zeros(uint64_t x) {
     return index64[((x & -x) * debruijn64) >> 58];
 }
 
+/**
+ * @brief   Returns the number of trailing zeros of a 64 bit integer.
+ * @precondition x != 0
+ */
+inline unsigned int trailing_zeros(uint64_t x) {
+    assert(x != 0);
+#if defined(__GNUC__)
+    // compiles to `tzcnt` or `bsf` (or their equivalent on other targets)
+    return __builtin_ctzll(x);
+#else
+    return trailing_zeros_debruijn(x);
+#endif
+}
+
 /**
  * Fast integer log base 2 for 64 bit integers.
  * @param x         Input value.
@@ -82,27 +98,33 @@ inline unsigned int log2_64(uint64_t value) {
 inline unsigned int leading_zeros_64(uint64_t x) {
     if (x == 0)
         return 64;
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
     unsigned int log2 = log2_64(x);
     return 64 - log2 - 1;
+#endif
 }
 
 inline unsigned int leading_zeros_32(uint32_t x) {
-    // TODO implement faster version for 32 bits
+    if (x == 0)
+        return 32;
+#if defined(__GNUC__)
+    return __builtin_clz(x);
+#else
     return leading_zeros_64(static_cast<uint64_t>(x)) - 32;
+#endif
 }
 
 template<typename T>
 inline unsigned int leading_zeros(T x) {
+    static_assert(sizeof(T) <= 8, "leading_zeros() supports integers of at most 64 bits");
+    typedef typename std::make_unsigned<T>::type U;
     if (sizeof(T)*8 == 64)
-        return leading_zeros_64(x);
-    else if (sizeof(T)*8 == 32)
-        return leading_zeros_32(x);
+        return leading_zeros_64(static_cast<U>(x));
     else
-    {
-        // TODO: implement other sizes
-        assert(false);
-        return -1;
-    }
+        // narrower types are zero extended to 32 bits
+        return leading_zeros_32(static_cast<U>(x)) - (32 - sizeof(T)*8);
 }
 
 unsigned int reference_trailing_zeros(uint64_t x) {
@@ -140,8 +162,7 @@ unsigned int reference_ceillog2(unsigned int x) {
 
 template <typename IntType>
 inline unsigned int floorlog2(IntType n) {
-    //return log2_64(n);
-    return ((unsigned) (8*sizeof(unsigned long long) - __builtin_clzll((n)) - 1));
+    return 63 - leading_zeros_64(static_cast<uint64_t>(n));
 }
 
 template <typename IntType>
@@ -151,6 +172,60 @@ inline unsigned int ceillog2(IntType n) {
     return log_floor + (((n&(n-1)) != 0) ? 1 : 0);
 }
 
+#if defined(__SIZEOF_INT128__)
+#define BITOPS_HAS_INT128 1
+#endif
+
+/**
+ * @brief   Unsigned 64 bit division by an invariant divisor, which replaces
+ *          the division instruction by a multiplication with a precomputed
+ *          multiplier and two shifts (T. Granlund and P. L. Montgomery,
+ *          "Division by invariant integers using multiplication", 1994).
+ *
+ * Falls back to the division instruction on platforms without 128 bit
+ * integers.
+ */
+class invariant_divisor {
+public:
+    invariant_divisor() : invariant_divisor(1) {}
+
+    /// @precondition d > 0
+    explicit invariant_divisor(uint64_t d) : m_d(d) {
+        assert(d > 0);
+#ifdef BITOPS_HAS_INT128
+        // l = ceil(log2(d)), m = floor(2^64 * (2^l - d) / d) + 1
+        unsigned int l = ceillog2(d);
+        unsigned __int128 pow_l = static_cast<unsigned __int128>(1) << l;
+        m_mult = static_cast<uint64_t>(((pow_l - d) << 64) / d) + 1;
+        m_sh1 = l < 1 ? l : 1;
+        m_sh2 = l < 1 ? 0 : l - 1;
+#else
+        m_mult = 0;
+        m_sh1 = m_sh2 = 0;
+#endif
+    }
+
+    inline uint64_t divisor() const {
+        return m_d;
+    }
+
+    /// returns floor(n / divisor())
+    inline uint64_t divide(uint64_t n) const {
+#ifdef BITOPS_HAS_INT128
+        uint64_t t = static_cast<uint64_t>((static_cast<unsigned __int128>(m_mult) * n) >> 64);
+        return (t + ((n - t) >> m_sh1)) >> m_sh2;
+#else
+        return n / m_d;
+#endif
+    }
+
+private:
+    uint64_t m_d;
+    uint64_t m_mult;
+    unsigned int m_sh1;
+    unsigned int m_sh2;
+};
+
 /**
  * @brief   Returns the number identical characters of two strings in k-mer
  *          compressed bit representation with `bits_per_char` bits per
@@ -182,6 +257,170 @@ unsigned int lcp_bitwise(T x, T y, unsigned int k, unsigned int bits_per_char) {
     return lcp;
 }
 
+/*********************************************************************
+ *                  Batched kernels and CPU dispatch                 *
+ *********************************************************************/
+
+// kernels are forced inline into the instruction set specific clones below
+#if defined(__GNUC__)
+#define BITOPS_KERNEL inline __attribute__((always_inline))
+#else
+#define BITOPS_KERNEL inline
+#endif
+
+// runtime selection of the instruction set on x86 with GCC or clang
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITOPS_X86_DISPATCH 1
+#endif
+
+/// the instruction set levels of the batched kernels
+constexpr int bitops_isa_generic = 0;
+/// AVX2 with the BMI1/BMI2 and LZCNT bit manipulation instructions
+constexpr int bitops_isa_avx2 = 1;
+/// AVX-512 F/CD/VL/BW (vectorized leading zero count)
+constexpr int bitops_isa_avx512 = 2;
+
+inline const char* bitops_isa_name(int isa) {
+    switch (isa) {
+        case bitops_isa_avx2: return "avx2";
+        case bitops_isa_avx512: return "avx512";
+        default: return "generic";
+    }
+}
+
+/**
+ * @brief   Returns the highest instruction set level supported by this CPU.
+ *          The result is detected once and cached.
+ */
+inline int bitops_isa() {
+#ifdef BITOPS_X86_DISPATCH
+    static const int isa = []() {
+        __builtin_cpu_init();
+        bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")
+                    && __builtin_cpu_supports("bmi2");
+        if (avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd")
+                 && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw"))
+            return bitops_isa_avx512;
+        if (avx2)
+            return bitops_isa_avx2;
+        return bitops_isa_generic;
+    }();
+    return isa;
+#else
+    return bitops_isa_generic;
+#endif
+}
+
+/**
+ * @brief   Leading zeros of a non-zero 64 bit integer.
+ */
+BITOPS_KERNEL unsigned int leading_zeros_nonzero(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    return 63 - log2_64(x);
+#endif
+}
+
+/**
+ * @brief   Computes `lcp_bitwise(x[i], y[i], k, bits_per_char)` for `n` pairs
+ *          of k-mers at once.
+ *
+ * The number of bits per character is a compile time constant, such that the
+ * division by it compiles into a multiplication. The loop body is free of
+ * branches, which lets the compiler vectorize it on instruction sets with a
+ * vectorized leading zero count (e.g. AVX-512CD).
+ *
+ * @tparam bits_per_char    The number of bits per character.
+ * @tparam T                The type of the k-mers (an integer type of at most
+ *                          64 bits).
+ * @param x                 The first k-mer of each pair.
+ * @param y                 The second k-mer of each pair.
+ * @param n                 The number of pairs.
+ * @param k                 The number of characters per k-mer.
+ * @param lcp               Output array of `n` LCP values.
+ */
+template <unsigned int bits_per_char, typename T>
+BITOPS_KERNEL void lcp_bitwise_batch(const T* x, const T* y, std::size_t n, unsigned int k, unsigned int* lcp) {
+    static_assert(bits_per_char > 0, "bits_per_char must be positive");
+    static_assert(sizeof(T) <= sizeof(uint64_t), "k-mer type is too wide");
+    typedef typename std::make_unsigned<T>::type U;
+    const unsigned int word_bits = sizeof(T)*8;
+    const unsigned int offset = word_bits - k*bits_per_char;
+    for (std::size_t i = 0; i < n; ++i) {
+        U z = static_cast<U>(x[i]) ^ static_cast<U>(y[i]);
+        // `z | 1` has the same leading zeros as any non-zero `z`, and equal
+        // k-mers select the full word, which yields an LCP of `k`
+        unsigned int lz = leading_zeros_nonzero(static_cast<uint64_t>(z | 1)) - (64 - word_bits);
+        lz = (z == 0) ? word_bits : lz;
+        lcp[i] = (lz - offset) / bits_per_char;
+    }
+}
+
+/**
+ * @brief   Computes `lcp_bitwise(x[i], y[i], k, bits_per_char)` for `n` pairs
+ *          of k-mers at once, using the compile time specialization for the
+ *          given `bits_per_char`.
+ */
+template <typename T>
+BITOPS_KERNEL void lcp_bitwise_batch_generic(const T* x, const T* y, std::size_t n, unsigned int k, unsigned int bits_per_char, unsigned int* lcp) {
+    switch (bits_per_char) {
+        case 1: lcp_bitwise_batch<1>(x, y, n, k, lcp); break;
+        case 2: lcp_bitwise_batch<2>(x, y, n, k, lcp); break;
+        case 3: lcp_bitwise_batch<3>(x, y, n, k, lcp); break;
+        case 4: lcp_bitwise_batch<4>(x, y, n, k, lcp); break;
+        case 5: lcp_bitwise_batch<5>(x, y, n, k, lcp); break;
+        case 6: lcp_bitwise_batch<6>(x, y, n, k, lcp); break;
+        case 7: lcp_bitwise_batch<7>(x, y, n, k, lcp); break;
+        case 8: lcp_bitwise_batch<8>(x, y, n, k, lcp); break;
+        case 9: lcp_bitwise_batch<9>(x, y, n, k, lcp); break;
+        default:
+            for (std::size_t i = 0; i < n; ++i)
+                lcp[i] = lcp_bitwise(x[i], y[i], k, bits_per_char);
+            break;
+    }
+}
+
+#ifdef BITOPS_X86_DISPATCH
+template <typename T>
+__attribute__((target("avx2,bmi,bmi2,lzcnt")))
+void lcp_bitwise_batch_avx2(const T* x, const T* y, std::size_t n, unsigned int k, unsigned int bits_per_char, unsigned int* lcp) {
+    lcp_bitwise_batch_generic(x, y, n, k, bits_per_char, lcp);
+}
+
+template <typename T>
+__attribute__((target("avx2,bmi,bmi2,lzcnt,avx512f,avx512cd,avx512vl,avx512bw")))
+void lcp_bitwise_batch_avx512(const T* x, const T* y, std::size_t n, unsigned int k, unsigned int bits_per_char, unsigned int* lcp) {
+    lcp_bitwise_batch_generic(x, y, n, k, bits_per_char, lcp);
+}
+#endif
+
+/**
+ * @brief   Computes `lcp_bitwise(x[i], y[i], k, bits_per_char)` for `n` pairs
+ *          of k-mers at once, with the kernel compiled for the given
+ *          instruction set level (which must be supported by this CPU).
+ */
+template <typename T>
+inline void lcp_bitwise_batch(int isa, const T* x, const T* y, std::size_t n, unsigned int k, unsigned int bits_per_char, unsigned int* lcp) {
+#ifdef BITOPS_X86_DISPATCH
+    if (isa == bitops_isa_avx512)
+        return lcp_bitwise_batch_avx512(x, y, n, k, bits_per_char, lcp);
+    if (isa == bitops_isa_avx2)
+        return lcp_bitwise_batch_avx2(x, y, n, k, bits_per_char, lcp);
+#endif
+    lcp_bitwise_batch_generic(x, y, n, k, bits_per_char, lcp);
+}
+
+/**
+ * @brief   Computes `lcp_bitwise(x[i], y[i], k, bits_per_char)` for `n` pairs
+ *          of k-mers at once, with the kernel for the best instruction set
+ *          supported by this CPU.
+ */
+template <typename T>
+inline void lcp_bitwise_batch(const T* x, const T* y, std::size_t n, unsigned int k, unsigned int bits_per_char, unsigned int* lcp) {
+    lcp_bitwise_batch(bitops_isa(), x, y, n, k, bits_per_char, lcp);
+}
+
 /**
  * @brief   Returns the number identical characters of two strings in k-mer
  *          compressed bit representation with `bits_per_char` bits per
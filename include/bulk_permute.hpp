@@ -4,26 +4,41 @@
 #include <mxx/comm.hpp>
 #include <mxx/partition.hpp>
 
+#include "all2all.hpp"
+#include "dvector.hpp"
+
 #include <assert.h>
+#include <vector>
+#include <algorithm>
 
 /*
  * TODO: double check with mxx bucketing implemenetation
  */
 
-template <typename T, typename index_t>
-void bulk_permute_inplace(std::vector<T>& vec, std::vector<T>& idx, mxx::partition::block_decomposition_buffered<index_t>& part, const mxx::comm& comm) {
+// `Partition` is either `mxx::partition::block_decomposition_buffered` or
+// any other distribution with the same interface (e.g. `gen_dist`)
+template <typename T, typename Partition>
+void bulk_permute_inplace(std::vector<T>& vec, std::vector<T>& idx, const Partition& part, const mxx::comm& comm) {
     assert(idx.size() == vec.size());
 
     //SAC_TIMER_START();
     // 1.) local bucketing for each processor
     //
-    // counting the number of elements for each processor
+    // counting the number of elements for each processor (the target
+    // processors are computed in batches of a fixed size, without divisions
+    // for the distributions in dvector.hpp)
     std::vector<size_t> send_counts(comm.size(), 0);
-    for (index_t gi : idx) {
-        int target_p = part.target_processor(gi);
-        assert(0 <= target_p && target_p < comm.size());
-        ++send_counts[target_p];
+    const std::size_t batch_size = 4096;
+    std::vector<int> target(std::min(batch_size, idx.size()));
+    for (std::size_t b = 0; b < idx.size(); b += batch_size) {
+        std::size_t e = std::min(b + batch_size, idx.size());
+        rank_of_many(part, idx.begin() + b, idx.begin() + e, target.begin());
+        for (std::size_t i = 0; i < e - b; ++i) {
+            assert(0 <= target[i] && target[i] < comm.size());
+            ++send_counts[target[i]];
+        }
     }
+    target = std::vector<int>();
 
     // get exclusive prefix sum
     std::vector<size_t> send_displs = mxx::local_exscan(send_counts);
@@ -57,14 +72,14 @@ void bulk_permute_inplace(std::vector<T>& vec, std::vector<T>& idx, mxx::partiti
     //SAC_TIMER_END_SECTION("sa2isa_bucketing");
 
     // all2all communication for both vectors
-    idx = mxx::all2allv(idx, send_counts, comm);
-    std::vector<T> recv_vec = mxx::all2allv(vec, send_counts, comm);
+    idx = auto_all2allv(idx, send_counts, comm);
+    std::vector<T> recv_vec = auto_all2allv(vec, send_counts, comm);
     //SAC_TIMER_END_SECTION("sa2isa_all2all");
 
     // locally rearrange (assign to correct index)
     size_t prefix = part.excl_prefix_size();
     for (std::size_t i = 0; i < idx.size(); ++i) {
-        index_t out_idx = idx[i] - prefix;
+        T out_idx = idx[i] - prefix;
         assert(0 <= out_idx && out_idx < idx.size());
         vec[out_idx] = recv_vec[i];
     }
@@ -72,5 +87,14 @@ void bulk_permute_inplace(std::vector<T>& vec, std::vector<T>& idx, mxx::partiti
     //SAC_TIMER_END_SECTION("sa2isa_rearrange");
 }
 
+// permutes the distributed range `vec` by the global indexes in the
+// distributed range `idx` (of the same distribution), i.e.,
+// vec[idx[i]] = vec[i], and overwrites `idx` in the process
+template <typename DRange, typename IdxRange>
+typename std::enable_if<is_drange<DRange>::value && is_drange<IdxRange>::value>::type
+bulk_permute_inplace(DRange& vec, IdxRange& idx) {
+    bulk_permute_inplace(vec.local(), idx.local(), vec.distribution(), vec.comm());
+}
+
 
 #endif // BULK_PERMUTE_HPP
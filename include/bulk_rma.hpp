@@ -5,11 +5,19 @@
 #include <mxx/comm.hpp>
 #include <mxx/timer.hpp>
 
+#include "all2all.hpp"
+#include "hier_comm.hpp"
+#include "dvector.hpp"
+
 // for posix sm
 #include <unistd.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 
+#include <vector>
+#include <algorithm>
+#include <limits>
+
 template <typename Q, typename Func>
 std::vector<typename std::result_of<Func(Q)>::type> bulk_query(const std::vector<Q>& queries, Func f, const std::vector<size_t>& send_counts, const mxx::comm& comm) {
     // type of the query results
@@ -17,11 +25,11 @@ std::vector<typename std::result_of<Func(Q)>::type> bulk_query(const std::vector
     mxx::section_timer t(std::cerr, comm);
 
     // get receive counts (needed as send counts for returning queries)
-    std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
     t.end_section("bulk_query: get recv_counts");
 
     // send all queries via all2all
-    std::vector<Q> local_queries = mxx::all2allv(queries, send_counts, recv_counts, comm);
+    std::vector<Q> local_queries = auto_all2allv(queries, send_counts, recv_counts, comm);
     t.end_section("bulk_query: all2all queries");
 
     // show load inbalance in queries and recv_counts
@@ -46,7 +54,7 @@ std::vector<typename std::result_of<Func(Q)>::type> bulk_query(const std::vector
 
     // return all results, send_counts are the same as the recv_counts from the
     // previous all2all, and the other way around
-    std::vector<T> results = mxx::all2allv(local_results, recv_counts, send_counts, comm);
+    std::vector<T> results = auto_all2allv(local_results, recv_counts, send_counts, comm);
     t.end_section("bulk_query: all2all query results");
     return results;
 }
@@ -108,20 +116,15 @@ std::vector<T> permute(const std::vector<T>& vec, const std::vector<size_t>& idx
 }
 
 
-template <typename InputIter>
+// `Partition` is either `mxx::partition::block_decomposition_buffered` or
+// any other distribution with the same interface (e.g. `gen_dist`)
+template <typename Partition, typename InputIter>
 std::vector<typename std::iterator_traits<InputIter>::value_type>
-bulk_rma(InputIter local_begin, InputIter local_end,
+bulk_rma(const Partition& part, InputIter local_begin, InputIter local_end,
          const std::vector<size_t>& global_indexes, const mxx::comm& comm) {
 
     using value_type = typename std::iterator_traits<InputIter>::value_type;
-    // get local and global size
-    size_t local_size = std::distance(local_begin, local_end);
-    size_t global_size = mxx::allreduce(local_size, comm);
-    // get the block decomposition class and check that input is actuall block
-    // decomposed
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
-    MXX_ASSERT(part.local_size() == local_size);
-
+    MXX_ASSERT(part.local_size() == static_cast<size_t>(std::distance(local_begin, local_end)));
 
     std::vector<size_t> bucketed_indexes;
     std::vector<size_t> original_pos;
@@ -133,6 +136,24 @@ bulk_rma(InputIter local_begin, InputIter local_end,
     return permute(results, original_pos);
 }
 
+template <typename InputIter>
+std::vector<typename std::iterator_traits<InputIter>::value_type>
+bulk_rma(InputIter local_begin, InputIter local_end,
+         const std::vector<size_t>& global_indexes, const mxx::comm& comm) {
+    // get the distribution of the input (with the fast path for block
+    // decompositions)
+    size_t local_size = std::distance(local_begin, local_end);
+    gen_dist part(comm, local_size);
+    return bulk_rma(part, local_begin, local_end, global_indexes, comm);
+}
+
+// reads the elements at the given global indexes of the distributed range `src`
+template <typename DRange>
+typename std::enable_if<is_drange<DRange>::value, std::vector<typename DRange::value_type> >::type
+bulk_rma(const DRange& src, const std::vector<size_t>& global_indexes) {
+    return bulk_rma(src.distribution(), src.begin(), src.end(), global_indexes, src.comm());
+}
+
 
 template <typename InputIter>
 std::vector<typename std::iterator_traits<InputIter>::value_type>
@@ -140,10 +161,9 @@ bulk_rma_mpiwin(InputIter local_begin, InputIter local_end,
          const std::vector<size_t>& global_indexes, const mxx::comm& comm) {
     using value_type = typename std::iterator_traits<InputIter>::value_type;
 
-    // get local and global size
+    // get local size and the distribution of the input
     size_t local_size = std::distance(local_begin, local_end);
-    size_t global_size = mxx::allreduce(local_size, comm);
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+    gen_dist part(comm, local_size);
 
     // create MPI_Win for input string, create character array for size of parents
     // and use RMA to request (read) all characters which are not `$`
@@ -189,53 +209,97 @@ public:
     value_type* shptr;
 
     template <typename Iterator>
-    void init(Iterator local_begin, Iterator local_end) {
+    void init(Iterator local_begin, Iterator local_end, const hier_comm& hc) {
         mxx::section_timer t(std::cerr, comm);
         // get local and global size
         local_size = std::distance(local_begin, local_end);
-        prefix = mxx::exscan(local_size, comm);
-        global_size = mxx::allreduce(local_size, comm);
-        mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
-
-        mxx::datatype dt = mxx::get_datatype<value_type>();
-
-        // create MPI_Win for input string, create character array for size of parents
-        // and use RMA to request (read) all characters which are not `$`
+        std::vector<size_t> local_sizes = mxx::allgather(local_size, comm);
+        std::vector<size_t> prefixes = mxx::local_exscan(local_sizes);
+        prefix = prefixes[comm.rank()];
+        global_size = prefixes.back() + local_sizes.back();
+
+        // create one shared MPI_Win for the whole input per node, allocated
+        // by the first processor of the node
+        const mxx::comm& node_comm = hc.node_comm;
         MPI_Info info;
         MPI_Info_create(&info);
         MPI_Info_set(info, "alloc_shared_noncontig", "true");
-        if (comm.rank() == 0) {
-            MPI_Win_allocate_shared(global_size, sizeof(value_type), info, comm, &charwin, &win);
+        if (node_comm.rank() == 0) {
+            MPI_Win_allocate_shared(global_size*sizeof(value_type), sizeof(value_type), info, node_comm, &charwin, &win);
         } else {
-            MPI_Win_allocate_shared(0, sizeof(value_type), info, comm, &charwin, &win);
+            MPI_Win_allocate_shared(0, sizeof(value_type), info, node_comm, &charwin, &win);
         }
+        MPI_Info_free(&info);
         t.end_section("alloc window");
 
-        /* create table of pointers for shared memory access */
-        //std::vector<CharT*> shptrs(comm.size());
-        /*
-           for (int i = 0; i < comm.size(); ++i) {
-           MPI_Aint winsize;
-           int windispls;
-           MPI_Win_shared_query(win, i, &winsize, &windispls, &shptrs[i]);
-           }
-           */
-
         MPI_Aint winsize; int windispls;
         MPI_Win_shared_query(win, 0, &winsize, &windispls, &shptr);
         t.end_section("get ptrs via shared_query");
 
         /* copy string into shared memory window */
-        memcpy(shptr+prefix, &(*local_begin), local_size*sizeof(value_type));
-        t.end_section("copy input string into shared win");
+        MPI_Win_fence(0, win);
+        std::copy(local_begin, local_end, shptr+prefix);
         MPI_Win_sync(win);
         MPI_Win_fence(0, win);
-        t.end_section("sync");
+        t.end_section("copy input string into shared win");
+
+        /* exchange the blocks of all nodes between the node leaders */
+        if (hc.num_nodes > 1) {
+            if (node_comm.rank() == 0) {
+                // the blocks of each node in the window, as runs of
+                // consecutive processors (split at the `int` counts of MPI)
+                mxx::datatype dt = mxx::get_datatype<value_type>();
+                const size_t max_run = std::numeric_limits<int>::max();
+                std::vector<MPI_Datatype> node_types(hc.num_nodes);
+                for (int d = 0; d < hc.num_nodes; ++d) {
+                    const std::vector<int>& ranks = hc.node_ranks[d];
+                    std::vector<int> run_sizes;
+                    std::vector<MPI_Aint> run_displs;
+                    for (size_t j = 0; j < ranks.size();) {
+                        size_t begin = prefixes[ranks[j]];
+                        size_t end = begin + local_sizes[ranks[j]];
+                        for (++j; j < ranks.size() && ranks[j] == ranks[j-1] + 1; ++j)
+                            end += local_sizes[ranks[j]];
+                        for (; begin < end; begin += max_run) {
+                            run_sizes.push_back(std::min(end - begin, max_run));
+                            run_displs.push_back(begin * sizeof(value_type));
+                        }
+                    }
+                    MPI_Type_create_hindexed(run_sizes.size(), run_sizes.data(), run_displs.data(), dt.type(), &node_types[d]);
+                    MPI_Type_commit(&node_types[d]);
+                }
+
+                // send the own blocks to all other leaders and receive
+                // theirs directly into the window
+                const int tag = 2017;
+                std::vector<MPI_Request> reqs;
+                for (int d = 0; d < hc.num_nodes; ++d) {
+                    if (d != hc.node_idx) {
+                        reqs.emplace_back();
+                        MPI_Irecv(shptr, 1, node_types[d], d, tag, hc.leader_comm, &reqs.back());
+                        reqs.emplace_back();
+                        MPI_Isend(shptr, 1, node_types[hc.node_idx], d, tag, hc.leader_comm, &reqs.back());
+                    }
+                }
+                MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+                for (int d = 0; d < hc.num_nodes; ++d)
+                    MPI_Type_free(&node_types[d]);
+            }
+            MPI_Win_sync(win);
+            MPI_Win_fence(0, win);
+            t.end_section("allgatherv blocks between node leaders");
+        }
     }
 
     template <typename Iterator>
     shmem_window_mpi(Iterator local_begin, Iterator local_end, const mxx::comm& c) : comm(c) {
-        init(local_begin, local_end);
+        init(local_begin, local_end, hier_comm::get(c));
+    }
+
+    /// creates the window over the nodes of the given hierarchical communicator
+    template <typename Iterator>
+    shmem_window_mpi(Iterator local_begin, Iterator local_end, const hier_comm& hc, const mxx::comm& c) : comm(c) {
+        init(local_begin, local_end, hc);
     }
 
     inline T get(size_t gidx) const {
@@ -321,6 +385,10 @@ public:
     }
 };
 
+/// number of groups of consecutive processors sharing one posix shared
+/// memory file in `shmem_window_posix_split`
+constexpr int shmem_split_groups = 4;
+
 template <typename T>
 class shmem_window_posix_split {
 // TODO: visablitiy
@@ -335,10 +403,9 @@ public:
     std::vector<size_t> group_data_sizes;
     std::vector<int> sm_fds;
 
-    // group sizes (TODO: move into a separate hier-communicator object)
-    mxx::comm subcomm;
+    // groups of consecutive processors: the rows of the 2D grid
+    const grid_comm* grid;
     int num_groups;
-    int group_size;
     int group_idx;
 
     template <typename Iterator>
@@ -351,26 +418,20 @@ public:
 
         /* split communicator into groups */
 
-        num_groups = 4; // split communicator into 4 subgroups
-        if (num_groups > comm.size()) {
-            num_groups = 1;
-        }
-        group_size = comm.size() / num_groups;
-        // number of group
-        group_idx = comm.rank() / group_size;
-        // create subcommunicator (TODO: use hierarchical communicator/or 2D grid comm)
-        subcomm = comm.split(group_idx);
-        MXX_ASSERT(subcomm.rank() == comm.rank() % group_size);
+        // split communicator into (up to) 4 subgroups
+        grid = &hier_comm::get(comm).grid(shmem_split_groups);
+        num_groups = grid->rows;
+        group_idx = grid->row;
+        const mxx::comm& subcomm = grid->row_comm;
 
 
         /* get data size for each group */
         shptrs.resize(num_groups);
 
         size_t group_data_size = mxx::allreduce(local_size, subcomm);
-        // allgather group sizes
-        mxx::comm span_comm = comm.split(subcomm.rank() == 0);
+        // allgather group sizes between the first processors of the groups
         if (subcomm.rank() == 0) {
-            group_data_sizes = mxx::allgather(group_data_size, span_comm);
+            group_data_sizes = mxx::allgather(group_data_size, grid->col_comm);
         }
         mxx::bcast(group_data_sizes, 0, subcomm);
         t.end_section("create groups");
@@ -410,6 +471,10 @@ public:
         }
         t.end_section("shm close on group-master");
 
+        // all groups' shared memory files exist only after every group
+        // master has created its own
+        comm.barrier();
+
         // open shared memory pages for the string
         for (int i = 0; i < num_groups; ++i) {
             char sh_name[20];
@@ -445,7 +510,7 @@ public:
     virtual ~shmem_window_posix_split() {
         // clean up shmem
         //munmap(shptr, sizeof(CharT)*global_size);
-        if (subcomm.rank() == 0) {
+        if (grid->col == 0) {
             char sh_name[20];
             sprintf(sh_name, "/my_shmem_%d", group_idx);
             shm_unlink(sh_name);
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    cartesian_tree.hpp
+ * @brief   Distributed Cartesian tree (e.g., of the LCP array) and bulk
+ *          longest-common-extension (LCE) queries.
+ *
+ * The Cartesian tree is the min-heap ordered binary tree over the positions
+ * of an array, with ties broken by position (the leftmost minimum is the
+ * root). The parent of position `i` is the larger of its nearest
+ * smaller-or-equal value to the left and its nearest smaller value to the
+ * right. Both are given by a single ANSV, and the subtree of `i` spans
+ * exactly the positions between them. Subtree sizes thus follow without
+ * any further rounds of communication.
+ *
+ * The lowest common ancestor of two positions is the minimum of the range
+ * between them. For the LCP array, its value is the LCE of the two
+ * suffixes, which `bulk_lce()` answers in bulk via `bulk_rmq()`.
+ */
+#ifndef CARTESIAN_TREE_HPP
+#define CARTESIAN_TREE_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <algorithm>
+
+#include "ansv.hpp"
+#include "dvector.hpp"
+#include "all2all.hpp"
+#include "bulk_rma.hpp"
+#include "par_rmq.hpp"
+#include "suffix_array.hpp"
+
+/**
+ * @brief   Distributed Cartesian tree with parent and child pointers and
+ *          subtree intervals. All vectors are indexed by the local position,
+ *          all pointers and bounds are global positions.
+ */
+struct cartesian_tree {
+    /// parent of each local position, `none()` for the root
+    std::vector<size_t> parent;
+    /// left and right child of each local position, `none()` if missing
+    std::vector<size_t> left_child;
+    std::vector<size_t> right_child;
+    /// first and last (inclusive) position of each local position's subtree
+    std::vector<size_t> lb;
+    std::vector<size_t> rb;
+
+    static inline size_t none() {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    /// returns the number of nodes in the subtree of the local position `i`
+    inline size_t subtree_size(size_t i) const {
+        return rb[i] - lb[i] + 1;
+    }
+};
+
+/**
+ * @brief   Constructs the Cartesian tree of the distributed array
+ *          `local_vals`, which may have any distribution with at least one
+ *          element per processor (collective call).
+ */
+template <typename T>
+cartesian_tree construct_cartesian_tree(const std::vector<T>& local_vals, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    gen_dist part(comm, local_vals.size());
+    size_t local_size = local_vals.size();
+    size_t global_size = part.global_size();
+    size_t prefix = part.eprefix();
+    for (int i = 0; i < comm.size(); ++i)
+        MXX_ASSERT(part.local_size(i) >= 1);
+
+    const size_t none = cartesian_tree::none();
+    std::vector<size_t> left_nsv;
+    std::vector<size_t> right_nsv;
+    std::vector<std::pair<T, size_t>> lr_mins;
+    ansv<T, nearest_eq, nearest_sm, local_indexing>(local_vals, left_nsv, right_nsv, lr_mins, comm, none);
+    t.end_section("cartesian tree: ansv");
+
+    // resolves the local index of the nsv of `i` into its global position and value
+    auto resolve = [&](size_t i, size_t nsv, size_t& pos, T& val) {
+        if (nsv == none)
+            return false;
+        if (nsv < local_size) {
+            pos = prefix + nsv;
+            val = local_vals[nsv];
+        } else {
+            pos = lr_mins[nsv - local_size].second;
+            val = lr_mins[nsv - local_size].first;
+        }
+        return pos != prefix + i;
+    };
+
+    cartesian_tree tree;
+    tree.parent.resize(local_size, none);
+    tree.left_child.resize(local_size, none);
+    tree.right_child.resize(local_size, none);
+    tree.lb.resize(local_size);
+    tree.rb.resize(local_size);
+    // (parent, child) edges, the child is a right child if it lies to the right
+    std::vector<std::pair<size_t, size_t>> edges;
+    edges.reserve(local_size);
+    for (size_t i = 0; i < local_size; ++i) {
+        size_t lpos, rpos;
+        T lval = T(), rval = T();
+        bool has_left = resolve(i, left_nsv[i], lpos, lval);
+        bool has_right = resolve(i, right_nsv[i], rpos, rval);
+        tree.lb[i] = has_left ? lpos + 1 : 0;
+        tree.rb[i] = has_right ? rpos - 1 : global_size - 1;
+        if (has_left && (!has_right || lval > rval)) {
+            tree.parent[i] = lpos;
+        } else if (has_right) {
+            tree.parent[i] = rpos;
+        }
+        if (tree.parent[i] != none)
+            edges.emplace_back(tree.parent[i], prefix + i);
+    }
+    t.end_section("cartesian tree: parents");
+
+    // send each child to its parent
+    auto_all2all_func(edges, [&part](const std::pair<size_t, size_t>& e) { return part.target_processor(e.first); }, comm);
+    for (const std::pair<size_t, size_t>& e : edges) {
+        if (e.second < e.first)
+            tree.left_child[e.first - prefix] = e.second;
+        else
+            tree.right_child[e.first - prefix] = e.second;
+    }
+    t.end_section("cartesian tree: children");
+
+    return tree;
+}
+
+/**
+ * @brief   Returns the minimum of the distributed array `local_els` in each
+ *          of the given non-empty global ranges [first, second)
+ *          (collective call).
+ *
+ * `bulk_rmq()` addresses its answers by global positions of the requesting
+ * processor, so the ranges are answered in rounds of at most `local_size`
+ * ranges per processor.
+ */
+template <typename index_t, typename Partition>
+std::vector<index_t> bulk_range_min(const Partition& part, const std::vector<index_t>& local_els,
+                                    const std::vector<std::pair<size_t, size_t>>& ranges, const mxx::comm& comm) {
+    size_t local_size = local_els.size();
+    MXX_ASSERT(local_size >= 1);
+    size_t prefix = part.excl_prefix_size();
+    size_t rounds = mxx::allreduce((ranges.size() + local_size - 1) / local_size, mxx::max<size_t>(), comm);
+
+    std::vector<index_t> result(ranges.size());
+    std::vector<std::tuple<index_t, index_t, index_t>> queries;
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t begin = std::min(r*local_size, ranges.size());
+        size_t end = std::min(begin + local_size, ranges.size());
+        queries.clear();
+        for (size_t i = begin; i < end; ++i) {
+            MXX_ASSERT(ranges[i].first < ranges[i].second);
+            queries.emplace_back(prefix + (i - begin), ranges[i].first, ranges[i].second);
+        }
+        bulk_rmq(part, local_els, queries, comm);
+        // the answers are sorted by the query index
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = std::get<2>(queries[i - begin]);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief   Returns the length of the longest common prefix of the suffixes
+ *          starting at the given pairs of string positions (collective
+ *          call).
+ *
+ * Requires the LCP and ISA (`local_B`) of the suffix array.
+ */
+template <typename char_t, typename index_t>
+std::vector<index_t> bulk_lce(const suffix_array<char_t, index_t, true>& sa, const std::vector<std::pair<size_t, size_t>>& pos_pairs, const mxx::comm& comm) {
+    const gen_dist& part = sa.distribution();
+    MXX_ASSERT(sa.local_B.size() == sa.local_LCP.size());
+
+    // get the SA ranks of both suffixes
+    std::vector<size_t> positions(2*pos_pairs.size());
+    for (size_t i = 0; i < pos_pairs.size(); ++i) {
+        positions[2*i] = pos_pairs[i].first;
+        positions[2*i+1] = pos_pairs[i].second;
+    }
+    std::vector<index_t> ranks = bulk_rma(part, sa.local_B.begin(), sa.local_B.end(), positions, comm);
+
+    // the LCE is the minimum LCP between the two ranks
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<size_t> range_idx;
+    for (size_t i = 0; i < pos_pairs.size(); ++i) {
+        size_t a = std::min(ranks[2*i], ranks[2*i+1]);
+        size_t b = std::max(ranks[2*i], ranks[2*i+1]);
+        if (a != b) {
+            ranges.emplace_back(a + 1, b + 1);
+            range_idx.push_back(i);
+        }
+    }
+    std::vector<index_t> mins = bulk_range_min(part, sa.local_LCP, ranges, comm);
+
+    // identical suffixes extend to the end of the string
+    std::vector<index_t> result(pos_pairs.size());
+    for (size_t i = 0; i < pos_pairs.size(); ++i) {
+        result[i] = sa.global_size() - pos_pairs[i].first;
+    }
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        result[range_idx[i]] = mins[i];
+    }
+    return result;
+}
+
+#endif // CARTESIAN_TREE_HPP
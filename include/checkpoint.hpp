@@ -0,0 +1,339 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    checkpoint.hpp
+ * @brief   Checkpoints of the prefix doubling state and recovery from the
+ *          loss of processors.
+ *
+ * A checkpoint consists of one file per processor holding its block of the
+ * bucket array (in ISA order) and of the partial LCP array, plus a meta file
+ * which records the global block offsets and a fingerprint of the input
+ * string (see `input_fingerprint()`). The meta file is replaced
+ * atomically once all blocks are written, so it always describes a complete
+ * checkpoint. Since the block offsets are stored, a checkpoint can be
+ * restored on any number of processors (e.g., after a restart with fewer
+ * processors, or by the survivors of a failure).
+ *
+ * With ULFM enabled MPI libraries (`ENABLE_ULFM`, defines `PSAC_ULFM`),
+ * `shrink_comm()` excludes failed processors from a communicator.
+ */
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <mpi.h>
+#ifdef PSAC_ULFM
+#include <mpi-ext.h>
+#endif
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/partition.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+/**
+ * @brief   The global state of a prefix doubling checkpoint.
+ */
+struct checkpoint_info {
+    /// global input size
+    std::size_t n;
+    /// the prefix doubling iteration (shift) at which to resume
+    std::size_t shift_by;
+    /// the initial k-mer size
+    std::size_t k;
+    /// whether the checkpoint contains the partial LCP array
+    bool has_lcp;
+    /// fingerprint of the input string
+    uint64_t fingerprint;
+    /// the global offset of the block of each processor which wrote the
+    /// checkpoint (size p+1)
+    std::vector<std::size_t> offsets;
+};
+
+namespace checkpoint_impl {
+
+const uint64_t magic = 0x32504b4343415350ull; // "PSACCKP2"
+
+// mixes a character with its position (the splitmix64 finalizer)
+inline uint64_t mix(uint64_t pos, uint64_t c) {
+    uint64_t z = pos * 0x9e3779b97f4a7c15ull + c + 1;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline std::string meta_file(const std::string& prefix) {
+    return prefix + ".meta";
+}
+
+inline std::string block_file(const std::string& prefix, std::size_t shift_by, int rank) {
+    return prefix + "." + std::to_string(shift_by) + "." + std::to_string(rank);
+}
+
+// reads the meta file (on a single processor); returns false if there is no
+// valid checkpoint
+inline bool read_meta(const std::string& prefix, std::size_t index_size, checkpoint_info& info) {
+    std::ifstream f(meta_file(prefix), std::ios::binary);
+    if (!f.good())
+        return false;
+    uint64_t header[8];
+    f.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!f.good() || header[0] != magic || header[6] != index_size)
+        return false;
+    info.n = header[1];
+    info.shift_by = header[2];
+    info.k = header[3];
+    info.has_lcp = header[4] != 0;
+    info.fingerprint = header[7];
+    std::vector<uint64_t> offsets(header[5]+1);
+    f.read(reinterpret_cast<char*>(&offsets[0]), sizeof(uint64_t)*offsets.size());
+    if (!f.good() || offsets.back() != info.n)
+        return false;
+    info.offsets.assign(offsets.begin(), offsets.end());
+    return true;
+}
+
+inline bool write_meta(const std::string& prefix, std::size_t index_size, const checkpoint_info& info) {
+    std::string tmp = meta_file(prefix) + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary);
+        uint64_t header[8] = {magic, info.n, info.shift_by, info.k, info.has_lcp, info.offsets.size()-1, index_size, info.fingerprint};
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        std::vector<uint64_t> offsets(info.offsets.begin(), info.offsets.end());
+        f.write(reinterpret_cast<const char*>(&offsets[0]), sizeof(uint64_t)*offsets.size());
+        f.close();
+        if (!f.good())
+            return false;
+    }
+    // atomically replaces the previous checkpoint
+    return std::rename(tmp.c_str(), meta_file(prefix).c_str()) == 0;
+}
+
+// returns the checkpoint as seen by processor 0 (collective call)
+template <typename index_t>
+bool bcast_meta(const std::string& prefix, checkpoint_info& info, const mxx::comm& comm) {
+    int valid = 0;
+    std::vector<std::size_t> buf;
+    if (comm.rank() == 0) {
+        valid = read_meta(prefix, sizeof(index_t), info);
+        if (valid) {
+            buf.push_back(info.n);
+            buf.push_back(info.shift_by);
+            buf.push_back(info.k);
+            buf.push_back(info.has_lcp);
+            buf.push_back(info.fingerprint);
+            buf.insert(buf.end(), info.offsets.begin(), info.offsets.end());
+        }
+    }
+    mxx::bcast(valid, 0, comm);
+    if (!valid)
+        return false;
+    std::size_t buf_size = buf.size();
+    mxx::bcast(buf_size, 0, comm);
+    buf.resize(buf_size);
+    mxx::bcast(buf, 0, comm);
+    info.n = buf[0];
+    info.shift_by = buf[1];
+    info.k = buf[2];
+    info.has_lcp = buf[3] != 0;
+    info.fingerprint = buf[4];
+    info.offsets.assign(buf.begin() + 5, buf.end());
+    return true;
+}
+
+} // namespace checkpoint_impl
+
+/**
+ * @brief   Returns a fingerprint of the distributed input string, which only
+ *          depends on the global string and not on its distribution
+ *          (collective call).
+ *
+ * Checkpoints store this fingerprint, such that they are only resumed for
+ * the same input. It costs one pass over the local input and an exscan and
+ * allreduce.
+ */
+template <typename Iterator>
+uint64_t input_fingerprint(Iterator begin, Iterator end, const mxx::comm& comm) {
+    std::size_t local_size = std::distance(begin, end);
+    std::size_t pos = mxx::exscan(local_size, comm);
+    if (comm.rank() == 0)
+        pos = 0;
+    uint64_t h = 0;
+    for (Iterator it = begin; it != end; ++it, ++pos)
+        h += checkpoint_impl::mix(pos, static_cast<uint64_t>(*it));
+    return mxx::allreduce(h, comm);
+}
+
+/**
+ * @brief   Writes a checkpoint of the bucket array `local_B` and the partial
+ *          LCP array `local_LCP` (which may be empty) and removes the
+ *          previous checkpoint with the same prefix (collective call).
+ *
+ * Both arrays may be distributed arbitrarily, but `local_LCP` must either
+ * be empty on all processors or of the same size as `local_B`.
+ * `fingerprint` identifies the input string (see `input_fingerprint()`).
+ *
+ * @throws std::runtime_error   If the checkpoint could not be written on
+ *                              any processor.
+ */
+template <typename index_t>
+void write_checkpoint(const std::string& prefix, std::size_t shift_by, std::size_t k, uint64_t fingerprint,
+                      const std::vector<index_t>& local_B, const std::vector<index_t>& local_LCP,
+                      const mxx::comm& comm) {
+    checkpoint_info prev;
+    bool has_prev = checkpoint_impl::bcast_meta<index_t>(prefix, prev, comm);
+
+    checkpoint_info info;
+    info.shift_by = shift_by;
+    info.k = k;
+    info.has_lcp = !local_LCP.empty();
+    info.fingerprint = fingerprint;
+    std::vector<std::size_t> sizes = mxx::allgather(local_B.size(), comm);
+    info.offsets.resize(sizes.size()+1, 0);
+    for (std::size_t i = 0; i < sizes.size(); ++i)
+        info.offsets[i+1] = info.offsets[i] + sizes[i];
+    info.n = info.offsets.back();
+
+    // 1) write the local blocks
+    bool ok;
+    {
+        std::ofstream f(checkpoint_impl::block_file(prefix, shift_by, comm.rank()), std::ios::binary);
+        f.write(reinterpret_cast<const char*>(local_B.data()), sizeof(index_t)*local_B.size());
+        f.write(reinterpret_cast<const char*>(local_LCP.data()), sizeof(index_t)*local_LCP.size());
+        f.close();
+        ok = f.good();
+    }
+    if (!mxx::all_of(ok, comm))
+        throw std::runtime_error("Writing the checkpoint blocks to `" + prefix + "` failed.");
+
+    // 2) commit the checkpoint
+    int committed = 0;
+    if (comm.rank() == 0)
+        committed = checkpoint_impl::write_meta(prefix, sizeof(index_t), info);
+    mxx::bcast(committed, 0, comm);
+    if (!committed)
+        throw std::runtime_error("Writing the checkpoint meta file `" + checkpoint_impl::meta_file(prefix) + "` failed.");
+
+    // 3) remove the blocks of the previous checkpoint
+    if (has_prev && prev.shift_by != shift_by) {
+        for (int r = comm.rank(); r+1 < static_cast<int>(prev.offsets.size()); r += comm.size())
+            std::remove(checkpoint_impl::block_file(prefix, prev.shift_by, r).c_str());
+    }
+}
+
+/**
+ * @brief   Restores the last checkpoint with the given prefix, block
+ *          decomposed (`block_decomposition_buffered`) across the given
+ *          communicator (collective call).
+ *
+ * @return  `false` if there is no valid checkpoint with the given prefix.
+ * @throws std::runtime_error   If the checkpoint blocks can not be read.
+ */
+template <typename index_t>
+bool read_checkpoint(const std::string& prefix, checkpoint_info& info,
+                     std::vector<index_t>& local_B, std::vector<index_t>& local_LCP,
+                     const mxx::comm& comm) {
+    if (!checkpoint_impl::bcast_meta<index_t>(prefix, info, comm))
+        return false;
+
+    mxx::partition::block_decomposition_buffered<std::size_t> part(info.n, comm.size(), comm.rank());
+    std::size_t begin = part.excl_prefix_size();
+    std::size_t end = begin + part.local_size();
+    local_B.resize(end - begin);
+    local_LCP.resize(info.has_lcp ? end - begin : 0);
+
+    // read the overlapping parts of the blocks of the previous processors
+    const std::vector<std::size_t>& off = info.offsets;
+    bool ok = true;
+    int r = std::upper_bound(off.begin(), off.end(), begin) - off.begin() - 1;
+    for (; ok && begin < end; ++r) {
+        std::size_t block_size = off[r+1] - off[r];
+        std::size_t cnt = std::min(end, off[r+1]) - begin;
+        if (cnt == 0)
+            continue;
+        std::ifstream f(checkpoint_impl::block_file(prefix, info.shift_by, r), std::ios::binary);
+        std::size_t pos = begin - off[r];
+        std::size_t out = begin - part.excl_prefix_size();
+        f.seekg(sizeof(index_t)*pos);
+        f.read(reinterpret_cast<char*>(&local_B[out]), sizeof(index_t)*cnt);
+        if (info.has_lcp) {
+            f.seekg(sizeof(index_t)*(block_size + pos));
+            f.read(reinterpret_cast<char*>(&local_LCP[out]), sizeof(index_t)*cnt);
+        }
+        ok = f.good();
+        begin += cnt;
+    }
+    if (!mxx::all_of(ok, comm))
+        throw std::runtime_error("Reading the checkpoint blocks of `" + prefix + "` failed.");
+    return true;
+}
+
+/**
+ * @brief   Removes the last checkpoint with the given prefix (collective call).
+ */
+template <typename index_t>
+void remove_checkpoint(const std::string& prefix, const mxx::comm& comm) {
+    checkpoint_info info;
+    if (!checkpoint_impl::bcast_meta<index_t>(prefix, info, comm))
+        return;
+    comm.barrier();
+    if (comm.rank() == 0)
+        std::remove(checkpoint_impl::meta_file(prefix).c_str());
+    for (int r = comm.rank(); r+1 < static_cast<int>(info.offsets.size()); r += comm.size())
+        std::remove(checkpoint_impl::block_file(prefix, info.shift_by, r).c_str());
+}
+
+/// whether `shrink_comm()` is supported by the MPI library
+inline bool comm_shrink_supported() {
+#ifdef PSAC_ULFM
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief   Revokes the given communicator and returns a new communicator of
+ *          all its surviving processors. This has to be called by all
+ *          surviving processors, after any of them observed a failure.
+ *
+ * @throws std::runtime_error   If the MPI library has no ULFM support.
+ */
+inline mxx::comm shrink_comm(const mxx::comm& comm) {
+#ifdef PSAC_ULFM
+    MPI_Comm c = comm;
+    MPIX_Comm_revoke(c);
+    MPI_Comm shrunk;
+    MPIX_Comm_shrink(c, &shrunk);
+    // the duplicate owns its MPI communicator and inherits the error handler
+    mxx::comm result = mxx::comm(shrunk).copy();
+    MPI_Comm_free(&shrunk);
+    return result;
+#else
+    (void) comm;
+    throw std::runtime_error("Shrinking communicators requires an MPI library with ULFM support (ENABLE_ULFM).");
+#endif
+}
+
+#endif // CHECKPOINT_HPP
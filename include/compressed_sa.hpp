@@ -0,0 +1,398 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    compressed_sa.hpp
+ * @brief   Export of the distributed SA and ISA as a compressed suffix array
+ *          (Ψ plus sampled SA and ISA), and a loader with random access.
+ *
+ * The compressed suffix array consists of
+ *  - Ψ[i] = ISA[(SA[i]+1) mod n], which is increasing within the SA-interval
+ *    of each character. It is stored in blocks of `psi_block` values, each
+ *    with its first value in plain, followed by the Elias-gamma coded
+ *    differences to the previous value. A decrease (at most once per
+ *    character) is coded as an escape followed by the absolute value.
+ *  - the SA values at the rows i with SA[i] mod s = 0, together with a bit
+ *    vector marking these rows. SA[i] follows from the first sampled row
+ *    j = Ψ^d(i) as SA[i] = SA[j] - d (mod n), with d < s.
+ *  - the ISA values at all text positions t with t mod s = 0. ISA[t] is
+ *    Ψ^(t mod s)(ISA[t - t mod s]).
+ *
+ * As for checkpoints, each processor writes the data of its own block into
+ * its own file, and processor 0 writes the meta file with the global block
+ * offsets once all blocks are written.
+ */
+#ifndef COMPRESSED_SA_HPP
+#define COMPRESSED_SA_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "bitops.hpp"
+#include "bulk_rma.hpp"
+#include "suffix_array.hpp"
+
+namespace csa_impl {
+
+const uint64_t magic = 0x3141534343415350ull; // "PSACCSA1"
+
+inline std::string meta_file(const std::string& prefix) {
+    return prefix + ".csa";
+}
+
+inline std::string block_file(const std::string& prefix, int rank) {
+    return prefix + ".csa." + std::to_string(rank);
+}
+
+/// appends bits (MSB first) to a vector of 64 bit words
+class bit_writer {
+public:
+    std::vector<uint64_t> words;
+    uint64_t num_bits = 0;
+
+    /// appends the lowest `len` bits of `x`
+    inline void write(uint64_t x, unsigned int len) {
+        if (len == 0)
+            return;
+        if (len < 64)
+            x &= (static_cast<uint64_t>(1) << len) - 1;
+        unsigned int off = num_bits % 64;
+        if (off == 0)
+            words.push_back(0);
+        unsigned int room = 64 - off;
+        if (len <= room) {
+            words.back() |= x << (room - len);
+        } else {
+            words.back() |= x >> (len - room);
+            words.push_back(x << (64 - (len - room)));
+        }
+        num_bits += len;
+    }
+
+    /// appends the Elias-gamma code of `x >= 1`
+    inline void write_gamma(uint64_t x) {
+        unsigned int len = floorlog2(x);
+        write(0, len);
+        write(x, len + 1);
+    }
+};
+
+/// returns the 64 bits starting at bit `pos`, padded with zeros
+inline uint64_t read_window(const std::vector<uint64_t>& words, uint64_t pos) {
+    std::size_t w = pos / 64;
+    unsigned int off = pos % 64;
+    uint64_t x = w < words.size() ? words[w] << off : 0;
+    if (off > 0 && w + 1 < words.size())
+        x |= words[w+1] >> (64 - off);
+    return x;
+}
+
+/// reads the Elias-gamma code at bit `pos` and advances `pos`
+inline uint64_t read_gamma(const std::vector<uint64_t>& words, uint64_t& pos) {
+    unsigned int len = leading_zeros_64(read_window(words, pos));
+    pos += len;
+    uint64_t x = read_window(words, pos) >> (63 - len);
+    pos += len + 1;
+    return x;
+}
+
+// escape code for a decrease of Ψ
+const uint64_t psi_escape = 1;
+
+template <typename T>
+inline void write_vector(std::ofstream& f, const std::vector<T>& vec) {
+    uint64_t size = vec.size();
+    f.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    f.write(reinterpret_cast<const char*>(vec.data()), sizeof(T)*vec.size());
+}
+
+template <typename T>
+inline void read_vector(std::ifstream& f, std::vector<T>& vec) {
+    uint64_t size = 0;
+    f.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!f.good())
+        return;
+    vec.resize(size);
+    f.read(reinterpret_cast<char*>(vec.data()), sizeof(T)*vec.size());
+}
+
+} // namespace csa_impl
+
+/**
+ * @brief   Writes the compressed suffix array of the distributed `local_SA`
+ *          and `local_ISA` (with the same distribution) to files with the
+ *          given prefix (collective call).
+ *
+ * @param sample_rate   The sampling rate `s` of the SA and ISA values.
+ * @param psi_block     The number of Ψ values per block with a plain sample.
+ *
+ * @throws std::runtime_error   If the files could not be written.
+ */
+template <typename index_t>
+void write_compressed_sa(const std::string& prefix, const std::vector<index_t>& local_SA, const std::vector<index_t>& local_ISA,
+                         std::size_t sample_rate, const mxx::comm& comm, std::size_t psi_block = 64) {
+    mxx::section_timer t(std::cerr, comm);
+    MXX_ASSERT(local_SA.size() == local_ISA.size());
+    MXX_ASSERT(sample_rate > 0 && psi_block > 0);
+    std::size_t local_size = local_SA.size();
+    gen_dist part(comm, local_size);
+    std::size_t n = part.global_size();
+    std::size_t prefix_size = part.eprefix();
+
+    // Ψ[i] = ISA[SA[i]+1]
+    std::vector<std::size_t> idx(local_size);
+    for (std::size_t i = 0; i < local_size; ++i)
+        idx[i] = (local_SA[i] + 1 == n) ? 0 : local_SA[i] + 1;
+    std::vector<index_t> psi = bulk_rma(part, local_ISA.begin(), local_ISA.end(), idx, comm);
+    idx = std::vector<std::size_t>();
+    t.end_section("compressed SA: psi");
+
+    // differential encoding of Ψ
+    std::vector<uint64_t> psi_samples;
+    csa_impl::bit_writer bits;
+    for (std::size_t i = 0; i < local_size; ++i) {
+        if (i % psi_block == 0) {
+            psi_samples.push_back(psi[i]);
+            psi_samples.push_back(bits.num_bits);
+        } else if (psi[i] > psi[i-1]) {
+            bits.write_gamma(static_cast<uint64_t>(psi[i] - psi[i-1]) + 1);
+        } else {
+            bits.write_gamma(csa_impl::psi_escape);
+            bits.write_gamma(static_cast<uint64_t>(psi[i]) + 1);
+        }
+    }
+    psi = std::vector<index_t>();
+
+    // sampled SA (by text position) and ISA
+    std::vector<uint64_t> sampled_rows((local_size + 63) / 64, 0);
+    std::vector<index_t> sa_samples;
+    for (std::size_t i = 0; i < local_size; ++i) {
+        if (local_SA[i] % sample_rate == 0) {
+            sampled_rows[i / 64] |= static_cast<uint64_t>(1) << (i % 64);
+            sa_samples.push_back(local_SA[i]);
+        }
+    }
+    std::vector<index_t> isa_samples;
+    for (std::size_t i = (sample_rate - prefix_size % sample_rate) % sample_rate; i < local_size; i += sample_rate)
+        isa_samples.push_back(local_ISA[i]);
+    t.end_section("compressed SA: encode");
+
+    // write the local block
+    bool ok;
+    {
+        std::ofstream f(csa_impl::block_file(prefix, comm.rank()), std::ios::binary);
+        csa_impl::write_vector(f, psi_samples);
+        csa_impl::write_vector(f, bits.words);
+        csa_impl::write_vector(f, sampled_rows);
+        csa_impl::write_vector(f, sa_samples);
+        csa_impl::write_vector(f, isa_samples);
+        f.close();
+        ok = f.good();
+    }
+    if (!mxx::all_of(ok, comm))
+        throw std::runtime_error("Writing the compressed SA blocks to `" + prefix + "` failed.");
+
+    // meta data: global parameters and block offsets
+    std::vector<std::size_t> sizes = mxx::gather(local_size, 0, comm);
+    int written = 0;
+    if (comm.rank() == 0) {
+        std::ofstream f(csa_impl::meta_file(prefix), std::ios::binary);
+        uint64_t header[6] = {csa_impl::magic, n, sample_rate, psi_block, sizeof(index_t), sizes.size()};
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        std::vector<uint64_t> offsets(sizes.size()+1, 0);
+        for (std::size_t i = 0; i < sizes.size(); ++i)
+            offsets[i+1] = offsets[i] + sizes[i];
+        f.write(reinterpret_cast<const char*>(&offsets[0]), sizeof(uint64_t)*offsets.size());
+        f.close();
+        written = f.good();
+    }
+    mxx::bcast(written, 0, comm);
+    if (!written)
+        throw std::runtime_error("Writing the compressed SA meta file `" + csa_impl::meta_file(prefix) + "` failed.");
+    t.end_section("compressed SA: write");
+}
+
+/**
+ * @brief   Writes the compressed suffix array of a constructed suffix array
+ *          (collective call).
+ */
+template <typename char_t, typename index_t, bool _CONSTRUCT_LCP>
+void write_compressed_sa(const std::string& prefix, const suffix_array<char_t, index_t, _CONSTRUCT_LCP>& sa, std::size_t sample_rate, const mxx::comm& comm, std::size_t psi_block = 64) {
+    write_compressed_sa(prefix, sa.local_SA, sa.local_B, sample_rate, comm, psi_block);
+}
+
+/**
+ * @brief   A compressed suffix array, as written by `write_compressed_sa()`,
+ *          loaded on a single processor with random access to Ψ, SA and ISA.
+ */
+template <typename index_t = std::size_t>
+class compressed_suffix_array {
+private:
+    std::size_t n;
+    std::size_t sample_rate;
+    std::size_t psi_block;
+    /// global row offsets of the written blocks
+    std::vector<std::size_t> offsets;
+    /// the index of the first Ψ sample of each written block
+    std::vector<std::size_t> block_samples;
+    /// (first value, bit position) of each block of Ψ values
+    std::vector<uint64_t> psi_samples;
+    /// gamma coded differences of Ψ
+    std::vector<uint64_t> psi_bits;
+    /// marks the rows with a sampled SA value
+    std::vector<uint64_t> sampled_rows;
+    /// number of marked rows before each word of `sampled_rows`
+    std::vector<std::size_t> sampled_rank;
+    std::vector<index_t> sa_samples;
+    std::vector<index_t> isa_samples;
+
+public:
+    compressed_suffix_array() : n(0), sample_rate(1), psi_block(1) {}
+
+    /**
+     * @brief   Loads the compressed suffix array with the given prefix.
+     *
+     * @throws std::runtime_error   If the files are missing or inconsistent.
+     */
+    explicit compressed_suffix_array(const std::string& prefix) {
+        load(prefix);
+    }
+
+    void load(const std::string& prefix) {
+        std::ifstream meta(csa_impl::meta_file(prefix), std::ios::binary);
+        uint64_t header[6];
+        meta.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!meta.good() || header[0] != csa_impl::magic || header[4] != sizeof(index_t))
+            throw std::runtime_error("`" + csa_impl::meta_file(prefix) + "` is not a compressed SA with this index type.");
+        n = header[1];
+        sample_rate = header[2];
+        psi_block = header[3];
+        std::vector<uint64_t> off(header[5]+1);
+        meta.read(reinterpret_cast<char*>(&off[0]), sizeof(uint64_t)*off.size());
+        if (!meta.good() || off.back() != n)
+            throw std::runtime_error("Invalid compressed SA meta file `" + csa_impl::meta_file(prefix) + "`.");
+        offsets.assign(off.begin(), off.end());
+
+        // concatenate the blocks
+        block_samples.clear();
+        psi_samples.clear();
+        psi_bits.clear();
+        sampled_rows.assign((n + 63) / 64, 0);
+        sa_samples.clear();
+        isa_samples.clear();
+        for (std::size_t r = 0; r+1 < offsets.size(); ++r) {
+            std::ifstream f(csa_impl::block_file(prefix, r), std::ios::binary);
+            std::vector<uint64_t> samples, bits, rows;
+            std::vector<index_t> sa, isa;
+            csa_impl::read_vector(f, samples);
+            csa_impl::read_vector(f, bits);
+            csa_impl::read_vector(f, rows);
+            csa_impl::read_vector(f, sa);
+            csa_impl::read_vector(f, isa);
+            if (!f.good())
+                throw std::runtime_error("Reading the compressed SA block `" + csa_impl::block_file(prefix, r) + "` failed.");
+            block_samples.push_back(psi_samples.size() / 2);
+            uint64_t bit_offset = 64 * psi_bits.size();
+            for (std::size_t i = 0; i < samples.size(); i += 2) {
+                psi_samples.push_back(samples[i]);
+                psi_samples.push_back(samples[i+1] + bit_offset);
+            }
+            psi_bits.insert(psi_bits.end(), bits.begin(), bits.end());
+            for (std::size_t i = 0; i < offsets[r+1] - offsets[r]; ++i) {
+                if ((rows[i / 64] >> (i % 64)) & 1) {
+                    std::size_t row = offsets[r] + i;
+                    sampled_rows[row / 64] |= static_cast<uint64_t>(1) << (row % 64);
+                }
+            }
+            sa_samples.insert(sa_samples.end(), sa.begin(), sa.end());
+            isa_samples.insert(isa_samples.end(), isa.begin(), isa.end());
+        }
+        sampled_rank.resize(sampled_rows.size());
+        std::size_t rank = 0;
+        for (std::size_t i = 0; i < sampled_rows.size(); ++i) {
+            sampled_rank[i] = rank;
+            rank += __builtin_popcountll(sampled_rows[i]);
+        }
+        if (rank != sa_samples.size() || isa_samples.size() != (n + sample_rate - 1) / sample_rate)
+            throw std::runtime_error("Inconsistent samples in the compressed SA `" + prefix + "`.");
+    }
+
+    /// the length of the string
+    inline std::size_t size() const {
+        return n;
+    }
+
+    /// the sampling rate of the SA and ISA
+    inline std::size_t sampling_rate() const {
+        return sample_rate;
+    }
+
+    /// the size of the compressed data in bytes
+    std::size_t size_in_bytes() const {
+        return sizeof(uint64_t) * (psi_samples.size() + psi_bits.size() + sampled_rows.size())
+            + sizeof(std::size_t) * (sampled_rank.size() + offsets.size() + block_samples.size())
+            + sizeof(index_t) * (sa_samples.size() + isa_samples.size());
+    }
+
+    /// returns Ψ[i] = ISA[(SA[i]+1) mod n]
+    index_t psi(std::size_t i) const {
+        std::size_t r = std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin() - 1;
+        std::size_t local = i - offsets[r];
+        std::size_t b = block_samples[r] + local / psi_block;
+        uint64_t value = psi_samples[2*b];
+        uint64_t pos = psi_samples[2*b+1];
+        for (std::size_t j = 0; j < local % psi_block; ++j) {
+            uint64_t code = csa_impl::read_gamma(psi_bits, pos);
+            if (code == csa_impl::psi_escape)
+                value = csa_impl::read_gamma(psi_bits, pos) - 1;
+            else
+                value += code - 1;
+        }
+        return value;
+    }
+
+    /// returns SA[i] (at most `s-1` steps of Ψ)
+    index_t sa(std::size_t i) const {
+        std::size_t d = 0;
+        while (!((sampled_rows[i / 64] >> (i % 64)) & 1)) {
+            i = psi(i);
+            ++d;
+        }
+        uint64_t mask = (static_cast<uint64_t>(1) << (i % 64)) - 1;
+        std::size_t rank = sampled_rank[i / 64] + __builtin_popcountll(sampled_rows[i / 64] & mask);
+        std::size_t v = sa_samples[rank];
+        return (v + n - d) % n;
+    }
+
+    /// returns ISA[t] (at most `s-1` steps of Ψ)
+    index_t isa(std::size_t t) const {
+        std::size_t i = isa_samples[t / sample_rate];
+        for (std::size_t d = 0; d < t % sample_rate; ++d)
+            i = psi(i);
+        return i;
+    }
+};
+
+#endif // COMPRESSED_SA_HPP
@@ -0,0 +1,527 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    document_array.hpp
+ * @brief   Distributed document and color arrays for generalized suffix
+ *          arrays and batched document/color listing with frequencies.
+ */
+#ifndef DOCUMENT_ARRAY_HPP
+#define DOCUMENT_ARRAY_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/partition.hpp>
+#include <mxx/shift.hpp>
+#include <mxx/sort.hpp>
+#include <mxx/distribution.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <tuple>
+#include <algorithm>
+#include <stdexcept>
+
+#include "stringset.hpp"
+#include "bulk_rma.hpp"
+#include "all2all.hpp"
+#include "rmq.hpp"
+#include "bitops.hpp"
+#include "suffix_tree.hpp"
+
+/**
+ * @brief   Returns the block distributed concatenation of all sequences of
+ *          the string set (without separators), i.e., the string indexed by
+ *          the generalized suffix array constructed via `construct_ss`
+ *          (collective call).
+ */
+inline std::string concat_stringset(const simple_dstringset& ss, const mxx::comm& comm) {
+    std::string local_str;
+    local_str.reserve(ss.sum_sizes);
+    for (size_t i = 0; i < ss.sizes.size(); ++i) {
+        local_str.append(ss.str_begins[i], ss.sizes[i]);
+    }
+    return mxx::stable_distribute(local_str, comm);
+}
+
+/**
+ * @brief   Listing of the distinct keys (documents or colors) and their
+ *          number of occurrences in SA-intervals.
+ *
+ * Listing follows Muthukrishnan's technique: for each SA position `i`,
+ * `C[i]` is the previous position of a suffix with the same key. The
+ * distinct keys in `[l, r)` are exactly the positions `i` in the range with
+ * `C[i] < l`, which are found via recursive range-minimum queries without
+ * enumerating all occurrences. The symmetric array `N` of next positions
+ * gives the last occurrences, and the frequency of a key is the distance of
+ * its first and last occurrence in the key-sorted order of all suffixes.
+ *
+ * Ranges are split at processor boundaries and each part is answered by a
+ * local RMQ on the processor owning it, so each batch needs a single round
+ * of all2all communication.
+ *
+ * The listing keeps `C`, `N` and `P` as three `index_t` arrays of the local
+ * size of the SA, plus the RMQ structures over `C` and `N` during `list()`.
+ */
+template <typename index_t = std::size_t>
+class range_listing {
+private:
+    /// The global size of the suffix array
+    std::size_t n;
+
+    /// The distribution of the suffix array
+    gen_dist part;
+
+    /// `C[i]+1` for the previous SA position with the same key, or 0
+    std::vector<index_t> local_C;
+
+    /// `n - N[i]` for the next SA position with the same key
+    /// (`N[i] = n` if none)
+    std::vector<index_t> local_Nrev;
+
+    /// position of each suffix in the key-sorted order
+    std::vector<index_t> local_P;
+
+public:
+    range_listing() : n(0) {}
+
+    /**
+     * @brief   Initializes the listing for the given key of each suffix in
+     *          the local block of the SA (collective call).
+     *
+     * Sorts all suffixes by (key, SA position) to get the previous and next
+     * occurrences of each key and the key-sorted position.
+     */
+    range_listing(const std::vector<index_t>& local_keys, const mxx::comm& comm) {
+        std::size_t local_size = local_keys.size();
+        part = gen_dist(comm, local_size);
+        n = part.global_size();
+        std::size_t prefix = part.excl_prefix_size();
+        std::vector<std::pair<index_t, index_t> > keys(local_size);
+        for (std::size_t i = 0; i < local_size; ++i) {
+            keys[i] = std::pair<index_t, index_t>(local_keys[i], prefix + i);
+        }
+        mxx::sort(keys.begin(), keys.end(), comm);
+
+        std::pair<index_t, index_t> left = mxx::right_shift(keys.back(), comm);
+        std::pair<index_t, index_t> right = mxx::left_shift(keys.front(), comm);
+        // tuples (SA position, C, N, P)
+        std::vector<std::tuple<index_t, index_t, index_t, index_t> > tuples(local_size);
+        for (std::size_t j = 0; j < local_size; ++j) {
+            index_t c = 0;
+            if (j > 0 && keys[j-1].first == keys[j].first)
+                c = keys[j-1].second + 1;
+            else if (j == 0 && comm.rank() > 0 && left.first == keys[j].first)
+                c = left.second + 1;
+            index_t nx = n;
+            if (j+1 < local_size && keys[j+1].first == keys[j].first)
+                nx = keys[j+1].second;
+            else if (j+1 == local_size && comm.rank()+1 < comm.size() && right.first == keys[j].first)
+                nx = right.second;
+            tuples[j] = std::make_tuple(keys[j].second, c, nx, prefix + j);
+        }
+        keys = std::vector<std::pair<index_t, index_t> >();
+
+        // send back to SA order
+        auto_all2all_func(tuples, [&](const std::tuple<index_t, index_t, index_t, index_t>& x) {
+            return part.target_processor(std::get<0>(x));
+        }, comm);
+        local_C.resize(local_size);
+        local_Nrev.resize(local_size);
+        local_P.resize(local_size);
+        for (std::size_t j = 0; j < tuples.size(); ++j) {
+            std::size_t i = std::get<0>(tuples[j]) - prefix;
+            local_C[i] = std::get<1>(tuples[j]);
+            local_Nrev[i] = n - std::get<2>(tuples[j]);
+            local_P[i] = std::get<3>(tuples[j]);
+        }
+    }
+
+private:
+
+    // reports all positions `i` in the local range [b, e) with `v[i] <= threshold`
+    template <typename Func>
+    static void local_listing(rmq<typename std::vector<index_t>::const_iterator>& r, const std::vector<index_t>& v,
+                              std::size_t b, std::size_t e, index_t threshold, Func report) {
+        std::vector<std::pair<std::size_t, std::size_t> > stack;
+        stack.push_back(std::make_pair(b, e));
+        while (!stack.empty()) {
+            std::size_t l = stack.back().first;
+            std::size_t h = stack.back().second;
+            stack.pop_back();
+            if (l >= h)
+                continue;
+            std::size_t m = r.query(v.begin() + l, v.begin() + h) - v.begin();
+            if (v[m] <= threshold) {
+                report(m);
+                stack.push_back(std::make_pair(l, m));
+                stack.push_back(std::make_pair(m+1, h));
+            }
+        }
+    }
+
+public:
+
+    /**
+     * @brief   Lists the distinct keys and their number of occurrences for
+     *          each of the given SA-intervals [begin, end) (collective call).
+     *
+     * @param ranges    The SA-intervals.
+     * @param offsets   Set to the offsets of each interval's keys in the
+     *                  result, i.e., the (key, frequency) pairs of the
+     *                  `i`-th interval are `[offsets[i], offsets[i+1])`,
+     *                  sorted by key.
+     * @param key       Returns the key of the local SA position `i`.
+     */
+    template <typename Key>
+    std::vector<std::pair<index_t, index_t> >
+    list(const std::vector<std::pair<index_t, index_t> >& ranges, std::vector<std::size_t>& offsets,
+         Key key, const mxx::comm& comm) const {
+        mxx::section_timer t(std::cerr, comm);
+        std::size_t prefix = part.excl_prefix_size();
+        std::size_t local_size = local_C.size();
+
+        // split ranges at processor boundaries: (query, begin, end)
+        std::vector<size_t> send_counts(comm.size(), 0);
+        for (std::size_t q = 0; q < ranges.size(); ++q) {
+            if (ranges[q].first >= ranges[q].second)
+                continue;
+            int p_end = part.target_processor(ranges[q].second - 1);
+            for (int p = part.target_processor(ranges[q].first); p <= p_end; ++p)
+                ++send_counts[p];
+        }
+        std::vector<size_t> offs = mxx::local_exscan(send_counts);
+        std::vector<std::tuple<index_t, index_t, index_t> > parts(offs.back() + send_counts.back());
+        for (std::size_t q = 0; q < ranges.size(); ++q) {
+            if (ranges[q].first >= ranges[q].second)
+                continue;
+            int p_end = part.target_processor(ranges[q].second - 1);
+            for (int p = part.target_processor(ranges[q].first); p <= p_end; ++p)
+                parts[offs[p]++] = std::make_tuple(q, ranges[q].first, ranges[q].second);
+        }
+        std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+        parts = auto_all2allv(parts, send_counts, recv_counts, comm);
+        t.end_section("range listing: all2all ranges");
+
+        // answer locally: tuples (query, key, key-sorted position, is_last)
+        std::vector<std::tuple<index_t, index_t, index_t, index_t> > results;
+        std::vector<size_t> result_counts(comm.size(), 0);
+        if (local_size > 0) {
+            rmq<typename std::vector<index_t>::const_iterator> c_rmq(local_C.begin(), local_C.end());
+            rmq<typename std::vector<index_t>::const_iterator> n_rmq(local_Nrev.begin(), local_Nrev.end());
+            std::size_t j = 0;
+            for (int p = 0; p < comm.size(); ++p) {
+                std::size_t before = results.size();
+                for (std::size_t k = 0; k < recv_counts[p]; ++k, ++j) {
+                    index_t q = std::get<0>(parts[j]);
+                    std::size_t l = std::get<1>(parts[j]);
+                    std::size_t r = std::get<2>(parts[j]);
+                    std::size_t b = std::max(l, prefix) - prefix;
+                    std::size_t e = std::min(r, prefix + local_size) - prefix;
+                    // first occurrences: C[i] < l  <=>  C[i]+1 <= l
+                    local_listing(c_rmq, local_C, b, e, l, [&](std::size_t i) {
+                        results.push_back(std::make_tuple(q, key(i), local_P[i], 0));
+                    });
+                    // last occurrences: N[i] >= r  <=>  n - N[i] <= n - r
+                    local_listing(n_rmq, local_Nrev, b, e, n - r, [&](std::size_t i) {
+                        results.push_back(std::make_tuple(q, key(i), local_P[i], 1));
+                    });
+                }
+                result_counts[p] = results.size() - before;
+            }
+        }
+        parts = std::vector<std::tuple<index_t, index_t, index_t> >();
+        t.end_section("range listing: local listing");
+
+        // return results and combine first and last occurrences
+        std::vector<size_t> recv_result_counts = auto_all2all(result_counts, comm);
+        results = auto_all2allv(results, result_counts, recv_result_counts, comm);
+        std::sort(results.begin(), results.end());
+        t.end_section("range listing: all2all results");
+
+        std::vector<std::pair<index_t, index_t> > listing;
+        offsets.assign(ranges.size()+1, 0);
+        // each key of a query has exactly one first (0) and last (1) entry
+        for (std::size_t i = 0; i+1 < results.size(); i += 2) {
+            index_t q = std::get<0>(results[i]);
+            MXX_ASSERT(std::get<1>(results[i]) == std::get<1>(results[i+1]) && std::get<3>(results[i]) == 0);
+            listing.push_back(std::pair<index_t, index_t>(std::get<1>(results[i]), std::get<2>(results[i+1]) - std::get<2>(results[i]) + 1));
+            ++offsets[q+1];
+        }
+        for (std::size_t q = 0; q < ranges.size(); ++q) {
+            offsets[q+1] += offsets[q];
+        }
+        return listing;
+    }
+};
+
+/**
+ * @brief   The document array (sequence id of each suffix) of a generalized
+ *          suffix array, together with the structures for listing the
+ *          distinct documents in SA-intervals (see `range_listing`).
+ */
+template <typename index_t = std::size_t>
+class document_array {
+private:
+    /// The MPI communicator
+    mxx::comm comm;
+
+    /// The number of documents (sequences)
+    std::size_t m_num_docs;
+
+    /// Listing of the documents in SA-intervals
+    range_listing<index_t> listing;
+
+public:
+    /// The document id for each suffix in the local block of the SA
+    std::vector<index_t> local_DA;
+
+    /// The (exclusive) sequence end for each position of the local block
+    /// of the concatenated input string
+    std::vector<index_t> local_seq_end;
+
+public:
+    /**
+     * @brief   Creates the document array for the given generalized suffix
+     *          array (collective call).
+     *
+     * @param local_SA  The local block of the generalized suffix array,
+     *                  distributed the same as the concatenated string.
+     * @param ss        The string set the GSA was constructed from.
+     * @param _comm     The communicator.
+     */
+    document_array(const std::vector<index_t>& local_SA, simple_dstringset& ss, const mxx::comm& _comm)
+        : comm(_comm.copy()) {
+        mxx::section_timer t(std::cerr, comm);
+        std::size_t local_size = local_SA.size();
+        std::size_t prefix = mxx::exscan(local_size, comm);
+        if (comm.rank() == 0)
+            prefix = 0;
+
+        // document ids and sequence ends in string order
+        dist_seqs ds = dist_seqs::from_dss(ss, comm);
+        std::size_t docs_before = mxx::exscan(ds.prefix_sizes.size(), comm);
+        if (comm.rank() == 0)
+            docs_before = 0;
+        m_num_docs = mxx::allreduce(ds.prefix_sizes.size(), comm);
+        std::vector<index_t> local_doc(local_size);
+        local_seq_end.resize(local_size);
+        std::size_t d = 0;
+        for (std::size_t i = 0; i < local_size; ++i) {
+            while (d < ds.prefix_sizes.size() && ds.prefix_sizes[d] <= prefix + i)
+                ++d;
+            // `d` local sequence starts are at or before this position
+            local_doc[i] = docs_before + d - 1;
+            local_seq_end[i] = (d < ds.prefix_sizes.size()) ? ds.prefix_sizes[d] : ds.right_sep;
+        }
+        t.end_section("document_array: string order");
+
+        // document array in SA order
+        std::vector<std::size_t> sa_idx(local_SA.begin(), local_SA.end());
+        local_DA = bulk_rma(local_doc.begin(), local_doc.end(), sa_idx, comm);
+        local_doc = std::vector<index_t>();
+        sa_idx = std::vector<std::size_t>();
+        t.end_section("document_array: bulk_rma document ids");
+
+        listing = range_listing<index_t>(local_DA, comm);
+        t.end_section("document_array: init listing");
+    }
+
+    /// The total number of documents
+    inline std::size_t num_docs() const {
+        return m_num_docs;
+    }
+
+    /**
+     * @brief   Lists the distinct documents and their number of occurrences
+     *          for each of the given SA-intervals [begin, end) (collective
+     *          call).
+     *
+     * The (document, frequency) pairs of the `i`-th interval are returned in
+     * `[offsets[i], offsets[i+1])` of the result, sorted by document id.
+     */
+    std::vector<std::pair<index_t, index_t> >
+    list_documents(const std::vector<std::pair<index_t, index_t> >& ranges, std::vector<std::size_t>& offsets) const {
+        const std::vector<index_t>& da = local_DA;
+        return listing.list(ranges, offsets, [&da](std::size_t i) { return da[i]; }, comm);
+    }
+};
+
+/// the default number of LCP positions per processor which are listed in
+/// one batch by `color_array::interval_colors()`
+constexpr std::size_t interval_colors_batch_size = 1 << 20;
+
+/**
+ * @brief   The color array of a generalized suffix array, which tags each
+ *          suffix with the color (e.g., the genome) of its document.
+ *
+ * Several documents (e.g., the contigs or chromosomes of a genome) may share
+ * a color. Colors are stored bit-packed with `ceil(log2(num_colors))` bits
+ * per suffix, and the distinct colors of SA-intervals (such as the
+ * LCP-intervals of the suffix tree) are listed via a `range_listing` over
+ * the colors.
+ */
+template <typename index_t = std::size_t>
+class color_array {
+private:
+    /// The MPI communicator
+    mxx::comm comm;
+
+    /// The number of colors
+    std::size_t m_num_colors;
+
+    /// The number of bits per color
+    unsigned int m_bits;
+
+    /// The number of suffixes in the local block
+    std::size_t m_local_size;
+
+    /// The colors of the local block of the SA, bit-packed
+    std::vector<uint64_t> local_packed;
+
+    /// Listing of the colors in SA-intervals
+    range_listing<index_t> listing;
+
+public:
+    /**
+     * @brief   Creates the color array from the document array and the color
+     *          of each document (collective call).
+     *
+     * @param da            The document array of the GSA.
+     * @param doc_colors    The color of each (global) document id, in
+     *                      `[0, num_colors)`, the same on all processors.
+     * @param _comm         The communicator.
+     */
+    color_array(const document_array<index_t>& da, const std::vector<index_t>& doc_colors, const mxx::comm& _comm)
+        : comm(_comm.copy()), m_local_size(da.local_DA.size()) {
+        mxx::section_timer t(std::cerr, comm);
+        if (doc_colors.size() != da.num_docs())
+            throw std::runtime_error("color_array: expected one color per document");
+        m_num_colors = doc_colors.empty() ? 0 : *std::max_element(doc_colors.begin(), doc_colors.end()) + 1;
+        m_bits = m_num_colors > 1 ? ceillog2(m_num_colors) : 1;
+
+        std::vector<index_t> local_colors(m_local_size);
+        local_packed.assign((m_local_size * m_bits + 63) / 64, 0);
+        for (std::size_t i = 0; i < m_local_size; ++i) {
+            local_colors[i] = doc_colors[da.local_DA[i]];
+            std::size_t bit = i * m_bits;
+            local_packed[bit / 64] |= static_cast<uint64_t>(local_colors[i]) << (bit % 64);
+            if (bit % 64 + m_bits > 64)
+                local_packed[bit / 64 + 1] |= static_cast<uint64_t>(local_colors[i]) >> (64 - bit % 64);
+        }
+        t.end_section("color_array: pack colors");
+
+        listing = range_listing<index_t>(local_colors, comm);
+        t.end_section("color_array: init listing");
+    }
+
+    /// The total number of colors
+    inline std::size_t num_colors() const {
+        return m_num_colors;
+    }
+
+    /// The number of bits per color
+    inline unsigned int bits_per_color() const {
+        return m_bits;
+    }
+
+    /// The color of the `i`-th suffix in the local block of the SA
+    inline index_t color(std::size_t i) const {
+        std::size_t bit = i * m_bits;
+        uint64_t x = local_packed[bit / 64] >> (bit % 64);
+        if (bit % 64 + m_bits > 64)
+            x |= local_packed[bit / 64 + 1] << (64 - bit % 64);
+        return static_cast<index_t>(m_bits == 64 ? x : x & ((static_cast<uint64_t>(1) << m_bits) - 1));
+    }
+
+    /// The colors of the local block of the SA
+    std::vector<index_t> local_colors() const {
+        std::vector<index_t> result(m_local_size);
+        for (std::size_t i = 0; i < m_local_size; ++i)
+            result[i] = color(i);
+        return result;
+    }
+
+    /// The size of the local packed colors in bytes
+    inline std::size_t local_size_in_bytes() const {
+        return local_packed.size() * sizeof(uint64_t);
+    }
+
+    /**
+     * @brief   Lists the distinct colors and their number of occurrences for
+     *          each of the given SA-intervals [begin, end) (collective
+     *          call).
+     *
+     * The (color, frequency) pairs of the `i`-th interval are returned in
+     * `[offsets[i], offsets[i+1])` of the result, sorted by color.
+     */
+    std::vector<std::pair<index_t, index_t> >
+    list_colors(const std::vector<std::pair<index_t, index_t> >& ranges, std::vector<std::size_t>& offsets) const {
+        return listing.list(ranges, offsets, [this](std::size_t i) { return color(i); }, comm);
+    }
+
+    /**
+     * @brief   Lists the color set of each local internal node of the suffix
+     *          tree, i.e., the colors sharing the node's path label
+     *          (collective call).
+     *
+     * The LCP-intervals are listed in batches of at most `batch_size` local
+     * LCP positions, such that the intervals and the intermediate results of
+     * the listing are bounded by the batch size. The (color, frequency)
+     * pairs of the node at local LCP position `i` are returned in
+     * `[offsets[i], offsets[i+1])` of the result, which is empty for
+     * positions which are not nodes.
+     *
+     * @param tree          The LCP-interval tree of the GSA, distributed
+     *                      the same as the SA.
+     * @param offsets       Set to the offsets of each position's colors.
+     * @param batch_size    The number of local LCP positions per batch.
+     */
+    std::vector<std::pair<index_t, index_t> >
+    interval_colors(const lcp_interval_tree& tree, std::vector<std::size_t>& offsets,
+                    std::size_t batch_size = interval_colors_batch_size) const {
+        std::size_t local_size = tree.node_rb.size();
+        if (!mxx::all_of(local_size == m_local_size, comm))
+            throw std::runtime_error("color_array: the LCP-interval tree must be distributed the same as the suffix array");
+        MXX_ASSERT(batch_size > 0);
+
+        // every processor takes part in all (collective) batches
+        std::size_t max_local_size = mxx::allreduce(local_size, mxx::max<std::size_t>(), comm);
+        std::vector<std::pair<index_t, index_t> > result;
+        offsets.assign(1, 0);
+        offsets.reserve(local_size + 1);
+        for (std::size_t b = 0; b < max_local_size; b += batch_size) {
+            std::size_t e = std::min(b + batch_size, local_size);
+            std::vector<std::pair<index_t, index_t> > ranges;
+            for (std::size_t i = b; i < e; ++i) {
+                if (tree.is_node(i))
+                    ranges.push_back(std::pair<index_t, index_t>(tree.node_lb[i], tree.node_rb[i] + 1));
+                else
+                    ranges.push_back(std::pair<index_t, index_t>(0, 0));
+            }
+            std::vector<std::size_t> batch_offsets;
+            std::vector<std::pair<index_t, index_t> > listing = list_colors(ranges, batch_offsets);
+            for (std::size_t i = 1; i < batch_offsets.size(); ++i)
+                offsets.push_back(result.size() + batch_offsets[i]);
+            result.insert(result.end(), listing.begin(), listing.end());
+        }
+        return result;
+    }
+};
+
+#endif // DOCUMENT_ARRAY_HPP
@@ -3,18 +3,45 @@
 
 #include <vector>
 #include <iterator>
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
 
 #include <mxx/comm.hpp>
-
-// rough interface for distribution of data elements over the processors of a
-// communicator
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+
+#include "all2all.hpp"
+#include "bitops.hpp"
+
+// The distributions of data elements over the processors of a communicator.
+//
+// All distributions are value types (they don't keep a reference to the
+// communicator) with the same (non virtual) interface, such that the
+// distributed algorithms are templated by the distribution type and the
+// conversions between global and (rank, local) indexes get inlined:
+//
+//     size_t local_size() const;
+//     size_t local_size(int rank) const;
+//     size_t global_size() const;
+//     size_t eprefix() const;
+//     size_t iprefix() const;
+//     size_t eprefix(int rank) const;
+//     size_t iprefix(int rank) const;
+//
+//     int    rank_of(size_t gidx) const;
+//     size_t lidx_of(size_t gidx) const;
+//     size_t gidx_of(int rank, size_t lidx) const;
+//
+// Additionally, each distribution provides the interface of
+// `mxx::partition::block_decomposition_buffered` (`target_processor`,
+// `excl_prefix_size`, `prefix_size`), such that it can be used in its place.
 class dist_base {
 protected:
-    const mxx::comm& m_comm;
-    const unsigned int m_comm_size, m_comm_rank;
-    const size_t m_local_size;
-    dist_base(const mxx::comm& comm, size_t local_size) :
-        m_comm(comm), m_comm_size(comm.size()), m_comm_rank(comm.rank()), m_local_size(local_size) {
+    unsigned int m_comm_size, m_comm_rank;
+    size_t m_local_size;
+    dist_base(unsigned int comm_size, unsigned int comm_rank, size_t local_size) :
+        m_comm_size(comm_size), m_comm_rank(comm_rank), m_local_size(local_size) {
     }
 
 public:
@@ -22,46 +49,61 @@ public:
         return m_local_size;
     }
 
-    inline const mxx::comm& comm() const {
-        return m_comm;
-    }
-
     inline int comm_size() const {
         return m_comm_size;
     }
     inline int comm_rank() const {
         return m_comm_rank;
     }
+};
 
-    /* need to be implemented by all deriving classes
-    inline size_t local_size(int rank) const;
-    inline size_t global_size() const;
-    inline size_t eprefix() const;
-    inline size_t iprefix() const;
-    inline size_t eprefix(int rank) const;
-    inline size_t iprefix(int rank) const;
+// mxx::partition compatible interface for the distribution `Dist`
+template <typename Dist>
+class partition_compat {
+public:
+    inline int target_processor(size_t gidx) const {
+        return static_cast<const Dist*>(this)->rank_of(gidx);
+    }
+
+    inline size_t excl_prefix_size() const {
+        return static_cast<const Dist*>(this)->eprefix();
+    }
 
-    inline int    rank_of(size_t gidx) const;
-    inline size_t lidx_of(size_t gidx) const;
-    inline size_t gidx_of(int rank, size_t lidx) const;
-    */
+    inline size_t excl_prefix_size(int rank) const {
+        return static_cast<const Dist*>(this)->eprefix(rank);
+    }
+
+    inline size_t prefix_size() const {
+        return static_cast<const Dist*>(this)->iprefix();
+    }
+
+    inline size_t prefix_size(int rank) const {
+        return static_cast<const Dist*>(this)->iprefix(rank);
+    }
 };
 
-class blk_dist_buf : public dist_base {
+// block distributed (consecutive numbers, #elements same as cyclic), with
+// buffered values for faster computation of the results
+class blk_dist_buf : public dist_base, public partition_compat<blk_dist_buf> {
 public:
     using dist_base::local_size;
 
-    ~blk_dist_buf () {}
-
     /// collective allreduce for global size
     blk_dist_buf(const mxx::comm& comm, size_t local_size)
-        : dist_base(comm, local_size),
-          n(mxx::allreduce(local_size, comm)),
+        : blk_dist_buf(mxx::allreduce(local_size, comm), comm.size(), comm.rank())
+    {
+        assert(local_size == m_local_size);
+    }
+
+    /// the block distribution of `global_size` elements (non collective)
+    blk_dist_buf(size_t global_size, unsigned int comm_size, unsigned int comm_rank)
+        : dist_base(comm_size, comm_rank, global_size / comm_size + (comm_rank < global_size % comm_size ? 1 : 0)),
+          n(global_size),
           div(n / m_comm_size), mod(n % m_comm_size),
           prefix(div*m_comm_rank + std::min<size_t>(mod, m_comm_rank)),
-          div1mod((div+1)*mod)
+          div1mod((div+1)*mod),
+          fast_div1(div+1), fast_div(std::max<size_t>(div, 1))
     {
-        assert(local_size == div + (m_comm_rank < mod ? 1 : 0));
     }
 
     blk_dist_buf(const blk_dist_buf& o) = default;
@@ -96,9 +138,22 @@ public:
     inline unsigned int rank_of(size_t gidx) const {
         if (gidx < div1mod) {
             // a_i is within the first n % p processors
-            return gidx/(div+1);
+            return fast_div1.divide(gidx);
         } else {
-            return mod + (gidx - div1mod)/div;
+            return mod + fast_div.divide(gidx - div1mod);
+        }
+    }
+
+    // rank_of for all global indexes in [first, last), written to `out`
+    template <typename InputIter, typename OutputIter>
+    inline void rank_of_many(InputIter first, InputIter last, OutputIter out) const {
+        // branch free (both quotients are computed), such that consecutive
+        // elements are pipelined
+        for (; first != last; ++first, ++out) {
+            size_t gidx = *first;
+            size_t r1 = fast_div1.divide(gidx);
+            size_t r2 = mod + fast_div.divide(gidx - div1mod);
+            *out = (gidx < div1mod) ? r1 : r2;
         }
     }
 
@@ -112,53 +167,36 @@ public:
 
 private:
     /* data */
-    const size_t n;
+    size_t n;
     // derived/buffered values (for faster computation of results)
-    const size_t div; // = n/p
-    const size_t mod; // = n%p
-    // local size (number of local elements)
+    size_t div; // = n/p
+    size_t mod; // = n%p
     // the exclusive prefix (number of elements on previous processors)
-    const size_t prefix;
+    size_t prefix;
     /// number of elements on processors with one more element
-    const size_t div1mod; // = (n/p + 1)*(n % p)
-};
-
-using blk_dist = blk_dist_buf;
-
-// block distributed (consecutive numbers, #elements same as cyclic)
-/*
-class blk_dist : public dist_base {
-    // TODO: move implementation from partition.hpp into here!
-    mxx::partition::block_decomposition_buffered<size_t> part;
-
-    inline size_t local_size(int rank) const;
-    inline size_t global_size() const;
-    inline size_t eprefix() const;
-    inline size_t iprefix() const;
-    inline size_t eprefix(int rank) const;
-    inline size_t iprefix(int rank) const;
-
-    inline int    rank_of(size_t gidx) const;
-    inline size_t lidx_of(size_t gidx) const;
-    inline size_t gidx_of(int rank, size_t lidx) const;
+    size_t div1mod; // = (n/p + 1)*(n % p)
+    /// division by (n/p + 1) and n/p without the division instruction
+    invariant_divisor fast_div1;
+    invariant_divisor fast_div;
 };
-*/
 
 using blk_dist = blk_dist_buf;
 
 
 // simplified block distr: equal number of elements on each processor:
 // exactly n/p (e.g.: the required input to bitonic sort)
-class eq_dist : public dist_base {
+class eq_dist : public dist_base, public partition_compat<eq_dist> {
 public:
-    eq_dist(const mxx::comm& comm, size_t local_size) : dist_base(comm, local_size) {}
+    using dist_base::local_size;
+
+    eq_dist(const mxx::comm& comm, size_t local_size) : dist_base(comm.size(), comm.rank(), local_size), fast_div(std::max<size_t>(local_size, 1)) {}
 
-    inline size_t local_size(int) {
-        return dist_base::local_size();
+    inline size_t local_size(int) const {
+        return m_local_size;
     }
 
     inline size_t global_size() const {
-        return dist_base::local_size() * comm_size();
+        return m_local_size * m_comm_size;
     }
 
     inline size_t eprefix() const {
@@ -178,29 +216,231 @@ public:
     }
 
     inline int    rank_of(size_t gidx) const {
-        return gidx / m_local_size;
+        return fast_div.divide(gidx);
+    }
+
+    template <typename InputIter, typename OutputIter>
+    inline void rank_of_many(InputIter first, InputIter last, OutputIter out) const {
+        for (; first != last; ++first, ++out)
+            *out = fast_div.divide(*first);
     }
 
     inline size_t lidx_of(size_t gidx) const {
-        return gidx % m_local_size;
+        return gidx - m_local_size * rank_of(gidx);
     }
 
     inline size_t gidx_of(int rank, size_t lidx) const {
         return m_local_size * rank + lidx;
     }
+
+private:
+    invariant_divisor fast_div;
 };
 
 // wraps around any distribution (initialized by only local_size (local number of elements))
 // and provides the general distribution functions for converting between gidx <-> (pidx, lidx)
 // representations, and the other helper functions
-class gen_dist {
-    // TODO constructing is collective
-    // each processor has the whole inclusive prefix (which allows answering
-    // most queries in two lookups) and rank_of using binary search
+//
+// each processor has the whole exclusive prefix (which allows answering
+// most queries in two lookups) and rank_of using binary search. If the
+// distribution happens to be the (buffered) block distribution, rank_of uses
+// the constant time block computation instead.
+class gen_dist : public partition_compat<gen_dist> {
+public:
+    gen_dist() : m_comm_rank(0), m_prefix(2, 0), n(0), mod(0), div1mod(0), m_is_blk(true) {}
+
+    /// collective allgather of all local sizes
+    gen_dist(const mxx::comm& comm, size_t local_size)
+        : m_comm_rank(comm.rank()), m_prefix(comm.size()+1, 0) {
+        std::vector<size_t> sizes = mxx::allgather(local_size, comm);
+        for (int i = 0; i < comm.size(); ++i)
+            m_prefix[i+1] = m_prefix[i] + sizes[i];
+        n = m_prefix.back();
+        size_t div = n / comm.size();
+        mod = n % comm.size();
+        div1mod = (div+1)*mod;
+        fast_div1 = invariant_divisor(div+1);
+        fast_div = invariant_divisor(std::max<size_t>(div, 1));
+        m_is_blk = true;
+        for (int i = 0; i < comm.size(); ++i)
+            if (sizes[i] != div + (static_cast<size_t>(i) < mod ? 1 : 0))
+                m_is_blk = false;
+    }
+
+    gen_dist(const gen_dist& o) = default;
+    gen_dist& operator=(const gen_dist& other) = default;
+
+    /// whether this is the block distribution `blk_dist`
+    inline bool is_blk_dist() const {
+        return m_is_blk;
+    }
+
+    /// returns the equivalent block distribution (requires `is_blk_dist()`)
+    inline blk_dist to_blk_dist() const {
+        assert(m_is_blk);
+        return blk_dist(n, comm_size(), m_comm_rank);
+    }
+
+    inline int comm_size() const {
+        return m_prefix.size() - 1;
+    }
+
+    inline int comm_rank() const {
+        return m_comm_rank;
+    }
+
+    inline size_t global_size() const {
+        return n;
+    }
+
+    inline size_t local_size() const {
+        return local_size(m_comm_rank);
+    }
+
+    inline size_t local_size(int rank) const {
+        return m_prefix[rank+1] - m_prefix[rank];
+    }
+
+    inline size_t eprefix() const {
+        return m_prefix[m_comm_rank];
+    }
+
+    inline size_t eprefix(int rank) const {
+        return m_prefix[rank];
+    }
+
+    inline size_t iprefix() const {
+        return m_prefix[m_comm_rank+1];
+    }
+
+    inline size_t iprefix(int rank) const {
+        return m_prefix[rank+1];
+    }
+
+    // which processor the element with the given global index belongs to
+    // (processors without elements are skipped)
+    inline int rank_of(size_t gidx) const {
+        if (m_is_blk) {
+            if (gidx < div1mod)
+                return fast_div1.divide(gidx);
+            else
+                return mod + fast_div.divide(gidx - div1mod);
+        }
+        return std::upper_bound(m_prefix.begin()+1, m_prefix.end(), gidx) - (m_prefix.begin()+1);
+    }
+
+    template <typename InputIter, typename OutputIter>
+    inline void rank_of_many(InputIter first, InputIter last, OutputIter out) const {
+        if (m_is_blk) {
+            for (; first != last; ++first, ++out) {
+                size_t gidx = *first;
+                size_t r1 = fast_div1.divide(gidx);
+                size_t r2 = mod + fast_div.divide(gidx - div1mod);
+                *out = (gidx < div1mod) ? r1 : r2;
+            }
+        } else {
+            for (; first != last; ++first, ++out)
+                *out = rank_of(*first);
+        }
+    }
+
+    inline size_t lidx_of(size_t gidx) const {
+        return gidx - eprefix(rank_of(gidx));
+    }
+
+    inline size_t gidx_of(int rank, size_t lidx) const {
+        return eprefix(rank) + lidx;
+    }
+
+private:
+    int m_comm_rank;
+    /// exclusive prefix sizes of all processors (size p+1)
+    std::vector<size_t> m_prefix;
+    size_t n;
+    // buffered values of the block distribution
+    size_t mod;
+    size_t div1mod;
+    invariant_divisor fast_div1;
+    invariant_divisor fast_div;
+    bool m_is_blk;
 };
 
+/**
+ * @brief   Writes the rank of the processor of each global index in
+ *          [first, last) to `out`, for any partition (with the
+ *          `target_processor` interface).
+ */
+template <typename Partition, typename InputIter, typename OutputIter>
+inline typename std::enable_if<!std::is_base_of<partition_compat<Partition>, Partition>::value>::type
+rank_of_many(const Partition& part, InputIter first, InputIter last, OutputIter out) {
+    for (; first != last; ++first, ++out)
+        *out = part.target_processor(*first);
+}
+
+// the batched (division free) implementation of the distributions above
+template <typename Dist, typename InputIter, typename OutputIter>
+inline typename std::enable_if<std::is_base_of<partition_compat<Dist>, Dist>::value>::type
+rank_of_many(const Dist& dist, InputIter first, InputIter last, OutputIter out) {
+    dist.rank_of_many(first, last, out);
+}
+
+/**
+ * @brief   Returns the local size of a distribution of `n` elements, which
+ *          assigns each processor a share proportional to its `weight`
+ *          (collective call).
+ *
+ * For equal weights, this is the block distribution.
+ */
+inline size_t weighted_local_size(size_t n, double weight, const mxx::comm& comm) {
+    assert(weight > 0);
+    if (mxx::all_same(weight, comm))
+        return n / comm.size() + (static_cast<size_t>(comm.rank()) < n % comm.size() ? 1 : 0);
+    std::vector<double> weights = mxx::allgather(weight, comm);
+    long double total = 0;
+    for (double w : weights)
+        total += w;
+    long double before = 0;
+    for (int i = 0; i < comm.rank(); ++i)
+        before += weights[i];
+    size_t begin = static_cast<size_t>(n * (before / total));
+    size_t end = comm.is_last() ? n : static_cast<size_t>(n * ((before + weight) / total));
+    return end - begin;
+}
+
+/**
+ * @brief   Redistributes the distributed vector such that this processor
+ *          holds `new_local_size` elements, preserving the global order
+ *          (collective call).
+ */
+template <typename T>
+std::vector<T> redistribute(const std::vector<T>& vec, size_t new_local_size, const mxx::comm& comm) {
+    gen_dist src(comm, vec.size());
+    gen_dist dst(comm, new_local_size);
+    assert(src.global_size() == dst.global_size());
+    // size of the intersection of two global ranges
+    auto overlap = [](size_t b1, size_t e1, size_t b2, size_t e2) {
+        return std::max(std::min(e1, e2), std::max(b1, b2)) - std::max(b1, b2);
+    };
+    std::vector<size_t> send_counts(comm.size());
+    std::vector<size_t> recv_counts(comm.size());
+    for (int i = 0; i < comm.size(); ++i) {
+        send_counts[i] = overlap(src.eprefix(), src.iprefix(), dst.eprefix(i), dst.iprefix(i));
+        recv_counts[i] = overlap(dst.eprefix(), dst.iprefix(), src.eprefix(i), src.iprefix(i));
+    }
+    return auto_all2allv(vec, send_counts, recv_counts, comm);
+}
+
 // checks whether the distribution (given by local_size) is block distirbuted
 // or not.and initialized the according "backend"
+//
+// Algorithms are instantiated for the compile time distribution types
+// (such that `rank_of` etc. get inlined), and the distribution is checked
+// only once at the top level, e.g.:
+//
+//     if (part.is_blk_dist())
+//         algo(part.to_blk_dist(), ...);
+//     else
+//         algo(part, ...);
 
 // always collective
 class dist_factory {
@@ -222,7 +462,7 @@ public:
     }
 
     inline bool is_blk_dist() {
-        size_t expected = global_size / comm.size() + ((global_size % comm.size() < static_cast<size_t>(comm.rank())) ? 1 : 0);
+        size_t expected = global_size / comm.size() + ((static_cast<size_t>(comm.rank()) < global_size % comm.size()) ? 1 : 0);
         bool is_blk = local_size == expected;
         return mxx::all_of(is_blk, comm);
     }
@@ -231,13 +471,28 @@ public:
         assert(is_blk_dist());
         return blk_dist(comm, local_size);
     }
-};
 
-// distributed range wrapper
-template <typename T, typename Dist>
-class drange : public Dist {
+    gen_dist to_gen_dist() {
+        return gen_dist(comm, local_size);
+    }
 };
 
+/*
+ * Distributed ranges: the local elements of a distributed array together
+ * with their distribution and communicator. Each range is itself its
+ * distribution (i.e., `rank_of`, `target_processor` etc. can be called on the
+ * range), and has the same interface:
+ *
+ *     const mxx::comm& comm() const;
+ *     [const] std::vector<T>& local() [const];
+ *     [const] T* data() [const];
+ *     iterators over the local elements
+ *
+ * `dvector` owns its local elements, while `dvector_wrapper` and
+ * `dvector_const_wrapper` refer to an existing `std::vector`. The distributed
+ * primitives (shifting.hpp, bulk_permute.hpp, bulk_rma.hpp, par_rmq.hpp) have
+ * overloads for any of them.
+ */
 
 template <typename T, typename dist>
 class dvector : public dist {
@@ -247,9 +502,32 @@ public:
 
     std::vector<T> vec;
 
-    dvector(const mxx::comm& c, size_t local_size) : dist(c, local_size), vec(local_size) {}
+    /// collective if the distribution is constructed collectively
+    dvector(const mxx::comm& c, size_t local_size) : dist(c, local_size), vec(local_size), m_comm(&c) {}
+
+    dvector(const mxx::comm& c, const dist& d) : dist(d), vec(d.local_size()), m_comm(&c) {}
 
+    /// takes over the given local elements
+    dvector(const mxx::comm& c, const dist& d, std::vector<T>&& local) : dist(d), vec(std::move(local)), m_comm(&c) {
+        assert(vec.size() == d.local_size());
+    }
+
+    inline const mxx::comm& comm() const {
+        return *m_comm;
+    }
 
+    inline const dist& distribution() const {
+        return *this;
+    }
+
+    /* data access */
+
+    inline std::vector<T>& local() {
+        return vec;
+    }
+    inline const std::vector<T>& local() const {
+        return vec;
+    }
     inline T* data() {
         return vec.data();
     }
@@ -262,6 +540,12 @@ public:
     inline T* data_at(size_t offset) {
         return data() + offset;
     }
+    inline T& operator[](size_t lidx) {
+        return vec[lidx];
+    }
+    inline const T& operator[](size_t lidx) const {
+        return vec[lidx];
+    }
 
 
     /* iterators */
@@ -284,6 +568,9 @@ public:
     const_iterator end() const {
         return vec.end();
     }
+
+private:
+    const mxx::comm* m_comm;
 };
 
 template <typename T, typename dist>
@@ -293,12 +580,33 @@ public:
     using value_type = T;
 
     std::vector<T>& vec;
+
+    /// collective if the distribution is constructed collectively
     dvector_wrapper(std::vector<T>& vec, const mxx::comm& comm)
-        : dist(comm, vec.size()), vec(vec) {
+        : dist(comm, vec.size()), vec(vec), m_comm(&comm) {
+    }
+
+    dvector_wrapper(std::vector<T>& vec, const dist& d, const mxx::comm& comm)
+        : dist(d), vec(vec), m_comm(&comm) {
+        assert(vec.size() == d.local_size());
+    }
+
+    inline const mxx::comm& comm() const {
+        return *m_comm;
+    }
+
+    inline const dist& distribution() const {
+        return *this;
     }
 
     /* data access */
 
+    inline std::vector<T>& local() {
+        return vec;
+    }
+    inline const std::vector<T>& local() const {
+        return vec;
+    }
     inline T* data() {
         return vec.data();
     }
@@ -311,6 +619,12 @@ public:
     inline T* data_at(size_t offset) {
         return data() + offset;
     }
+    inline T& operator[](size_t lidx) {
+        return vec[lidx];
+    }
+    inline const T& operator[](size_t lidx) const {
+        return vec[lidx];
+    }
 
     /* iterators */
 
@@ -332,6 +646,9 @@ public:
     const_iterator end() const {
         return vec.end();
     }
+
+private:
+    const mxx::comm* m_comm;
 };
 
 template <typename T, typename dist>
@@ -341,17 +658,38 @@ public:
     using value_type = T;
 
     const std::vector<T>& vec;
+
+    /// collective if the distribution is constructed collectively
     dvector_const_wrapper(const std::vector<T>& vec, const mxx::comm& comm)
-        : dist(comm, vec.size()), vec(vec) {
+        : dist(comm, vec.size()), vec(vec), m_comm(&comm) {
+    }
+
+    dvector_const_wrapper(const std::vector<T>& vec, const dist& d, const mxx::comm& comm)
+        : dist(d), vec(vec), m_comm(&comm) {
+        assert(vec.size() == d.local_size());
+    }
+
+    inline const mxx::comm& comm() const {
+        return *m_comm;
+    }
+
+    inline const dist& distribution() const {
+        return *this;
     }
 
     /* data access */
+    inline const std::vector<T>& local() const {
+        return vec;
+    }
     inline const T* data() const {
         return vec.data();
     }
     inline const T* data_at(size_t offset) const {
         return data() + offset;
     }
+    inline const T& operator[](size_t lidx) const {
+        return vec[lidx];
+    }
 
     /* iterators */
     using const_iterator = typename std::vector<T>::const_iterator;
@@ -363,13 +701,22 @@ public:
     const_iterator end() const {
         return vec.end();
     }
+
+private:
+    const mxx::comm* m_comm;
 };
 
-// TODO how to dynamically decide whether its equally distributed and without using virtual table lookup having inlined functions??
-// TODO: need to be able to call the original function with different type
-// Thus: dynamically check distribution for each target function and then
-// call different type instantiations?
-// oh C++, how do I do that again? poops
-// meta programming ftw, no way around if else?
+// whether `R` is one of the distributed ranges
+template <typename R>
+struct is_drange : std::false_type {};
+
+template <typename T, typename dist>
+struct is_drange<dvector<T, dist> > : std::true_type {};
+
+template <typename T, typename dist>
+struct is_drange<dvector_wrapper<T, dist> > : std::true_type {};
+
+template <typename T, typename dist>
+struct is_drange<dvector_const_wrapper<T, dist> > : std::true_type {};
 
 #endif // DVECTOR_HPP
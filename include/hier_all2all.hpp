@@ -0,0 +1,188 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    hier_all2all.hpp
+ * @brief   Topology aware, two-level all2all(v) for the bulk exchanges.
+ *
+ * Messages are first aggregated on one leader processor per (shared memory)
+ * node, exchanged between the node leaders, and finally scattered to the
+ * processors of the destination node. The number of messages between nodes
+ * thus scales with the number of nodes squared, instead of the number of
+ * processors squared.
+ *
+ * The two-level exchange is selected by `auto_all2allv()` (all2all.hpp)
+ * whenever the communicator spans multiple nodes with multiple processors
+ * each.
+ *
+ * To bound the memory of the node leaders, large exchanges are forwarded in
+ * rounds, each of which aggregates at most `hier_all2all_max_bytes` on the
+ * sending leader.
+ */
+#ifndef HIER_ALL2ALL_HPP
+#define HIER_ALL2ALL_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "hier_comm.hpp"
+
+/// default maximum number of bytes aggregated on a node leader per round
+constexpr std::size_t hier_all2all_max_bytes = 64 << 20;
+
+namespace impl {
+
+// a single round of the two-level all2allv: the leader holds the gathered
+// messages of its node twice (aggregated and reordered), followed by the
+// received messages twice
+template <typename T>
+std::vector<T> hier_all2allv_round(const std::vector<T>& msgs, const std::vector<size_t>& send_counts, std::vector<size_t>& recv_counts, const hier_comm& topo, const mxx::comm& comm) {
+    const mxx::comm& nc = topo.node_comm;
+    size_t p = comm.size();
+    size_t ns = nc.size();
+
+    // 1) aggregate messages and send counts on the node leader
+    std::vector<size_t> node_send_counts = mxx::gatherv(send_counts, 0, nc);
+    std::vector<T> node_msgs = mxx::gatherv(msgs, 0, nc);
+
+    std::vector<T> local_msgs;
+    std::vector<size_t> local_sizes;
+    std::vector<size_t> local_counts;
+    if (nc.rank() == 0) {
+        // 2) exchange between leaders, each message ordered by
+        //    (destination node, destination rank, source rank within node)
+        std::vector<size_t> seg_displs = mxx::local_exscan(node_send_counts);
+        std::vector<T> send_buf(node_msgs.size());
+        std::vector<size_t> send_matrix;
+        send_matrix.reserve(ns*p);
+        std::vector<size_t> node_counts(topo.num_nodes, 0);
+        // the count matrices are (ranks on sending node) x (ranks on receiving node)
+        std::vector<size_t> matrix_counts(topo.num_nodes);
+        size_t pos = 0;
+        for (int d = 0; d < topo.num_nodes; ++d) {
+            for (int r : topo.node_ranks[d]) {
+                for (size_t s = 0; s < ns; ++s) {
+                    size_t cnt = node_send_counts[s*p + r];
+                    send_matrix.push_back(cnt);
+                    std::copy(node_msgs.begin() + seg_displs[s*p + r], node_msgs.begin() + seg_displs[s*p + r] + cnt, send_buf.begin() + pos);
+                    pos += cnt;
+                    node_counts[d] += cnt;
+                }
+            }
+            matrix_counts[d] = topo.node_ranks[d].size()*ns;
+        }
+        node_msgs = std::vector<T>();
+
+        const mxx::comm& lc = topo.leader_comm;
+        std::vector<size_t> recv_matrix = mxx::all2allv(send_matrix, matrix_counts, matrix_counts, lc);
+        std::vector<size_t> matrix_displs = mxx::local_exscan(matrix_counts);
+        std::vector<size_t> recv_node_counts(topo.num_nodes, 0);
+        for (int e = 0; e < topo.num_nodes; ++e) {
+            for (size_t k = matrix_displs[e]; k < matrix_displs[e] + matrix_counts[e]; ++k)
+                recv_node_counts[e] += recv_matrix[k];
+        }
+        std::vector<T> recv_buf = mxx::all2allv(send_buf, node_counts, recv_node_counts, lc);
+        send_buf = std::vector<T>();
+
+        // 3) reorder by (destination rank within node, source rank)
+        std::vector<size_t> recv_displs = mxx::local_exscan(recv_matrix);
+        local_msgs.resize(recv_buf.size());
+        local_sizes.resize(ns, 0);
+        local_counts.resize(ns*p);
+        pos = 0;
+        for (size_t r = 0; r < ns; ++r) {
+            for (size_t s = 0; s < p; ++s) {
+                int e = topo.rank_node[s];
+                size_t k = matrix_displs[e] + r*topo.node_ranks[e].size() + topo.rank_local[s];
+                size_t cnt = recv_matrix[k];
+                std::copy(recv_buf.begin() + recv_displs[k], recv_buf.begin() + recv_displs[k] + cnt, local_msgs.begin() + pos);
+                pos += cnt;
+                local_counts[r*p + s] = cnt;
+                local_sizes[r] += cnt;
+            }
+        }
+    }
+
+    // 4) scatter to the processors of this node
+    recv_counts = mxx::scatterv(local_counts, std::vector<size_t>(ns, p), 0, nc);
+    return mxx::scatterv(local_msgs, local_sizes, 0, nc);
+}
+
+} // namespace impl
+
+/**
+ * @brief   Two-level all2allv over the given hierarchical communicator
+ *          (collective call).
+ *
+ * The result and `recv_counts` are identical to those of a flat
+ * `mxx::all2allv`, i.e., the received messages are ordered by source rank.
+ *
+ * If any processor sends more than `max_bytes / (ranks per node)` bytes,
+ * the send buffers are forwarded in consecutive windows of that size, so
+ * that a sending leader aggregates at most `max_bytes` per round (a
+ * receiving leader at most `max_bytes` from each node). Every additional
+ * round costs one gather, one leader all2all and one scatter, plus a single
+ * exchange of the counts up front.
+ */
+template <typename T>
+std::vector<T> hier_all2allv(const std::vector<T>& msgs, const std::vector<size_t>& send_counts, std::vector<size_t>& recv_counts, const hier_comm& topo, const mxx::comm& comm, size_t max_bytes = hier_all2all_max_bytes) {
+    size_t p = comm.size();
+    // the same window on all processors, sized for the largest node
+    size_t max_ns = 1;
+    for (int d = 0; d < topo.num_nodes; ++d)
+        max_ns = std::max(max_ns, topo.node_ranks[d].size());
+    size_t window = std::max<size_t>(1, max_bytes / (sizeof(T) * max_ns));
+    size_t max_size = mxx::allreduce(msgs.size(), mxx::max<size_t>(), comm);
+    if (max_size <= window)
+        return impl::hier_all2allv_round(msgs, send_counts, recv_counts, topo, comm);
+
+    // exchange the counts first, to place the pieces of each round
+    std::vector<size_t> count_sizes;
+    recv_counts = impl::hier_all2allv_round(send_counts, std::vector<size_t>(p, 1), count_sizes, topo, comm);
+    std::vector<size_t> recv_pos = mxx::local_exscan(recv_counts);
+    std::vector<T> result(recv_pos.back() + recv_counts.back());
+    std::vector<size_t> send_displs = mxx::local_exscan(send_counts);
+
+    for (size_t begin = 0; begin < max_size; begin += window) {
+        // the part of each message within the window [begin, end)
+        size_t end = begin + window;
+        std::vector<size_t> round_counts(p, 0);
+        for (size_t i = 0; i < p; ++i) {
+            size_t lo = std::max(send_displs[i], begin);
+            size_t hi = std::min(send_displs[i] + send_counts[i], end);
+            if (lo < hi)
+                round_counts[i] = hi - lo;
+        }
+        std::vector<T> round_msgs(msgs.begin() + std::min(begin, msgs.size()), msgs.begin() + std::min(end, msgs.size()));
+        std::vector<size_t> round_recv_counts;
+        std::vector<T> recv = impl::hier_all2allv_round(round_msgs, round_counts, round_recv_counts, topo, comm);
+
+        // the pieces from each source arrive in order
+        size_t pos = 0;
+        for (size_t i = 0; i < p; ++i) {
+            std::copy(recv.begin() + pos, recv.begin() + pos + round_recv_counts[i], result.begin() + recv_pos[i]);
+            recv_pos[i] += round_recv_counts[i];
+            pos += round_recv_counts[i];
+        }
+    }
+    return result;
+}
+
+#endif // HIER_ALL2ALL_HPP
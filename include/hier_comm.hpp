@@ -0,0 +1,222 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    hier_comm.hpp
+ * @brief   Hierarchical (MPI + shared memory) communicator: the node and
+ *          node-leader subcommunicators of a communicator and optional 2D
+ *          processor grids.
+ *
+ * The node membership is discovered once per group of processors via
+ * `hier_comm::get()`, and is shared by all hierarchy aware algorithms: the
+ * two-level all2all (hier_all2all.hpp, used by `auto_all2allv()` and thereby
+ * by `bulk_rma()` and the ANSV), and the shared memory windows
+ * (bulk_rma.hpp).
+ */
+#ifndef HIER_COMM_HPP
+#define HIER_COMM_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief   A 2D grid of the processors of a communicator: `rows` blocks of
+ *          consecutive ranks, each of (nearly) equal size.
+ */
+struct grid_comm {
+    /// number of rows and the row and column of this processor
+    int rows;
+    int row;
+    int col;
+
+    /// the processors of this processor's row, ranked by column
+    mxx::comm row_comm;
+
+    /// the processors with the same column, ranked by row (the column of
+    /// the first processor of each row spans all rows)
+    mxx::comm col_comm;
+
+    /// creates the grid with the given number of rows (collective call)
+    grid_comm(const mxx::comm& comm, int num_rows)
+        : rows(std::max(1, std::min(num_rows, comm.size()))),
+          row(static_cast<int>(static_cast<long long>(comm.rank()) * rows / comm.size())),
+          col(comm.rank() - first_rank(row, rows, comm.size())),
+          row_comm(comm.split(row)), col_comm(comm.split(col)) {
+    }
+
+    /// the first rank of row `r`
+    static inline int first_rank(int r, int rows, int p) {
+        // smallest rank `i` with `i * rows / p >= r`
+        return static_cast<int>((static_cast<long long>(r) * p + rows - 1) / rows);
+    }
+};
+
+/**
+ * @brief   The node membership of all processors of a communicator.
+ */
+class hier_comm {
+public:
+    /// processors on the same node as this processor
+    mxx::comm node_comm;
+
+    /// the first processor of each node (only valid on node leaders)
+    mxx::comm leader_comm;
+
+    /// number of nodes and the index of this processor's node
+    int num_nodes;
+    int node_idx;
+
+    /// node index and rank within its node of each processor
+    std::vector<int> rank_node;
+    std::vector<int> rank_local;
+
+    /// the processors of each node, ordered by rank within the node
+    std::vector<std::vector<int> > node_ranks;
+
+    /// detects the processors which share a node (collective call)
+    hier_comm(const mxx::comm& comm) : node_comm(split_nodes(comm)), comm_size(comm.size()) {
+        init(comm);
+    }
+
+    /// emulates nodes of `ranks_per_node` consecutive processors (collective call)
+    hier_comm(const mxx::comm& comm, int ranks_per_node) : node_comm(comm.split(comm.rank() / ranks_per_node)), comm_size(comm.size()) {
+        init(comm);
+    }
+
+    ~hier_comm() {
+        for (size_t i = 0; i < grids.size(); ++i)
+            delete grids[i];
+    }
+
+    /// whether the two-level exchange can save messages
+    inline bool is_hierarchical() const {
+        return num_nodes > 1 && num_nodes < static_cast<int>(rank_node.size());
+    }
+
+    /// whether each node consists of consecutive ranks
+    inline bool nodes_contiguous() const {
+        for (int d = 0; d < num_nodes; ++d)
+            if (node_ranks[d].back() - node_ranks[d].front() + 1 != static_cast<int>(node_ranks[d].size()))
+                return false;
+        return true;
+    }
+
+    /**
+     * @brief   Returns the 2D grid with the given number of rows, which is
+     *          created only once (collective call on its first use).
+     *
+     * With `rows = 0`, the rows are the nodes if these consist of
+     * consecutive ranks, otherwise the grid is (nearly) square.
+     */
+    const grid_comm& grid(int rows = 0) const {
+        if (rows <= 0)
+            rows = nodes_contiguous() ? num_nodes : static_cast<int>(std::sqrt(static_cast<double>(comm_size)));
+        rows = std::max(1, std::min(rows, comm_size));
+        for (size_t i = 0; i < grids.size(); ++i)
+            if (grids[i]->rows == rows)
+                return *grids[i];
+        grids.push_back(new grid_comm(whole_comm, rows));
+        return *grids.back();
+    }
+
+    /// prints the number of nodes and processors per node (on the first processor)
+    void print_node_distribution(std::ostream& os = std::cerr) const {
+        if (rank_node.empty() || whole_comm.rank() != 0)
+            return;
+        size_t min_size = rank_node.size();
+        size_t max_size = 0;
+        for (int d = 0; d < num_nodes; ++d) {
+            min_size = std::min(min_size, node_ranks[d].size());
+            max_size = std::max(max_size, node_ranks[d].size());
+        }
+        os << "Running " << rank_node.size() << " processes on " << num_nodes << " nodes (" << min_size;
+        if (max_size != min_size)
+            os << "-" << max_size;
+        os << " per node)" << std::endl;
+    }
+
+    /**
+     * @brief   Returns the hierarchical communicator of the given
+     *          communicator, which is detected only once per group of
+     *          processors (collective call).
+     */
+    static const hier_comm& get(const mxx::comm& comm) {
+        // hierarchical communicators are never freed, since their
+        // communicators would otherwise be freed after MPI_Finalize
+        static std::vector<std::pair<MPI_Group, hier_comm*> > cache;
+        MPI_Group group;
+        MPI_Comm_group(comm, &group);
+        for (auto& entry : cache) {
+            int result;
+            MPI_Group_compare(group, entry.first, &result);
+            if (result == MPI_IDENT) {
+                MPI_Group_free(&group);
+                return *entry.second;
+            }
+        }
+        cache.emplace_back(group, new hier_comm(comm));
+        return *cache.back().second;
+    }
+
+private:
+    /// a copy of the whole communicator and its size, for creating grids
+    mxx::comm whole_comm;
+    int comm_size;
+
+    /// the grids created so far
+    mutable std::vector<grid_comm*> grids;
+
+    static mxx::comm split_nodes(const mxx::comm& comm) {
+#if MPI_VERSION > 2
+        return comm.split_shared();
+#else
+        // group processors by their processor name
+        std::vector<char> name(MPI_MAX_PROCESSOR_NAME, '\0');
+        int len;
+        MPI_Get_processor_name(&name[0], &len);
+        std::vector<char> names = mxx::allgather(name, comm);
+        int color = 0;
+        while (!std::equal(name.begin(), name.end(), names.begin() + color*MPI_MAX_PROCESSOR_NAME))
+            ++color;
+        return comm.split(color);
+#endif
+    }
+
+    void init(const mxx::comm& comm) {
+        whole_comm = comm.copy();
+        leader_comm = comm.split(node_comm.rank() == 0);
+        node_idx = leader_comm.rank();
+        num_nodes = leader_comm.size();
+        mxx::bcast(node_idx, 0, node_comm);
+        mxx::bcast(num_nodes, 0, node_comm);
+        rank_node = mxx::allgather(node_idx, comm);
+        rank_local = mxx::allgather(node_comm.rank(), comm);
+        node_ranks.resize(num_nodes);
+        for (int i = 0; i < comm.size(); ++i) {
+            std::vector<int>& ranks = node_ranks[rank_node[i]];
+            if (static_cast<int>(ranks.size()) <= rank_local[i])
+                ranks.resize(rank_local[i]+1);
+            ranks[rank_local[i]] = i;
+        }
+    }
+};
+
+#endif // HIER_COMM_HPP
@@ -0,0 +1,318 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    kmer_count.hpp
+ * @brief   Distributed k-mer counting and k-mer SA-interval queries, based on
+ *          the initial k-mer sorting of the suffix array construction.
+ */
+#ifndef KMER_COUNT_HPP
+#define KMER_COUNT_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/partition.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "alphabet.hpp"
+#include "kmer.hpp"
+#include "idxsort.hpp"
+#include "bucketing.hpp"
+#include "shifting.hpp"
+#include "bulk_permute.hpp"
+#include "bulk_rma.hpp"
+#include "sampled_index.hpp"
+
+/**
+ * @brief   Sorts all positions of a distributed string by their first `k`
+ *          characters only, and counts the occurrences of each k-mer.
+ *
+ * If `k` fits into a single machine word, this is a single k-mer sort.
+ * Otherwise, the prefix doubling of the suffix array construction is run
+ * until the buckets correspond to the first `k` characters, i.e., without
+ * completing the suffix array.
+ *
+ * After construction, each processor holds a table of all k-mers whose
+ * SA-interval intersects its block of `local_SA`. Queries are routed to
+ * these processors via a replicated sample of the block boundaries.
+ */
+template <typename char_t, typename index_t = std::size_t>
+class kmer_index {
+public:
+    using char_type = char_t;
+    using string_type = std::basic_string<char_t>;
+    using alphabet_type = alphabet<char_t>;
+
+    kmer_index(const mxx::comm& _comm) : comm(_comm.copy()) {
+    }
+
+    virtual ~kmer_index() {}
+
+private:
+    /// The global size of the input string
+    std::size_t n;
+
+    /// The local size of the input string
+    std::size_t local_size;
+
+    /// The k-mer size
+    unsigned int k;
+
+    /// The MPI communicator
+    mxx::comm comm;
+
+    /// The block decomposition for the input and `local_SA`
+    mxx::partition::block_decomposition_buffered<size_t> part;
+
+    /// SA-intervals (begin, end) of the k-mers intersecting the local block
+    std::vector<std::pair<index_t, index_t> > kmer_intervals;
+
+    /// the `k` characters for each k-mer in `kmer_intervals`, concatenated
+    std::vector<char_t> kmer_chars;
+
+    /// replicated first k-mer of each processor's block, for routing queries
+    sampled_index<char_t, index_t> boundaries;
+
+public:
+    alphabet_type alpha;
+
+    /// The local block of all string positions, sorted by their k-mer
+    std::vector<index_t> local_SA;
+
+public:
+
+    /// k-mer size
+    inline unsigned int kmer_size() const {
+        return k;
+    }
+
+    /// Global size of the input string
+    inline std::size_t global_size() const {
+        return n;
+    }
+
+    /**
+     * @brief   Sorts all k-mers and creates the local k-mer tables
+     *          (collective call).
+     */
+    template <typename Iterator>
+    void construct(Iterator begin, Iterator end, unsigned int _k) {
+        mxx::section_timer t(std::cerr, comm);
+        k = _k;
+        local_size = std::distance(begin, end);
+        n = mxx::allreduce(local_size, comm);
+        part = mxx::partition::block_decomposition_buffered<size_t>(n, comm.size(), comm.rank());
+        if (part.local_size() != local_size)
+            throw std::runtime_error("The input string must be equally block decomposed accross all MPI processes.");
+        if (k == 0 || k > n)
+            throw std::runtime_error("The k-mer size must be in [1, n].");
+        // the distributed k-mer generation reads from the right neighbor
+        if (n < static_cast<std::size_t>(comm.size()))
+            throw std::runtime_error("The input string must have at least one character per processor.");
+
+        alpha = alphabet_type::from_sequence(begin, end, comm);
+        unsigned int k0 = get_optimal_k<index_t>(alpha, local_size, comm, k);
+
+        // initial k0-mers as bucket numbers
+        std::vector<index_t> local_B = kmer_generation<index_t>(begin, end, k0, alpha, comm);
+        t.end_section("kmer_index: kmer generation");
+
+        if (k0 == k) {
+            // single k-mer sort
+            std::vector<index_t> local_B2(local_size, 0);
+            local_SA = idxsort_vectors<index_t, index_t>(local_B, local_B2, comm);
+            rebucket(local_B, local_B2, false, comm);
+            t.end_section("kmer_index: kmer sort");
+        } else {
+            // prefix doubling until the buckets represent the k-prefix
+            for (std::size_t h = k0; h < k;) {
+                std::size_t shift_by = std::min<std::size_t>(h, k - h);
+                std::vector<index_t> local_B2 = shift_vector(local_B, part, shift_by, comm);
+                local_SA = idxsort_vectors<index_t, index_t>(local_B, local_B2, comm);
+                rebucket(local_B, local_B2, false, comm);
+                h += shift_by;
+                if (h < k) {
+                    std::vector<index_t> cpy_SA(local_SA);
+                    bulk_permute_inplace(local_B, cpy_SA, part, comm);
+                }
+                t.end_section("kmer_index: prefix doubling iteration");
+            }
+        }
+
+        init_tables(begin, end, local_B);
+        t.end_section("kmer_index: init tables");
+    }
+
+private:
+
+    // builds the local k-mer tables from the (1-based) bucket numbers in SA order
+    template <typename Iterator>
+    void init_tables(Iterator begin, Iterator end, const std::vector<index_t>& local_B) {
+        std::size_t prefix = part.excl_prefix_size();
+
+        // local positions of bucket starts (including the first element)
+        std::vector<std::size_t> starts;
+        for (std::size_t i = 0; i < local_size; ++i) {
+            if (i == 0 || local_B[i] == prefix + i + 1)
+                starts.push_back(i);
+        }
+        // an empty block (p > n) has no bucket to split
+        bool first_split = (local_size > 0 && local_B[0] != prefix + 1);
+
+        // global start of the first bucket starting on a processor to the right
+        std::size_t first_start = first_split ? 1 : 0;
+        std::size_t local_first_start = (first_start < starts.size()) ? prefix + starts[first_start] : n;
+        mxx::comm rev = comm.reverse();
+        std::size_t next_start = mxx::exscan(local_first_start, mxx::min<size_t>(), rev);
+        if (rev.rank() == 0)
+            next_start = n;
+
+        // get the characters of all complete k-mers
+        std::vector<std::size_t> char_idx;
+        kmer_intervals.clear();
+        for (std::size_t j = 0; j < starts.size(); ++j) {
+            std::size_t pos = local_SA[starts[j]];
+            if (pos + k > n)
+                continue;
+            std::size_t sa_begin = local_B[starts[j]] - 1;
+            std::size_t sa_end = (j+1 < starts.size()) ? prefix + starts[j+1] : next_start;
+            kmer_intervals.push_back(std::pair<index_t, index_t>(sa_begin, sa_end));
+            for (unsigned int c = 0; c < k; ++c)
+                char_idx.push_back(pos + c);
+        }
+        kmer_chars = bulk_rma(begin, end, char_idx, comm);
+
+        // replicate the first k-mer of each block for routing
+        boundaries = sampled_index<char_t, index_t>(local_SA, begin, end, n, k, comm);
+    }
+
+    // compares the `i`-th local k-mer to the pattern `P`
+    inline int compare(std::size_t i, const string_type& P) const {
+        const char_t* s = &kmer_chars[i*k];
+        for (unsigned int j = 0; j < k; ++j) {
+            if (s[j] < P[j])
+                return -1;
+            if (P[j] < s[j])
+                return 1;
+        }
+        return 0;
+    }
+
+    // local lookup of a single k-mer in the local table
+    std::pair<index_t, index_t> local_interval(const string_type& P) const {
+        if (P.size() != k)
+            return std::pair<index_t, index_t>(0, 0);
+        std::size_t l = 0;
+        std::size_t r = kmer_intervals.size();
+        while (l < r) {
+            std::size_t mid = l + (r - l) / 2;
+            if (compare(mid, P) < 0)
+                l = mid + 1;
+            else
+                r = mid;
+        }
+        if (l < kmer_intervals.size() && compare(l, P) == 0)
+            return kmer_intervals[l];
+        return std::pair<index_t, index_t>(0, 0);
+    }
+
+public:
+
+    /**
+     * @brief   Returns the (k-mer position, count) pairs of all distinct
+     *          k-mers whose first occurrence in SA order is located on this
+     *          processor.
+     *
+     * The k-mer positions are global positions in the input string. The
+     * k-mers are returned in lexicographic order.
+     */
+    std::vector<std::pair<index_t, index_t> > local_counts() const {
+        std::vector<std::pair<index_t, index_t> > result;
+        result.reserve(kmer_intervals.size());
+        std::size_t prefix = part.excl_prefix_size();
+        for (std::size_t i = 0; i < kmer_intervals.size(); ++i) {
+            std::size_t sa_begin = kmer_intervals[i].first;
+            if (sa_begin < prefix)
+                continue;
+            result.push_back(std::pair<index_t, index_t>(local_SA[sa_begin - prefix], kmer_intervals[i].second - sa_begin));
+        }
+        return result;
+    }
+
+    /**
+     * @brief   Returns the distinct k-mers as strings, corresponding to the
+     *          result of `local_counts()`.
+     */
+    std::vector<string_type> local_kmers() const {
+        std::vector<string_type> result;
+        std::size_t prefix = part.excl_prefix_size();
+        for (std::size_t i = 0; i < kmer_intervals.size(); ++i) {
+            if (kmer_intervals[i].first < prefix)
+                continue;
+            result.emplace_back(kmer_chars.begin() + i*k, kmer_chars.begin() + (i+1)*k);
+        }
+        return result;
+    }
+
+    /**
+     * @brief   Returns the global number of distinct k-mers (collective call).
+     */
+    std::size_t num_distinct() const {
+        std::size_t local_num = kmer_intervals.size();
+        if (local_num > 0 && kmer_intervals[0].first < part.excl_prefix_size())
+            --local_num;
+        return mxx::allreduce(local_num, comm);
+    }
+
+    /**
+     * @brief   Returns the SA-interval [begin, end) for each of the given
+     *          k-mers (collective call).
+     *
+     * The SA-interval refers to the global positions in `local_SA` at which
+     * the occurrences of the k-mer are located. K-mers which do not occur
+     * (or are not of length `k`) return an empty interval.
+     */
+    std::vector<std::pair<index_t, index_t> > sa_intervals(const std::vector<string_type>& kmers) const {
+        std::vector<int> targets(kmers.size());
+        for (std::size_t i = 0; i < kmers.size(); ++i) {
+            targets[i] = boundaries.owner_processor(kmers[i]);
+        }
+        return bulk_pattern_query(kmers, targets, [this](const string_type& P) {
+            return this->local_interval(P);
+        }, comm);
+    }
+
+    /**
+     * @brief   Returns the number of occurrences for each of the given k-mers
+     *          (collective call).
+     */
+    std::vector<index_t> counts(const std::vector<string_type>& kmers) const {
+        std::vector<std::pair<index_t, index_t> > intervals = sa_intervals(kmers);
+        std::vector<index_t> result(intervals.size());
+        for (std::size_t i = 0; i < intervals.size(); ++i) {
+            result[i] = intervals[i].second - intervals[i].first;
+        }
+        return result;
+    }
+};
+
+#endif // KMER_COUNT_HPP
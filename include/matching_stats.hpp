@@ -0,0 +1,351 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    matching_stats.hpp
+ * @brief   Batched matching statistics and maximal exact matches (MEMs) of
+ *          query sequences against a distributed suffix array.
+ *
+ * The matching statistic `ms[i]` of a query `Q` is the length of the longest
+ * prefix of `Q[i..]` which occurs in the indexed string. It is given by the
+ * larger LCP of `Q[i..]` with the two suffixes adjacent to its insertion
+ * point in the suffix array. All query suffixes of a batch are searched
+ * simultaneously by a distributed binary search for their insertion point:
+ *  - the replicated sampled index brackets the search range locally
+ *  - each round fetches the suffix positions of the new midpoints and a
+ *    window of characters of all pending comparisons via `bulk_rma`
+ *  - comparisons skip the `min(llcp, rlcp)` characters shared with both
+ *    bounds of the search range (Manber & Myers), and comparisons which
+ *    exhaust their window continue in the next round with a doubled window
+ *
+ * When the search range is empty, the LCPs with both bounds are known, such
+ * that no further communication is needed to obtain the matching statistics.
+ */
+#ifndef MATCHING_STATS_HPP
+#define MATCHING_STATS_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+#include "bulk_rma.hpp"
+#include "sampled_index.hpp"
+
+/**
+ * @brief   Matching statistics of a batch of queries.
+ *
+ * The entries of the `i`-th query are stored in `[offsets[i], offsets[i+1])`.
+ */
+template <typename index_t>
+struct matching_statistics {
+    /// start of each query's entries, `offsets.back()` is the number of bases
+    std::vector<std::size_t> offsets;
+    /// length of the longest match starting at each query position
+    std::vector<index_t> length;
+    /// string position of one occurrence of that match (`n` if there is none)
+    std::vector<index_t> pos;
+
+    /// number of queries
+    inline std::size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    /// total number of query bases
+    inline std::size_t num_bases() const {
+        return offsets.empty() ? 0 : offsets.back();
+    }
+};
+
+/// A maximal exact match between a query and the indexed string.
+struct mem_hit {
+    /// index of the query within its batch
+    std::size_t query;
+    /// start position within the query
+    std::size_t qpos;
+    /// start position of one occurrence within the indexed string
+    std::size_t tpos;
+    /// length of the match
+    std::size_t len;
+};
+
+namespace impl {
+
+// search state of a single query suffix
+template <typename index_t>
+struct ms_search_state {
+    // insertion point search range [lo, hi)
+    index_t lo, hi;
+    // LCP with the suffixes SA[lo-1] and SA[hi], and their SA positions
+    // (`none` for the virtual sentinels before and after the SA)
+    index_t llcp, rlcp;
+    index_t lidx, ridx;
+    // pending comparison: midpoint, its suffix and the number of matched
+    // characters so far
+    index_t mid, mid_pos, matched;
+    std::size_t window;
+    bool comparing;
+};
+
+// LCP of the pattern with the stored prefix of a sample, the result is exact
+// if it is smaller than the prefix length of the index
+template <typename char_t, typename index_t, typename Iterator>
+std::size_t sample_lcp(const sampled_index<char_t, index_t>& idx, std::size_t i, Iterator p_begin, Iterator p_end) {
+    const char_t* s = idx.prefix(i);
+    std::size_t m = std::min<std::size_t>(std::distance(p_begin, p_end), idx.prefix_length());
+    std::size_t l = 0;
+    while (l < m && s[l] == *p_begin) {
+        ++l;
+        ++p_begin;
+    }
+    return l;
+}
+
+} // namespace impl
+
+/**
+ * @brief   Computes the matching statistics of all positions of the given
+ *          queries (collective call).
+ *
+ * @param local_SA      The local block of the suffix array.
+ * @param str_begin     Iterator to the local block of the input string.
+ * @param str_end       End iterator of the local block of the input string.
+ * @param idx           The sampled index over the same suffix array.
+ * @param queries       The local batch of queries.
+ * @param comm          The communicator.
+ * @param init_window   Number of characters fetched for the first round of
+ *                      each comparison.
+ */
+template <typename char_t, typename index_t, typename StringIter>
+matching_statistics<index_t>
+bulk_matching_statistics(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+                         const sampled_index<char_t, index_t>& idx,
+                         const std::vector<std::basic_string<char_t> >& queries, const mxx::comm& comm,
+                         std::size_t init_window = 16) {
+    mxx::section_timer t(std::cerr, comm);
+    MXX_ASSERT(init_window > 0);
+    const index_t none = std::numeric_limits<index_t>::max();
+    std::size_t n = idx.global_size();
+
+    matching_statistics<index_t> ms;
+    ms.offsets.resize(queries.size() + 1);
+    ms.offsets[0] = 0;
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        ms.offsets[i+1] = ms.offsets[i] + queries[i].size();
+    }
+    std::size_t num_bases = ms.offsets.back();
+
+    // one search per query suffix, bracketed by the closest samples which
+    // are known to be smaller, respectively not smaller
+    std::vector<impl::ms_search_state<index_t> > states(num_bases);
+    std::vector<std::size_t> query_of(num_bases);
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+        for (std::size_t j = 0; j < queries[q].size(); ++j) {
+            impl::ms_search_state<index_t>& s = states[ms.offsets[q] + j];
+            query_of[ms.offsets[q] + j] = q;
+            typename std::basic_string<char_t>::const_iterator p_begin = queries[q].begin() + j;
+            typename std::basic_string<char_t>::const_iterator p_end = queries[q].end();
+            std::size_t l = 0;
+            std::size_t r = idx.size();
+            while (l < r) {
+                std::size_t mid = l + (r - l) / 2;
+                if (idx.compare(mid, p_begin, p_end) < 0)
+                    l = mid + 1;
+                else
+                    r = mid;
+            }
+            std::size_t lo_sample = l;
+            r = idx.size();
+            while (l < r) {
+                std::size_t mid = l + (r - l) / 2;
+                if (idx.compare(mid, p_begin, p_end) <= 0)
+                    l = mid + 1;
+                else
+                    r = mid;
+            }
+            if (lo_sample == 0) {
+                s.lo = 0;
+                s.llcp = 0;
+                s.lidx = none;
+            } else {
+                s.lidx = idx.position(lo_sample - 1);
+                s.lo = s.lidx + 1;
+                s.llcp = impl::sample_lcp(idx, lo_sample - 1, p_begin, p_end);
+            }
+            if (l == idx.size()) {
+                s.hi = n;
+                s.rlcp = 0;
+                s.ridx = none;
+            } else {
+                s.ridx = idx.position(l);
+                s.hi = s.ridx;
+                s.rlcp = impl::sample_lcp(idx, l, p_begin, p_end);
+            }
+            s.comparing = false;
+        }
+    }
+    t.end_section("matching stats: sampled index");
+
+    std::vector<std::size_t> started;
+    std::vector<std::size_t> sa_idx;
+    std::vector<std::size_t> char_idx;
+    bool active = true;
+    while (mxx::any_of(active, comm)) {
+        // start new comparisons at the midpoints of the search ranges
+        started.clear();
+        sa_idx.clear();
+        for (std::size_t i = 0; i < num_bases; ++i) {
+            impl::ms_search_state<index_t>& s = states[i];
+            if (s.lo < s.hi && !s.comparing) {
+                s.mid = s.lo + (s.hi - s.lo) / 2;
+                s.matched = std::min(s.llcp, s.rlcp);
+                s.window = init_window;
+                s.comparing = true;
+                started.push_back(i);
+                sa_idx.push_back(s.mid);
+            }
+        }
+        std::vector<index_t> sa_pos = bulk_rma(local_SA.begin(), local_SA.end(), sa_idx, comm);
+        for (std::size_t j = 0; j < started.size(); ++j) {
+            states[started[j]].mid_pos = sa_pos[j];
+        }
+
+        // request the next window of characters of all pending comparisons
+        char_idx.clear();
+        for (std::size_t i = 0; i < num_bases; ++i) {
+            impl::ms_search_state<index_t>& s = states[i];
+            if (!s.comparing)
+                continue;
+            std::size_t m = ms.offsets[query_of[i]+1] - i;
+            std::size_t end = std::min<std::size_t>(std::min<std::size_t>(s.mid_pos + s.matched + s.window, n), s.mid_pos + m);
+            for (std::size_t c = s.mid_pos + s.matched; c < end; ++c)
+                char_idx.push_back(c);
+        }
+        std::vector<char_t> chars = bulk_rma(str_begin, str_end, char_idx, comm);
+
+        // compare and update the search ranges
+        std::size_t c = 0;
+        active = false;
+        for (std::size_t i = 0; i < num_bases; ++i) {
+            impl::ms_search_state<index_t>& s = states[i];
+            if (!s.comparing)
+                continue;
+            const std::basic_string<char_t>& Q = queries[query_of[i]];
+            std::size_t qoff = i - ms.offsets[query_of[i]];
+            std::size_t m = Q.size() - qoff;
+            std::size_t end = std::min<std::size_t>(std::min<std::size_t>(s.mid_pos + s.matched + s.window, n), s.mid_pos + m);
+            std::size_t len = end - (s.mid_pos + s.matched);
+            int cmp = 0;
+            std::size_t k = 0;
+            for (; k < len; ++k) {
+                if (chars[c+k] < Q[qoff + s.matched + k]) {
+                    cmp = -1;
+                    break;
+                } else if (Q[qoff + s.matched + k] < chars[c+k]) {
+                    cmp = 1;
+                    break;
+                }
+            }
+            c += len;
+            s.matched += k;
+            if (cmp == 0) {
+                if (s.matched == m) {
+                    // the suffix is prefixed by the whole query suffix
+                    cmp = 1;
+                } else if (s.mid_pos + s.matched == n) {
+                    // the suffix is a proper prefix of the query suffix
+                    cmp = -1;
+                } else {
+                    // window exhausted: continue with a larger one
+                    s.window *= 2;
+                    active = true;
+                    continue;
+                }
+            }
+            if (cmp < 0) {
+                s.lo = s.mid + 1;
+                s.llcp = s.matched;
+                s.lidx = s.mid;
+            } else {
+                s.hi = s.mid;
+                s.rlcp = s.matched;
+                s.ridx = s.mid;
+            }
+            s.comparing = false;
+            if (s.lo < s.hi)
+                active = true;
+        }
+    }
+    t.end_section("matching stats: distributed binary search");
+
+    // the longer of the two matches with the adjacent suffixes
+    ms.length.resize(num_bases);
+    std::vector<std::size_t> match_idx;
+    for (std::size_t i = 0; i < num_bases; ++i) {
+        const impl::ms_search_state<index_t>& s = states[i];
+        bool left = s.ridx == none || (s.lidx != none && s.llcp >= s.rlcp);
+        ms.length[i] = left ? s.llcp : s.rlcp;
+        index_t mi = left ? s.lidx : s.ridx;
+        if (mi != none)
+            match_idx.push_back(mi);
+    }
+    std::vector<index_t> match_pos = bulk_rma(local_SA.begin(), local_SA.end(), match_idx, comm);
+    ms.pos.resize(num_bases);
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < num_bases; ++i) {
+        const impl::ms_search_state<index_t>& s = states[i];
+        bool left = s.ridx == none || (s.lidx != none && s.llcp >= s.rlcp);
+        index_t mi = left ? s.lidx : s.ridx;
+        ms.pos[i] = (mi != none) ? match_pos[j++] : index_t(n);
+    }
+    t.end_section("matching stats: match positions");
+    return ms;
+}
+
+/**
+ * @brief   Returns the maximal exact matches of at least `min_len`
+ *          characters from the matching statistics.
+ *
+ * The match starting at query position `i` is reported if it can not be
+ * extended to the left, i.e., if `i` is the first position of the query or
+ * `ms[i-1] <= ms[i]`. One occurrence is reported per match, all occurrences
+ * can be located via `bulk_sa_ranges()`.
+ */
+template <typename index_t>
+std::vector<mem_hit> find_mems(const matching_statistics<index_t>& ms, std::size_t min_len) {
+    std::vector<mem_hit> mems;
+    for (std::size_t q = 0; q < ms.size(); ++q) {
+        for (std::size_t i = ms.offsets[q]; i < ms.offsets[q+1]; ++i) {
+            if (ms.length[i] == 0 || ms.length[i] < min_len)
+                continue;
+            if (i == ms.offsets[q] || ms.length[i-1] <= ms.length[i]) {
+                mem_hit h;
+                h.query = q;
+                h.qpos = i - ms.offsets[q];
+                h.tpos = ms.pos[i];
+                h.len = ms.length[i];
+                mems.push_back(h);
+            }
+        }
+    }
+    return mems;
+}
+
+#endif // MATCHING_STATS_HPP
@@ -0,0 +1,428 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    minimizer_index.hpp
+ * @brief   Sparse index of the (w,k)-minimizers of a distributed string, as
+ *          a seed table for long-read mapping.
+ *
+ * Every window of `w` consecutive k-mers selects the k-mer with the smallest
+ * hash value (the leftmost one on ties). Only the selected positions are
+ * indexed, which are about `2n/(w+1)` for random strings, instead of all `n`
+ * suffixes of the suffix array.
+ *
+ * The k-mers are created chunk by chunk via `kmer_generation()`, such that the
+ * construction only needs memory for the input, a single chunk, and the
+ * resulting table of (minimizer, position) pairs. The table is sorted with
+ * the distributed sort and block decomposed. Queries for minimizers are
+ * routed via the replicated key range of each processor's block.
+ */
+#ifndef MINIMIZER_INDEX_HPP
+#define MINIMIZER_INDEX_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/sort.hpp>
+#include <mxx/distribution.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "alphabet.hpp"
+#include "kmer.hpp"
+#include "bulk_rma.hpp"
+#include "all2all.hpp"
+
+/**
+ * @brief   Invertible integer hash of a k-mer, restricted to the bits of
+ *          `mask`, such that distinct k-mers get distinct hash values.
+ */
+inline uint64_t minimizer_hash(uint64_t key, uint64_t mask) {
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+namespace impl {
+
+/**
+ * @brief   Calls `f(hash, pos)` with the minimizer of every window of `w`
+ *          consecutive k-mers of the sequence given by `char_at(i)` for
+ *          `0 <= i < num_kmers + k - 1`.
+ *
+ * `pos` is the position of the selected k-mer. The k-mers are generated in
+ * chunks of `chunk_size` k-mers.
+ */
+template <typename char_t, typename CharFunc, typename Func>
+void for_each_window_minimizer(std::size_t num_kmers, unsigned int k, unsigned int w, const alphabet<char_t>& alpha, CharFunc char_at, Func f, std::size_t chunk_size) {
+    unsigned int bits = alpha.bits_per_char() * k;
+    uint64_t mask = bits >= 64 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << bits) - 1;
+    // monotone queue of (hash, pos) with increasing hash values
+    std::deque<std::pair<uint64_t, std::size_t> > q;
+    std::vector<char_t> buf;
+    for (std::size_t c = 0; c < num_kmers; c += chunk_size) {
+        std::size_t m = std::min(chunk_size, num_kmers - c);
+        buf.resize(m + k - 1);
+        for (std::size_t i = 0; i < buf.size(); ++i)
+            buf[i] = char_at(c + i);
+        // the first `m` k-mers of the chunk are complete
+        std::vector<uint64_t> kmers = kmer_generation<uint64_t>(buf.begin(), buf.end(), k, alpha);
+        for (std::size_t i = 0; i < m; ++i) {
+            std::size_t pos = c + i;
+            uint64_t h = minimizer_hash(kmers[i], mask);
+            while (!q.empty() && q.back().first > h)
+                q.pop_back();
+            q.push_back(std::pair<uint64_t, std::size_t>(h, pos));
+            if (pos + 1 >= w) {
+                while (q.front().second + w <= pos)
+                    q.pop_front();
+                f(q.front().first, q.front().second);
+            }
+        }
+    }
+}
+
+} // namespace impl
+
+/**
+ * @brief   Returns the distinct (w,k)-minimizers (hash, position) of a local
+ *          sequence, ordered by position.
+ *
+ * Sequences shorter than `w+k-1` have no minimizers.
+ */
+template <typename Iterator>
+std::vector<std::pair<uint64_t, std::size_t> >
+sequence_minimizers(Iterator begin, Iterator end, unsigned int k, unsigned int w, const alphabet<typename std::iterator_traits<Iterator>::value_type>& alpha) {
+    std::vector<std::pair<uint64_t, std::size_t> > result;
+    std::size_t n = std::distance(begin, end);
+    if (k == 0 || w == 0 || n < k + w - 1)
+        return result;
+    impl::for_each_window_minimizer(n - k + 1, k, w, alpha, [&begin](std::size_t i) -> typename std::iterator_traits<Iterator>::value_type {
+        return *(begin + i);
+    }, [&result](uint64_t h, std::size_t pos) {
+        if (result.empty() || result.back().second != pos)
+            result.push_back(std::pair<uint64_t, std::size_t>(h, pos));
+    }, n);
+    return result;
+}
+
+/**
+ * @brief   The occurrences of a batch of minimizers, as the concatenation of
+ *          the (sorted) positions of each minimizer.
+ */
+template <typename index_t>
+struct minimizer_hits {
+    /// `pos[offsets[i]..offsets[i+1])` are the positions of the i-th minimizer
+    std::vector<std::size_t> offsets;
+    /// the positions in the indexed string
+    std::vector<index_t> pos;
+
+    /// number of queried minimizers
+    inline std::size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    /// number of occurrences of the i-th minimizer
+    inline std::size_t count(std::size_t i) const {
+        return offsets[i+1] - offsets[i];
+    }
+};
+
+/**
+ * @brief   A seed of a read: the minimizer at position `qpos` in read `read`
+ *          occurs at position `tpos` in the indexed string.
+ */
+struct minimizer_seed {
+    std::size_t read;
+    std::size_t qpos;
+    std::size_t tpos;
+};
+
+/**
+ * @brief   Distributed table of the (w,k)-minimizers of a string, sorted by
+ *          (minimizer hash, position) and block decomposed.
+ */
+template <typename char_t, typename index_t = std::size_t>
+class minimizer_index {
+public:
+    using char_type = char_t;
+    using string_type = std::basic_string<char_t>;
+    using alphabet_type = alphabet<char_t>;
+    using entry_type = std::pair<uint64_t, index_t>;
+
+    minimizer_index(const mxx::comm& _comm) : comm(_comm.copy()) {
+    }
+
+    virtual ~minimizer_index() {}
+
+private:
+    /// The global size of the input string
+    std::size_t n;
+
+    /// The k-mer size
+    unsigned int k;
+
+    /// The number of consecutive k-mers per window
+    unsigned int w;
+
+    /// The MPI communicator
+    mxx::comm comm;
+
+    /// replicated first and last minimizer of each non-empty table block
+    std::vector<std::pair<uint64_t, uint64_t> > key_ranges;
+
+    /// the processor of each entry in `key_ranges`
+    std::vector<int> key_range_procs;
+
+public:
+    alphabet_type alpha;
+
+    /// The local block of the (minimizer hash, position) table
+    std::vector<entry_type> local_table;
+
+public:
+
+    /// k-mer size
+    inline unsigned int kmer_size() const {
+        return k;
+    }
+
+    /// window size (in k-mers)
+    inline unsigned int window_size() const {
+        return w;
+    }
+
+    /// Global size of the input string
+    inline std::size_t global_size() const {
+        return n;
+    }
+
+    /**
+     * @brief   Returns the global number of indexed positions (collective call).
+     */
+    std::size_t num_minimizers() const {
+        return mxx::allreduce(local_table.size(), comm);
+    }
+
+    /**
+     * @brief   Selects the minimizers of the block decomposed string
+     *          `[begin, end)` and creates the table (collective call).
+     *
+     * Each processor evaluates all windows that can select a position of its
+     * own block, which includes the last `w-1` windows of its left neighbor,
+     * and emits the selected positions of its own block only, such that
+     * every minimizer position is indexed exactly once.
+     */
+    template <typename Iterator>
+    void construct(Iterator begin, Iterator end, unsigned int _k, unsigned int _w, std::size_t chunk_size = 1 << 20) {
+        mxx::section_timer t(std::cerr, comm);
+        k = _k;
+        w = _w;
+        std::size_t local_size = std::distance(begin, end);
+        n = mxx::allreduce(local_size, comm);
+        blk_dist part(n, comm.size(), comm.rank());
+        if (part.local_size() != local_size)
+            throw std::runtime_error("The input string must be equally block decomposed accross all MPI processes.");
+        alpha = alphabet_type::from_sequence(begin, end, comm);
+        if (k == 0 || k > alpha.template chars_per_word<uint64_t>())
+            throw std::runtime_error("The k-mer size must be in [1, " + std::to_string(alpha.template chars_per_word<uint64_t>()) + "] for this alphabet.");
+        if (w == 0)
+            throw std::runtime_error("The window size must be at least 1.");
+
+        // windows [win_begin, win_end) can select a local position
+        std::size_t prefix = part.eprefix();
+        std::size_t num_windows = (n >= k + w - 1) ? n - k - w + 2 : 0;
+        std::size_t win_begin = prefix >= w - 1 ? prefix - (w - 1) : 0;
+        std::size_t win_end = std::min(prefix + local_size, num_windows);
+        if (win_begin > win_end)
+            win_begin = win_end;
+        std::size_t num_kmers = (win_begin < win_end) ? win_end - win_begin + w - 1 : 0;
+        std::size_t chars_end = (num_kmers > 0) ? win_begin + num_kmers + k - 1 : prefix;
+
+        // read the characters of the neighboring blocks
+        std::vector<std::size_t> char_idx;
+        for (std::size_t i = win_begin; i < prefix; ++i)
+            char_idx.push_back(i);
+        for (std::size_t i = prefix + local_size; i < chars_end; ++i)
+            char_idx.push_back(i);
+        std::vector<char_t> ext_chars = bulk_rma(begin, end, char_idx, comm);
+        std::size_t num_head = std::min(prefix, chars_end) - win_begin;
+        t.end_section("minimizer_index: get neighboring characters");
+
+        local_table.clear();
+        if (num_kmers > 0) {
+            std::size_t local_end = prefix + local_size;
+            impl::for_each_window_minimizer(num_kmers, k, w, alpha, [&](std::size_t i) -> char_t {
+                std::size_t g = win_begin + i;
+                if (g < prefix)
+                    return ext_chars[g - win_begin];
+                else if (g < local_end)
+                    return *(begin + (g - prefix));
+                else
+                    return ext_chars[num_head + (g - local_end)];
+            }, [&](uint64_t h, std::size_t pos) {
+                std::size_t g = win_begin + pos;
+                if (prefix <= g && g < local_end && (local_table.empty() || local_table.back().second != g))
+                    local_table.push_back(entry_type(h, g));
+            }, chunk_size);
+        }
+        t.end_section("minimizer_index: select minimizers");
+
+        // sort by (minimizer, position) and block decompose
+        mxx::sort(local_table.begin(), local_table.end(), comm);
+        mxx::stable_distribute_inplace(local_table, comm);
+        t.end_section("minimizer_index: sort minimizers");
+
+        // replicate the key range of each block for routing queries
+        std::pair<uint64_t, uint64_t> range(0, 0);
+        if (!local_table.empty())
+            range = std::pair<uint64_t, uint64_t>(local_table.front().first, local_table.back().first);
+        std::vector<std::pair<uint64_t, uint64_t> > all_ranges = mxx::allgather(range, comm);
+        std::vector<size_t> sizes = mxx::allgather(local_table.size(), comm);
+        key_ranges.clear();
+        key_range_procs.clear();
+        for (int i = 0; i < comm.size(); ++i) {
+            if (sizes[i] > 0) {
+                key_ranges.push_back(all_ranges[i]);
+                key_range_procs.push_back(i);
+            }
+        }
+        t.end_section("minimizer_index: key ranges");
+    }
+
+    /**
+     * @brief   Returns the sorted positions of each of the given minimizer
+     *          hashes (collective call).
+     *
+     * A minimizer whose occurrences span several table blocks is sent to
+     * each of these processors.
+     */
+    minimizer_hits<index_t> lookup(const std::vector<uint64_t>& keys) const {
+        mxx::section_timer t(std::cerr, comm);
+        // the range of (non-empty) blocks which may contain each key
+        std::vector<std::pair<std::size_t, std::size_t> > targets(keys.size());
+        std::vector<size_t> send_counts(comm.size(), 0);
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            std::size_t b = std::lower_bound(key_ranges.begin(), key_ranges.end(), keys[i],
+                [](const std::pair<uint64_t, uint64_t>& r, uint64_t key) {
+                    return r.second < key;
+                }) - key_ranges.begin();
+            std::size_t e = b;
+            while (e < key_ranges.size() && key_ranges[e].first <= keys[i]) {
+                ++send_counts[key_range_procs[e]];
+                ++e;
+            }
+            targets[i] = std::pair<std::size_t, std::size_t>(b, e);
+        }
+        std::vector<size_t> send_displs = mxx::local_exscan(send_counts);
+        std::vector<uint64_t> requests(send_displs.back() + send_counts.back());
+        std::vector<size_t> offset = send_displs;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            for (std::size_t j = targets[i].first; j < targets[i].second; ++j)
+                requests[offset[key_range_procs[j]]++] = keys[i];
+        }
+        std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+        requests = auto_all2allv(requests, send_counts, recv_counts, comm);
+        t.end_section("minimizer_index: send queries");
+
+        // answer with the number of local occurrences and their positions
+        std::vector<size_t> counts(requests.size());
+        std::vector<index_t> pos;
+        std::vector<size_t> pos_send_counts(comm.size(), 0);
+        std::size_t r = 0;
+        for (int p = 0; p < comm.size(); ++p) {
+            for (std::size_t j = 0; j < recv_counts[p]; ++j, ++r) {
+                typename std::vector<entry_type>::const_iterator lb = std::lower_bound(local_table.begin(), local_table.end(),
+                    entry_type(requests[r], 0));
+                typename std::vector<entry_type>::const_iterator it = lb;
+                for (; it != local_table.end() && it->first == requests[r]; ++it)
+                    pos.push_back(it->second);
+                counts[r] = it - lb;
+                pos_send_counts[p] += counts[r];
+            }
+        }
+        requests = std::vector<uint64_t>();
+        counts = auto_all2allv(counts, recv_counts, send_counts, comm);
+        std::vector<size_t> pos_recv_counts = auto_all2all(pos_send_counts, comm);
+        pos = auto_all2allv(pos, pos_send_counts, pos_recv_counts, comm);
+        t.end_section("minimizer_index: answer queries");
+
+        // assemble the occurrences of each key from its blocks in order
+        std::vector<size_t> pos_displs = mxx::local_exscan(pos_recv_counts);
+        minimizer_hits<index_t> result;
+        result.offsets.resize(keys.size() + 1, 0);
+        result.pos.reserve(pos.size());
+        offset = send_displs;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            for (std::size_t j = targets[i].first; j < targets[i].second; ++j) {
+                int p = key_range_procs[j];
+                std::size_t c = counts[offset[p]++];
+                result.pos.insert(result.pos.end(), pos.begin() + pos_displs[p], pos.begin() + pos_displs[p] + c);
+                pos_displs[p] += c;
+            }
+            result.offsets[i+1] = result.pos.size();
+        }
+        return result;
+    }
+
+    /**
+     * @brief   Returns all seeds of the given reads, i.e., the occurrences of
+     *          their minimizers in the indexed string (collective call).
+     *
+     * Minimizers with more than `max_occ` occurrences are skipped as
+     * repeats.
+     */
+    std::vector<minimizer_seed> seeds(const std::vector<string_type>& reads, std::size_t max_occ = std::numeric_limits<std::size_t>::max()) const {
+        std::vector<uint64_t> keys;
+        std::vector<std::pair<std::size_t, std::size_t> > key_src;
+        for (std::size_t r = 0; r < reads.size(); ++r) {
+            std::vector<std::pair<uint64_t, std::size_t> > mins = sequence_minimizers(reads[r].begin(), reads[r].end(), k, w, alpha);
+            for (std::size_t i = 0; i < mins.size(); ++i) {
+                keys.push_back(mins[i].first);
+                key_src.push_back(std::pair<std::size_t, std::size_t>(r, mins[i].second));
+            }
+        }
+        minimizer_hits<index_t> hits = lookup(keys);
+        std::vector<minimizer_seed> result;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            if (hits.count(i) > max_occ)
+                continue;
+            for (std::size_t j = hits.offsets[i]; j < hits.offsets[i+1]; ++j) {
+                minimizer_seed s;
+                s.read = key_src[i].first;
+                s.qpos = key_src[i].second;
+                s.tpos = hits.pos[j];
+                result.push_back(s);
+            }
+        }
+        return result;
+    }
+};
+
+#endif // MINIMIZER_INDEX_HPP
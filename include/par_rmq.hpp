@@ -32,10 +32,15 @@
 #include <mxx/collective.hpp>
 
 #include "rmq.hpp"
+#include "all2all.hpp"
+#include "dvector.hpp"
 
 
-template <typename index_t>
-void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
+// `Partition` is the distribution of `local_els`, either a
+// `mxx::partition::block_decomposition_buffered` or any other distribution
+// with the same interface (e.g. `gen_dist`)
+template <typename index_t, typename Partition>
+void bulk_rmq(const Partition& part, const std::vector<index_t>& local_els,
               std::vector<std::tuple<index_t, index_t, index_t>>& ranges,
               const mxx::comm& comm) {
     // 3.) bulk-parallel-distributed RMQ for ranges (B2[i-1],B2[i]+1) to get min_lcp[i]
@@ -52,10 +57,9 @@ void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
     //     f.) for each range: get RMQ of intermediary processors
     //                         min(min_p_left, RMQ(p_left+1,p_right-1), min_p_right)
 
-    mxx::partition::block_decomposition_buffered<index_t> part(n, comm.size(), comm.rank());
-
     // get size parameters
     std::size_t local_size = local_els.size();
+    assert(part.local_size() == local_size);
     std::size_t prefix_size = part.excl_prefix_size();
 
     // create RMQ for local elements
@@ -91,7 +95,7 @@ void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
     std::vector<std::tuple<index_t, index_t, index_t> > ranges_right(ranges);
 
     // first communication
-    mxx::all2all_func(
+    auto_all2all_func(
         ranges,
         [&](const std::tuple<index_t, index_t, index_t>& x) {
             return part.target_processor(std::get<1>(x));
@@ -111,14 +115,14 @@ void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
         std::get<2>(*it) = *range_min;
     }
     // send results back to originator
-    mxx::all2all_func(
+    auto_all2all_func(
         ranges,
         [&](const std::tuple<index_t, index_t, index_t>& x) {
             return part.target_processor(std::get<0>(x));
         }, comm);
 
     // second communication
-    mxx::all2all_func(
+    auto_all2all_func(
         ranges_right,
         [&](const std::tuple<index_t, index_t, index_t>& x) {
             return part.target_processor(std::get<2>(x)-1);
@@ -138,7 +142,7 @@ void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
         std::get<2>(*it) = *range_min;
     }
     // send results back to originator
-    mxx::all2all_func(
+    auto_all2all_func(
         ranges_right,
         [&](const std::tuple<index_t, index_t, index_t>& x) {
             return part.target_processor(std::get<0>(x));
@@ -196,4 +200,20 @@ void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
     }
 }
 
+// for block decomposed `local_els`
+template <typename index_t>
+void bulk_rmq(const std::size_t n, const std::vector<index_t>& local_els,
+              std::vector<std::tuple<index_t, index_t, index_t>>& ranges,
+              const mxx::comm& comm) {
+    blk_dist part(n, comm.size(), comm.rank());
+    bulk_rmq(part, local_els, ranges, comm);
+}
+
+// for the distributed range `els`
+template <typename DRange>
+typename std::enable_if<is_drange<DRange>::value>::type
+bulk_rmq(const DRange& els, std::vector<std::tuple<typename DRange::value_type, typename DRange::value_type, typename DRange::value_type>>& ranges) {
+    bulk_rmq(els.distribution(), els.local(), ranges, els.comm());
+}
+
 #endif // PARALLEL_BULK_RMQ_HPP
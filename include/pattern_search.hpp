@@ -0,0 +1,208 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    pattern_search.hpp
+ * @brief   Batched pattern count and locate queries on a distributed
+ *          suffix array.
+ */
+#ifndef PATTERN_SEARCH_HPP
+#define PATTERN_SEARCH_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <limits>
+
+#include "bulk_rma.hpp"
+#include "sampled_index.hpp"
+
+/**
+ * @brief   Returns the SA-interval [begin, end) of all suffixes prefixed by
+ *          each of the given patterns (collective call).
+ *
+ * All patterns are searched simultaneously by a distributed binary search.
+ * The search range is initially narrowed down via the replicated sampled
+ * index, after which each round fetches the suffix positions and pattern
+ * length characters of the current midpoints via `bulk_rma`.
+ *
+ * For generalized suffix arrays, `local_seq_end` holds for each position of
+ * the local input block the (exclusive) end of its sequence, such that
+ * suffixes are not matched across sequence boundaries. If empty, all
+ * suffixes end at the end of the string.
+ *
+ * @param local_SA      The local block of the suffix array.
+ * @param str_begin     Iterator to the local block of the input string.
+ * @param str_end       End iterator of the local block of the input string.
+ * @param local_seq_end The local block of sequence ends (or empty).
+ * @param idx           The sampled index over the same suffix array.
+ * @param patterns      The local batch of patterns.
+ * @param comm          The communicator.
+ */
+template <typename char_t, typename index_t, typename StringIter>
+std::vector<std::pair<index_t, index_t> >
+bulk_sa_ranges(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+               const std::vector<index_t>& local_seq_end, const sampled_index<char_t, index_t>& idx,
+               const std::vector<std::basic_string<char_t> >& patterns, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    std::size_t n = idx.global_size();
+    std::size_t q = patterns.size();
+    bool has_seq_ends = mxx::any_of(!local_seq_end.empty(), comm);
+
+    // two binary searches per pattern: [lower bound, upper bound]
+    std::vector<std::pair<index_t, index_t> > lb(q);
+    std::vector<std::pair<index_t, index_t> > ub(q);
+    bool active = false;
+    for (std::size_t i = 0; i < q; ++i) {
+        lb[i] = idx.sa_range(patterns[i]);
+        ub[i] = lb[i];
+        if (lb[i].first < lb[i].second)
+            active = true;
+    }
+    t.end_section("bulk_sa_ranges: sampled index");
+
+    std::vector<std::size_t> sa_idx;
+    std::vector<std::size_t> char_idx;
+    while (mxx::any_of(active, comm)) {
+        // request the suffix positions of all midpoints
+        sa_idx.clear();
+        for (std::size_t i = 0; i < q; ++i) {
+            if (lb[i].first < lb[i].second)
+                sa_idx.push_back(lb[i].first + (lb[i].second - lb[i].first) / 2);
+            if (ub[i].first < ub[i].second)
+                sa_idx.push_back(ub[i].first + (ub[i].second - ub[i].first) / 2);
+        }
+        std::vector<index_t> sa_pos = bulk_rma(local_SA.begin(), local_SA.end(), sa_idx, comm);
+        std::vector<index_t> sa_end(sa_pos.size(), n);
+        if (has_seq_ends) {
+            std::vector<std::size_t> pos_idx(sa_pos.begin(), sa_pos.end());
+            sa_end = bulk_rma(local_seq_end.begin(), local_seq_end.end(), pos_idx, comm);
+        }
+
+        // request the first |P| characters of these suffixes
+        char_idx.clear();
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < q; ++i) {
+            std::size_t m = patterns[i].size();
+            for (int b = 0; b < 2; ++b) {
+                const std::pair<index_t, index_t>& r = (b == 0) ? lb[i] : ub[i];
+                if (r.first < r.second) {
+                    for (std::size_t c = sa_pos[j]; c < std::min<std::size_t>(sa_pos[j] + m, sa_end[j]); ++c)
+                        char_idx.push_back(c);
+                    ++j;
+                }
+            }
+        }
+        std::vector<char_t> chars = bulk_rma(str_begin, str_end, char_idx, comm);
+
+        // compare and update the search ranges
+        j = 0;
+        std::size_t c = 0;
+        active = false;
+        for (std::size_t i = 0; i < q; ++i) {
+            const std::basic_string<char_t>& P = patterns[i];
+            for (int b = 0; b < 2; ++b) {
+                std::pair<index_t, index_t>& r = (b == 0) ? lb[i] : ub[i];
+                if (r.first >= r.second)
+                    continue;
+                std::size_t len = std::min<std::size_t>(sa_pos[j] + P.size(), sa_end[j]) - sa_pos[j];
+                int cmp = 0;
+                for (std::size_t k = 0; k < len && cmp == 0; ++k) {
+                    if (chars[c+k] < P[k])
+                        cmp = -1;
+                    else if (P[k] < chars[c+k])
+                        cmp = 1;
+                }
+                // suffixes shorter than P which match P are smaller than P
+                if (cmp == 0 && len < P.size())
+                    cmp = -1;
+                c += len;
+                ++j;
+
+                index_t mid = r.first + (r.second - r.first) / 2;
+                // lower bound: first suffix >= P, upper bound: first suffix > P
+                if (cmp < 0 || (b == 1 && cmp == 0))
+                    r.first = mid + 1;
+                else
+                    r.second = mid;
+                if (r.first < r.second)
+                    active = true;
+            }
+        }
+    }
+    t.end_section("bulk_sa_ranges: distributed binary search");
+
+    std::vector<std::pair<index_t, index_t> > result(q);
+    for (std::size_t i = 0; i < q; ++i) {
+        result[i] = std::pair<index_t, index_t>(lb[i].first, ub[i].first);
+    }
+    return result;
+}
+
+template <typename char_t, typename index_t, typename StringIter>
+std::vector<std::pair<index_t, index_t> >
+bulk_sa_ranges(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+               const sampled_index<char_t, index_t>& idx,
+               const std::vector<std::basic_string<char_t> >& patterns, const mxx::comm& comm) {
+    return bulk_sa_ranges(local_SA, str_begin, str_end, std::vector<index_t>(), idx, patterns, comm);
+}
+
+/**
+ * @brief   Returns the number of occurrences of each of the given patterns
+ *          (collective call).
+ */
+template <typename char_t, typename index_t, typename StringIter>
+std::vector<index_t>
+bulk_count(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+           const sampled_index<char_t, index_t>& idx,
+           const std::vector<std::basic_string<char_t> >& patterns, const mxx::comm& comm) {
+    std::vector<std::pair<index_t, index_t> > ranges = bulk_sa_ranges(local_SA, str_begin, str_end, idx, patterns, comm);
+    std::vector<index_t> counts(ranges.size());
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        counts[i] = ranges[i].second - ranges[i].first;
+    }
+    return counts;
+}
+
+/**
+ * @brief   Returns the string positions of all suffixes in the given
+ *          SA-intervals (collective call).
+ *
+ * The positions of the `i`-th interval are returned in
+ * `[offsets[i], offsets[i+1])` of the result, in SA order.
+ * At most `max_occ` positions are returned per interval.
+ */
+template <typename index_t>
+std::vector<index_t>
+bulk_locate(const std::vector<index_t>& local_SA, const std::vector<std::pair<index_t, index_t> >& ranges,
+            std::vector<std::size_t>& offsets, const mxx::comm& comm,
+            std::size_t max_occ = std::numeric_limits<std::size_t>::max()) {
+    std::vector<std::size_t> sa_idx;
+    offsets.resize(ranges.size()+1);
+    offsets[0] = 0;
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        std::size_t num = std::min<std::size_t>(ranges[i].second - ranges[i].first, max_occ);
+        for (std::size_t j = ranges[i].first; j < ranges[i].first + num; ++j)
+            sa_idx.push_back(j);
+        offsets[i+1] = sa_idx.size();
+    }
+    return bulk_rma(local_SA.begin(), local_SA.end(), sa_idx, comm);
+}
+
+#endif // PATTERN_SEARCH_HPP
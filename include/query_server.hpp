@@ -0,0 +1,229 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    query_server.hpp
+ * @brief   Long running server answering batches of pattern queries against
+ *          a resident distributed suffix array.
+ *
+ * Queries are read line by line on the master processor from a named pipe
+ * (or a regular file, or stdin), one query per line:
+ *
+ *      count <pattern>
+ *      locate <pattern>
+ *
+ * An empty line flushes the current batch, and `quit` stops the server
+ * after answering the current batch. Batches are broadcast to all
+ * processors, answered with the bulk distributed search, and the results are
+ * streamed back in query order:
+ *
+ *      <pattern>\t<count>
+ *      <pattern>\t<count>\t<pos_1> <pos_2> ...
+ */
+#ifndef QUERY_SERVER_HPP
+#define QUERY_SERVER_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/partition.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "sampled_index.hpp"
+#include "pattern_search.hpp"
+
+/// Latency statistics of the query server
+struct query_server_stats {
+    std::size_t num_batches = 0;
+    std::size_t num_queries = 0;
+    double total_time = 0.0;
+    double max_batch_time = 0.0;
+};
+
+namespace impl {
+
+// reads the next batch of queries on the master processor, returns
+// `false` if the server should stop after this batch
+inline bool read_query_batch(std::istream& in, std::size_t max_batch, std::vector<char>& types, std::vector<std::string>& patterns) {
+    std::string line;
+    while (patterns.size() < max_batch && std::getline(in, line)) {
+        if (line.empty()) {
+            if (patterns.empty())
+                continue;
+            break;
+        }
+        if (line == "quit")
+            return false;
+        std::size_t sep = line.find(' ');
+        std::string cmd = line.substr(0, sep);
+        if (sep == std::string::npos || (cmd != "count" && cmd != "locate")) {
+            std::cerr << "query server: ignoring invalid query `" << line << "`" << std::endl;
+            continue;
+        }
+        types.push_back(cmd[0]);
+        patterns.push_back(line.substr(sep+1));
+    }
+    return true;
+}
+
+} // namespace impl
+
+/**
+ * @brief   Answers batches of pattern queries until `quit` is read
+ *          (collective call).
+ *
+ * @param local_SA      The local block of the suffix array.
+ * @param str_begin     Iterator to the local block of the input string.
+ * @param str_end       End iterator of the local block of the input string.
+ * @param idx           The sampled index over the suffix array.
+ * @param in_path       Input named pipe, regular file, or "-" for stdin,
+ *                      only used on the master processor. A named pipe is
+ *                      re-opened whenever a writer closes it, otherwise
+ *                      the server stops at the end of the input.
+ * @param out           Output stream for the results (master processor).
+ * @param max_batch     Maximum number of queries per batch.
+ * @param max_occ       Maximum number of positions reported per `locate`.
+ * @param comm          The communicator.
+ */
+template <typename char_t, typename index_t, typename StringIter>
+query_server_stats serve_queries(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+                                 const sampled_index<char_t, index_t>& idx, const std::string& in_path, std::ostream& out,
+                                 std::size_t max_batch, std::size_t max_occ, const mxx::comm& comm) {
+    query_server_stats stats;
+    std::ifstream in_file;
+    bool use_stdin = (in_path == "-");
+    bool is_fifo = false;
+    int open_ok = 1;
+    if (comm.rank() == 0 && !use_stdin) {
+        struct stat st;
+        is_fifo = (stat(in_path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode));
+        in_file.open(in_path);
+        open_ok = in_file.is_open() ? 1 : 0;
+    }
+    mxx::bcast(open_ok, 0, comm);
+    if (!open_ok)
+        throw std::runtime_error("query server: could not open `" + in_path + "`");
+
+    bool running = true;
+    while (running) {
+        // read next batch on master and broadcast it as '\0' terminated
+        // patterns, each prefixed by its query type
+        std::vector<char> batch;
+        if (comm.rank() == 0) {
+            std::vector<char> types;
+            std::vector<std::string> patterns;
+            std::istream& in = use_stdin ? std::cin : in_file;
+            running = impl::read_query_batch(in, max_batch, types, patterns);
+            if (running && patterns.empty()) {
+                if (!is_fifo || in_file.bad()) {
+                    running = false;
+                } else {
+                    // writer closed the pipe: wait for the next one
+                    in_file.close();
+                    in_file.open(in_path);
+                    open_ok = in_file.is_open() ? 1 : 0;
+                }
+            }
+            for (std::size_t i = 0; i < patterns.size(); ++i) {
+                batch.push_back(types[i]);
+                batch.insert(batch.end(), patterns[i].begin(), patterns[i].end());
+                batch.push_back('\0');
+            }
+        }
+        // -1 signals that the pipe could not be re-opened
+        int run_flag = !open_ok ? -1 : (running ? 1 : 0);
+        mxx::bcast(run_flag, 0, comm);
+        if (run_flag < 0)
+            throw std::runtime_error("query server: could not re-open `" + in_path + "`");
+        running = (run_flag != 0);
+        mxx::bcast(batch, 0, comm);
+        if (batch.empty())
+            continue;
+
+        mxx::timer t;
+        // each processor answers an equal block of the batch
+        std::vector<char> types;
+        std::vector<std::basic_string<char_t> > patterns;
+        for (std::size_t pos = 0; pos < batch.size();) {
+            std::size_t len = std::find(batch.begin() + pos + 1, batch.end(), '\0') - batch.begin() - pos - 1;
+            types.push_back(batch[pos]);
+            patterns.emplace_back(batch.begin() + pos + 1, batch.begin() + pos + 1 + len);
+            pos += len + 2;
+        }
+        std::size_t num_queries = patterns.size();
+        mxx::partition::block_decomposition_buffered<std::size_t> qpart(num_queries, comm.size(), comm.rank());
+        std::size_t qbegin = qpart.excl_prefix_size();
+        std::vector<std::basic_string<char_t> > local_patterns(patterns.begin() + qbegin, patterns.begin() + qbegin + qpart.local_size());
+
+        std::vector<std::pair<index_t, index_t> > ranges = bulk_sa_ranges(local_SA, str_begin, str_end, idx, local_patterns, comm);
+        std::vector<std::pair<index_t, index_t> > locate_ranges(ranges.size());
+        for (std::size_t i = 0; i < ranges.size(); ++i) {
+            if (types[qbegin + i] == 'l')
+                locate_ranges[i] = ranges[i];
+        }
+        std::vector<std::size_t> offsets;
+        std::vector<index_t> positions = bulk_locate(local_SA, locate_ranges, offsets, comm, max_occ);
+        std::vector<std::size_t> num_occ(ranges.size());
+        for (std::size_t i = 0; i < ranges.size(); ++i) {
+            num_occ[i] = offsets[i+1] - offsets[i];
+        }
+
+        // stream results back on master
+        std::vector<std::pair<index_t, index_t> > all_ranges = mxx::gatherv(ranges, 0, comm);
+        std::vector<std::size_t> all_num_occ = mxx::gatherv(num_occ, 0, comm);
+        std::vector<index_t> all_positions = mxx::gatherv(positions, 0, comm);
+        if (comm.rank() == 0) {
+            std::size_t p = 0;
+            for (std::size_t i = 0; i < num_queries; ++i) {
+                out << patterns[i] << "\t" << all_ranges[i].second - all_ranges[i].first;
+                if (types[i] == 'l') {
+                    out << "\t";
+                    for (std::size_t j = 0; j < all_num_occ[i]; ++j, ++p)
+                        out << (j > 0 ? " " : "") << all_positions[p];
+                }
+                out << "\n";
+            }
+            out.flush();
+        }
+
+        // latency metrics
+        double batch_time = t.elapsed();
+        ++stats.num_batches;
+        stats.num_queries += num_queries;
+        stats.total_time += batch_time;
+        stats.max_batch_time = std::max(stats.max_batch_time, batch_time);
+        if (comm.rank() == 0) {
+            std::cerr << "batch " << stats.num_batches << ": " << num_queries << " queries in " << batch_time << " ms ("
+                      << batch_time / num_queries << " ms/query)" << std::endl;
+        }
+    }
+
+    if (comm.rank() == 0 && stats.num_batches > 0) {
+        std::cerr << "served " << stats.num_queries << " queries in " << stats.num_batches << " batches, avg batch latency: "
+                  << stats.total_time / stats.num_batches << " ms, max batch latency: " << stats.max_batch_time << " ms" << std::endl;
+    }
+    return stats;
+}
+
+#endif // QUERY_SERVER_HPP
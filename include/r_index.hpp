@@ -0,0 +1,396 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    r_index.hpp
+ * @brief   Distributed construction of the run-length BWT with SA samples at
+ *          the run boundaries (the r-index), and a loader for counting and
+ *          locating patterns.
+ *
+ * For highly repetitive collections, the number of runs `r` of the BWT is
+ * much smaller than `n`, and the r-index takes O(r) space. Each processor
+ * reads the BWT characters `T[SA[i]-1]` of its block of the SA via
+ * `bulk_rma()`, and keeps only its runs: the run character and length, and
+ * the SA values at the first and last row of the run. Neither the BWT nor
+ * the SA are ever collected on a single processor.
+ *
+ * The strings of this library are not terminated, and the suffix starting
+ * at position 0 has the BWT character `0` (which must not occur in the
+ * string). Runs which are split by the block boundaries are merged by the
+ * loader.
+ */
+#ifndef R_INDEX_HPP
+#define R_INDEX_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/shift.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "alphabet.hpp"
+#include "bulk_rma.hpp"
+#include "suffix_array.hpp"
+
+namespace r_index_impl {
+
+const uint64_t magic = 0x3158495243415350ull; // "PSACRIX1"
+
+inline std::string meta_file(const std::string& prefix) {
+    return prefix + ".ri";
+}
+
+inline std::string block_file(const std::string& prefix, int rank) {
+    return prefix + ".ri." + std::to_string(rank);
+}
+
+template <typename T>
+inline void write_vector(std::ofstream& f, const std::vector<T>& vec) {
+    uint64_t size = vec.size();
+    f.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    f.write(reinterpret_cast<const char*>(vec.data()), sizeof(T)*vec.size());
+}
+
+template <typename T>
+inline void read_vector(std::ifstream& f, std::vector<T>& vec) {
+    uint64_t size = 0;
+    f.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!f.good())
+        return;
+    vec.resize(size);
+    f.read(reinterpret_cast<char*>(vec.data()), sizeof(T)*vec.size());
+}
+
+} // namespace r_index_impl
+
+/**
+ * @brief   Computes the runs of the BWT of the distributed string
+ *          `[begin, end)` with the suffix array `local_SA` (of the same
+ *          distribution) and writes the r-index to files with the given
+ *          prefix (collective call).
+ *
+ * @return  The number of runs of the BWT.
+ * @throws std::runtime_error   If the files could not be written.
+ */
+template <typename index_t, typename Iterator>
+std::size_t write_r_index(const std::string& prefix, const std::vector<index_t>& local_SA, Iterator begin, Iterator end, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    std::size_t local_size = local_SA.size();
+    MXX_ASSERT(local_size == static_cast<std::size_t>(std::distance(begin, end)));
+    gen_dist part(comm, local_size);
+    std::size_t n = part.global_size();
+
+    // BWT[i] = T[SA[i]-1]
+    std::vector<std::size_t> idx(local_size);
+    for (std::size_t i = 0; i < local_size; ++i)
+        idx[i] = local_SA[i] > 0 ? local_SA[i] - 1 : 0;
+    std::vector<char> bwt = bulk_rma(part, begin, end, idx, comm);
+    idx = std::vector<std::size_t>();
+    for (std::size_t i = 0; i < local_size; ++i)
+        if (local_SA[i] == 0)
+            bwt[i] = '\0';
+    t.end_section("r-index: BWT characters");
+
+    // local runs with the SA samples at their first and last row
+    std::vector<char> heads;
+    std::vector<index_t> lengths;
+    std::vector<index_t> first_sa;
+    std::vector<index_t> last_sa;
+    for (std::size_t i = 0; i < local_size; ++i) {
+        if (i == 0 || bwt[i] != bwt[i-1]) {
+            heads.push_back(bwt[i]);
+            lengths.push_back(0);
+            first_sa.push_back(local_SA[i]);
+            last_sa.push_back(local_SA[i]);
+        }
+        ++lengths.back();
+        last_sa.back() = local_SA[i];
+    }
+    // runs which continue the last run of the previous (non-empty) block
+    std::pair<int, char> last_char(local_size > 0 ? 1 : 0, local_size > 0 ? bwt.back() : '\0');
+    std::vector<std::pair<int, char> > last_chars = mxx::allgather(last_char, comm);
+    bool continued = false;
+    for (int r = comm.rank() - 1; local_size > 0 && r >= 0; --r) {
+        if (last_chars[r].first) {
+            continued = (last_chars[r].second == bwt[0]);
+            break;
+        }
+    }
+    bwt = std::vector<char>();
+    std::size_t num_runs = mxx::allreduce(heads.size() - (continued ? 1 : 0), comm);
+    t.end_section("r-index: runs");
+
+    // the character counts and the last character for the C array
+    std::vector<uint64_t> hist = alphabet_histogram<uint64_t>(begin, end, comm);
+    std::pair<int, char> last(local_size > 0 && part.eprefix() + local_size == n ? 1 : 0, local_size > 0 ? *(end - 1) : '\0');
+    std::vector<std::pair<int, char> > lasts = mxx::gather(last, 0, comm);
+
+    bool ok;
+    {
+        std::ofstream f(r_index_impl::block_file(prefix, comm.rank()), std::ios::binary);
+        r_index_impl::write_vector(f, heads);
+        r_index_impl::write_vector(f, lengths);
+        r_index_impl::write_vector(f, first_sa);
+        r_index_impl::write_vector(f, last_sa);
+        f.close();
+        ok = f.good();
+    }
+    if (!mxx::all_of(ok, comm))
+        throw std::runtime_error("Writing the r-index blocks to `" + prefix + "` failed.");
+
+    int written = 0;
+    if (comm.rank() == 0) {
+        uint64_t last_c = 0;
+        for (std::size_t r = 0; r < lasts.size(); ++r)
+            if (lasts[r].first)
+                last_c = static_cast<unsigned char>(lasts[r].second);
+        std::ofstream f(r_index_impl::meta_file(prefix), std::ios::binary);
+        uint64_t header[6] = {r_index_impl::magic, n, num_runs, sizeof(index_t), last_c, static_cast<uint64_t>(comm.size())};
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(&hist[0]), sizeof(uint64_t)*hist.size());
+        f.close();
+        written = f.good();
+    }
+    mxx::bcast(written, 0, comm);
+    if (!written)
+        throw std::runtime_error("Writing the r-index meta file `" + r_index_impl::meta_file(prefix) + "` failed.");
+    t.end_section("r-index: write");
+    return num_runs;
+}
+
+/**
+ * @brief   Writes the r-index of a constructed suffix array (collective call).
+ */
+template <typename index_t, bool _CONSTRUCT_LCP, typename Iterator>
+std::size_t write_r_index(const std::string& prefix, const suffix_array<char, index_t, _CONSTRUCT_LCP>& sa, Iterator begin, Iterator end, const mxx::comm& comm) {
+    return write_r_index(prefix, sa.local_SA, begin, end, comm);
+}
+
+/**
+ * @brief   The r-index as written by `write_r_index()`, loaded on a single
+ *          processor: counting via backward search on the run-length BWT,
+ *          and locating via the toehold and the Φ function.
+ */
+template <typename index_t = std::size_t>
+class r_index {
+private:
+    std::size_t n;
+    /// C[c] = first row of the suffixes starting with `c` which are the
+    /// LF mapping of a BWT row
+    std::vector<std::size_t> C;
+    /// the last character of the string
+    unsigned char last_c;
+    /// run characters
+    std::vector<char> heads;
+    /// first row of each run (plus n)
+    std::vector<std::size_t> run_begin;
+    /// SA value at the last row of each run
+    std::vector<index_t> last_sa;
+    /// for each character: its runs, and the number of its occurrences before them
+    std::vector<std::vector<std::size_t> > char_runs;
+    std::vector<std::vector<std::size_t> > char_ranks;
+    /// (SA value at the first row of a run, SA value of the row before), sorted
+    std::vector<std::pair<index_t, index_t> > phi_samples;
+
+    // number of occurrences of `c` in BWT[0, i)
+    std::size_t rank(unsigned char c, std::size_t i) const {
+        const std::vector<std::size_t>& runs = char_runs[c];
+        // the last run of `c` starting before `i`
+        std::size_t k = std::upper_bound(runs.begin(), runs.end(), i, [this](std::size_t row, std::size_t run) {
+            return row <= run_begin[run];
+        }) - runs.begin();
+        if (k == 0)
+            return 0;
+        std::size_t run = runs[k-1];
+        return char_ranks[c][k-1] + std::min(i, run_begin[run+1]) - run_begin[run];
+    }
+
+    // the run containing row i
+    inline std::size_t run_of(std::size_t i) const {
+        return std::upper_bound(run_begin.begin(), run_begin.end(), i) - run_begin.begin() - 1;
+    }
+
+    // SA[i-1] from SA[i]
+    index_t phi(index_t p) const {
+        typename std::vector<std::pair<index_t, index_t> >::const_iterator it = std::upper_bound(phi_samples.begin(), phi_samples.end(),
+            std::pair<index_t, index_t>(p, std::numeric_limits<index_t>::max())) - 1;
+        return it->second + (p - it->first);
+    }
+
+public:
+    r_index() : n(0), last_c(0) {}
+
+    /**
+     * @brief   Loads the r-index with the given prefix.
+     *
+     * @throws std::runtime_error   If the files are missing or inconsistent.
+     */
+    explicit r_index(const std::string& prefix) {
+        load(prefix);
+    }
+
+    void load(const std::string& prefix) {
+        std::ifstream meta(r_index_impl::meta_file(prefix), std::ios::binary);
+        uint64_t header[6];
+        meta.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!meta.good() || header[0] != r_index_impl::magic || header[3] != sizeof(index_t))
+            throw std::runtime_error("`" + r_index_impl::meta_file(prefix) + "` is not an r-index with this index type.");
+        n = header[1];
+        std::size_t num_runs = header[2];
+        last_c = header[4];
+        std::vector<uint64_t> hist(256);
+        meta.read(reinterpret_cast<char*>(&hist[0]), sizeof(uint64_t)*hist.size());
+        if (!meta.good())
+            throw std::runtime_error("Invalid r-index meta file `" + r_index_impl::meta_file(prefix) + "`.");
+        C.assign(257, 0);
+        for (std::size_t c = 0; c < 256; ++c)
+            C[c+1] = C[c] + hist[c];
+        // the suffix of length 1 is not preceded by any BWT character, such
+        // that the LF mapping of `last_c` starts one row later
+        ++C[last_c];
+
+        // concatenate the runs of all blocks, merging split runs
+        heads.clear();
+        run_begin.assign(1, 0);
+        last_sa.clear();
+        std::vector<index_t> first_sa;
+        for (std::size_t r = 0; r < header[5]; ++r) {
+            std::ifstream f(r_index_impl::block_file(prefix, r), std::ios::binary);
+            std::vector<char> h;
+            std::vector<index_t> len, fsa, lsa;
+            r_index_impl::read_vector(f, h);
+            r_index_impl::read_vector(f, len);
+            r_index_impl::read_vector(f, fsa);
+            r_index_impl::read_vector(f, lsa);
+            if (!f.good())
+                throw std::runtime_error("Reading the r-index block `" + r_index_impl::block_file(prefix, r) + "` failed.");
+            for (std::size_t j = 0; j < h.size(); ++j) {
+                if (!heads.empty() && heads.back() == h[j]) {
+                    run_begin.back() += len[j];
+                    last_sa.back() = lsa[j];
+                } else {
+                    heads.push_back(h[j]);
+                    run_begin.push_back(run_begin.back() + len[j]);
+                    first_sa.push_back(fsa[j]);
+                    last_sa.push_back(lsa[j]);
+                }
+            }
+        }
+        if (heads.size() != num_runs || run_begin.back() != n)
+            throw std::runtime_error("Inconsistent runs in the r-index `" + prefix + "`.");
+
+        char_runs.assign(256, std::vector<std::size_t>());
+        char_ranks.assign(256, std::vector<std::size_t>());
+        std::vector<std::size_t> counts(256, 0);
+        for (std::size_t j = 0; j < heads.size(); ++j) {
+            unsigned char c = heads[j];
+            char_runs[c].push_back(j);
+            char_ranks[c].push_back(counts[c]);
+            counts[c] += run_begin[j+1] - run_begin[j];
+        }
+        // the row before the first row would be the terminator at position n
+        phi_samples.assign(1, std::pair<index_t, index_t>(first_sa[0], n));
+        for (std::size_t j = 1; j < heads.size(); ++j)
+            phi_samples.push_back(std::pair<index_t, index_t>(first_sa[j], last_sa[j-1]));
+        std::sort(phi_samples.begin(), phi_samples.end());
+    }
+
+    /// the length of the string
+    inline std::size_t size() const {
+        return n;
+    }
+
+    /// the number of runs of the BWT
+    inline std::size_t num_runs() const {
+        return heads.size();
+    }
+
+    /// the size of the loaded index in bytes
+    std::size_t size_in_bytes() const {
+        return heads.size() * (sizeof(char) + 3*sizeof(std::size_t) + 3*sizeof(index_t));
+    }
+
+    /// returns BWT[i]
+    inline char bwt(std::size_t i) const {
+        return heads[run_of(i)];
+    }
+
+    /**
+     * @brief   Returns the rows [sp, ep) of the suffixes prefixed by `P`, and
+     *          the SA value at row `ep-1` if the range is not empty.
+     */
+    std::pair<std::size_t, std::size_t> backward_search(const std::string& P, index_t& toehold) const {
+        std::size_t sp = 0;
+        std::size_t ep = n;
+        toehold = n > 0 ? last_sa.back() : 0;
+        for (std::size_t k = P.size(); k > 0 && sp < ep; --k) {
+            unsigned char c = P[k-1];
+            std::size_t r = run_of(ep - 1);
+            if (static_cast<unsigned char>(heads[r]) == c) {
+                toehold = toehold - 1;
+            } else {
+                // the last occurrence of `c` before row ep-1 ends a run
+                std::size_t j = std::lower_bound(char_runs[c].begin(), char_runs[c].end(), r) - char_runs[c].begin();
+                if (j == 0) {
+                    sp = ep = 0;
+                    break;
+                }
+                toehold = last_sa[char_runs[c][j-1]] - 1;
+            }
+            sp = C[c] + rank(c, sp);
+            ep = C[c] + rank(c, ep);
+            if (k == P.size() && c == last_c) {
+                // the suffix of length 1 is the first one starting with `c`
+                if (sp == ep)
+                    toehold = n - 1;
+                --sp;
+            }
+        }
+        if (sp >= ep)
+            return std::pair<std::size_t, std::size_t>(0, 0);
+        return std::pair<std::size_t, std::size_t>(sp, ep);
+    }
+
+    /// returns the number of occurrences of `P`
+    std::size_t count(const std::string& P) const {
+        index_t toehold;
+        std::pair<std::size_t, std::size_t> range = backward_search(P, toehold);
+        return range.second - range.first;
+    }
+
+    /// returns the positions of all occurrences of `P` (in SA order)
+    std::vector<index_t> locate(const std::string& P) const {
+        index_t toehold;
+        std::pair<std::size_t, std::size_t> range = backward_search(P, toehold);
+        std::vector<index_t> result(range.second - range.first);
+        if (!result.empty()) {
+            result.back() = toehold;
+            for (std::size_t k = result.size() - 1; k > 0; --k)
+                result[k-1] = phi(result[k]);
+        }
+        return result;
+    }
+};
+
+#endif // R_INDEX_HPP
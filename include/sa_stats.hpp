@@ -0,0 +1,170 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    sa_stats.hpp
+ * @brief   Distinct substring counts, k-mer spectra, repeat content and LCP
+ *          histograms from the distributed SA and LCP.
+ *
+ * All statistics are computed in a single pass over the local SA and LCP,
+ * where each suffix only needs the LCP with its left neighbor (`LCP[i]`) and
+ * its right neighbor (`LCP[i+1]`, shifted from the next processor at block
+ * boundaries). The counts for all k up to `max_k` are accumulated as
+ * difference arrays, such that one suffix contributes O(1) updates, and all
+ * counters are summed up in a single reduction.
+ */
+#ifndef SA_STATS_HPP
+#define SA_STATS_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/shift.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+
+#include "suffix_array.hpp"
+
+/**
+ * @brief   Global statistics of the substrings of a string.
+ *
+ * The vectors are indexed by the length k (for 0 <= k <= max_k).
+ */
+struct sa_statistics {
+    /// the length of the string
+    std::size_t n;
+    /// number of distinct non-empty substrings
+    uint64_t distinct_substrings;
+    /// length of the longest repeated substring (maximum LCP value)
+    std::size_t max_lcp;
+    /// sum of all LCP values
+    uint64_t lcp_sum;
+    /// number of LCP values equal to each length, the last entry counts
+    /// all values >= max_k (excludes the undefined LCP of the first suffix)
+    std::vector<uint64_t> lcp_hist;
+    /// number of distinct k-mers
+    std::vector<uint64_t> distinct_kmers;
+    /// number of distinct k-mers which occur at least twice
+    std::vector<uint64_t> repeated_kmers;
+    /// number of positions at which a repeated k-mer starts
+    std::vector<uint64_t> repeat_positions;
+
+    /// average LCP value
+    inline double avg_lcp() const {
+        return n > 1 ? static_cast<double>(lcp_sum) / (n - 1) : 0.0;
+    }
+
+    /// writes all per-k statistics as tab separated table
+    void print_table(std::ostream& os) const {
+        os << "k\tdistinct_kmers\trepeated_kmers\trepeat_positions\tlcp_hist" << std::endl;
+        for (std::size_t k = 0; k < distinct_kmers.size(); ++k) {
+            os << k << "\t" << distinct_kmers[k] << "\t" << repeated_kmers[k] << "\t"
+               << repeat_positions[k] << "\t" << lcp_hist[k] << std::endl;
+        }
+    }
+};
+
+/**
+ * @brief   Computes the substring statistics for all k-mer lengths up to
+ *          `max_k` from the SA and LCP (collective call).
+ */
+template <typename char_t, typename index_t>
+sa_statistics compute_sa_statistics(const suffix_array<char_t, index_t, true>& sa, std::size_t max_k, const mxx::comm& comm) {
+    std::size_t local_size = sa.local_SA.size();
+    std::size_t n = sa.global_size();
+    MXX_ASSERT(sa.local_LCP.size() == local_size);
+
+    // the LCP of the last local suffix with its right neighbor
+    index_t next_lcp = mxx::left_shift(local_size > 0 ? sa.local_LCP[0] : index_t(0), comm);
+    bool has_next = sa.distribution().eprefix() + local_size < n;
+
+    // counters: [distinct substrings, lcp sum, lcp_hist, 3 difference arrays]
+    std::size_t m = max_k + 2;
+    std::vector<uint64_t> counters(2 + (max_k + 1) + 3*m, 0);
+    uint64_t* lcp_hist = &counters[2];
+    uint64_t* distinct_diff = lcp_hist + (max_k + 1);
+    uint64_t* repeated_diff = distinct_diff + m;
+    uint64_t* positions_diff = repeated_diff + m;
+    std::size_t max_lcp = 0;
+
+    bool is_first = sa.distribution().eprefix() == 0;
+    for (std::size_t i = 0; i < local_size; ++i) {
+        std::size_t len = n - sa.local_SA[i];
+        std::size_t lcp_left = (is_first && i == 0) ? 0 : sa.local_LCP[i];
+        std::size_t lcp_right;
+        if (i + 1 < local_size)
+            lcp_right = sa.local_LCP[i+1];
+        else
+            lcp_right = has_next ? next_lcp : 0;
+
+        counters[0] += len - lcp_left;
+        if (!(is_first && i == 0)) {
+            counters[1] += lcp_left;
+            max_lcp = std::max(max_lcp, lcp_left);
+            ++lcp_hist[std::min(lcp_left, max_k)];
+        }
+        // the prefixes of lengths (lcp_left, len] occur first at this suffix
+        std::size_t kmax = std::min(len, max_k);
+        if (lcp_left < kmax) {
+            ++distinct_diff[lcp_left + 1];
+            --distinct_diff[kmax + 1];
+        }
+        // ... and are repeated if they are also a prefix of the next suffix
+        kmax = std::min(lcp_right, max_k);
+        if (lcp_left < kmax) {
+            ++repeated_diff[lcp_left + 1];
+            --repeated_diff[kmax + 1];
+        }
+        // the prefixes up to the larger LCP occur elsewhere, too
+        kmax = std::min(std::max(lcp_left, lcp_right), max_k);
+        if (kmax > 0) {
+            ++positions_diff[1];
+            --positions_diff[kmax + 1];
+        }
+    }
+
+    counters = mxx::allreduce(counters, comm);
+    max_lcp = mxx::allreduce(max_lcp, mxx::max<std::size_t>(), comm);
+
+    sa_statistics stats;
+    stats.n = n;
+    stats.distinct_substrings = counters[0];
+    stats.lcp_sum = counters[1];
+    stats.max_lcp = max_lcp;
+    lcp_hist = &counters[2];
+    distinct_diff = lcp_hist + (max_k + 1);
+    repeated_diff = distinct_diff + m;
+    positions_diff = repeated_diff + m;
+    stats.lcp_hist.assign(lcp_hist, lcp_hist + max_k + 1);
+    stats.distinct_kmers.resize(max_k + 1);
+    stats.repeated_kmers.resize(max_k + 1);
+    stats.repeat_positions.resize(max_k + 1);
+    uint64_t d = 0, r = 0, q = 0;
+    for (std::size_t k = 0; k <= max_k; ++k) {
+        d += distinct_diff[k];
+        r += repeated_diff[k];
+        q += positions_diff[k];
+        stats.distinct_kmers[k] = d;
+        stats.repeated_kmers[k] = r;
+        stats.repeat_positions[k] = q;
+    }
+    return stats;
+}
+
+#endif // SA_STATS_HPP
@@ -0,0 +1,419 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    sampled_index.hpp
+ * @brief   Replicated top-level index over a distributed suffix array, used
+ *          to route pattern queries to the processors owning the matching
+ *          part of the suffix array.
+ */
+#ifndef SAMPLED_INDEX_HPP
+#define SAMPLED_INDEX_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/partition.hpp>
+#include <mxx/reduction.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+#include "bulk_rma.hpp"
+#include "all2all.hpp"
+
+/**
+ * @brief   Replicated sample of the suffix array.
+ *
+ * Every `sample_rate`-th suffix of the distributed suffix array, as
+ * well as the first suffix of each processor's block, is sampled. For each
+ * sampled suffix, the first `prefix_len` characters are stored (padded with
+ * '\0' past the end of the string). The samples are gathered on all
+ * processors, so that the range of the suffix array containing all
+ * occurrences of a pattern can be bracketed locally without communication.
+ *
+ * The input string must not contain the '\0' character.
+ */
+template <typename char_t, typename index_t = std::size_t>
+class sampled_index {
+public:
+    using char_type = char_t;
+    using index_type = index_t;
+
+    /// Default constructor for an empty index.
+    sampled_index() : n(0), sample_rate(1), prefix_len(1) {}
+
+    /**
+     * @brief   Samples the given suffix array (collective call).
+     *
+     * @param local_SA      The local block of the suffix array.
+     * @param str_begin     Iterator to the local block of the input string.
+     * @param str_end       End iterator of the local block of the input string.
+     * @param sample_rate   Every `sample_rate`-th suffix is sampled.
+     * @param prefix_len    Number of leading characters stored per sample.
+     * @param comm          The communicator.
+     */
+    template <typename StringIter>
+    sampled_index(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+                  std::size_t sample_rate, std::size_t prefix_len, const mxx::comm& comm)
+        : sampled_index(local_SA, str_begin, str_end, std::vector<index_t>(), sample_rate, prefix_len, comm) {
+    }
+
+    /**
+     * @brief   Samples the given generalized suffix array (collective call).
+     *
+     * For a suffix array over a set of concatenated sequences, suffixes end at
+     * the end of their sequence. `local_seq_end` holds for each position of
+     * the local block of the input string the (exclusive) end of the sequence
+     * containing that position. If empty, all suffixes end at the end of the
+     * string.
+     */
+    template <typename StringIter>
+    sampled_index(const std::vector<index_t>& local_SA, StringIter str_begin, StringIter str_end,
+                  const std::vector<index_t>& local_seq_end,
+                  std::size_t sample_rate, std::size_t prefix_len, const mxx::comm& comm)
+        : sample_rate(sample_rate), prefix_len(prefix_len) {
+        mxx::section_timer t(std::cerr, comm);
+        MXX_ASSERT(sample_rate > 0 && prefix_len > 0);
+
+        std::size_t local_size = local_SA.size();
+        part = gen_dist(comm, local_size);
+        n = part.global_size();
+        MXX_ASSERT(static_cast<std::size_t>(std::distance(str_begin, str_end)) == local_size);
+
+        // select local samples: first suffix of this block and every
+        // `sample_rate`-th global SA position
+        std::size_t prefix = part.excl_prefix_size();
+        std::vector<index_t> local_pos;
+        std::size_t first_sample = ((prefix + sample_rate - 1) / sample_rate) * sample_rate;
+        if (local_size > 0 && first_sample != prefix)
+            local_pos.push_back(prefix);
+        for (std::size_t g = first_sample; g < prefix + local_size; g += sample_rate)
+            local_pos.push_back(g);
+
+        // get the end of each sampled suffix
+        std::vector<std::size_t> sample_sa(local_pos.size());
+        for (std::size_t i = 0; i < local_pos.size(); ++i) {
+            sample_sa[i] = local_SA[local_pos[i] - prefix];
+        }
+        std::vector<index_t> sample_end(local_pos.size(), n);
+        if (mxx::any_of(!local_seq_end.empty(), comm)) {
+            sample_end = bulk_rma(local_seq_end.begin(), local_seq_end.end(), sample_sa, comm);
+        }
+
+        // request the leading characters of all sampled suffixes
+        std::vector<std::size_t> char_idx;
+        char_idx.reserve(local_pos.size() * prefix_len);
+        for (std::size_t i = 0; i < local_pos.size(); ++i) {
+            for (std::size_t j = 0; j < prefix_len && sample_sa[i] + j < sample_end[i]; ++j) {
+                char_idx.push_back(sample_sa[i] + j);
+            }
+        }
+        t.end_section("sampled_index: select samples");
+        std::vector<char_t> chars = bulk_rma(str_begin, str_end, char_idx, comm);
+        char_idx = std::vector<std::size_t>();
+        t.end_section("sampled_index: bulk_rma sample prefixes");
+
+        // pad prefixes which extend past the end of the string (or sequence)
+        std::vector<char_t> local_prefixes(local_pos.size() * prefix_len, char_t('\0'));
+        std::size_t c = 0;
+        for (std::size_t i = 0; i < local_pos.size(); ++i) {
+            for (std::size_t j = 0; j < prefix_len && sample_sa[i] + j < sample_end[i]; ++j) {
+                local_prefixes[i*prefix_len + j] = chars[c++];
+            }
+        }
+
+        // replicate samples on all processors
+        sample_pos = mxx::allgatherv(local_pos, comm);
+        sample_prefixes = mxx::allgatherv(local_prefixes, comm);
+        t.end_section("sampled_index: allgather samples");
+    }
+
+    /// Number of samples.
+    inline std::size_t size() const {
+        return sample_pos.size();
+    }
+
+    /// Global size of the indexed suffix array.
+    inline std::size_t global_size() const {
+        return n;
+    }
+
+    /// Number of leading characters stored per sample.
+    inline std::size_t prefix_length() const {
+        return prefix_len;
+    }
+
+    /// SA position of the `i`-th sample.
+    inline index_t position(std::size_t i) const {
+        return sample_pos[i];
+    }
+
+    /// Pointer to the `prefix_len` leading characters of the `i`-th sample.
+    inline const char_t* prefix(std::size_t i) const {
+        return &sample_prefixes[i*prefix_len];
+    }
+
+    /**
+     * @brief   Compares the `i`-th sample against the pattern `P`.
+     *
+     * Only the first `min(|P|, prefix_len)` characters are compared.
+     *
+     * @return  A negative value if all suffixes prefixed by `P` come after
+     *          the sample, a positive value if they all come before the
+     *          sample, and 0 if this can't be decided from the stored prefix.
+     */
+    template <typename Iterator>
+    int compare(std::size_t i, Iterator p_begin, Iterator p_end) const {
+        const char_t* s = prefix(i);
+        std::size_t m = std::min<std::size_t>(std::distance(p_begin, p_end), prefix_len);
+        for (std::size_t j = 0; j < m; ++j, ++p_begin) {
+            if (s[j] < *p_begin)
+                return -1;
+            if (*p_begin < s[j])
+                return 1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief   Returns a range [lo, hi) of the global suffix array, which
+     *          contains all suffixes prefixed by `P`.
+     *
+     * The range is bounded by the closest samples which are known to be
+     * smaller, respectively larger, than `P`.
+     */
+    template <typename Iterator>
+    std::pair<index_t, index_t> sa_range(Iterator p_begin, Iterator p_end) const {
+        // samples are ordered, so the comparison results are monotonically
+        // increasing: {-1}* {0}* {1}*
+        std::size_t l = 0;
+        std::size_t r = sample_pos.size();
+        while (l < r) {
+            std::size_t mid = l + (r - l) / 2;
+            if (compare(mid, p_begin, p_end) < 0)
+                l = mid + 1;
+            else
+                r = mid;
+        }
+        std::size_t lo_sample = l;
+        r = sample_pos.size();
+        while (l < r) {
+            std::size_t mid = l + (r - l) / 2;
+            if (compare(mid, p_begin, p_end) <= 0)
+                l = mid + 1;
+            else
+                r = mid;
+        }
+        index_t lo = (lo_sample == 0) ? 0 : sample_pos[lo_sample-1] + 1;
+        index_t hi = (l == sample_pos.size()) ? n : sample_pos[l];
+        return std::pair<index_t, index_t>(lo, hi);
+    }
+
+    template <typename String>
+    inline std::pair<index_t, index_t> sa_range(const String& P) const {
+        return sa_range(P.begin(), P.end());
+    }
+
+    /**
+     * @brief   Returns the range [first, last] of processors owning the
+     *          suffixes of the range `sa_range(P)`.
+     *
+     * All suffixes prefixed by `P` are located on these processors. For an
+     * empty range, `first == last` is the processor at which the range
+     * would start.
+     */
+    template <typename Iterator>
+    inline std::pair<int, int> target_processors(Iterator p_begin, Iterator p_end) const {
+        std::pair<index_t, index_t> range = sa_range(p_begin, p_end);
+        int first = part.target_processor(std::min<std::size_t>(range.first, n-1));
+        int last = (range.second > range.first) ? part.target_processor(range.second - 1) : first;
+        return std::pair<int, int>(first, last);
+    }
+
+    template <typename String>
+    inline std::pair<int, int> target_processors(const String& P) const {
+        return target_processors(P.begin(), P.end());
+    }
+
+    /**
+     * @brief   Returns the processor of the last sample which is not larger
+     *          than `P`.
+     *
+     * Since the first suffix of each processor is sampled, all suffixes
+     * between two consecutive samples are located on the same processor. For
+     * `|P| <= prefix_len`, the returned processor thus holds at least one
+     * suffix prefixed by `P`, if any exists.
+     */
+    template <typename Iterator>
+    int owner_processor(Iterator p_begin, Iterator p_end) const {
+        std::size_t l = 0;
+        std::size_t r = sample_pos.size();
+        while (l < r) {
+            std::size_t mid = l + (r - l) / 2;
+            if (compare(mid, p_begin, p_end) <= 0)
+                l = mid + 1;
+            else
+                r = mid;
+        }
+        if (l == 0)
+            return 0;
+        return part.target_processor(sample_pos[l-1]);
+    }
+
+    template <typename String>
+    inline int owner_processor(const String& P) const {
+        return owner_processor(P.begin(), P.end());
+    }
+
+private:
+    /// global size of the suffix array
+    std::size_t n;
+    /// sampling rate
+    std::size_t sample_rate;
+    /// number of characters stored per sample
+    std::size_t prefix_len;
+    /// distribution of the suffix array (the same as the input string)
+    gen_dist part;
+    /// SA positions of the samples (sorted)
+    std::vector<index_t> sample_pos;
+    /// `prefix_len` characters for each sample, concatenated
+    std::vector<char_t> sample_prefixes;
+};
+
+
+/**
+ * @brief   Sends a batch of patterns to the given target processors and
+ *          answers them there via `f` (collective call).
+ *
+ * All patterns are sent in a single all2all. On the target processor, `f(P)`
+ * is called and the results are returned to the originating processor in the
+ * order of the input patterns.
+ *
+ * @param patterns  The local batch of patterns. Patterns must not contain '\0'.
+ * @param targets   The target processor for each pattern.
+ * @param f         The function answering a single pattern on its target
+ *                  processor: `T f(const std::basic_string<char_t>&)`.
+ * @param comm      The communicator.
+ */
+template <typename char_t, typename Func>
+std::vector<typename std::result_of<Func(const std::basic_string<char_t>&)>::type>
+bulk_pattern_query(const std::vector<std::basic_string<char_t>>& patterns, const std::vector<int>& targets, Func f, const mxx::comm& comm) {
+    using string_t = std::basic_string<char_t>;
+    using T = typename std::result_of<Func(const string_t&)>::type;
+    mxx::section_timer t(std::cerr, comm);
+    MXX_ASSERT(patterns.size() == targets.size());
+
+    // bucket patterns by target processor
+    std::vector<size_t> send_counts(comm.size(), 0);
+    std::vector<size_t> send_char_counts(comm.size(), 0);
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        ++send_counts[targets[i]];
+        send_char_counts[targets[i]] += patterns[i].size() + 1;
+    }
+    std::vector<size_t> offsets = mxx::local_exscan(send_counts);
+    std::vector<size_t> char_offsets = mxx::local_exscan(send_char_counts);
+    std::vector<size_t> original_pos(patterns.size());
+    std::vector<char_t> send_chars(char_offsets.empty() ? 0 : char_offsets.back() + send_char_counts.back());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        original_pos[offsets[targets[i]]++] = i;
+        size_t& co = char_offsets[targets[i]];
+        std::copy(patterns[i].begin(), patterns[i].end(), send_chars.begin() + co);
+        co += patterns[i].size();
+        send_chars[co++] = char_t('\0');
+    }
+    t.end_section("bulk_pattern_query: bucket patterns");
+
+    // send patterns (as '\0' terminated character sequences)
+    std::vector<size_t> recv_char_counts = auto_all2all(send_char_counts, comm);
+    std::vector<char_t> recv_chars = auto_all2allv(send_chars, send_char_counts, recv_char_counts, comm);
+    send_chars = std::vector<char_t>();
+    t.end_section("bulk_pattern_query: all2all patterns");
+
+    // answer patterns locally
+    std::vector<size_t> recv_counts(comm.size(), 0);
+    std::vector<T> local_results;
+    size_t pos = 0;
+    for (int i = 0; i < comm.size(); ++i) {
+        size_t end = pos + recv_char_counts[i];
+        while (pos < end) {
+            size_t len = std::find(recv_chars.begin() + pos, recv_chars.begin() + end, char_t('\0')) - recv_chars.begin() - pos;
+            local_results.push_back(f(string_t(recv_chars.begin() + pos, recv_chars.begin() + pos + len)));
+            ++recv_counts[i];
+            pos += len + 1;
+        }
+    }
+    recv_chars = std::vector<char_t>();
+    t.end_section("bulk_pattern_query: local query");
+
+    // return results and reorder into original order
+    std::vector<T> results = auto_all2allv(local_results, recv_counts, send_counts, comm);
+    t.end_section("bulk_pattern_query: all2all results");
+    return permute(results, original_pos);
+}
+
+/**
+ * @brief   Routes a batch of patterns to their owning processors according to
+ *          the sampled index and answers them there via `f` (collective call).
+ *
+ * Each pattern `P` is sent to every processor of `idx.target_processors(P)`,
+ * where `f(P)` answers it for the local block of the suffix array only. The
+ * partial answers are combined in the order of the processors via
+ * `merge(a, b)`, e.g., by summing the local number of occurrences.
+ *
+ * @param idx       The sampled index.
+ * @param patterns  The local batch of patterns. Patterns must not contain '\0'.
+ * @param f         The function answering a single pattern for the local
+ *                  block: `T f(const std::basic_string<char_t>&)`.
+ * @param merge     Combines two partial answers: `T merge(const T&, const T&)`.
+ * @param comm      The communicator.
+ */
+template <typename char_t, typename index_t, typename Func, typename Merge>
+std::vector<typename std::result_of<Func(const std::basic_string<char_t>&)>::type>
+bulk_pattern_query(const sampled_index<char_t, index_t>& idx, const std::vector<std::basic_string<char_t>>& patterns,
+                   Func f, Merge merge, const mxx::comm& comm) {
+    using T = typename std::result_of<Func(const std::basic_string<char_t>&)>::type;
+    // one copy of each pattern per owning processor
+    std::vector<std::basic_string<char_t>> routed;
+    std::vector<int> targets;
+    std::vector<size_t> num_parts(patterns.size());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        std::pair<int, int> procs = idx.target_processors(patterns[i]);
+        for (int p = procs.first; p <= procs.second; ++p) {
+            routed.push_back(patterns[i]);
+            targets.push_back(p);
+        }
+        num_parts[i] = procs.second - procs.first + 1;
+    }
+    std::vector<T> partial = bulk_pattern_query(routed, targets, f, comm);
+    routed = std::vector<std::basic_string<char_t>>();
+
+    // combine the partial answers of each pattern
+    std::vector<T> results;
+    results.reserve(patterns.size());
+    size_t j = 0;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        T r = partial[j++];
+        for (size_t k = 1; k < num_parts[i]; ++k)
+            r = merge(r, partial[j++]);
+        results.push_back(r);
+    }
+    return results;
+}
+
+#endif // SAMPLED_INDEX_HPP
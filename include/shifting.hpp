@@ -24,15 +24,17 @@
 #include <mxx/future.hpp>
 #include <mxx/partition.hpp>
 
-//#include "dvector.hpp"
+#include "dvector.hpp"
 
 
 /*********************************************************************
  *               Shifting buckets (i -> i + 2^l) => B2               *
  *********************************************************************/
 
-template <typename T>
-std::vector<T> shift_vector(const std::vector<T>& vec, mxx::partition::block_decomposition_buffered<size_t>& dist, std::size_t shift_by, const mxx::comm& comm) {
+// `Partition` is either `mxx::partition::block_decomposition_buffered` or
+// any other distribution with the same interface (e.g. `gen_dist`)
+template <typename T, typename Partition>
+std::vector<T> shift_vector(const std::vector<T>& vec, const Partition& dist, std::size_t shift_by, const mxx::comm& comm) {
     // get # elements to the left
     assert(dist.local_size() == vec.size());
     size_t local_size = vec.size();
@@ -43,83 +45,56 @@ std::vector<T> shift_vector(const std::vector<T>& vec, mxx::partition::block_dec
 
     mxx::datatype mpidt = mxx::get_datatype<T>();
 
-    MPI_Request recv_reqs[2];
-    int n_irecvs = 0;
-    // receive elements from the right
-    if (prev_size + shift_by < dist.global_size()) {
+    // receive elements from the right (from at most two processors for block
+    // decompositions, but possibly more for unequal distributions)
+    std::vector<MPI_Request> recv_reqs;
+    if (local_size > 0 && prev_size + shift_by < dist.global_size()) {
         std::size_t right_first_gl_idx = prev_size + shift_by;
-        int p1 = dist.target_processor(right_first_gl_idx);
-
-        std::size_t p1_gl_end = dist.prefix_size(p1);
-        std::size_t p1_recv_cnt = p1_gl_end - right_first_gl_idx;
-
-        if (p1 != comm.rank()) {
-            // only receive if the source is not myself (i.e., `rank`)
-            // [otherwise results are directly written instead of MPI_Sended]
-            assert(p1_recv_cnt < std::numeric_limits<int>::max());
-            // increase iterators
-            int recv_cnt = p1_recv_cnt;
-            MPI_Irecv(&result[0],recv_cnt, mpidt.type(), p1,
-                      0, comm, &recv_reqs[n_irecvs++]);
-        }
-
-        if (p1_recv_cnt < local_size && p1 != comm.size()-1) {
-            // also receive from one more processor
-            int p2 = p1+1;
-            // since p2 has at least local_size - 1 elements and at least
-            // one element came from p1, we can assume that the receive count
-            // is our local size minus the already received elements
-            std::size_t p2_recv_cnt = local_size - p1_recv_cnt;
-
-            assert(p2_recv_cnt < std::numeric_limits<int>::max());
-            int recv_cnt = p2_recv_cnt;
-            // send to `p1` (which is necessarily different from `rank`)
-            MPI_Irecv(&result[0] + p1_recv_cnt, recv_cnt, mpidt.type(), p2,
-                      0, comm, &recv_reqs[n_irecvs++]);
+        std::size_t right_end_gl_idx = std::min(prev_size + local_size + shift_by, dist.global_size());
+        int src_p = dist.target_processor(right_first_gl_idx);
+        for (std::size_t gl_idx = right_first_gl_idx; gl_idx < right_end_gl_idx; ++src_p) {
+            std::size_t src_end = std::min<std::size_t>(dist.prefix_size(src_p), right_end_gl_idx);
+            if (src_end <= gl_idx)
+                continue;
+            std::size_t recv_cnt = src_end - gl_idx;
+            if (src_p != comm.rank()) {
+                // only receive if the source is not myself (i.e., `rank`)
+                // [otherwise results are directly written instead of MPI_Sended]
+                assert(recv_cnt < std::numeric_limits<int>::max());
+                recv_reqs.emplace_back();
+                MPI_Irecv(&result[gl_idx - right_first_gl_idx], recv_cnt, mpidt.type(), src_p,
+                          0, comm, &recv_reqs.back());
+            }
+            gl_idx = src_end;
         }
     }
 
-    // send elements to the left (split to at most 2 target processors)
-    if (prev_size + local_size - 1 >= shift_by) {
-        int p1 = -1;
-        if (prev_size >= shift_by) {
-            std::size_t first_gl_idx = prev_size - shift_by;
-            p1 = dist.target_processor(first_gl_idx);
-        }
-        std::size_t last_gl_idx = prev_size + local_size - 1 - shift_by;
-        int p2 = dist.target_processor(last_gl_idx);
-
-        std::size_t local_split;
-        if (p1 != p2) {
-            // local start index of area for second processor
-            if (p1 >= 0) {
-                local_split = dist.prefix_size(p1) + shift_by - prev_size;
-                // send to first processor
-                assert(p1 != comm.rank());
-                MPI_Send(const_cast<T*>(&vec[0]), local_split, mpidt.type(), p1, 0, comm);
+    // send elements to the left (split by target processors)
+    if (local_size > 0 && prev_size + local_size > shift_by) {
+        std::size_t local_begin = (prev_size >= shift_by) ? 0 : shift_by - prev_size;
+        std::size_t gl_idx = prev_size + local_begin - shift_by;
+        int dst_p = dist.target_processor(gl_idx);
+        for (std::size_t i = local_begin; i < local_size; ++dst_p) {
+            std::size_t dst_end = dist.prefix_size(dst_p);
+            if (dst_end <= gl_idx)
+                continue;
+            std::size_t send_cnt = std::min(dst_end - gl_idx, local_size - i);
+            if (dst_p != comm.rank()) {
+                assert(send_cnt < std::numeric_limits<int>::max());
+                MPI_Send(const_cast<T*>(&vec[i]), send_cnt, mpidt.type(), dst_p, 0, comm);
             } else {
-                // p1 doesn't exist, then there is no prefix to add
-                local_split = shift_by - prev_size;
-            }
-        } else {
-            // only one target processor
-            local_split = 0;
-        }
-
-        if (p2 != comm.rank()) {
-            MPI_Send(const_cast<T*>(&vec[0] + local_split), local_size - local_split, mpidt.type(), p2, 0, comm);
-        } else {
-            // in this case the split should be exactly at `shift_by`
-            assert(local_split == shift_by);
-            // locally reassign
-            for (std::size_t i = local_split; i < local_size; ++i) {
-                result[i-local_split] = vec[i];
+                // locally reassign
+                for (std::size_t j = 0; j < send_cnt; ++j) {
+                    result[gl_idx - prev_size + j] = vec[i + j];
+                }
             }
+            i += send_cnt;
+            gl_idx += send_cnt;
         }
     }
 
     // wait for successful receive:
-    MPI_Waitall(n_irecvs, recv_reqs, MPI_STATUS_IGNORE);
+    MPI_Waitall(recv_reqs.size(), recv_reqs.data(), MPI_STATUSES_IGNORE);
     return result;
 }
 
@@ -242,8 +217,8 @@ void multi_shift_inplace(std::vector<std::array<T, 1+L> >& tuples, mxx::partitio
 }
 
 
-template <typename T>
-mxx::requests isend_to_global_range(const std::vector<T>& src, mxx::partition::block_decomposition_buffered<size_t>& dist, size_t src_begin, size_t src_end, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
+template <typename T, typename Partition>
+mxx::requests isend_to_global_range(const std::vector<T>& src, const Partition& dist, size_t src_begin, size_t src_end, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
     assert(src_end > src_begin);
     assert(dst_end > dst_begin);
     assert(src_end - src_begin == dst_end - dst_begin);
@@ -271,8 +246,8 @@ mxx::requests isend_to_global_range(const std::vector<T>& src, mxx::partition::b
 }
 
 
-template <typename T>
-mxx::requests irecv_from_global_range(std::vector<T>& dst, mxx::partition::block_decomposition_buffered<size_t>& dist, size_t src_begin, size_t src_end, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
+template <typename T, typename Partition>
+mxx::requests irecv_from_global_range(std::vector<T>& dst, const Partition& dist, size_t src_begin, size_t src_end, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
     assert(src_end > src_begin);
     assert(dst_end > dst_begin);
     assert(src_end - src_begin == dst_end - dst_begin);
@@ -303,44 +278,24 @@ mxx::requests irecv_from_global_range(std::vector<T>& dst, mxx::partition::block
 
 
 
-/*
-
-template <template<class, class> class DRange, typename T, typename D>
-dvector<T, typename DRange<T, D>::dist_type> left_shift_drange(const DRange<T, D>& src, size_t shift_by) {
-    using result_type = dvector<T, typename DRange<T, D>::dist_type>;
-    result_type result(src.comm(), src.local_size());
-
-    // receive from right
-    size_t src_begin = std::min(src.eprefix() + shift_by, src.global_size());
-    size_t src_end = std::min(src.iprefix() + shift_by, src.global_size());
-    mxx::requests req;
-    if (src_begin < src_end) {
-        req.insert(irecv_from_global_range(result, src_begin, src_end, src_begin - shift_by, src_end - shift_by));
-    }
-
-    // send to left
-    size_t dst_begin = (src.eprefix() <= shift_by) ? 0 : src.eprefix() - shift_by;
-    size_t dst_end = (src.iprefix() <= shift_by) ? 0 : src.iprefix() - shift_by;
-
-    if (dst_begin < dst_end) {
-        req.insert(isend_to_global_range(src, dst_begin + shift_by, dst_end + shift_by, dst_begin, dst_end));
-    }
-
-    req.waitall();
-
-    return result;
+// shifts the distributed range `src` by `shift_by` to the left, i.e.,
+// result[i] = src[i + shift_by] (or `0` for i + shift_by >= n), with the
+// same distribution as `src`
+template <typename DRange>
+dvector<typename DRange::value_type, typename DRange::dist_type> left_shift_drange(const DRange& src, size_t shift_by) {
+    using result_type = dvector<typename DRange::value_type, typename DRange::dist_type>;
+    return result_type(src.comm(), src.distribution(), shift_vector(src.local(), src.distribution(), shift_by, src.comm()));
 }
 
 template <typename T>
 std::vector<T> left_shift_dvec(const std::vector<T>& vec, const mxx::comm& comm, size_t shift_by) {
     dvector_const_wrapper<T, blk_dist> src(vec, comm);
     dvector<T, blk_dist> result = left_shift_drange(src, shift_by);
-    return result.vec;
+    return std::move(result.vec);
 }
-*/
 
-template <typename T>
-mxx::requests icopy_global_range(const std::vector<T>& src, mxx::partition::block_decomposition_buffered<size_t>& dist, size_t src_begin, size_t src_end, std::vector<T>& dst, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
+template <typename T, typename Partition>
+mxx::requests icopy_global_range(const std::vector<T>& src, const Partition& dist, size_t src_begin, size_t src_end, std::vector<T>& dst, size_t dst_begin, size_t dst_end, const mxx::comm& comm) {
     assert(src_begin < src_end);
     assert(dst_begin < dst_end);
     assert(src_end - src_begin == dst_end - dst_begin);
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    st_aggregate.hpp
+ * @brief   Bulk-synchronous bottom-up aggregation of node annotations over
+ *          the distributed suffix tree.
+ *
+ * The internal nodes of the suffix tree (as given by `construct_suffix_tree()`
+ * or `construct_lcp_interval_tree()`) are identified by LCP positions, and
+ * the subtree of each node is the contiguous segment of SA/LCP positions
+ * given by its SA-interval [lb, rb]. For an associative and commutative
+ * reduction, each node's aggregate is the reduction over its segment:
+ *  - nodes whose segment lies within one processor are reduced locally,
+ *    children before parents
+ *  - nodes whose segment spans processors combine the partial reductions of
+ *    the first and last processor of the segment with the totals of the
+ *    processors in between
+ *
+ * This takes a constant number of communication rounds (one allgather and
+ * two bulk request/reply exchanges), independent of the tree height.
+ */
+#ifndef ST_AGGREGATE_HPP
+#define ST_AGGREGATE_HPP
+
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <mxx/timer.hpp>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "dvector.hpp"
+#include "all2all.hpp"
+#include "bulk_rma.hpp"
+#include "suffix_tree.hpp"
+
+namespace st_aggregate_impl {
+
+// sends the requests to the owner of `key(request)` and returns the answers
+// `answer(request)` in the original order (collective call)
+template <typename T, typename Q, typename Key, typename Answer>
+std::vector<T> exchange_requests(const std::vector<Q>& requests, Key key, Answer answer, const mxx::comm& comm) {
+    std::vector<Q> bucketed;
+    std::vector<size_t> original_pos;
+    std::vector<size_t> send_counts = idxbucketing(requests, key, comm.size(), bucketed, original_pos);
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
+    std::vector<Q> local_requests = auto_all2allv(bucketed, send_counts, recv_counts, comm);
+    bucketed = std::vector<Q>();
+    std::vector<T> local_answers(local_requests.size());
+    for (size_t i = 0; i < local_requests.size(); ++i) {
+        local_answers[i] = answer(local_requests[i]);
+    }
+    std::vector<T> answers = auto_all2allv(local_answers, recv_counts, send_counts, comm);
+    return permute(answers, original_pos);
+}
+
+// reduction over the elements [first, last) of `tree`, which is a bottom-up
+// segment tree with its leaves in [p, 2p)
+template <typename T, typename Reduce>
+T segment_reduce(const std::vector<T>& tree, size_t first, size_t last, Reduce op, const T& identity) {
+    T result = identity;
+    size_t p = tree.size() / 2;
+    for (first += p, last += p; first < last; first >>= 1, last >>= 1) {
+        if (first & 1)
+            result = op(result, tree[first++]);
+        if (last & 1)
+            result = op(result, tree[--last]);
+    }
+    return result;
+}
+
+} // namespace st_aggregate_impl
+
+/**
+ * @brief   Aggregates annotations bottom-up over the suffix tree
+ *          (collective call).
+ *
+ * @param tree      The LCP-interval tree of the suffix array.
+ * @param leaf_vals The annotation of each local leaf (SA position).
+ * @param node_vals The annotation of each local internal node (LCP
+ *                  position), ignored for positions which are not nodes.
+ * @param op        Associative and commutative reduction `T(T, T)`.
+ * @param identity  The identity element of `op`.
+ *
+ * @return  The reduction over the annotations of all leaves and internal
+ *          nodes in the subtree of each local internal node (including the
+ *          node itself), `identity` for positions which are not nodes.
+ */
+template <typename T, typename Reduce>
+std::vector<T> subtree_aggregate(const lcp_interval_tree& tree, const std::vector<T>& leaf_vals, const std::vector<T>& node_vals,
+                                 Reduce op, const T& identity, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    size_t local_size = leaf_vals.size();
+    MXX_ASSERT(node_vals.size() == local_size && tree.leaf_parent.size() == local_size);
+    gen_dist part(comm, local_size);
+    size_t prefix = part.eprefix();
+    auto is_local = [&](size_t gidx) { return prefix <= gidx && gidx < prefix + local_size; };
+
+    // combined annotations of each position, and their partial reductions
+    // up to the end and from the start of the local block
+    std::vector<T> vals(local_size);
+    for (size_t i = 0; i < local_size; ++i) {
+        vals[i] = tree.is_node(i) ? op(leaf_vals[i], node_vals[i]) : leaf_vals[i];
+    }
+    std::vector<T> suffix_red(local_size + 1, identity);
+    for (size_t i = local_size; i > 0; --i) {
+        suffix_red[i-1] = op(vals[i-1], suffix_red[i]);
+    }
+    std::vector<T> prefix_red(local_size);
+    T acc = identity;
+    for (size_t i = 0; i < local_size; ++i) {
+        acc = op(acc, vals[i]);
+        prefix_red[i] = acc;
+    }
+
+    // segment tree over the totals of all processors
+    size_t p = comm.size();
+    std::vector<T> totals = mxx::allgather(suffix_red[0], comm);
+    std::vector<T> seg_tree(2*p, identity);
+    std::copy(totals.begin(), totals.end(), seg_tree.begin() + p);
+    for (size_t i = p - 1; i > 0; --i) {
+        seg_tree[i] = op(seg_tree[2*i], seg_tree[2*i+1]);
+    }
+    t.end_section("subtree aggregate: partial reductions");
+
+    // 1) nodes within the local block: children (smaller intervals) before parents
+    std::vector<T> result(local_size, identity);
+    std::vector<size_t> closed;
+    std::vector<size_t> open;
+    for (size_t i = 0; i < local_size; ++i) {
+        if (!tree.is_node(i))
+            continue;
+        if (is_local(tree.node_lb[i]) && is_local(tree.node_rb[i])) {
+            closed.push_back(i);
+            result[i] = node_vals[i];
+        } else {
+            open.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < local_size; ++i) {
+        size_t parent = tree.leaf_parent[i];
+        if (is_local(parent) && is_local(tree.node_rb[parent - prefix]) && is_local(tree.node_lb[parent - prefix]))
+            result[parent - prefix] = op(result[parent - prefix], leaf_vals[i]);
+    }
+    std::sort(closed.begin(), closed.end(), [&tree](size_t x, size_t y) {
+        return tree.node_rb[x] - tree.node_lb[x] < tree.node_rb[y] - tree.node_lb[y];
+    });
+    for (size_t i : closed) {
+        size_t parent = tree.node_parent[i];
+        if (parent != lcp_interval_tree::none() && is_local(parent)
+            && is_local(tree.node_lb[parent - prefix]) && is_local(tree.node_rb[parent - prefix]))
+            result[parent - prefix] = op(result[parent - prefix], result[i]);
+    }
+    t.end_section("subtree aggregate: local nodes");
+
+    // 2) nodes spanning processors: leaf at `lb` (plus the node, if it is the
+    //    root) and all of (lb, rb]
+    std::vector<std::pair<size_t, size_t>> left_reqs(open.size());
+    std::vector<size_t> right_reqs(open.size());
+    for (size_t j = 0; j < open.size(); ++j) {
+        size_t i = open[j];
+        left_reqs[j] = std::make_pair(tree.node_lb[i], size_t(tree.node_lb[i] == prefix + i));
+        right_reqs[j] = tree.node_rb[i];
+    }
+    std::vector<T> left_parts = st_aggregate_impl::exchange_requests<T>(left_reqs,
+        [&part](const std::pair<size_t, size_t>& r) { return part.target_processor(r.first); },
+        [&](const std::pair<size_t, size_t>& r) {
+            size_t k = r.first - prefix;
+            return op(r.second != 0 ? vals[k] : leaf_vals[k], suffix_red[k+1]);
+        }, comm);
+    std::vector<T> right_parts = st_aggregate_impl::exchange_requests<T>(right_reqs,
+        [&part](size_t r) { return part.target_processor(r); },
+        [&](size_t r) { return prefix_red[r - prefix]; }, comm);
+    for (size_t j = 0; j < open.size(); ++j) {
+        size_t i = open[j];
+        int first = part.target_processor(tree.node_lb[i]);
+        int last = part.target_processor(tree.node_rb[i]);
+        T middle = st_aggregate_impl::segment_reduce(seg_tree, first + 1, last, op, identity);
+        result[i] = op(op(left_parts[j], middle), right_parts[j]);
+    }
+    t.end_section("subtree aggregate: spanning nodes");
+
+    return result;
+}
+
+/**
+ * @brief   Returns the number of leaves in the subtree of each local
+ *          internal node, 0 for positions which are not nodes
+ *          (collective call).
+ */
+inline std::vector<size_t> subtree_leaf_counts(const lcp_interval_tree& tree, const mxx::comm& comm) {
+    size_t local_size = tree.leaf_parent.size();
+    return subtree_aggregate(tree, std::vector<size_t>(local_size, 1), std::vector<size_t>(local_size, 0),
+                             [](size_t x, size_t y) { return x + y; }, size_t(0), comm);
+}
+
+#endif // ST_AGGREGATE_HPP
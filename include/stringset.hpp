@@ -25,6 +25,8 @@
 
 #include <mxx/comm.hpp>
 #include "shifting.hpp"
+#include "all2all.hpp"
+#include "dvector.hpp"
 
 // distributed stringset with strings split across boundaries
 // and each string not necessarily starting in memory right after the previous
@@ -420,7 +422,7 @@ struct dist_seqs : public dist_seqs_base {
 
         // XXX: possibly optimize this communication (expected very low volume,
         //      and mostly with direct neighbors)
-        prefix_sizes = mxx::all2allv(gidx, send_counts, comm);
+        prefix_sizes = auto_all2allv(gidx, send_counts, comm);
     }
 
     static dist_seqs from_dss(simple_dstringset& dss, const mxx::comm& comm) {
@@ -476,7 +478,7 @@ struct dist_seqs : public dist_seqs_base {
 };
 
 struct dist_seqs_buckets : public dist_seqs_base {
-    mxx::partition::block_decomposition_buffered<size_t> part;
+    gen_dist part;
     size_t global_size;
     bool has_local_els;
 
@@ -486,8 +488,8 @@ struct dist_seqs_buckets : public dist_seqs_base {
         // init size and distribution
         dist_seqs_buckets d;
         d.has_local_els = seq.size() > 0;
-        d.global_size = mxx::allreduce(seq.size(), comm);
-        d.part = mxx::partition::block_decomposition_buffered<size_t>(d.global_size, comm.size(), comm.rank());
+        d.part = gen_dist(comm, seq.size());
+        d.global_size = d.part.global_size();
 
         // set these three:
         T prev = mxx::right_shift(seq.back(), comm);
@@ -19,6 +19,7 @@
 
 #include <mpi.h>
 #include <vector>
+#include <string>
 #include <cstring> // memcmp
 
 #include "alphabet.hpp"
@@ -29,7 +30,10 @@
 #include "stringset.hpp"
 #include "bulk_permute.hpp"
 #include "bulk_rma.hpp"
+#include "all2all.hpp"
 #include "idxsort.hpp"
+#include "checkpoint.hpp"
+#include "dvector.hpp"
 
 #include <mxx/datatypes.hpp>
 #include <mxx/shift.hpp>
@@ -134,9 +138,9 @@ private:
     /// The global size of the input string and suffix array
     std::size_t n;
 
-    /// The local size of the input string and suffix array
-    /// is either floor(n/p) or ceil(n/p) and based on a equal block
-    /// distribution
+    /// The local size of the input string and suffix array, which is the
+    /// same as the local size of the input (usually the equal block
+    /// distribution with floor(n/p) or ceil(n/p) elements)
     std::size_t local_size;
 
     /// The MPI communicator to use for the parallel suffix array construction
@@ -145,8 +149,8 @@ private:
     /// number of processes = size of the communicator
     int p;
 
-    // The block decomposition for the suffix array
-    mxx::partition::block_decomposition_buffered<size_t> part;
+    // The distribution of the suffix array (the same as the input)
+    gen_dist part;
 
 public:
     /// Iterators over the local input string
@@ -167,29 +171,62 @@ public:
     /// The local LCP array (remains empty if no LCP is constructed)
     std::vector<index_t> local_LCP;
 
+    /// If non-empty, `construct()` writes a checkpoint with this file prefix
+    /// after every prefix doubling iteration which permutes the bucket array
+    /// back into ISA order (see checkpoint.hpp)
+    std::string checkpoint_prefix;
+    /// fingerprint of the input, stored with each checkpoint
+    uint64_t checkpoint_fingerprint = 0;
+
+    /// The number of failed processors excluded by `construct_resilient()`
+    int lost_processors = 0;
+
 private:
 
     // MPI tags used in constructing the suffix array
     static const int PSAC_TAG_SHIFT = 2;
 
+    // number of adjacent k-mer pairs per block of the initial LCP kernel
+    static const std::size_t kmer_lcp_block_size = 1024;
+
 public:
 
+/// the global size of the input string and suffix array
+inline std::size_t global_size() const {
+    return n;
+}
+
+/// the distribution of the suffix array (the same as the input)
+inline const gen_dist& distribution() const {
+    return part;
+}
+
 void init_size(size_t lsize) {
     local_size = lsize;
-    n = mxx::allreduce(local_size, this->comm);
-    // get distribution
-    part = mxx::partition::block_decomposition_buffered<size_t>(n, comm.size(), comm.rank());
+    // get distribution (any distribution with at least one element on each
+    // processor, e.g. weighted by the memory of each node; `k` is capped by
+    // the smallest local size in `get_optimal_k()`)
+    part = gen_dist(comm, local_size);
+    n = part.global_size();
+    for (int i = 0; i < comm.size(); ++i) {
+        if (part.local_size(i) == 0)
+            throw std::runtime_error("The input string must have at least one character per processor.");
+    }
 
     p = comm.size();
+}
 
-    // assert a block decomposition
-    if (part.local_size() != local_size)
+// for construction methods which are implemented for block decompositions only
+void require_block_decomposition() const {
+    if (!part.is_blk_dist())
         throw std::runtime_error("The input string must be equally block decomposed accross all MPI processes.");
 }
 
 //template <typename StringSet> TODO template later
 void construct_ss(simple_dstringset& ss, const alphabet_type& alpha) {
     SAC_TIMER_START();
+    // keep the alphabet for the edge labels of the suffix tree
+    this->alpha = alpha;
     /***********************
      *  Initial bucketing  *
      ***********************/
@@ -284,6 +321,24 @@ void construct(Iterator begin, Iterator end, bool fast_resolval, const alphabet_
     local_B = kmer_generation<index_t>(begin, end, k, alpha, comm);
     SAC_TIMER_END_SECTION("kmer-gen");
 
+    prefix_doubling(k, k, alpha.bits_per_char(), fast_resolval);
+}
+
+// the prefix doubling iterations, starting from the bucket numbers `local_B`
+// of all `start_shift`-mers (`bits_per_char` is only used if `start_shift`
+// is the initial k-mer size `k`)
+void prefix_doubling(std::size_t start_shift, unsigned int k, unsigned int bits_per_char, bool fast_resolval) {
+    // instantiate for the block distribution whenever possible
+    if (part.is_blk_dist())
+        prefix_doubling(part.to_blk_dist(), start_shift, k, bits_per_char, fast_resolval);
+    else
+        prefix_doubling(part, start_shift, k, bits_per_char, fast_resolval);
+}
+
+template <typename Dist>
+void prefix_doubling(const Dist& dist, std::size_t start_shift, unsigned int k, unsigned int bits_per_char, bool fast_resolval) {
+    SAC_TIMER_START();
+    dvector_wrapper<index_t, Dist> B(local_B, dist, comm);
     std::vector<index_t> local_B_SA;
     std::size_t unfinished_buckets = 1<<k;
     std::size_t unfinished_elements = n;
@@ -292,20 +347,21 @@ void construct(Iterator begin, Iterator end, bool fast_resolval, const alphabet_
     /*******************************
      *  Prefix Doubling main loop  *
      *******************************/
-    for (shift_by = k; shift_by < n; shift_by <<= 1) {
+    for (shift_by = start_shift; shift_by < n; shift_by <<= 1) {
         SAC_TIMER_LOOP_START();
         /**************************************************
          *  Pairing buckets by shifting `shift_by` = 2^i  *
          **************************************************/
         // shift the B1 buckets by 2^i to the left => equals B2
-        std::vector<index_t> local_B2 = shift_vector(local_B, part, shift_by, comm);
+        dvector<index_t, Dist> B2 = left_shift_drange(B, shift_by);
         SAC_TIMER_END_LOOP_SECTION(shift_by, "shift-buckets");
 
         /*************
          *  ISA->SA  *
          *************/
         // by using sample sort on tuples (B1,B2)
-        local_SA = idxsort_vectors<index_t, index_t>(local_B, local_B2, comm);
+        local_SA = idxsort_vectors<index_t, index_t>(local_B, B2.local(), comm);
+        dvector_wrapper<index_t, Dist> SA(local_SA, dist, comm);
         SAC_TIMER_END_LOOP_SECTION(shift_by, "ISA-to-SA");
 
         /****************
@@ -314,10 +370,10 @@ void construct(Iterator begin, Iterator end, bool fast_resolval, const alphabet_
         // if this is the first iteration: create LCP, otherwise update
         if (_CONSTRUCT_LCP) {
             if (shift_by == k) {
-                initial_kmer_lcp(k, alpha.bits_per_char(), local_B2);
+                initial_kmer_lcp(k, bits_per_char, B2.local());
                 SAC_TIMER_END_LOOP_SECTION(shift_by, "init-lcp");
             } else {
-                resolve_next_lcp(shift_by, local_B2);
+                resolve_next_lcp(dist, shift_by, B2.local());
                 SAC_TIMER_END_LOOP_SECTION(shift_by, "update-lcp");
             }
         }
@@ -325,7 +381,7 @@ void construct(Iterator begin, Iterator end, bool fast_resolval, const alphabet_
         /*******************************
          *  Assign new bucket numbers  *
          *******************************/
-        std::tie(unfinished_buckets, unfinished_elements) = rebucket(local_B, local_B2, true, comm);
+        std::tie(unfinished_buckets, unfinished_elements) = rebucket(local_B, B2.local(), true, comm);
         if (comm.rank() == 0) {
             INFO("iteration " << shift_by << ": unfinished buckets = " << unfinished_buckets << ", unfinished elements = " << unfinished_elements);
         }
@@ -338,21 +394,25 @@ void construct(Iterator begin, Iterator end, bool fast_resolval, const alphabet_
         if (fast_resolval && unfinished_elements < n/10) {
             // prepare for bucket chaising (needs SA, and bucket arrays in both
             // SA and ISA order)
-            std::vector<index_t> cpy_SA(local_SA);
+            dvector<index_t, Dist> cpy_SA(comm, dist, std::vector<index_t>(local_SA));
             local_B_SA = local_B; // copy
-            bulk_permute_inplace(local_B, cpy_SA, part, comm);
+            bulk_permute_inplace(B, cpy_SA);
             SAC_TIMER_END_LOOP_SECTION(shift_by, "SA-to-ISA");
             SAC_TIMER_END_SECTION("sac-iteration");
             break;
         } else if ((shift_by << 1) >= n || unfinished_buckets == 0) {
             // if last iteration, use copy of local_SA for reorder and keep
             // original SA
-            std::vector<index_t> cpy_SA(local_SA);
-            bulk_permute_inplace(local_B, cpy_SA, part, comm);
+            dvector<index_t, Dist> cpy_SA(comm, dist, std::vector<index_t>(local_SA));
+            bulk_permute_inplace(B, cpy_SA);
             SAC_TIMER_END_LOOP_SECTION(shift_by, "SA-to-ISA");
         } else {
-            bulk_permute_inplace(local_B, local_SA, part, comm);
+            bulk_permute_inplace(B, SA);
             SAC_TIMER_END_LOOP_SECTION(shift_by, "SA-to-ISA");
+            if (!checkpoint_prefix.empty()) {
+                write_checkpoint(checkpoint_prefix, shift_by << 1, k, checkpoint_fingerprint, local_B, local_LCP, comm);
+                SAC_TIMER_END_LOOP_SECTION(shift_by, "checkpoint");
+            }
         }
 
         // end iteratior
@@ -387,6 +447,8 @@ void construct(Iterator begin, Iterator end, bool fast_resolval = true, unsigned
     /* get sizes */
     // the local size of the input
     init_size(std::distance(begin, end));
+    if (!checkpoint_prefix.empty())
+        checkpoint_fingerprint = input_fingerprint(begin, end, comm);
 
     /***********************
      *  Initial bucketing  *
@@ -403,12 +465,102 @@ void construct(Iterator begin, Iterator end, bool fast_resolval = true, unsigned
     construct(begin, end, fast_resolval, alpha, k);
 }
 
+/**
+ * @brief   Resumes the construction from the last checkpoint with the given
+ *          prefix, which may have been written with a different number of
+ *          processors.
+ *
+ * @param n             The global size of the input.
+ * @param fingerprint   The `input_fingerprint()` of the input.
+ *
+ * @return  `false` if there is no checkpoint of this input, i.e., of size `n`
+ *          and with the given fingerprint.
+ */
+bool resume(const std::string& prefix, std::size_t n, uint64_t fingerprint, bool fast_resolval = true) {
+    checkpoint_info info;
+    if (!read_checkpoint(prefix, info, local_B, local_LCP, comm) || info.n != n || info.fingerprint != fingerprint) {
+        local_B.clear();
+        local_LCP.clear();
+        return false;
+    }
+    if (_CONSTRUCT_LCP && !info.has_lcp)
+        throw std::runtime_error("The checkpoint `" + prefix + "` does not contain the LCP array.");
+    init_size(local_B.size());
+    if (comm.rank() == 0) {
+        INFO("Resuming from checkpoint `" << prefix << "` at iteration " << info.shift_by << " on " << comm.size() << " processors");
+    }
+    checkpoint_prefix = prefix;
+    checkpoint_fingerprint = fingerprint;
+    // the initial k-mer iteration is never checkpointed, thus
+    // `bits_per_char` is not used
+    prefix_doubling(info.shift_by, info.k, 0, fast_resolval);
+    return true;
+}
+
+/**
+ * @brief   Constructs the suffix array with a checkpoint after every prefix
+ *          doubling iteration, resuming from an existing checkpoint of the
+ *          same input (same size and `input_fingerprint()`).
+ *
+ * Checkpoints are only written by iterations which permute the bucket array
+ * back into ISA order, not by the initial k-mer iteration nor by the last
+ * iteration or the switch to bucket chasing.
+ *
+ * If processors fail and the MPI library supports ULFM, the surviving
+ * processors exclude the failed ones and continue from the last checkpoint.
+ * Afterwards, the suffix array is block decomposed across the survivors,
+ * which differs from the distribution of the input.
+ */
+template <typename Iterator>
+void construct_resilient(Iterator begin, Iterator end, const std::string& prefix, bool fast_resolval = true) {
+    std::size_t input_size = mxx::allreduce(static_cast<std::size_t>(std::distance(begin, end)), comm);
+    // the input of failed processors is lost, so fingerprint it up front
+    uint64_t fingerprint = input_fingerprint(begin, end, comm);
+    try {
+        if (!resume(prefix, input_size, fingerprint, fast_resolval)) {
+            checkpoint_prefix = prefix;
+            construct(begin, end, fast_resolval);
+        }
+    } catch (std::exception& e) {
+        if (!comm_shrink_supported())
+            throw;
+        // the input of failed processors is lost: retry from the last
+        // checkpoint until it succeeds on the remaining processors
+        std::string reason = e.what();
+        while (true) {
+            int p_before = comm.size();
+            comm = shrink_comm(comm);
+            if (comm.size() == p_before)
+                // not caused by a processor failure
+                throw;
+            lost_processors += p_before - comm.size();
+            if (comm.rank() == 0) {
+                INFO("Lost " << p_before - comm.size() << " processors (" << reason << ")");
+            }
+            bool resumed;
+            try {
+                resumed = resume(prefix, input_size, fingerprint, fast_resolval);
+            } catch (std::exception& e2) {
+                reason = e2.what();
+                continue;
+            }
+            if (!resumed)
+                throw std::runtime_error("There is no checkpoint to resume from after the loss of processors.");
+            break;
+        }
+    }
+    remove_checkpoint<index_t>(prefix, comm);
+    checkpoint_prefix.clear();
+}
+
 // generalized to more than "doubling" (e.g. prefix-trippling with L=3)
 // NOTE: this implementation doesn't support building the LCP (SA + ISA only)
 template <std::size_t L, typename Iterator>
 void construct_arr(Iterator begin, Iterator end, bool fast_resolval = true) {
     SAC_TIMER_START();
     init_size(std::distance(begin, end));
+    require_block_decomposition();
+    mxx::partition::block_decomposition_buffered<size_t> blk_part(n, comm.size(), comm.rank());
 
     /***********************
      *  Initial bucketing  *
@@ -454,7 +606,7 @@ void construct_arr(Iterator begin, Iterator end, bool fast_resolval = true) {
          *  Pairing buckets by shifting `shift_by` = 2^k  *
          **************************************************/
         // shift the B1 buckets by 2^k to the left => equals B2
-        multi_shift_inplace<index_t, L>(tuples, part, shift_by, comm);
+        multi_shift_inplace<index_t, L>(tuples, blk_part, shift_by, comm);
         SAC_TIMER_END_LOOP_SECTION(shift_by, "shift-buckets");
 
 
@@ -896,7 +1048,7 @@ std::vector<index_t> sparse_get_b2(const std::vector<index_t>& active, const std
 
     // use bulk RMA to request the values of B at doubled (+shift_by) location for
     // each active suffix
-    std::vector<index_t> rma_b2 = bulk_rma(B.begin(), B.end(), rma_reqs, comm);
+    std::vector<index_t> rma_b2 = bulk_rma(part, B.begin(), B.end(), rma_reqs, comm);
 
     auto b2in = rma_b2.begin();
     for (size_t i = 0; i < active.size(); ++i) {
@@ -942,19 +1094,19 @@ template <typename T>
 std::vector<T> sparse_doubling(const dist_seqs& ds, const std::vector<T>& vec, const std::vector<size_t>& rma_reqs, size_t shift_by, const mxx::comm& comm) {
     size_t local_size = vec.size();
     size_t global_size = mxx::allreduce(local_size, comm);
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+    blk_dist part(global_size, comm.size(), comm.rank());
 
     std::vector<size_t> original_pos;
     std::vector<size_t> bucketed_rma;
     std::vector<size_t> send_counts = idxbucketing(rma_reqs, [&part](size_t gidx) { return part.target_processor(gidx); }, comm.size(), bucketed_rma, original_pos);
 
-    std::vector<size_t> recv_counts = mxx::all2all(send_counts, comm);
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, comm);
 
     // send all queries via all2all
-    std::vector<size_t> local_queries = mxx::all2allv(bucketed_rma, send_counts, recv_counts, comm);
+    std::vector<size_t> local_queries = auto_all2allv(bucketed_rma, send_counts, recv_counts, comm);
 
     std::vector<index_t> results = local_get_sparse_b2(ds, vec, local_queries, shift_by);
-    results = mxx::all2allv(results, recv_counts, send_counts, comm);
+    results = auto_all2allv(results, recv_counts, send_counts, comm);
 
     std::vector<index_t> rma_b2 = permute(results, original_pos);
     return rma_b2;
@@ -1174,7 +1326,7 @@ void construct_msgs(std::vector<index_t>& local_B, std::vector<index_t>& local_I
             // time LCP separately!
             SAC_TIMER_START();
             // get parallel-distributed RMQ for all queries, results are in `minqueries`
-            bulk_rmq(n, local_LCP, minqueries, comm);
+            bulk_rmq(part, local_LCP, minqueries, comm);
 
             // update the new LCP values:
             for (auto min_lcp : minqueries) {
@@ -1199,7 +1351,7 @@ void construct_msgs(std::vector<index_t>& local_B, std::vector<index_t>& local_I
         }
 
         // message exchange to processor which contains first index
-        mxx::all2all_func(msgs, [&](const mypair<index_t>& x){return part.target_processor(x.first);}, comm);
+        auto_all2all_func(msgs, [&](const mypair<index_t>& x){return part.target_processor(x.first);}, comm);
 
         // update local ISA with new bucket numbers
         for (auto it = msgs.begin(); it != msgs.end(); ++it) {
@@ -1242,21 +1394,25 @@ void initial_kmer_lcp(unsigned int k, unsigned int bits_per_char) {
     local_LCP.assign(local_size, n);
 
     // 1) getting next element to left
-    index_t left_B = mxx::right_shift(local_B.back(), comm);
+    index_t left_B = mxx::right_shift(local_size > 0 ? local_B.back() : index_t(0), comm);
 
     // initialize first LCP
-    if (comm.rank() == 0) {
-        local_LCP[0] = 0;
-    } else {
-        if (left_B != local_B[0]) {
+    if (local_size > 0) {
+        if (comm.rank() == 0) {
+            local_LCP[0] = 0;
+        } else if (left_B != local_B[0]) {
             local_LCP[0] = lcp_bitwise(left_B, local_B[0], k, bits_per_char);
         }
     }
 
-    // intialize the LCP for all other elements for bucket boundaries
-    for (std::size_t i = 1; i < local_size; ++i) {
-        if (local_B[i-1] != local_B[i]) {
-            local_LCP[i] = lcp_bitwise(local_B[i-1], local_B[i], k, bits_per_char);
+    // intialize the LCP for all other elements for bucket boundaries, by
+    // blocks of adjacent k-mer pairs
+    unsigned int lcp[kmer_lcp_block_size];
+    for (std::size_t b = 1; b < local_size; b += kmer_lcp_block_size) {
+        std::size_t m = std::min(static_cast<std::size_t>(kmer_lcp_block_size), local_size - b);
+        lcp_bitwise_batch(&local_B[b-1], &local_B[b], m, k, bits_per_char, lcp);
+        for (std::size_t j = 0; j < m; ++j) {
+            local_LCP[b+j] = (local_B[b+j-1] != local_B[b+j]) ? lcp[j] : n;
         }
     }
 }
@@ -1289,22 +1445,63 @@ void initial_kmer_lcp(unsigned int k, unsigned int bits_per_char,
 
     // resize to size `local_size` and set all items to max of n
     local_LCP.assign(local_size, n);
-    if (comm.rank() == 0) {
+    if (comm.rank() == 0 && local_size > 0) {
         local_LCP[0] = 0;
     }
 
-    for_each_lpair_2vec(local_B, local_B2, [k, bits_per_char, this](const index_t left1, const index_t left2, const index_t right1, const index_t right2, size_t i) {
-        if (left1 != right1
-            || (left1 == right1 && left2 != right2)) {
-            unsigned int lcp = lcp_bitwise(left1, right1, k, bits_per_char);
-            if (lcp == k)
-                lcp += lcp_bitwise(left2, right2, k, bits_per_char);
-            local_LCP[i] = lcp;
+    // 1) the first pair spans the processor boundary
+    std::pair<index_t, index_t> last_el(0, 0);
+    if (local_size > 0)
+        last_el = std::make_pair(local_B.back(), local_B2.back());
+    std::pair<index_t, index_t> left_el = mxx::right_shift(last_el, comm);
+    if (comm.rank() > 0 && local_size > 0 && (left_el.first != local_B[0] || left_el.second != local_B2[0])) {
+        unsigned int lcp = lcp_bitwise(left_el.first, local_B[0], k, bits_per_char);
+        if (lcp == k)
+            lcp += lcp_bitwise(left_el.second, local_B2[0], k, bits_per_char);
+        local_LCP[0] = lcp;
+    }
+
+    // 2) all other pairs by blocks: the B2 LCP only counts if the B1 k-mers
+    //    are equal
+    unsigned int lcp1[kmer_lcp_block_size];
+    unsigned int lcp2[kmer_lcp_block_size];
+    for (std::size_t b = 1; b < local_size; b += kmer_lcp_block_size) {
+        std::size_t m = std::min(static_cast<std::size_t>(kmer_lcp_block_size), local_size - b);
+        lcp_bitwise_batch(&local_B[b-1], &local_B[b], m, k, bits_per_char, lcp1);
+        lcp_bitwise_batch(&local_B2[b-1], &local_B2[b], m, k, bits_per_char, lcp2);
+        for (std::size_t j = 0; j < m; ++j) {
+            std::size_t i = b + j;
+            unsigned int lcp = lcp1[j] + ((lcp1[j] == k) ? lcp2[j] : 0);
+            local_LCP[i] = (local_B[i-1] != local_B[i] || local_B2[i-1] != local_B2[i]) ? lcp : n;
         }
-    }, comm);
+    }
 }
 
 
+// the initial LCP of two adjacent (B1, B2) pairs of the generalized suffix
+// array, given the LCPs `lcp1` and `lcp2` of the B1 and B2 k-mers. Equal
+// k-mers are padded with 0 at the end of their string, in which case their
+// LCP is the length up to the padding. Returns `n` if the LCP is not yet
+// known.
+inline index_t kmer_pair_lcp_gsa(index_t left1, index_t left2, index_t right1, index_t right2,
+                                 unsigned int lcp1, unsigned int lcp2, unsigned int k, unsigned int bits_per_char) const {
+    if (left1 != right1)
+        return lcp1;
+    //unsigned int lcp = lcp_bitwise_no0(left1, right1, k, bits_per_char);
+    assert(left1 != 0);
+    unsigned int lcp = k - trailing_zeros(left1) / bits_per_char;
+    if (lcp < k) {
+        // lcp is smaller than k => B1 has trailing 0
+        return lcp;
+    }
+    if (left2 != right2)
+        return lcp + lcp2;
+    if (left2 != 0) {
+        lcp += (k - trailing_zeros(left2) / bits_per_char);
+    }
+    return (lcp < 2*k) ? lcp : n;
+}
+
 // for pairs of two buckets: pair[i] = (B1[i], B2[i])
 void initial_kmer_lcp_gsa(unsigned int k, unsigned int bits_per_char,
                           const std::vector<index_t>& local_B2) {
@@ -1314,39 +1511,44 @@ void initial_kmer_lcp_gsa(unsigned int k, unsigned int bits_per_char,
 
     // resize to size `local_size` and set all items to max of n
     local_LCP.assign(local_size, n);
-    if (comm.rank() == 0) {
+    if (comm.rank() == 0 && local_size > 0) {
         local_LCP[0] = 0;
     }
 
-    for_each_lpair_2vec(local_B, local_B2, [k, bits_per_char, this](const index_t left1, const index_t left2, const index_t right1, const index_t right2, size_t i) {
-        if (left1 != right1) {
-            local_LCP[i] = lcp_bitwise(left1, right1, k, bits_per_char);
-        } else {
-            //unsigned int lcp = lcp_bitwise_no0(left1, right1, k, bits_per_char);
-            assert(left1 != 0);
-            unsigned int lcp = k - trailing_zeros(left1) / bits_per_char;
-            if (lcp == k) {
-                if(left2 != right2) {
-                    lcp += lcp_bitwise(left2, right2, k, bits_per_char);
-                    local_LCP[i] = lcp;
-                } else {
-                    if (left2 != 0) {
-                        lcp += (k - trailing_zeros(left2) / bits_per_char);
-                    }
-                    if (lcp < 2*k) {
-                        local_LCP[i] = lcp;
-                    }
-                }
-            } else {
-                // lcp is smaller than k => B1 has trailing 0
-                local_LCP[i] = lcp;
-            }
+    // 1) the first pair spans the processor boundary
+    std::pair<index_t, index_t> last_el(0, 0);
+    if (local_size > 0)
+        last_el = std::make_pair(local_B.back(), local_B2.back());
+    std::pair<index_t, index_t> left_el = mxx::right_shift(last_el, comm);
+    if (comm.rank() > 0 && local_size > 0) {
+        local_LCP[0] = kmer_pair_lcp_gsa(left_el.first, left_el.second, local_B[0], local_B2[0],
+                                         lcp_bitwise(left_el.first, local_B[0], k, bits_per_char),
+                                         lcp_bitwise(left_el.second, local_B2[0], k, bits_per_char), k, bits_per_char);
+    }
+
+    // 2) all other pairs by blocks, only equal k-mers need the scalar
+    //    trailing zero count
+    unsigned int lcp1[kmer_lcp_block_size];
+    unsigned int lcp2[kmer_lcp_block_size];
+    for (std::size_t b = 1; b < local_size; b += kmer_lcp_block_size) {
+        std::size_t m = std::min(static_cast<std::size_t>(kmer_lcp_block_size), local_size - b);
+        lcp_bitwise_batch(&local_B[b-1], &local_B[b], m, k, bits_per_char, lcp1);
+        lcp_bitwise_batch(&local_B2[b-1], &local_B2[b], m, k, bits_per_char, lcp2);
+        for (std::size_t j = 0; j < m; ++j) {
+            std::size_t i = b + j;
+            local_LCP[i] = kmer_pair_lcp_gsa(local_B[i-1], local_B2[i-1], local_B[i], local_B2[i], lcp1[j], lcp2[j], k, bits_per_char);
         }
-    }, comm);
+    }
 }
 
 
 void resolve_next_lcp(int dist, const std::vector<index_t>& local_B2) {
+    resolve_next_lcp(part, dist, local_B2);
+}
+
+// `part_dist` is the distribution of the arrays
+template <typename Dist>
+void resolve_next_lcp(const Dist& part_dist, int dist, const std::vector<index_t>& local_B2) {
     // 2.) find _new_ bucket boundaries (B1[i-1] == B1[i] && B2[i-1] != B2[i])
     // 3.) bulk-parallel-distributed RMQ for ranges (B2[i-1],B2[i]+1) to get min_lcp[i]
     // 4.) LCP[i] = dist + min_lcp[i]
@@ -1354,7 +1556,7 @@ void resolve_next_lcp(int dist, const std::vector<index_t>& local_B2) {
     // find _new_ bucket boundaries and create associated parallel distributed
     // RMQ queries.
     std::vector<std::tuple<index_t, index_t, index_t> > minqueries;
-    std::size_t prefix_size = part.excl_prefix_size();
+    std::size_t prefix_size = part_dist.eprefix();
 
     for_each_lpair_2vec(local_B, local_B2, [dist, prefix_size, &minqueries, this](const index_t left1, const index_t left2, const index_t right1, const index_t right2, size_t i) {
         if (left1 == right1) {
@@ -1384,7 +1586,7 @@ void resolve_next_lcp(int dist, const std::vector<index_t>& local_B2) {
     // `minqueries`
     // TODO: bulk updatable RMQs [such that we don't have to construct the
     //       RMQ for the local_LCP in each iteration]
-    bulk_rmq(n, local_LCP, minqueries, comm);
+    bulk_rmq(dvector_const_wrapper<index_t, Dist>(local_LCP, part_dist, comm), minqueries);
     assert(minqueries.size() == nqueries);
 
 
@@ -18,6 +18,7 @@
 #define SUFFIX_TREE_HPP
 
 #include <vector>
+#include <limits>
 
 #include <mxx/comm.hpp>
 #include <mxx/timer.hpp>
@@ -26,187 +27,375 @@
 #include <ansv.hpp>
 
 #include <bulk_rma.hpp>
+#include <dvector.hpp>
+#include <all2all.hpp>
 
-template <typename Func, typename char_t, typename index_t = std::size_t>
-void for_each_parent(const suffix_array<char_t, index_t, true>& sa, Func func, const mxx::comm& comm) {
-    mxx::section_timer t(std::cerr, comm);
-    // get input sizes
-    size_t local_size = sa.local_SA.size();
-    size_t global_size = mxx::allreduce(local_size, comm);
-    size_t prefix = mxx::exscan(local_size, comm);
-    // assert n >= p, or rather at least one element per process
-    MXX_ASSERT(mxx::all_of(local_size >= 1, comm));
-    // ansv of lcp!
-    // TODO: use index_t instead of size_t
-    std::vector<size_t> left_nsv;
-    std::vector<size_t> right_nsv;
-    std::vector<std::pair<index_t, size_t>> lr_mins;
-
-    const size_t nonsv = std::numeric_limits<size_t>::max();
-    t.end_section("pre ansv");
-
-    // ANSV with furthest eq for left and smallest for right
-    ansv<index_t, furthest_eq, nearest_sm, local_indexing>(sa.local_LCP, left_nsv, right_nsv, lr_mins, comm, nonsv);
-    t.end_section("ansv");
-
-    // each SA[i] lies between two LCP values
-    // LCP[i] = lcp(S[SA[i-1]], S[SA[i]])
-    // leaf nodes are the suffix array positions. Their parent is the either their left or their right
-    // LCP, depending on which one is larger
+/**
+ * @brief   The parents of all local nodes of the suffix tree, given by the
+ *          ANSV of the LCP array.
+ *
+ * The constructor runs the (global) ANSV. Afterwards, the parents of any
+ * range of local leaves and internal nodes are enumerated without further
+ * communication, which allows processing them in chunks.
+ */
+template <typename char_t, typename index_t = std::size_t>
+class st_parents {
+public:
+    /// runs the ANSV of the LCP array (collective call)
+    st_parents(const suffix_array<char_t, index_t, true>& sa, const mxx::comm& comm)
+        : LCP(sa.local_LCP), rank(comm.rank()), size(comm.size()), nonsv(std::numeric_limits<size_t>::max()) {
+        // input sizes, as known from the SA construction
+        const gen_dist& part = sa.distribution();
+        local_size = sa.local_SA.size();
+        global_size = sa.global_size();
+        prefix = part.eprefix();
+        MXX_ASSERT(part.local_size() == local_size && part.comm_size() == size);
+        // assert n >= p, or rather at least one element per process
+        for (int i = 0; i < size; ++i)
+            MXX_ASSERT(part.local_size(i) >= 1);
+
+        // ANSV with furthest eq for left and smallest for right
+        ansv<index_t, furthest_eq, nearest_sm, local_indexing>(sa.local_LCP, left_nsv, right_nsv, lr_mins, comm, nonsv);
+
+        // get the first LCP value of the next processor
+        next_first_lcp = mxx::left_shift(sa.local_LCP[0], comm);
+    }
 
-    // get the first LCP value of the next processor
-    index_t next_first_lcp = mxx::left_shift(sa.local_LCP[0], comm);
-    for (size_t i = 0; i < local_size; ++i) {
-        // for each suffix array position SA[i], we check the longest-common-prefix
-        // with the neighboring suffixes SA[i-1] and SA[i+1]. Whichever one it
-        // shares the larger common prefix with, is its sibling in the ST and
-        // they share a parent at the depth given by the larger LCP value. The
-        // index of the LCP that has that value will be the index of the parent
-        // node.
-        //
-        // This means for every `i`, we need argmax_i {LCP[i], LCP[i+1]}, where
-        // `i+1` might be on the next processor.
-        //
-        // If there are multiple leafs > 2 for an internal node, the parent
-        // will be the index of the furthest equal element. We thus need
-        // to use the NSV for determining the left parent.
-        // If the right LCP is larger, then that one is the direct parent,
-        // since there can't be any equal elements to the left (since the
-        // right one was larger).
-
-        // parent will be an index into LCP
-        size_t parent = std::numeric_limits<size_t>::max();
-        index_t lcp_val;
-
-        // the globally first element has parent 1
-        if (comm.rank() == 0 && i == 0) {
-            // globally first leaf: SA[0]
-            if (local_size > 1) {
-                lcp_val = sa.local_LCP[1];
-            } else {
-                MXX_ASSERT(global_size > 1);
-                lcp_val = next_first_lcp;
-            }
-            // -> parent = 1, since it is the common prefix between SA[0] and SA[1]
-            // unless the lcp is 0, then this leaf is connected
-            // directly to the root node (parent = 0)
-            parent = lcp_val > 0 ? 1 : 0;
-        } else {
-            // To determine whether the left or right LCP is the parent,
-            // we take the max of LCP[i]=lcp(SA[i-1],SA[i]) and LCP[i+1]=lcp(SA[i], SA[i+1])
-            // There are two special cases to handle:
-            // 1) locally last element: we need to use the first LCP value of the next processor
-            //    in place of LCP[i+1]
-            // 2) globally last element: parent is always the left furthest eq nsv
-            if ((i == local_size-1
-                 && (comm.rank() == comm.size() || sa.local_LCP[local_size-1] >= next_first_lcp))
-                || (i < local_size-1 && sa.local_LCP[i] >= sa.local_LCP[i+1])) {
-                // the parent is the left furthest eq or nearest sm
-                size_t nsv;
-                if (left_nsv[i] < local_size) {
-                    nsv = prefix + left_nsv[i];
-                    lcp_val = sa.local_LCP[left_nsv[i]];
-                } else {
-                    nsv = lr_mins[left_nsv[i] - local_size].second;
-                    lcp_val = lr_mins[left_nsv[i] - local_size].first;
-                }
-                if (lcp_val == sa.local_LCP[i]) {
-                    parent = nsv;
+    size_t local_size;
+    size_t global_size;
+    size_t prefix;
+
+    /**
+     * @brief   Calls `func(i, global_size + prefix + i, parent, lcp_val)` for
+     *          each local leaf (SA position) `i` in [begin, end).
+     */
+    template <typename Func>
+    void for_each_leaf(size_t begin, size_t end, Func func) const {
+        // each SA[i] lies between two LCP values
+        // LCP[i] = lcp(S[SA[i-1]], S[SA[i]])
+        // leaf nodes are the suffix array positions. Their parent is the either their left or their right
+        // LCP, depending on which one is larger
+        for (size_t i = begin; i < end; ++i) {
+            // for each suffix array position SA[i], we check the longest-common-prefix
+            // with the neighboring suffixes SA[i-1] and SA[i+1]. Whichever one it
+            // shares the larger common prefix with, is its sibling in the ST and
+            // they share a parent at the depth given by the larger LCP value. The
+            // index of the LCP that has that value will be the index of the parent
+            // node.
+            //
+            // This means for every `i`, we need argmax_i {LCP[i], LCP[i+1]}, where
+            // `i+1` might be on the next processor.
+            //
+            // If there are multiple leafs > 2 for an internal node, the parent
+            // will be the index of the furthest equal element. We thus need
+            // to use the NSV for determining the left parent.
+            // If the right LCP is larger, then that one is the direct parent,
+            // since there can't be any equal elements to the left (since the
+            // right one was larger).
+
+            // parent will be an index into LCP
+            size_t parent = std::numeric_limits<size_t>::max();
+            index_t lcp_val;
+
+            // the globally first element has parent 1
+            if (rank == 0 && i == 0) {
+                // globally first leaf: SA[0]
+                if (local_size > 1) {
+                    lcp_val = LCP[1];
                 } else {
-                    parent = prefix + i;
-                    lcp_val = sa.local_LCP[i];
-                }
-            } else {
-                // SA[i] shares a longer prefix with its right neighbor SA[i+1]
-                // they converge at internal node prefix+i+1
-                parent = prefix + i + 1;
-                if (i == local_size - 1)
+                    MXX_ASSERT(global_size > 1);
                     lcp_val = next_first_lcp;
-                else
-                    lcp_val = sa.local_LCP[i+1];
-            }
-        }
-        func(i, global_size + prefix + i, parent, lcp_val);
-    }
-
-    // get parents of internal nodes (via LCP)
-    for (size_t i = 0; i < local_size; ++i) {
-        size_t parent = std::numeric_limits<size_t>::max();
-        index_t lcp_val;
-        // for each LCP position, get ANSV left-furthest-eq and right-nearest-sm
-        // and the max of the two is the parent
-        // Special cases: first (LCP[0]) and globally last LCP
-        if (comm.rank() == 0 && i == 0) {
-            // this is the root node and it has no parent!
-            continue;
-
-        //} else if (comm.rank() == comm.size() - 1 && i == local_size - 1) {
-            // globally last element (no right ansv)
-            // this case is identical to the regular case, since for the right
-            // most element, right_nsv[i] will be == nonsv
-            // and as such is handled in the corresponding case below
-        } else {
-            if (sa.local_LCP[i] == 0) {
-                // this is a dupliate of the root node which is located at
-                // position 0 on processor 0
-                continue;
+                }
+                // -> parent = 1, since it is the common prefix between SA[0] and SA[1]
+                // unless the lcp is 0, then this leaf is connected
+                // directly to the root node (parent = 0)
+                parent = lcp_val > 0 ? 1 : 0;
             } else {
-                // left NSV can't be non-existant because LCP[0] = 0
-                assert(left_nsv[i] != nonsv);
-                if (right_nsv[i] == nonsv) {
-                    // use left one
+                // To determine whether the left or right LCP is the parent,
+                // we take the max of LCP[i]=lcp(SA[i-1],SA[i]) and LCP[i+1]=lcp(SA[i], SA[i+1])
+                // There are two special cases to handle:
+                // 1) locally last element: we need to use the first LCP value of the next processor
+                //    in place of LCP[i+1]
+                // 2) globally last element: parent is always the left furthest eq nsv
+                if ((i == local_size-1
+                     && (rank == size || LCP[local_size-1] >= next_first_lcp))
+                    || (i < local_size-1 && LCP[i] >= LCP[i+1])) {
+                    // the parent is the left furthest eq or nearest sm
                     size_t nsv;
                     if (left_nsv[i] < local_size) {
                         nsv = prefix + left_nsv[i];
-                        lcp_val = sa.local_LCP[left_nsv[i]];
+                        lcp_val = LCP[left_nsv[i]];
                     } else {
                         nsv = lr_mins[left_nsv[i] - local_size].second;
                         lcp_val = lr_mins[left_nsv[i] - local_size].first;
                     }
-                    if (lcp_val == sa.local_LCP[i]) {
-                        // duplicate node, don't add!
-                        continue;
-                    }
-                    parent = nsv;
-                } else {
-                    // get left NSV index and value
-                    size_t lnsv;
-                    index_t left_lcp_val;
-                    if (left_nsv[i] < local_size) {
-                        lnsv = prefix + left_nsv[i];
-                        left_lcp_val = sa.local_LCP[left_nsv[i]];
-                    } else {
-                        lnsv = lr_mins[left_nsv[i] - local_size].second;
-                        left_lcp_val = lr_mins[left_nsv[i] - local_size].first;
-                    }
-                    // get right NSV index and value
-                    size_t rnsv;
-                    index_t right_lcp_val;
-                    if (right_nsv[i] < local_size) {
-                        rnsv = prefix + right_nsv[i];
-                        right_lcp_val = sa.local_LCP[right_nsv[i]];
+                    if (lcp_val == LCP[i]) {
+                        parent = nsv;
                     } else {
-                        rnsv = lr_mins[right_nsv[i] - local_size].second;
-                        right_lcp_val = lr_mins[right_nsv[i] - local_size].first;
+                        parent = prefix + i;
+                        lcp_val = LCP[i];
                     }
-                    // parent is the NSV for which LCP is larger.
-                    // if same, use left furthest_eq
-                    if (left_lcp_val >= right_lcp_val) {
-                        if (left_lcp_val == sa.local_LCP[i]) {
-                            // this is a duplicate node, and won't be added
+                } else {
+                    // SA[i] shares a longer prefix with its right neighbor SA[i+1]
+                    // they converge at internal node prefix+i+1
+                    parent = prefix + i + 1;
+                    if (i == local_size - 1)
+                        lcp_val = next_first_lcp;
+                    else
+                        lcp_val = LCP[i+1];
+                }
+            }
+            func(i, global_size + prefix + i, parent, lcp_val);
+        }
+    }
+
+    /**
+     * @brief   Calls `func(i, prefix + i, parent, lcp_val)` for each local
+     *          internal node (LCP position) `i` in [begin, end), except for
+     *          the root and duplicate nodes.
+     */
+    template <typename Func>
+    void for_each_internal(size_t begin, size_t end, Func func) const {
+        for (size_t i = begin; i < end; ++i) {
+            size_t parent = std::numeric_limits<size_t>::max();
+            index_t lcp_val;
+            // for each LCP position, get ANSV left-furthest-eq and right-nearest-sm
+            // and the max of the two is the parent
+            // Special cases: first (LCP[0]) and globally last LCP
+            if (rank == 0 && i == 0) {
+                // this is the root node and it has no parent!
+                continue;
+
+            //} else if (rank == size - 1 && i == local_size - 1) {
+                // globally last element (no right ansv)
+                // this case is identical to the regular case, since for the right
+                // most element, right_nsv[i] will be == nonsv
+                // and as such is handled in the corresponding case below
+            } else {
+                if (LCP[i] == 0) {
+                    // this is a dupliate of the root node which is located at
+                    // position 0 on processor 0
+                    continue;
+                } else {
+                    // left NSV can't be non-existant because LCP[0] = 0
+                    assert(left_nsv[i] != nonsv);
+                    if (right_nsv[i] == nonsv) {
+                        // use left one
+                        size_t nsv;
+                        if (left_nsv[i] < local_size) {
+                            nsv = prefix + left_nsv[i];
+                            lcp_val = LCP[left_nsv[i]];
+                        } else {
+                            nsv = lr_mins[left_nsv[i] - local_size].second;
+                            lcp_val = lr_mins[left_nsv[i] - local_size].first;
+                        }
+                        if (lcp_val == LCP[i]) {
+                            // duplicate node, don't add!
                             continue;
                         }
-                        parent = lnsv;
-                        lcp_val = left_lcp_val;
+                        parent = nsv;
                     } else {
-                        parent = rnsv;
-                        lcp_val = right_lcp_val;
+                        // get left NSV index and value
+                        size_t lnsv;
+                        index_t left_lcp_val;
+                        if (left_nsv[i] < local_size) {
+                            lnsv = prefix + left_nsv[i];
+                            left_lcp_val = LCP[left_nsv[i]];
+                        } else {
+                            lnsv = lr_mins[left_nsv[i] - local_size].second;
+                            left_lcp_val = lr_mins[left_nsv[i] - local_size].first;
+                        }
+                        // get right NSV index and value
+                        size_t rnsv;
+                        index_t right_lcp_val;
+                        if (right_nsv[i] < local_size) {
+                            rnsv = prefix + right_nsv[i];
+                            right_lcp_val = LCP[right_nsv[i]];
+                        } else {
+                            rnsv = lr_mins[right_nsv[i] - local_size].second;
+                            right_lcp_val = lr_mins[right_nsv[i] - local_size].first;
+                        }
+                        // parent is the NSV for which LCP is larger.
+                        // if same, use left furthest_eq
+                        if (left_lcp_val >= right_lcp_val) {
+                            if (left_lcp_val == LCP[i]) {
+                                // this is a duplicate node, and won't be added
+                                continue;
+                            }
+                            parent = lnsv;
+                            lcp_val = left_lcp_val;
+                        } else {
+                            parent = rnsv;
+                            lcp_val = right_lcp_val;
+                        }
                     }
                 }
             }
+            func(i, prefix + i, parent, lcp_val);
+        }
+    }
+
+    /**
+     * @brief   Returns the right bound (inclusive) of the SA-interval of the
+     *          internal node at the local LCP position `i`, given by its
+     *          nearest smaller LCP value to the right.
+     */
+    inline size_t right_bound(size_t i) const {
+        if (right_nsv[i] == nonsv)
+            return global_size - 1;
+        else if (right_nsv[i] < local_size)
+            return prefix + right_nsv[i] - 1;
+        else
+            return lr_mins[right_nsv[i] - local_size].second - 1;
+    }
+
+private:
+    const std::vector<index_t>& LCP;
+    int rank;
+    int size;
+    // ansv of lcp!
+    // TODO: use index_t instead of size_t
+    std::vector<size_t> left_nsv;
+    std::vector<size_t> right_nsv;
+    std::vector<std::pair<index_t, size_t>> lr_mins;
+    const size_t nonsv;
+    index_t next_first_lcp;
+};
+
+template <typename Func, typename char_t, typename index_t = std::size_t>
+void for_each_parent(const suffix_array<char_t, index_t, true>& sa, Func func, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    st_parents<char_t, index_t> parents(sa, comm);
+    t.end_section("ansv");
+    parents.for_each_leaf(0, parents.local_size, func);
+    parents.for_each_internal(0, parents.local_size, func);
+}
+
+/**
+ * @brief   Lightweight suffix tree representation as LCP-interval tree.
+ *
+ * Internal nodes are identified by the index of their (leftmost) LCP
+ * entry, and leaves by `global_size + SA index`, the same as for
+ * `construct_suffix_tree()`. Instead of a child table, each node stores
+ * a pointer to its parent. Internal nodes additionally store their
+ * SA-interval [lb, rb]; their string depth is given by the LCP value.
+ * All vectors are indexed by the local SA/LCP index.
+ */
+struct lcp_interval_tree {
+    /// parent of each local leaf (SA position)
+    std::vector<size_t> leaf_parent;
+    /// parent of each local internal node (LCP position), `none()` for the root
+    std::vector<size_t> node_parent;
+    /// left bound of each local internal node's SA-interval
+    std::vector<size_t> node_lb;
+    /// right bound (inclusive) of each local internal node's SA-interval,
+    /// `none()` if the LCP position is not an internal node
+    std::vector<size_t> node_rb;
+
+    static inline size_t none() {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    /// returns whether the local LCP position `i` is an internal node
+    inline bool is_node(size_t i) const {
+        return node_rb[i] != none();
+    }
+};
+
+/**
+ * @brief   Constructs the LCP-interval tree (collective call).
+ *
+ * Parents are determined by `st_parents` as for the full suffix tree, but
+ * are stored at the child, such that the exchange of edges to their
+ * parents, the edge character RMA, and the (sigma+1) wide node table are
+ * skipped entirely.
+ *
+ * The right interval bounds are the nearest smaller LCP values to the right
+ * from the same ANSV. The left `furthest_eq` matches jump past the nearest
+ * smaller value to the leftmost entry of its node, thus the left bounds are
+ * found by a local scan, and for the nodes without a smaller value on their
+ * processor, by a single query to the last processor to the left with a
+ * smaller value.
+ */
+template <typename char_t, typename index_t = std::size_t>
+lcp_interval_tree construct_lcp_interval_tree(const suffix_array<char_t, index_t, true>& sa, const mxx::comm& comm) {
+    mxx::section_timer t(std::cerr, comm);
+    const std::vector<index_t>& LCP = sa.local_LCP;
+    size_t local_size = sa.local_SA.size();
+    size_t prefix = sa.distribution().eprefix();
+
+    const size_t none = lcp_interval_tree::none();
+    lcp_interval_tree tree;
+    tree.leaf_parent.resize(local_size);
+    tree.node_parent.resize(local_size, none);
+    tree.node_lb.resize(local_size, none);
+    tree.node_rb.resize(local_size, none);
+
+    st_parents<char_t, index_t> parents(sa, comm);
+    t.end_section("lcp interval tree: ansv");
+
+    parents.for_each_leaf(0, local_size, [&](size_t i, size_t, size_t parent, index_t) {
+        tree.leaf_parent[i] = parent;
+    });
+    parents.for_each_internal(0, local_size, [&](size_t i, size_t, size_t parent, index_t) {
+        tree.node_parent[i] = parent;
+        tree.node_rb[i] = parents.right_bound(i);
+    });
+    if (comm.rank() == 0) {
+        // the root
+        tree.node_lb[0] = 0;
+        tree.node_rb[0] = sa.global_size() - 1;
+    }
+    t.end_section("lcp interval tree: parents and right bounds");
+
+    // left bounds: nearest smaller LCP value to the left of each node, via
+    // the stack of strict suffix minima (increasing LCP values)
+    std::vector<size_t> stack;
+    std::vector<size_t> remote_nodes;
+    for (size_t i = 0; i < local_size; ++i) {
+        while (!stack.empty() && LCP[stack.back()] >= LCP[i])
+            stack.pop_back();
+        if (tree.node_parent[i] != none) {
+            if (stack.empty())
+                remote_nodes.push_back(i);
+            else
+                tree.node_lb[i] = prefix + stack.back();
         }
-        func(i, prefix + i, parent, lcp_val);
+        stack.push_back(i);
+    }
+
+    // the remaining nodes are smaller or equal to all LCP values to their
+    // left on this processor, their nearest smaller value is on the last
+    // processor to the left with a smaller minimum (`LCP[0] = 0` on the
+    // first processor is smaller than the LCP value of any node)
+    std::vector<index_t> block_min = mxx::allgather(LCP[stack.front()], comm);
+    std::vector<std::pair<int, size_t> > remote_reqs(remote_nodes.size());
+    for (size_t j = 0; j < remote_nodes.size(); ++j) {
+        index_t x = LCP[remote_nodes[j]];
+        int q = comm.rank() - 1;
+        while (block_min[q] >= x)
+            --q;
+        remote_reqs[j] = std::pair<int, size_t>(q, remote_nodes[j]);
+    }
+    std::sort(remote_reqs.begin(), remote_reqs.end());
+    std::vector<size_t> send_counts(comm.size(), 0);
+    std::vector<index_t> queries(remote_reqs.size());
+    for (size_t j = 0; j < remote_reqs.size(); ++j) {
+        ++send_counts[remote_reqs[j].first];
+        queries[j] = LCP[remote_reqs[j].second];
     }
+    // the last local position with a smaller LCP value is a suffix minimum
+    std::vector<size_t> lbs = bulk_query(queries, [&](index_t x) {
+        auto it = std::lower_bound(stack.begin(), stack.end(), x, [&LCP](size_t pos, index_t y) { return LCP[pos] < y; });
+        assert(it != stack.begin());
+        return prefix + *(it - 1);
+    }, send_counts, comm);
+    for (size_t j = 0; j < remote_reqs.size(); ++j) {
+        tree.node_lb[remote_reqs[j].second] = lbs[j];
+    }
+    t.end_section("lcp interval tree: left bounds");
+
+    return tree;
 }
 
 constexpr int edgechar_twophase_all2all = 1;
@@ -265,10 +454,10 @@ std::vector<size_t> construct_st_2phase(const suffix_array<char_t, index_t, true
     // Most parents are on the same processor as the child node, thus
     // this requires a lot more communication then necessary
     // 1) send tuples (parent, i, SA[i]+LCP[i]) to 3rd index)
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+    const gen_dist& part = sa.distribution();
     // send all requests to the process on which the character for the
     // character request lies
-    mxx::all2all_func(parent_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<2>(t));}, comm);
+    auto_all2all_func(parent_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<2>(t));}, comm);
     t.end_section("all2all_func: req characters");
 
     // replace string request with character from original string
@@ -289,7 +478,7 @@ std::vector<size_t> construct_st_2phase(const suffix_array<char_t, index_t, true
     t.end_section("locally answer char queries");
 
     // 2) send tuples (parent, i, S[SA[i]+LCP[i]) to 1st index) [to parent]
-    mxx::all2all_func(parent_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<0>(t));}, comm);
+    auto_all2all_func(parent_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<0>(t));}, comm);
     t.end_section("all2all_func: send to parent");
 
     // one internal node for each LCP entry, each internal node is sigma cells
@@ -339,10 +528,10 @@ std::vector<size_t> construct_suffix_tree(const suffix_array<char_t, index_t, tr
     //typedef typename std::iterator_traits<InputIterator>::value_type CharT;
     std::vector<char_t> edge_chars;
     if (edgechar_method == edgechar_bulk_rma) {
-        mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+        const gen_dist& part = sa.distribution();
         // send those edges for which the parent lies on a remote processor
         typedef std::tuple<size_t, size_t, size_t> Tp;
-        mxx::all2all_func(remote_reqs, [&part](const Tp& t) {return part.target_processor(std::get<0>(t));}, comm);
+        auto_all2all_func(remote_reqs, [&part](const Tp& t) {return part.target_processor(std::get<0>(t));}, comm);
         parent_reqs.insert(parent_reqs.end(), remote_reqs.begin(), remote_reqs.end());
         remote_reqs = std::vector<Tp>();
         t.end_section("bulk_rma: send to parent");
@@ -368,9 +557,9 @@ std::vector<size_t> construct_suffix_tree(const suffix_array<char_t, index_t, tr
         edge_chars = bulk_rma(str_begin, str_end, global_indexes, send_counts, comm);
         t.end_section("bulk_rma: bulk_rma");
     } else {
-        mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+        const gen_dist& part = sa.distribution();
         // send those edges for which the parent lies on a remote processor
-        mxx::all2all_func(remote_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<0>(t));}, comm);
+        auto_all2all_func(remote_reqs, [&part](const std::tuple<size_t,size_t,size_t>& t) {return part.target_processor(std::get<0>(t));}, comm);
         parent_reqs.insert(parent_reqs.end(), remote_reqs.begin(), remote_reqs.end());
         t.end_section("all2all_func: send to parent");
 
@@ -431,6 +620,291 @@ std::vector<size_t> construct_suffix_tree(const suffix_array<char_t, index_t, tr
     return internal_nodes;
 }
 
+/// default number of local SA positions per chunk of the pipelined construction
+constexpr std::size_t st_pipeline_chunk_size = 1 << 16;
+
+namespace impl {
+
+// edge labels of the suffix tree of a single string: the edge from a parent
+// of string depth `lcp_val` to the node of suffix `suffix` is labeled by the
+// character at `suffix + lcp_val`, or by `$` (0) past the end of the string
+template <typename Iterator, typename char_t>
+struct st_string_labels {
+    Iterator str_begin;
+    size_t prefix;
+
+    // request key for the edge label
+    inline size_t key(size_t suffix, size_t lcp_val) const {
+        return suffix + lcp_val;
+    }
+    // string position of the label (the global size for the final `$`)
+    inline size_t pos(size_t key) const {
+        return key;
+    }
+    // the label, answered by the processor holding the string position
+    inline char_t label(size_t key) const {
+        return *(str_begin + (key - prefix));
+    }
+};
+
+// edge labels of the generalized suffix tree of a string set: each sequence
+// ends in its own terminator, such that an edge to a leaf is labeled only by
+// the terminator if its label starts at the end of the sequence. Since
+// sequences are non-empty, this is the case iff the parent's string depth is
+// non-zero and the label starts at the beginning of the next sequence. Keys
+// carry the former in their lowest bit.
+template <typename Iterator, typename char_t>
+struct gst_string_labels {
+    Iterator str_begin;
+    size_t prefix;
+    // whether each local string position starts a sequence
+    const std::vector<bool>& seq_start;
+
+    inline size_t key(size_t suffix, size_t lcp_val) const {
+        return 2*(suffix + lcp_val) + (lcp_val > 0 ? 1 : 0);
+    }
+    inline size_t pos(size_t key) const {
+        return key >> 1;
+    }
+    inline char_t label(size_t key) const {
+        size_t i = pos(key) - prefix;
+        if ((key & 1) && seq_start[i])
+            return char_t(0);
+        return *(str_begin + i);
+    }
+};
+
+// the pipelined construction, with edge labels given by `labels`. Edges
+// labeled by `0` are attached to cell 0 of their parent, which holds the
+// leftmost such child. If `num_terminals` is given, it is set to the number
+// of these children for each local internal node.
+template <typename Labels, typename char_t, typename index_t>
+std::vector<size_t> construct_suffix_tree_pipelined(const suffix_array<char_t, index_t, true>& sa, const st_parents<char_t, index_t>& parents,
+                                                    const Labels& labels, const mxx::comm& comm, std::size_t chunk_size,
+                                                    std::vector<size_t>* num_terminals) {
+    mxx::section_timer t(std::cerr, comm);
+    size_t local_size = parents.local_size;
+    size_t global_size = parents.global_size;
+    size_t prefix = parents.prefix;
+    MXX_ASSERT(chunk_size > 0);
+
+    // the string is distributed the same as the SA
+    const gen_dist& part = sa.distribution();
+    size_t num_chunks = mxx::allreduce((local_size + chunk_size - 1) / chunk_size, mxx::max<size_t>(), comm);
+
+    typedef std::tuple<size_t, size_t, size_t> Tp;
+    // the state of a chunk in flight
+    struct chunk_state {
+        // edges (parent, gidx, label key) at the parent's processor
+        std::vector<Tp> edges;
+        // edges labeled with the last `$`/`0` character
+        std::vector<Tp> dollar_edges;
+        std::vector<size_t> char_counts;
+        async_all2allv<Tp> to_parent;
+        async_all2allv<size_t> char_reqs;
+        async_all2allv<char_t> char_replies;
+    };
+    const int depth = 4;
+    const int tag = 2017;
+    chunk_state chunks[depth];
+
+    // one internal node for each LCP entry, each internal node is sigma cells
+    size_t sigma = sa.alpha.sigma() + 1;
+    std::vector<size_t> internal_nodes(sigma*local_size);
+    if (num_terminals != nullptr)
+        num_terminals->assign(local_size, 0);
+    auto add_terminal = [&](size_t parent, size_t gidx) {
+        size_t node_idx = (parent - prefix)*sigma;
+        if (internal_nodes[node_idx] == 0 || gidx < internal_nodes[node_idx])
+            internal_nodes[node_idx] = gidx;
+        if (num_terminals != nullptr)
+            ++(*num_terminals)[parent - prefix];
+    };
+
+    for (size_t c = 0; c < num_chunks + depth - 1; ++c) {
+        // 1) parents of chunk `c`
+        if (c < num_chunks) {
+            chunk_state& cs = chunks[c % depth];
+            size_t begin = std::min(c*chunk_size, local_size);
+            size_t end = std::min(begin + chunk_size, local_size);
+            std::vector<Tp> remote_edges;
+            auto add_edge = [&](size_t i, size_t gidx, size_t parent, size_t lcp_val) {
+                if (prefix <= parent && parent < prefix + local_size) {
+                    cs.edges.emplace_back(parent, gidx, labels.key(sa.local_SA[i], lcp_val));
+                } else {
+                    remote_edges.emplace_back(parent, gidx, labels.key(sa.local_SA[i], lcp_val));
+                }
+            };
+            parents.for_each_leaf(begin, end, add_edge);
+            parents.for_each_internal(begin, end, add_edge);
+            std::vector<size_t> send_counts = mxx::bucketing(remote_edges, [&part](const Tp& x) { return part.target_processor(std::get<0>(x)); }, comm.size());
+            cs.to_parent.start(std::move(remote_edges), send_counts, tag + 3*(c % depth), comm);
+        }
+        // 2) character requests of chunk `c-1`
+        if (c >= 1 && c - 1 < num_chunks) {
+            chunk_state& cs = chunks[(c-1) % depth];
+            std::vector<Tp> recv_edges = cs.to_parent.wait();
+            cs.edges.insert(cs.edges.end(), recv_edges.begin(), recv_edges.end());
+            recv_edges = std::vector<Tp>();
+            auto dollar_begin = std::partition(cs.edges.begin(), cs.edges.end(), [&](const Tp& x) { return labels.pos(std::get<2>(x)) < global_size; });
+            cs.dollar_edges.assign(dollar_begin, cs.edges.end());
+            cs.edges.erase(dollar_begin, cs.edges.end());
+            cs.char_counts = mxx::bucketing(cs.edges, [&](const Tp& x) { return part.target_processor(labels.pos(std::get<2>(x))); }, comm.size());
+            std::vector<size_t> keys(cs.edges.size());
+            for (size_t i = 0; i < cs.edges.size(); ++i) {
+                keys[i] = std::get<2>(cs.edges[i]);
+            }
+            cs.char_reqs.start(std::move(keys), cs.char_counts, tag + 3*((c-1) % depth) + 1, comm);
+        }
+        // 3) character replies of chunk `c-2`
+        if (c >= 2 && c - 2 < num_chunks) {
+            chunk_state& cs = chunks[(c-2) % depth];
+            std::vector<size_t> keys = cs.char_reqs.wait();
+            std::vector<char_t> chars(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i) {
+                chars[i] = labels.label(keys[i]);
+            }
+            cs.char_replies.start(std::move(chars), cs.char_reqs.recv_counts(), cs.char_counts, tag + 3*((c-2) % depth) + 2, comm);
+        }
+        // 4) internal nodes of chunk `c-3`
+        if (c >= 3 && c - 3 < num_chunks) {
+            chunk_state& cs = chunks[(c-3) % depth];
+            std::vector<char_t> edge_chars = cs.char_replies.wait();
+            for (size_t i = 0; i < cs.edges.size(); ++i) {
+                char_t x = edge_chars[i];
+                if (x == 0) {
+                    add_terminal(std::get<0>(cs.edges[i]), std::get<1>(cs.edges[i]));
+                } else {
+                    size_t node_idx = (std::get<0>(cs.edges[i]) - prefix)*sigma;
+                    uint16_t a = sa.alpha.encode(x);
+                    MXX_ASSERT(0 < a && a < sigma);
+                    internal_nodes[node_idx + a] = std::get<1>(cs.edges[i]);
+                }
+            }
+            for (size_t i = 0; i < cs.dollar_edges.size(); ++i) {
+                add_terminal(std::get<0>(cs.dollar_edges[i]), std::get<1>(cs.dollar_edges[i]));
+            }
+            cs.edges = std::vector<Tp>();
+            cs.dollar_edges = std::vector<Tp>();
+        }
+    }
+    t.end_section("pipelined edges and internal nodes");
+
+    return internal_nodes;
+}
+
+} // namespace impl
+
+/**
+ * @brief   Suffix tree construction, pipelined over chunks of the local
+ *          SA/LCP positions (collective call).
+ *
+ * Returns the same internal nodes as `construct_suffix_tree()`. After the
+ * ANSV, each chunk passes through four stages, with the non-blocking
+ * exchanges of up to three earlier chunks in flight while the parents of
+ * the next chunk are computed:
+ *  1) compute the parents and send the edges to the parent's processor
+ *  2) request the edge characters from the processors holding them
+ *  3) answer the character requests
+ *  4) insert the edges into the internal nodes
+ *
+ * Only the edges of the chunks in flight are buffered at any time. The
+ * SA may have any distribution (see `suffix_array::distribution()`).
+ */
+template <typename Iterator, typename char_t, typename index_t = std::size_t>
+std::vector<size_t> construct_suffix_tree_pipelined(const suffix_array<char_t, index_t, true>& sa, Iterator str_begin, Iterator str_end,
+                                                    const mxx::comm& comm, std::size_t chunk_size = st_pipeline_chunk_size) {
+    mxx::section_timer t(std::cerr, comm);
+    st_parents<char_t, index_t> parents(sa, comm);
+    MXX_ASSERT(static_cast<size_t>(std::distance(str_begin, str_end)) == parents.local_size);
+    t.end_section("ansv");
+    impl::st_string_labels<Iterator, char_t> labels = {str_begin, parents.prefix};
+    return impl::construct_suffix_tree_pipelined(sa, parents, labels, comm, chunk_size, nullptr);
+}
+
+/**
+ * @brief   Generalized suffix tree of a string set, in which each sequence
+ *          ends in its own terminator `$_d`, with `$_0 < $_1 < ...`.
+ *
+ * Internal nodes are stored as for `construct_suffix_tree()`, with `sigma+1`
+ * cells per LCP position. The terminators share cell 0, such that the
+ * alphabet is not widened: since the suffixes ending in terminators directly
+ * below a node are equal up to their terminator, they are ordered by their
+ * sequence and are consecutive in the GSA. Cell 0 holds the first of these
+ * leaves, and the others follow it. The terminator of a leaf is given by its
+ * document (see `document_array`).
+ */
+struct generalized_suffix_tree {
+    /// `sigma+1` cells for each local LCP position
+    std::vector<size_t> internal_nodes;
+    /// number of children of each local internal node which are leaves
+    /// labeled only by their terminator, starting at cell 0
+    std::vector<size_t> num_terminals;
+};
+
+/**
+ * @brief   Constructs the generalized suffix tree from the GSA and GLCP of
+ *          `suffix_array::construct_ss()` (collective call).
+ *
+ * Uses the same ANSV and pipelined edge construction as
+ * `construct_suffix_tree_pipelined()`. Edges whose label starts at the end
+ * of their sequence are detected by the processor holding the label's
+ * string position, so that no per-suffix sequence information is exchanged.
+ *
+ * @param sa        The GSA and GLCP of the string set.
+ * @param ss        The string set.
+ * @param str_begin Iterator to the local block of the concatenated string
+ *                  set, as given by `concat_stringset()`.
+ * @param str_end   End iterator of the local block.
+ */
+template <typename Iterator, typename char_t, typename index_t>
+generalized_suffix_tree construct_generalized_suffix_tree(const suffix_array<char_t, index_t, true>& sa, simple_dstringset& ss,
+                                                          Iterator str_begin, Iterator str_end, const mxx::comm& comm,
+                                                          std::size_t chunk_size = st_pipeline_chunk_size) {
+    mxx::section_timer t(std::cerr, comm);
+    st_parents<char_t, index_t> parents(sa, comm);
+    MXX_ASSERT(static_cast<size_t>(std::distance(str_begin, str_end)) == parents.local_size);
+    t.end_section("ansv");
+
+    // mark the sequence starts of the local block
+    dist_seqs ds = dist_seqs::from_dss(ss, comm);
+    MXX_ASSERT(ds.global_size == parents.global_size);
+    std::vector<bool> seq_start(parents.local_size, false);
+    for (size_t s : ds.prefix_sizes) {
+        MXX_ASSERT(parents.prefix <= s && s < parents.prefix + parents.local_size);
+        seq_start[s - parents.prefix] = true;
+    }
+    t.end_section("sequence starts");
+
+    generalized_suffix_tree gst;
+    impl::gst_string_labels<Iterator, char_t> labels = {str_begin, parents.prefix, seq_start};
+    gst.internal_nodes = impl::construct_suffix_tree_pipelined(sa, parents, labels, comm, chunk_size, &gst.num_terminals);
+    return gst;
+}
+
+/**
+ * @brief   Constructs the SA, LCP and suffix tree of the given string
+ *          (collective call).
+ *
+ * The tree is built by `construct_suffix_tree_pipelined()` directly from
+ * the state of the SA construction, whose sizes and distribution are reused.
+ * Unless `keep_isa` is set, the ISA (`sa.local_B`) is released before the
+ * tree is allocated, such that it doesn't add to the peak memory.
+ *
+ * @param sa_time   Set to the time (in ms) of the SA and LCP construction.
+ */
+template <typename Iterator, typename char_t, typename index_t>
+std::vector<size_t> construct_sa_lcp_st(suffix_array<char_t, index_t, true>& sa, Iterator str_begin, Iterator str_end, const mxx::comm& comm,
+                                        double& sa_time, bool keep_isa = false, std::size_t chunk_size = st_pipeline_chunk_size) {
+    mxx::timer t;
+    sa.construct(str_begin, str_end);
+    sa_time = t.elapsed();
+    if (!keep_isa) {
+        sa.local_B = std::vector<index_t>();
+    }
+    return construct_suffix_tree_pipelined(sa, str_begin, str_end, comm, chunk_size);
+}
+
 struct edge {
     size_t parent;
     size_t gidx;
@@ -495,9 +969,9 @@ std::vector<size_t> construct_suffix_tree_edges(const suffix_array<char_t, index
     //typedef typename std::iterator_traits<InputIterator>::value_type CharT;
     std::vector<char_t> edge_chars;
 
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+    const gen_dist& part = sa.distribution();
     // send those edges for which the parent lies on a remote processor
-    mxx::all2all_func(remote_edges, [&part](const std::pair<edge,size_t>& e) {return part.target_processor(e.first.parent);}, comm);
+    auto_all2all_func(remote_edges, [&part](const std::pair<edge,size_t>& e) {return part.target_processor(e.first.parent);}, comm);
     for (auto& p : remote_edges) {
         if (p.second < global_size) {
             edges.emplace_back(p.first);
@@ -687,9 +1161,9 @@ std::vector<size_t> construct_suffix_tree_sm(const suffix_array<char_t, index_t,
 
     /* process remote edges */
 
-    mxx::partition::block_decomposition_buffered<size_t> part(global_size, comm.size(), comm.rank());
+    const gen_dist& part = sa.distribution();
     // send those edges for which the parent lies on a remote processor
-    mxx::all2all_func(remote_edges, [&part](const std::pair<edge,size_t>& e) {return part.target_processor(e.first.parent);}, comm);
+    auto_all2all_func(remote_edges, [&part](const std::pair<edge,size_t>& e) {return part.target_processor(e.first.parent);}, comm);
     for (auto& p : remote_edges) {
         if (p.second < global_size) {
             size_t local_nodeidx = sigma*(p.first.parent-prefix);
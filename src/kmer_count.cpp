@@ -0,0 +1,135 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file    kmer_count.cpp
+ * @brief   Distributed k-mer counting and batched k-mer count queries, using
+ *          the initial k-mer sorting of the suffix array construction.
+ */
+
+// include MPI
+#include <mpi.h>
+
+// C++ includes
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// using TCLAP for command line parsing
+#include <tclap/CmdLine.h>
+
+// distributed k-mer counting
+#include <kmer_count.hpp>
+#include <alphabet.hpp>
+
+// node hierarchy
+#include <hier_comm.hpp>
+
+// parallel file block decompose
+#include <mxx/env.hpp>
+#include <mxx/comm.hpp>
+#include <mxx/file.hpp>
+#include <mxx/utils.hpp>
+// Timer
+#include <mxx/timer.hpp>
+
+typedef uint64_t index_t;
+
+int main(int argc, char *argv[]) {
+    // set up MPI
+    mxx::env e(argc, argv);
+    mxx::env::set_exception_on_error();
+    mxx::comm comm = mxx::comm();
+    // discover the node hierarchy once for all hierarchy aware algorithms
+    hier_comm::get(comm).print_node_distribution();
+
+    try {
+    // define commandline usage
+    TCLAP::CmdLine cmd("Parallel distributed k-mer counting.");
+    TCLAP::ValueArg<std::string> fileArg("f", "file", "Input filename.", true, "", "filename");
+    TCLAP::ValueArg<std::size_t> randArg("r", "random", "Random input size", true, 0, "size");
+    cmd.xorAdd(fileArg, randArg);
+    TCLAP::ValueArg<int> seedArg("s", "seed", "Sets the seed for the ranom input generation", false, 0, "int");
+    cmd.add(seedArg);
+    TCLAP::ValueArg<unsigned int> kArg("k", "kmer-size", "The k-mer size.", true, 0, "k");
+    cmd.add(kArg);
+    TCLAP::ValueArg<std::string> outArg("o", "output", "Output prefix for the (k-mer, count) pairs. Each processor writes to `<prefix>.<rank>`.", false, "", "prefix");
+    cmd.add(outArg);
+    TCLAP::ValueArg<std::string> queryArg("q", "queries", "File of k-mers (one per line) to query the counts for.", false, "", "filename");
+    cmd.add(queryArg);
+    cmd.parse(argc, argv);
+
+    // read input file or generate input on master processor
+    // block decompose input file
+    std::string local_str;
+    if (fileArg.getValue() != "") {
+        local_str = mxx::file_block_decompose(fileArg.getValue().c_str(), MPI_COMM_WORLD);
+    } else {
+        local_str = rand_dna(randArg.getValue(), seedArg.getValue(), comm);
+    }
+
+    // sort and count all k-mers
+    mxx::timer t;
+    double start = t.elapsed();
+    kmer_index<char, index_t> idx(comm);
+    idx.construct(local_str.begin(), local_str.end(), kArg.getValue());
+    double kmer_time = t.elapsed() - start;
+    std::size_t distinct = idx.num_distinct();
+    if (comm.rank() == 0) {
+        std::cerr << "k-mer counting time: " << kmer_time << " ms" << std::endl;
+        std::cerr << "distinct " << kArg.getValue() << "-mers: " << distinct << std::endl;
+    }
+
+    // write (k-mer, count) pairs, sorted lexicographically accross processors
+    if (outArg.getValue() != "") {
+        std::vector<std::pair<index_t, index_t> > counts = idx.local_counts();
+        std::vector<std::string> kmers = idx.local_kmers();
+        std::ofstream out(outArg.getValue() + "." + std::to_string(comm.rank()));
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            out << kmers[i] << "\t" << counts[i].second << "\n";
+        }
+    }
+
+    // answer the batch of queries (read on the master processor)
+    if (queryArg.getValue() != "") {
+        std::vector<std::string> queries;
+        if (comm.rank() == 0) {
+            std::ifstream in(queryArg.getValue());
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty())
+                    queries.push_back(line);
+            }
+        }
+        start = t.elapsed();
+        std::vector<index_t> counts = idx.counts(queries);
+        double query_time = t.elapsed() - start;
+        if (comm.rank() == 0) {
+            for (std::size_t i = 0; i < queries.size(); ++i) {
+                std::cout << queries[i] << "\t" << counts[i] << std::endl;
+            }
+            std::cerr << "query time: " << query_time << " ms for " << queries.size() << " queries" << std::endl;
+        }
+    }
+
+    // catch any TCLAP exception
+    } catch (TCLAP::ArgException& e) {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
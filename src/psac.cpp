@@ -41,6 +41,21 @@
 #include <suffix_tree.hpp>
 #include <check_suffix_tree.hpp>
 
+// query server
+#include <sampled_index.hpp>
+#include <query_server.hpp>
+#include <matching_stats.hpp>
+
+// substring statistics
+#include <sa_stats.hpp>
+
+// compressed suffix array export
+#include <compressed_sa.hpp>
+#include <r_index.hpp>
+
+// node hierarchy
+#include <hier_comm.hpp>
+
 // parallel file block decompose
 #include <mxx/env.hpp>
 #include <mxx/comm.hpp>
@@ -53,12 +68,114 @@
 // size!)
 typedef uint64_t index_t;
 
+// keeps the constructed suffix array resident and answers pattern queries
+template <typename idx_t>
+void serve(const std::vector<idx_t>& local_SA, const std::string& local_str, const std::string& in_path,
+           std::size_t sample_rate, std::size_t batch_size, std::size_t max_occ, const mxx::comm& comm) {
+    mxx::timer t;
+    sampled_index<char, idx_t> idx(local_SA, local_str.begin(), local_str.end(), sample_rate, 16, comm);
+    if (comm.rank() == 0)
+        std::cerr << "sampled index time: " << t.elapsed() << " ms" << std::endl;
+    serve_queries(local_SA, local_str.begin(), local_str.end(), idx, in_path, std::cout, batch_size, max_occ, comm);
+}
+
+// computes the maximal exact matches of the queries in the given file (one
+// query per line) in batches and reports the throughput in query bases/s
+template <typename idx_t>
+void query_mems(const std::vector<idx_t>& local_SA, const std::string& local_str, const std::string& query_path,
+                std::size_t sample_rate, std::size_t batch_size, std::size_t min_len, const mxx::comm& comm) {
+    sampled_index<char, idx_t> idx(local_SA, local_str.begin(), local_str.end(), sample_rate, 16, comm);
+    std::ifstream in;
+    if (comm.rank() == 0)
+        in.open(query_path);
+    std::size_t num_queries = 0;
+    std::size_t num_bases = 0;
+    std::size_t num_mems = 0;
+    double total_time = 0.0;
+    while (true) {
+        // read the next batch on the master and broadcast it
+        std::vector<char> batch;
+        if (comm.rank() == 0) {
+            std::string line;
+            for (std::size_t i = 0; i < batch_size && std::getline(in, line); ++i) {
+                batch.insert(batch.end(), line.begin(), line.end());
+                batch.push_back('\n');
+            }
+        }
+        mxx::bcast(batch, 0, comm);
+        if (batch.empty())
+            break;
+        std::vector<std::string> queries;
+        for (std::size_t pos = 0; pos < batch.size();) {
+            std::size_t len = std::find(batch.begin() + pos, batch.end(), '\n') - batch.begin() - pos;
+            queries.emplace_back(batch.begin() + pos, batch.begin() + pos + len);
+            pos += len + 1;
+        }
+        mxx::partition::block_decomposition_buffered<std::size_t> qpart(queries.size(), comm.size(), comm.rank());
+        std::size_t qbegin = qpart.excl_prefix_size();
+        std::vector<std::string> local_queries(queries.begin() + qbegin, queries.begin() + qbegin + qpart.local_size());
+
+        mxx::timer t;
+        matching_statistics<idx_t> ms = bulk_matching_statistics(local_SA, local_str.begin(), local_str.end(), idx, local_queries, comm);
+        std::vector<mem_hit> mems = find_mems(ms, min_len);
+        total_time += t.elapsed();
+
+        // report MEMs on master as: <query>\t<query pos>\t<string pos>\t<length>
+        std::vector<std::size_t> local_hits;
+        for (const mem_hit& h : mems) {
+            local_hits.push_back(num_queries + qbegin + h.query);
+            local_hits.push_back(h.qpos);
+            local_hits.push_back(h.tpos);
+            local_hits.push_back(h.len);
+        }
+        std::vector<std::size_t> hits = mxx::gatherv(local_hits, 0, comm);
+        if (comm.rank() == 0) {
+            for (std::size_t i = 0; i < hits.size(); i += 4)
+                std::cout << hits[i] << "\t" << hits[i+1] << "\t" << hits[i+2] << "\t" << hits[i+3] << "\n";
+            std::cout.flush();
+        }
+        num_queries += queries.size();
+        num_bases += batch.size() - queries.size();
+        num_mems += hits.size() / 4;
+    }
+    if (comm.rank() == 0) {
+        std::cerr << "MEMs: " << num_mems << " in " << num_queries << " queries, " << num_bases << " bases in "
+                  << total_time << " ms (" << (total_time > 0 ? num_bases / total_time * 1000.0 : 0.0) << " bases/s)" << std::endl;
+    }
+}
+
+// prints the distinct substring, k-mer and LCP statistics
+template <typename idx_t>
+void print_sa_statistics(const suffix_array<char, idx_t, true>& sa, std::size_t max_k, const mxx::comm& comm) {
+    sa_statistics stats = compute_sa_statistics(sa, max_k, comm);
+    if (comm.rank() == 0) {
+        std::cout << "distinct substrings: " << stats.distinct_substrings << std::endl;
+        std::cout << "longest repeat: " << stats.max_lcp << ", average LCP: " << stats.avg_lcp() << std::endl;
+        stats.print_table(std::cout);
+    }
+}
+
+// writes the compressed suffix array and/or the r-index if their prefix is given
+template <typename idx_t, bool lcp>
+void export_indexes(const suffix_array<char, idx_t, lcp>& sa, const std::string& local_str, const std::string& csa_prefix,
+                    std::size_t csa_sample_rate, const std::string& rindex_prefix, const mxx::comm& comm) {
+    if (csa_prefix != "") {
+        write_compressed_sa(csa_prefix, sa, csa_sample_rate, comm);
+    }
+    if (rindex_prefix != "") {
+        std::size_t r = write_r_index(rindex_prefix, sa, local_str.begin(), local_str.end(), comm);
+        if (comm.rank() == 0)
+            std::cerr << "BWT runs: " << r << " (n/r = " << (double)sa.global_size() / r << ")" << std::endl;
+    }
+}
+
 int main(int argc, char *argv[]) {
     // set up MPI
     mxx::env e(argc, argv);
     mxx::env::set_exception_on_error();
     mxx::comm comm = mxx::comm();
-    mxx::print_node_distribution(comm);
+    // discover the node hierarchy once for all hierarchy aware algorithms
+    hier_comm::get(comm).print_node_distribution();
 
     try {
     // define commandline usage
@@ -72,18 +189,47 @@ int main(int argc, char *argv[]) {
     cmd.add(lcpArg);
     TCLAP::SwitchArg  stArg("t", "tree", "Construct the Suffix Tree structute.", false);
     cmd.add(stArg);
+    TCLAP::SwitchArg  intervalArg("i", "interval-tree", "Construct only the LCP-interval tree (parent pointers and SA-intervals) instead of the full Suffix Tree.", false);
+    cmd.add(intervalArg);
     TCLAP::SwitchArg  checkArg("c", "check", "Check correctness of SA (and LCP).", false);
     cmd.add(checkArg);
+    TCLAP::ValueArg<std::string> serveArg("q", "serve", "After construction, keep serving `count`/`locate` queries read from the given named pipe (or `-` for stdin).", false, "", "pipe");
+    cmd.add(serveArg);
+    TCLAP::ValueArg<std::size_t> batchArg("b", "batch-size", "Maximum number of queries per batch in server mode.", false, 1024, "size");
+    cmd.add(batchArg);
+    TCLAP::ValueArg<std::size_t> sampleArg("", "sample-rate", "Sampling rate of the top-level index in server mode.", false, 64, "rate");
+    cmd.add(sampleArg);
+    TCLAP::ValueArg<std::size_t> maxOccArg("", "max-occ", "Maximum number of positions reported per `locate` query.", false, 1000, "num");
+    cmd.add(maxOccArg);
+    TCLAP::ValueArg<std::string> checkpointArg("", "checkpoint", "Checkpoint the SA (and LCP) construction after every iteration to files with the given prefix, and resume from an existing checkpoint.", false, "", "prefix");
+    cmd.add(checkpointArg);
+    TCLAP::ValueArg<std::size_t> statsArg("", "stats", "After constructing the SA and LCP, print the distinct substring, k-mer and LCP statistics for all k up to the given length.", false, 0, "k");
+    cmd.add(statsArg);
+    TCLAP::ValueArg<std::string> memsArg("", "mems", "After construction, report the maximal exact matches of the queries in the given file (one per line) against the input.", false, "", "filename");
+    cmd.add(memsArg);
+    TCLAP::ValueArg<std::size_t> minMemArg("", "min-mem", "Minimum length of the reported maximal exact matches.", false, 20, "length");
+    cmd.add(minMemArg);
+    TCLAP::ValueArg<std::string> csaArg("", "csa", "After construction, write the compressed suffix array (Psi with sampled SA and ISA) to files with the given prefix.", false, "", "prefix");
+    cmd.add(csaArg);
+    TCLAP::ValueArg<std::size_t> csaSampleArg("", "csa-sample-rate", "Sampling rate of the SA and ISA values in the compressed suffix array.", false, 32, "rate");
+    cmd.add(csaSampleArg);
+    TCLAP::ValueArg<std::string> rindexArg("", "rindex", "After construction, write the r-index (run-length BWT with phi samples) to files with the given prefix.", false, "", "prefix");
+    cmd.add(rindexArg);
     cmd.parse(argc, argv);
 
+    // checkpoints are only written by the prefix doubling of the SA (and LCP)
+    if (checkpointArg.getValue() != "" && (stArg.getValue() || intervalArg.getValue()))
+        throw TCLAP::ArgException("only supported for the SA (and LCP) construction, not with -t or -i", "checkpoint");
+    if (statsArg.getValue() > 0 && !(lcpArg.getValue() || stArg.getValue() || intervalArg.getValue()))
+        throw TCLAP::ArgException("requires the LCP (-l, -t or -i)", "stats");
+
     // read input file or generate input on master processor
     // block decompose input file
     std::string local_str;
     if (fileArg.getValue() != "") {
         local_str = mxx::file_block_decompose(fileArg.getValue().c_str(), MPI_COMM_WORLD);
     } else {
-        // TODO proper distributed random!
-        local_str = rand_dna(randArg.getValue()/comm.size(), seedArg.getValue() * comm.rank());
+        local_str = rand_dna(randArg.getValue(), seedArg.getValue(), comm);
     }
 
     // TODO differentiate between index types
@@ -91,14 +237,38 @@ int main(int argc, char *argv[]) {
     // run our distributed suffix array construction
     mxx::timer t;
     double start = t.elapsed();
-    if (stArg.getValue()) {
-        // construct SA+LCP+ST
+    if (intervalArg.getValue()) {
+        // construct SA+LCP+LCP-interval tree
         suffix_array<char, size_t, true> sa(comm);
         sa.construct(local_str.begin(), local_str.end());
         double sa_time = t.elapsed() - start;
-        // build ST
-        std::vector<size_t> local_st_nodes = construct_suffix_tree(sa, local_str.begin(), local_str.end(), comm);
-        double st_time = t.elapsed() - sa_time;
+        lcp_interval_tree tree = construct_lcp_interval_tree(sa, comm);
+        double tree_time = t.elapsed() - start - sa_time;
+        if (comm.rank() == 0) {
+            std::cerr << "SA time: " << sa_time << " ms" << std::endl;
+            std::cerr << "LCP-interval tree time: " << tree_time << " ms" << std::endl;
+            std::cerr << "Total  : " << sa_time+tree_time << " ms" << std::endl;
+        }
+        if (checkArg.getValue()) {
+            gl_check_correct(sa, local_str.begin(), local_str.end(), comm);
+        }
+        if (statsArg.getValue() > 0) {
+            print_sa_statistics(sa, statsArg.getValue(), comm);
+        }
+        export_indexes(sa, local_str, csaArg.getValue(), csaSampleArg.getValue(), rindexArg.getValue(), comm);
+        if (memsArg.getValue() != "") {
+            query_mems(sa.local_SA, local_str, memsArg.getValue(), sampleArg.getValue(), batchArg.getValue(), minMemArg.getValue(), comm);
+        }
+        if (serveArg.getValue() != "") {
+            serve(sa.local_SA, local_str, serveArg.getValue(), sampleArg.getValue(), batchArg.getValue(), maxOccArg.getValue(), comm);
+        }
+    } else if (stArg.getValue()) {
+        // construct SA+LCP+ST, the ISA is only kept for checking and the CSA
+        suffix_array<char, size_t, true> sa(comm);
+        double sa_time;
+        bool keep_isa = checkArg.getValue() || csaArg.getValue() != "";
+        std::vector<size_t> local_st_nodes = construct_sa_lcp_st(sa, local_str.begin(), local_str.end(), comm, sa_time, keep_isa);
+        double st_time = t.elapsed() - start - sa_time;
         if (comm.rank() == 0) {
             std::cerr << "SA time: " << sa_time << " ms" << std::endl;
             std::cerr << "ST time: " << st_time << " ms" << std::endl;
@@ -107,29 +277,74 @@ int main(int argc, char *argv[]) {
         if (checkArg.getValue())  {
             gl_check_suffix_tree(local_str, sa, local_st_nodes, comm);
         }
+        if (statsArg.getValue() > 0) {
+            print_sa_statistics(sa, statsArg.getValue(), comm);
+        }
+        export_indexes(sa, local_str, csaArg.getValue(), csaSampleArg.getValue(), rindexArg.getValue(), comm);
+        if (memsArg.getValue() != "") {
+            query_mems(sa.local_SA, local_str, memsArg.getValue(), sampleArg.getValue(), batchArg.getValue(), minMemArg.getValue(), comm);
+        }
+        if (serveArg.getValue() != "") {
+            serve(sa.local_SA, local_str, serveArg.getValue(), sampleArg.getValue(), batchArg.getValue(), maxOccArg.getValue(), comm);
+        }
 
     } else if (lcpArg.getValue()) {
         // construct SA+LCP
         suffix_array<char, index_t, true> sa(comm);
         // TODO choose construction method
-        sa.construct(local_str.begin(), local_str.end(), true);
+        if (checkpointArg.getValue() != "")
+            sa.construct_resilient(local_str.begin(), local_str.end(), checkpointArg.getValue(), true);
+        else
+            sa.construct(local_str.begin(), local_str.end(), true);
         double end = t.elapsed() - start;
         if (comm.rank() == 0)
             std::cerr << "PSAC time: " << end << " ms" << std::endl;
-        if (checkArg.getValue()) {
+        if (sa.lost_processors > 0) {
+            // the input is no longer available on all processors
+            if (comm.rank() == 0)
+                std::cerr << "Finished after losing " << sa.lost_processors << " processors" << std::endl;
+        } else if (checkArg.getValue()) {
             gl_check_correct(sa, local_str.begin(), local_str.end(), comm);
         }
+        if (sa.lost_processors == 0 && statsArg.getValue() > 0) {
+            print_sa_statistics(sa, statsArg.getValue(), comm);
+        }
+        if (sa.lost_processors == 0) {
+            export_indexes(sa, local_str, csaArg.getValue(), csaSampleArg.getValue(), rindexArg.getValue(), comm);
+        }
+        if (sa.lost_processors == 0 && memsArg.getValue() != "") {
+            query_mems(sa.local_SA, local_str, memsArg.getValue(), sampleArg.getValue(), batchArg.getValue(), minMemArg.getValue(), comm);
+        }
+        if (sa.lost_processors == 0 && serveArg.getValue() != "") {
+            serve(sa.local_SA, local_str, serveArg.getValue(), sampleArg.getValue(), batchArg.getValue(), maxOccArg.getValue(), comm);
+        }
     } else {
         // construct SA
         suffix_array<char, index_t, false> sa(comm);
         // TODO choose construction method
-        sa.construct_arr<2>(local_str.begin(), local_str.end(), true);
+        if (checkpointArg.getValue() != "")
+            sa.construct_resilient(local_str.begin(), local_str.end(), checkpointArg.getValue(), true);
+        else
+            sa.construct_arr<2>(local_str.begin(), local_str.end(), true);
         double end = t.elapsed() - start;
         if (comm.rank() == 0)
             std::cerr << "PSAC time: " << end << " ms" << std::endl;
-        if (checkArg.getValue()) {
+        if (sa.lost_processors > 0) {
+            // the input is no longer available on all processors
+            if (comm.rank() == 0)
+                std::cerr << "Finished after losing " << sa.lost_processors << " processors" << std::endl;
+        } else if (checkArg.getValue()) {
             gl_check_correct(sa, local_str.begin(), local_str.end(), comm);
         }
+        if (sa.lost_processors == 0) {
+            export_indexes(sa, local_str, csaArg.getValue(), csaSampleArg.getValue(), rindexArg.getValue(), comm);
+        }
+        if (sa.lost_processors == 0 && memsArg.getValue() != "") {
+            query_mems(sa.local_SA, local_str, memsArg.getValue(), sampleArg.getValue(), batchArg.getValue(), minMemArg.getValue(), comm);
+        }
+        if (sa.lost_processors == 0 && serveArg.getValue() != "") {
+            serve(sa.local_SA, local_str, serveArg.getValue(), sampleArg.getValue(), batchArg.getValue(), maxOccArg.getValue(), comm);
+        }
     }
 
     // catch any TCLAP exception
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the all2all algorithm selection.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <all2all.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+// creates messages of the given sizes, tagged with source and destination
+std::vector<std::pair<int, int> > create_msgs(const std::vector<size_t>& send_counts, const mxx::comm& c) {
+    std::vector<std::pair<int, int> > msgs;
+    for (int i = 0; i < c.size(); ++i) {
+        for (size_t j = 0; j < send_counts[i]; ++j)
+            msgs.emplace_back(c.rank(), i);
+    }
+    return msgs;
+}
+
+// runs `auto_all2allv` and compares against `mxx::all2allv`, returns the chosen algorithm
+int check_auto_all2allv(const std::vector<size_t>& send_counts, const mxx::comm& c) {
+    std::vector<std::pair<int, int> > msgs = create_msgs(send_counts, c);
+    std::vector<size_t> recv_counts = mxx::all2all(send_counts, c);
+    std::vector<std::pair<int, int> > expected = mxx::all2allv(msgs, send_counts, recv_counts, c);
+
+    all2all_counters before = all2all_stats();
+    std::vector<std::pair<int, int> > result = auto_all2allv(msgs, send_counts, recv_counts, c);
+    EXPECT_EQ(expected, result);
+    all2all_counters after = all2all_stats();
+    int algo = -1;
+    for (int a = 0; a < 4; ++a) {
+        if (after.calls[a] != before.calls[a])
+            algo = a;
+    }
+    return algo;
+}
+
+TEST(PsacAll2all, Bruck) {
+    mxx::comm c;
+    for (size_t m : {0, 1, 3}) {
+        std::vector<std::pair<int, int> > msgs;
+        for (int i = 0; i < c.size(); ++i) {
+            for (size_t j = 0; j < m; ++j)
+                msgs.emplace_back(c.rank(), i);
+        }
+        std::vector<std::pair<int, int> > result(msgs.size());
+        bruck_all2all(msgs.data(), m, result.data(), c);
+        EXPECT_EQ(mxx::all2all(msgs, c), result);
+    }
+}
+
+TEST(PsacAll2all, SparseNeighbors) {
+    mxx::comm c;
+    // shift pattern: messages only to the right neighbor
+    std::vector<size_t> send_counts(c.size(), 0);
+    if (c.rank() + 1 < c.size())
+        send_counts[c.rank()+1] = 1000;
+    EXPECT_EQ(all2all_sparse, check_auto_all2allv(send_counts, c));
+}
+
+TEST(PsacAll2all, DenseTiny) {
+    mxx::comm c;
+    std::vector<size_t> send_counts(c.size(), 2);
+    int algo = check_auto_all2allv(send_counts, c);
+    if (c.size() >= 3) {
+        EXPECT_EQ(all2all_bruck, algo);
+    }
+}
+
+TEST(PsacAll2all, DenseLarge) {
+    mxx::comm c;
+    std::srand(7 + c.rank());
+    std::vector<size_t> send_counts(c.size());
+    for (int i = 0; i < c.size(); ++i)
+        send_counts[i] = 100 + std::rand() % 100;
+    int algo = check_auto_all2allv(send_counts, c);
+    if (c.size() >= 3) {
+        EXPECT_TRUE(algo == all2all_dense || algo == all2all_hierarchical);
+    }
+}
+
+TEST(PsacAll2all, Displacements) {
+    mxx::comm c;
+    // messages with gaps in the send and receive buffers
+    std::vector<size_t> send_counts(c.size());
+    for (int i = 0; i < c.size(); ++i)
+        send_counts[i] = (c.rank() + i) % 3;
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, c);
+    std::vector<size_t> send_displs(c.size());
+    std::vector<size_t> recv_displs(c.size());
+    std::vector<int> msgs;
+    for (int i = 0; i < c.size(); ++i) {
+        send_displs[i] = msgs.size() + 1;
+        msgs.push_back(-1);
+        for (size_t j = 0; j < send_counts[i]; ++j)
+            msgs.push_back(c.rank());
+        recv_displs[i] = (i == 0) ? 2 : recv_displs[i-1] + recv_counts[i-1] + 2;
+    }
+    std::vector<int> result(recv_displs.back() + recv_counts.back(), -1);
+    auto_all2allv(msgs.data(), send_counts, send_displs, result.data(), recv_counts, recv_displs, c);
+    for (int i = 0; i < c.size(); ++i) {
+        ASSERT_EQ((size_t)(c.rank() + i) % 3, recv_counts[i]);
+        for (size_t j = 0; j < recv_counts[i]; ++j)
+            EXPECT_EQ(i, result[recv_displs[i] + j]);
+        EXPECT_EQ(-1, result[recv_displs[i] - 1]);
+    }
+}
+
+TEST(PsacAll2all, Async) {
+    mxx::comm c;
+    std::srand(11 + c.rank());
+    // two exchanges in flight at the same time
+    std::vector<size_t> counts1(c.size());
+    std::vector<size_t> counts2(c.size());
+    for (int i = 0; i < c.size(); ++i) {
+        counts1[i] = std::rand() % 50;
+        counts2[i] = (c.rank() + i) % 2;
+    }
+    std::vector<std::pair<int, int> > msgs1 = create_msgs(counts1, c);
+    std::vector<std::pair<int, int> > msgs2 = create_msgs(counts2, c);
+    std::vector<std::pair<int, int> > expected1 = mxx::all2allv(msgs1, counts1, c);
+    std::vector<std::pair<int, int> > expected2 = mxx::all2allv(msgs2, counts2, c);
+
+    async_all2allv<std::pair<int, int> > a1;
+    async_all2allv<std::pair<int, int> > a2;
+    EXPECT_FALSE(a1.active());
+    a1.start(std::move(msgs1), counts1, 2017, c);
+    a2.start(std::move(msgs2), counts2, mxx::all2all(counts2, c), 2018, c);
+    EXPECT_TRUE(a1.active());
+    EXPECT_EQ(expected2, a2.wait());
+    EXPECT_EQ(expected1, a1.wait());
+    EXPECT_FALSE(a1.active());
+    EXPECT_EQ(mxx::all2all(counts1, c), a1.recv_counts());
+
+    // restart after completion
+    std::vector<std::pair<int, int> > msgs3 = create_msgs(counts1, c);
+    a1.start(std::move(msgs3), counts1, 2017, c);
+    EXPECT_EQ(expected1, a1.wait());
+}
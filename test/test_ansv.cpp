@@ -325,6 +325,20 @@ PAR_GTEST_ANSV_RAND(my_ansv);
 PAR_GTEST_ANSV_RAND_PERM(my_ansv_minpair);
 PAR_GTEST_ANSV_RAND_PERM(hh_ansv);
 
+// few distinct values: chains of equal elements span several processors
+TEST(PsacANSV, ParallelANSVrand_fewvalues) {
+    mxx::comm c;
+    for (size_t n : {60, 1000}) {
+        std::vector<size_t> in;
+        if (c.rank() == 0) {
+            in.resize(n);
+            std::srand(293);
+            std::generate(in.begin(), in.end(), [](){return std::rand() % 4;});
+        }
+        PAR_TEST_GANSV_ALL(size_t, in, c, gansv_impl);
+    }
+}
+
 TEST(PsacANSV, ParallelANSVrand_special) {
     mxx::comm c;
     for (size_t n : {137}) { // {13, 137, 1000, 26666}) {
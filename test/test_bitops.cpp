@@ -22,6 +22,7 @@
 
 #include <bitops.hpp>
 #include <cstdlib>
+#include <vector>
 
 TEST(PsacBitops, TrailingZeros) {
     ASSERT_EQ(3u, trailing_zeros(0x8));
@@ -57,6 +58,12 @@ TEST(PsacBitops, LeadingZeros) {
     ASSERT_EQ(0u, leading_zeros(0xbeefbeefbeefadadull));
     ASSERT_EQ(32u, leading_zeros(0x0));
     ASSERT_EQ(8*sizeof(size_t), leading_zeros((size_t)0x0));
+    ASSERT_EQ(3u, leading_zeros(static_cast<uint8_t>(0x10)));
+    ASSERT_EQ(8u, leading_zeros(static_cast<uint8_t>(0x0)));
+    ASSERT_EQ(0u, leading_zeros(static_cast<int8_t>(-1)));
+    ASSERT_EQ(7u, leading_zeros(static_cast<uint16_t>(0x01ff)));
+    ASSERT_EQ(16u, leading_zeros(static_cast<uint16_t>(0x0)));
+    ASSERT_EQ(0u, leading_zeros(-1));
 }
 
 TEST(PsacBitops, ReferenceLeadingZeros) {
@@ -82,6 +89,43 @@ TEST(PsacBitops, LCPbitwise) {
     ASSERT_EQ(0u,lcp_bitwise(0x8eefbeefbeefadadull, 0xbeefbeefbeefadadull, 21, 3));
 }
 
+TEST(PsacBitops, LCPbitwiseBatch) {
+    const std::size_t n = 1000;
+    for (unsigned int bpc = 1; bpc <= 12; ++bpc) {
+        unsigned int k = 64 / bpc;
+        std::vector<uint64_t> x(n);
+        std::vector<uint64_t> y(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            x[i] = static_cast<uint64_t>(rand()) << 32 | static_cast<uint64_t>(rand());
+            if (k*bpc < 64)
+                x[i] &= (static_cast<uint64_t>(1) << k*bpc) - 1;
+            // flip a random bit, or none
+            unsigned int flip = rand() % (k*bpc + 1);
+            y[i] = (flip == k*bpc) ? x[i] : x[i] ^ (static_cast<uint64_t>(1) << flip);
+        }
+        std::vector<unsigned int> lcp(n);
+        for (int isa = bitops_isa_generic; isa <= bitops_isa(); ++isa) {
+            lcp_bitwise_batch(isa, &x[0], &y[0], n, k, bpc, &lcp[0]);
+            for (std::size_t i = 0; i < n; ++i) {
+                ASSERT_EQ(lcp_bitwise(x[i], y[i], k, bpc), lcp[i]) << "isa: " << bitops_isa_name(isa);
+            }
+        }
+
+        // 32 bit k-mers
+        unsigned int k32 = 32 / bpc;
+        std::vector<uint32_t> x32(n);
+        std::vector<uint32_t> y32(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            x32[i] = static_cast<uint32_t>(x[i]) & ((k32*bpc < 32) ? ((1u << k32*bpc) - 1) : ~0u);
+            y32[i] = (i % 3 == 0) ? x32[i] : x32[i] ^ (1u << (rand() % (k32*bpc)));
+        }
+        lcp_bitwise_batch(&x32[0], &y32[0], n, k32, bpc, &lcp[0]);
+        for (std::size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(lcp_bitwise(x32[i], y32[i], k32, bpc), lcp[i]);
+        }
+    }
+}
+
 // ceillog and floorlog functions (similar to leading zeros!!)
 TEST(PsacBitops, CeilFloorlog2) {
     ASSERT_EQ(9u, floorlog2(0x00000321u));
@@ -114,3 +158,33 @@ TEST(PsacBitops, CeilFloorlog2) {
     ASSERT_EQ(63u, floorlog2(0xffffffffffffffffull));
     ASSERT_EQ(64u, ceillog2(0xffffffffffffffffull));
 }
+
+TEST(PsacBitops, InvariantDivisor) {
+    std::vector<uint64_t> divisors = {1, 2, 3, 5, 7, 10, 641, 1ull << 20, (1ull << 20) + 1,
+                                      6700417, 1ull << 32, (1ull << 32) - 1, (1ull << 63) - 1,
+                                      1ull << 63, (1ull << 63) + 1, 0xffffffffffffffffull};
+    std::vector<uint64_t> values = {0, 1, 2, 3, 63, 64, 641, 6700416, 6700417,
+                                    (1ull << 32) - 1, 1ull << 32, 0x123456789abcdefull,
+                                    (1ull << 63) - 1, 1ull << 63, 0xfffffffffffffffeull,
+                                    0xffffffffffffffffull};
+    std::srand(13);
+    for (int i = 0; i < 100; ++i) {
+        uint64_t r = (static_cast<uint64_t>(std::rand()) << 33) ^ (static_cast<uint64_t>(std::rand()) << 11) ^ std::rand();
+        divisors.push_back(r >> (i % 64) | 1);
+        values.push_back(r);
+    }
+    for (uint64_t d : divisors) {
+        invariant_divisor div(d);
+        EXPECT_EQ(d, div.divisor());
+        for (uint64_t x : values) {
+            EXPECT_EQ(x / d, div.divide(x)) << "x=" << x << ", d=" << d;
+        }
+        // around multiples of the divisor
+        for (uint64_t q : {1ull, 2ull, 1000ull, 123456789ull}) {
+            if (q > 0xffffffffffffffffull / d)
+                continue;
+            EXPECT_EQ(q, div.divide(q*d));
+            EXPECT_EQ(q-1, div.divide(q*d-1));
+        }
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the distributed Cartesian tree and LCE queries.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <cartesian_tree.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+// sequential Cartesian tree via a stack (ties: the leftmost minimum is the root)
+void seq_cartesian_tree(const std::vector<size_t>& vals, std::vector<size_t>& parent,
+                        std::vector<size_t>& left_child, std::vector<size_t>& right_child) {
+    const size_t none = cartesian_tree::none();
+    parent.assign(vals.size(), none);
+    left_child.assign(vals.size(), none);
+    right_child.assign(vals.size(), none);
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < vals.size(); ++i) {
+        size_t last = none;
+        while (!stack.empty() && vals[stack.back()] > vals[i]) {
+            last = stack.back();
+            stack.pop_back();
+        }
+        if (last != none) {
+            parent[last] = i;
+            left_child[i] = last;
+        }
+        if (!stack.empty()) {
+            parent[i] = stack.back();
+            right_child[stack.back()] = i;
+        }
+        stack.push_back(i);
+    }
+}
+
+TEST(PsacCartesianTree, RandomValues) {
+    mxx::comm c;
+    for (size_t n : {13, 1000, 12345}) {
+        // many ties
+        std::vector<size_t> vals(n);
+        std::srand(n);
+        for (size_t i = 0; i < n; ++i)
+            vals[i] = std::rand() % 10;
+        if (n < (size_t)c.size())
+            continue;
+        // unequal distribution: rank i holds one element plus a share of the
+        // rest proportional to i+1
+        size_t total_weight = c.size()*(c.size()+1)/2;
+        size_t rest = n - c.size();
+        size_t begin = c.rank() + rest * (c.rank()*(c.rank()+1)/2) / total_weight;
+        size_t end = c.rank() + 1 + rest * ((c.rank()+1)*(c.rank()+2)/2) / total_weight;
+        std::vector<size_t> local_vals(vals.begin() + begin, vals.begin() + end);
+
+        cartesian_tree tree = construct_cartesian_tree(local_vals, c);
+        std::vector<size_t> parent = mxx::gatherv(tree.parent, 0, c);
+        std::vector<size_t> left_child = mxx::gatherv(tree.left_child, 0, c);
+        std::vector<size_t> right_child = mxx::gatherv(tree.right_child, 0, c);
+        std::vector<size_t> sizes;
+        for (size_t i = 0; i < local_vals.size(); ++i)
+            sizes.push_back(tree.subtree_size(i));
+        sizes = mxx::gatherv(sizes, 0, c);
+        std::vector<size_t> lb = mxx::gatherv(tree.lb, 0, c);
+
+        if (c.rank() == 0) {
+            std::vector<size_t> exp_parent, exp_left, exp_right;
+            seq_cartesian_tree(vals, exp_parent, exp_left, exp_right);
+            EXPECT_EQ(exp_parent, parent);
+            EXPECT_EQ(exp_left, left_child);
+            EXPECT_EQ(exp_right, right_child);
+            // subtree sizes by summing up the children
+            std::vector<size_t> exp_sizes(n, 1);
+            std::vector<size_t> order(n);
+            for (size_t i = 0; i < n; ++i)
+                order[i] = i;
+            std::vector<size_t> depth(n, 0);
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = i; exp_parent[j] != cartesian_tree::none(); j = exp_parent[j])
+                    ++depth[i];
+            std::sort(order.begin(), order.end(), [&](size_t x, size_t y) { return depth[x] > depth[y]; });
+            for (size_t i : order)
+                if (exp_parent[i] != cartesian_tree::none())
+                    exp_sizes[exp_parent[i]] += exp_sizes[i];
+            EXPECT_EQ(exp_sizes, sizes);
+            for (size_t i = 0; i < n; ++i)
+                EXPECT_LE(lb[i], i);
+        }
+    }
+}
+
+TEST(PsacCartesianTree, LCE) {
+    mxx::comm c;
+    std::string str;
+    size_t n = 5000;
+    if (c.rank() == 0) {
+        str = rand_dna(n/2, 5);
+        str += str.substr(0, n/4) + rand_dna(n/4, 6);
+    }
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, true> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+    mxx::bcast(n, 0, c);
+
+    // random pairs of positions, including identical ones
+    std::srand(c.rank() + 1);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < 3000; ++i) {
+        size_t a = std::rand() % n;
+        size_t b = (i % 100 == 0) ? a : std::rand() % n;
+        if (i % 7 == 0)
+            b = (a + n/2) % n;
+        pairs.emplace_back(a, b);
+    }
+    std::vector<size_t> lce = bulk_lce(sa, pairs, c);
+    ASSERT_EQ(pairs.size(), lce.size());
+
+    std::vector<std::pair<size_t, size_t>> all_pairs = mxx::gatherv(pairs, 0, c);
+    std::vector<size_t> all_lce = mxx::gatherv(lce, 0, c);
+    if (c.rank() == 0) {
+        for (size_t i = 0; i < all_pairs.size(); ++i) {
+            size_t a = all_pairs[i].first;
+            size_t b = all_pairs[i].second;
+            size_t l = 0;
+            while (a + l < n && b + l < n && str[a+l] == str[b+l])
+                ++l;
+            EXPECT_EQ(l, all_lce[i]) << "positions " << a << ", " << b;
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for checkpointing and resuming the construction.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <checkpoint.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+const std::string test_prefix = "test_checkpoint_ckp";
+
+TEST(PsacCheckpoint, Redistribute) {
+    mxx::comm c;
+
+    // arbitrary distribution
+    std::vector<uint64_t> local_B((c.rank()*7) % 5 + 3);
+    std::vector<uint64_t> local_LCP(local_B.size());
+    size_t offset = mxx::exscan(local_B.size(), c);
+    for (size_t i = 0; i < local_B.size(); ++i) {
+        local_B[i] = offset + i;
+        local_LCP[i] = 2*(offset + i);
+    }
+    size_t n = mxx::allreduce(local_B.size(), c);
+    write_checkpoint(test_prefix, 8, 4, 42, local_B, local_LCP, c);
+
+    // restore on all and on a subset of the processors
+    for (int q : {c.size(), std::max(1, c.size()-1)}) {
+        c.with_subset(c.rank() < q, [&](const mxx::comm& sc) {
+            checkpoint_info info;
+            std::vector<uint64_t> B, LCP;
+            ASSERT_TRUE(read_checkpoint(test_prefix, info, B, LCP, sc));
+            EXPECT_EQ(n, info.n);
+            EXPECT_EQ(8u, info.shift_by);
+            EXPECT_EQ(4u, info.k);
+            EXPECT_EQ(42u, info.fingerprint);
+            EXPECT_TRUE(info.has_lcp);
+            mxx::partition::block_decomposition_buffered<size_t> part(n, sc.size(), sc.rank());
+            ASSERT_EQ(part.local_size(), B.size());
+            ASSERT_EQ(part.local_size(), LCP.size());
+            for (size_t i = 0; i < B.size(); ++i) {
+                EXPECT_EQ(part.excl_prefix_size() + i, B[i]);
+                EXPECT_EQ(2*(part.excl_prefix_size() + i), LCP[i]);
+            }
+        });
+    }
+
+    // a newer checkpoint without LCP replaces the previous one
+    write_checkpoint(test_prefix, 16, 4, 42, local_B, std::vector<uint64_t>(), c);
+    checkpoint_info info;
+    std::vector<uint64_t> B, LCP;
+    ASSERT_TRUE(read_checkpoint(test_prefix, info, B, LCP, c));
+    EXPECT_EQ(16u, info.shift_by);
+    EXPECT_FALSE(info.has_lcp);
+    EXPECT_TRUE(LCP.empty());
+    std::ifstream old_block(test_prefix + ".8." + std::to_string(c.rank()));
+    EXPECT_FALSE(old_block.good());
+
+    // wrong index type
+    std::vector<uint32_t> B32, LCP32;
+    EXPECT_FALSE(read_checkpoint(test_prefix, info, B32, LCP32, c));
+
+    remove_checkpoint<uint64_t>(test_prefix, c);
+    EXPECT_FALSE(read_checkpoint(test_prefix, info, B, LCP, c));
+}
+
+TEST(PsacCheckpoint, Resume) {
+    mxx::comm c;
+
+    std::string str;
+    if (c.rank() == 0) {
+        str = rand_dna(23456, 13);
+    }
+    std::string local_str = mxx::stable_distribute(str, c);
+    size_t n = str.size();
+    mxx::bcast(n, 0, c);
+    uint64_t fp = input_fingerprint(local_str.begin(), local_str.end(), c);
+    // the fingerprint does not depend on the distribution
+    c.with_subset(c.rank() == 0, [&](const mxx::comm& sc) {
+        EXPECT_EQ(fp, input_fingerprint(str.begin(), str.end(), sc));
+    });
+
+    // reference construction
+    suffix_array<char, uint64_t, true> ref(c);
+    ref.construct(local_str.begin(), local_str.end(), false, 2);
+    std::vector<uint64_t> gsa = mxx::gatherv(ref.local_SA, 0, c);
+    std::vector<uint64_t> gisa = mxx::gatherv(ref.local_B, 0, c);
+    std::vector<uint64_t> glcp = mxx::gatherv(ref.local_LCP, 0, c);
+
+    // construct with checkpoints, which leaves the last checkpoint behind
+    suffix_array<char, uint64_t, true> sa(c);
+    sa.checkpoint_prefix = test_prefix;
+    sa.construct(local_str.begin(), local_str.end(), false, 2);
+    checkpoint_info info;
+    std::vector<uint64_t> B, LCP;
+    ASSERT_TRUE(read_checkpoint(test_prefix, info, B, LCP, c));
+    EXPECT_EQ(n, info.n);
+    EXPECT_LT(2u, info.shift_by);
+
+    // resume on fewer processors
+    int q = std::max(1, c.size()-1);
+    c.with_subset(c.rank() < q, [&](const mxx::comm& sc) {
+        suffix_array<char, uint64_t, true> resumed(sc);
+        EXPECT_FALSE(resumed.resume(test_prefix, n+1, fp, false));
+        EXPECT_FALSE(resumed.resume(test_prefix, n, fp+1, false));
+        ASSERT_TRUE(resumed.resume(test_prefix, n, fp, false));
+        std::vector<uint64_t> rsa = mxx::gatherv(resumed.local_SA, 0, sc);
+        std::vector<uint64_t> risa = mxx::gatherv(resumed.local_B, 0, sc);
+        std::vector<uint64_t> rlcp = mxx::gatherv(resumed.local_LCP, 0, sc);
+        if (sc.rank() == 0) {
+            EXPECT_EQ(gsa, rsa);
+            EXPECT_EQ(gisa, risa);
+            EXPECT_EQ(glcp, rlcp);
+        }
+    });
+
+    // resilient construction resumes from the remaining checkpoint and
+    // removes it afterwards
+    suffix_array<char, uint64_t, true> rsa(c);
+    rsa.construct_resilient(local_str.begin(), local_str.end(), test_prefix);
+    EXPECT_EQ(0, rsa.lost_processors);
+    std::vector<uint64_t> sa2 = mxx::gatherv(rsa.local_SA, 0, c);
+    std::vector<uint64_t> lcp2 = mxx::gatherv(rsa.local_LCP, 0, c);
+    if (c.rank() == 0) {
+        EXPECT_EQ(gsa, sa2);
+        EXPECT_EQ(glcp, lcp2);
+    }
+    EXPECT_FALSE(read_checkpoint(test_prefix, info, B, LCP, c));
+
+    // a checkpoint of another input of the same size is not resumed
+    sa.construct(local_str.begin(), local_str.end(), false, 2);
+    std::string other_str = local_str;
+    other_str[0] = (other_str[0] == 'A') ? 'C' : 'A';
+    suffix_array<char, uint64_t, true> osa(c);
+    osa.construct_resilient(other_str.begin(), other_str.end(), test_prefix);
+    suffix_array<char, uint64_t, true> oref(c);
+    oref.construct(other_str.begin(), other_str.end(), false, 2);
+    EXPECT_EQ(oref.local_SA, osa.local_SA);
+    EXPECT_FALSE(read_checkpoint(test_prefix, info, B, LCP, c));
+
+    // without a previous checkpoint
+    suffix_array<char, uint64_t, false> sa3(c);
+    sa3.construct_resilient(local_str.begin(), local_str.end(), test_prefix);
+    std::vector<uint64_t> sa3_g = mxx::gatherv(sa3.local_SA, 0, c);
+    if (c.rank() == 0) {
+        EXPECT_EQ(gsa, sa3_g);
+    }
+    EXPECT_FALSE(read_checkpoint(test_prefix, info, B, LCP, c));
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the compressed suffix array export and loader.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <compressed_sa.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+const std::string test_prefix = "test_compressed_sa";
+
+template <bool LCP>
+void test_csa(const std::string& str, std::size_t sample_rate, std::size_t psi_block, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, LCP> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+    write_compressed_sa(test_prefix, sa, sample_rate, c, psi_block);
+
+    std::vector<size_t> SA = mxx::allgatherv(sa.local_SA, c);
+    std::vector<size_t> ISA = mxx::allgatherv(sa.local_B, c);
+    size_t n = SA.size();
+    c.barrier();
+
+    compressed_suffix_array<size_t> csa(test_prefix);
+    ASSERT_EQ(n, csa.size());
+    for (size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(ISA[(SA[i] + 1) % n], csa.psi(i)) << "i=" << i;
+        EXPECT_EQ(SA[i], csa.sa(i)) << "i=" << i;
+        EXPECT_EQ(ISA[i], csa.isa(i)) << "i=" << i;
+    }
+    if (n > 1000) {
+        EXPECT_LT(csa.size_in_bytes(), n * sizeof(size_t));
+    }
+
+    c.barrier();
+    if (c.rank() == 0)
+        std::remove(csa_impl::meta_file(test_prefix).c_str());
+    std::remove(csa_impl::block_file(test_prefix, c.rank()).c_str());
+}
+
+TEST(PsacCompressedSA, Mississippi) {
+    mxx::comm c;
+    if (c.size() <= 11) {
+        test_csa<false>("mississippi", 2, 3, c);
+        test_csa<true>("mississippi", 1, 1, c);
+    }
+}
+
+TEST(PsacCompressedSA, RandomDNA) {
+    mxx::comm c;
+    std::string str = rand_dna(5000, 13);
+    str += str.substr(1000, 700);
+    test_csa<false>(str, 16, 64, c);
+    test_csa<false>(str, 7, 5, c);
+}
+
+TEST(PsacCompressedSA, WrongIndexType) {
+    mxx::comm c;
+    std::string local_str = mxx::stable_distribute(std::string("abracadabra"), c);
+    if (c.size() <= 11) {
+        suffix_array<char, size_t, false> sa(c);
+        sa.construct(local_str.begin(), local_str.end());
+        write_compressed_sa(test_prefix, sa, 4, c);
+        c.barrier();
+        EXPECT_THROW(compressed_suffix_array<uint32_t> csa(test_prefix), std::runtime_error);
+        c.barrier();
+        if (c.rank() == 0)
+            std::remove(csa_impl::meta_file(test_prefix).c_str());
+        std::remove(csa_impl::block_file(test_prefix, c.rank()).c_str());
+    }
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the document array and document listing.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <stringset.hpp>
+#include <sampled_index.hpp>
+#include <pattern_search.hpp>
+#include <document_array.hpp>
+
+#include <map>
+#include <vector>
+#include <string>
+
+void test_document_listing(const std::vector<std::string>& docs, const mxx::comm& c) {
+    std::string flatstrs;
+    if (c.rank() == 0)
+        flatstrs = flatten_strings(docs);
+    flatstrs = mxx::stable_distribute(flatstrs, c);
+
+    // construct GSA and document array
+    simple_dstringset ss(flatstrs.begin(), flatstrs.end(), c);
+    alphabet<char> a = alphabet<char>::from_string("ACGT", c);
+    suffix_array<char, uint64_t, false> sa(c);
+    sa.construct_ss(ss, a);
+    document_array<uint64_t> da(sa.local_SA, ss, c);
+    EXPECT_EQ(docs.size(), da.num_docs());
+
+    // check document array against sequential
+    std::string local_str = concat_stringset(ss, c);
+    std::vector<uint64_t> gsa = mxx::allgatherv(sa.local_SA, c);
+    std::vector<uint64_t> gda = mxx::allgatherv(da.local_DA, c);
+    std::vector<uint64_t> seq_end = mxx::allgatherv(da.local_seq_end, c);
+    std::vector<uint64_t> doc_of;
+    std::vector<uint64_t> exp_end;
+    for (size_t d = 0; d < docs.size(); ++d) {
+        doc_of.insert(doc_of.end(), docs[d].size(), d);
+        exp_end.insert(exp_end.end(), docs[d].size(), doc_of.size());
+    }
+    ASSERT_EQ(doc_of.size(), gsa.size());
+    EXPECT_EQ(exp_end, seq_end);
+    for (size_t i = 0; i < gsa.size(); ++i) {
+        EXPECT_EQ(doc_of[gsa[i]], gda[i]);
+    }
+
+    // patterns: search GSA ranges without crossing sequence boundaries
+    sampled_index<char, uint64_t> idx(sa.local_SA, local_str.begin(), local_str.end(), da.local_seq_end, 8, 4, c);
+    std::vector<std::string> patterns;
+    std::srand(11 + c.rank());
+    for (size_t i = 0; i < 40; ++i) {
+        const std::string& doc = docs[std::rand() % docs.size()];
+        size_t len = 1 + std::rand() % 6;
+        if (len > doc.size())
+            len = doc.size();
+        patterns.push_back(doc.substr(std::rand() % (doc.size() - len + 1), len));
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> ranges = bulk_sa_ranges(sa.local_SA, local_str.begin(), local_str.end(), da.local_seq_end, idx, patterns, c);
+    std::vector<size_t> offsets;
+    std::vector<std::pair<uint64_t, uint64_t>> listing = da.list_documents(ranges, offsets);
+    ASSERT_EQ(patterns.size()+1, offsets.size());
+
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        // sequential document listing
+        std::map<uint64_t, uint64_t> exp;
+        for (size_t d = 0; d < docs.size(); ++d) {
+            for (size_t j = 0; j + patterns[i].size() <= docs[d].size(); ++j) {
+                if (docs[d].compare(j, patterns[i].size(), patterns[i]) == 0)
+                    ++exp[d];
+            }
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> exp_listing(exp.begin(), exp.end());
+        std::vector<std::pair<uint64_t, uint64_t>> res(listing.begin() + offsets[i], listing.begin() + offsets[i+1]);
+        EXPECT_EQ(exp_listing, res) << "pattern " << patterns[i];
+    }
+}
+
+TEST(PsacDocumentArray, RandomDocs) {
+    mxx::comm c;
+    std::vector<std::string> docs;
+    for (size_t i = 0; i < 25; ++i)
+        docs.push_back(rand_dna(3 + (i*37) % 60, i+1));
+    test_document_listing(docs, c);
+}
+
+TEST(PsacDocumentArray, RepeatedDocs) {
+    mxx::comm c;
+    std::vector<std::string> docs;
+    for (size_t i = 0; i < 10; ++i)
+        docs.push_back(std::string(2 + i*5, 'A') + "CG");
+    docs.push_back("ACGACGACGTTT");
+    test_document_listing(docs, c);
+}
+
+void test_color_listing(const std::vector<std::string>& docs, const std::vector<uint64_t>& doc_colors, const mxx::comm& c) {
+    std::string flatstrs;
+    if (c.rank() == 0)
+        flatstrs = flatten_strings(docs);
+    flatstrs = mxx::stable_distribute(flatstrs, c);
+
+    // construct GSA with LCP, document array and color array
+    simple_dstringset ss(flatstrs.begin(), flatstrs.end(), c);
+    alphabet<char> a = alphabet<char>::from_string("ACGT", c);
+    suffix_array<char, uint64_t, true> sa(c);
+    sa.construct_ss(ss, a);
+    document_array<uint64_t> da(sa.local_SA, ss, c);
+    color_array<uint64_t> ca(da, doc_colors, c);
+    size_t num_colors = *std::max_element(doc_colors.begin(), doc_colors.end()) + 1;
+    EXPECT_EQ(num_colors, ca.num_colors());
+
+    // colors of all suffixes
+    std::vector<uint64_t> gsa = mxx::allgatherv(sa.local_SA, c);
+    std::vector<uint64_t> gca = mxx::allgatherv(ca.local_colors(), c);
+    std::vector<uint64_t> color_of;
+    for (size_t d = 0; d < docs.size(); ++d)
+        color_of.insert(color_of.end(), docs[d].size(), doc_colors[d]);
+    ASSERT_EQ(color_of.size(), gca.size());
+    for (size_t i = 0; i < gsa.size(); ++i) {
+        EXPECT_EQ(color_of[gsa[i]], gca[i]);
+    }
+
+    // patterns: the colors sharing each substring
+    std::string local_str = concat_stringset(ss, c);
+    sampled_index<char, uint64_t> idx(sa.local_SA, local_str.begin(), local_str.end(), da.local_seq_end, 8, 4, c);
+    std::vector<std::string> patterns;
+    std::srand(17 + c.rank());
+    for (size_t i = 0; i < 40; ++i) {
+        const std::string& doc = docs[std::rand() % docs.size()];
+        size_t len = 1 + std::rand() % 8;
+        if (len > doc.size())
+            len = doc.size();
+        patterns.push_back(doc.substr(std::rand() % (doc.size() - len + 1), len));
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> ranges = bulk_sa_ranges(sa.local_SA, local_str.begin(), local_str.end(), da.local_seq_end, idx, patterns, c);
+    std::vector<size_t> offsets;
+    std::vector<std::pair<uint64_t, uint64_t>> listing = ca.list_colors(ranges, offsets);
+    ASSERT_EQ(patterns.size()+1, offsets.size());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        std::map<uint64_t, uint64_t> exp;
+        for (size_t d = 0; d < docs.size(); ++d) {
+            for (size_t j = 0; j + patterns[i].size() <= docs[d].size(); ++j) {
+                if (docs[d].compare(j, patterns[i].size(), patterns[i]) == 0)
+                    ++exp[doc_colors[d]];
+            }
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> exp_listing(exp.begin(), exp.end());
+        std::vector<std::pair<uint64_t, uint64_t>> res(listing.begin() + offsets[i], listing.begin() + offsets[i+1]);
+        EXPECT_EQ(exp_listing, res) << "pattern " << patterns[i];
+    }
+
+    // color sets of all LCP-intervals
+    lcp_interval_tree tree = construct_lcp_interval_tree(sa, c);
+    std::vector<size_t> node_offsets;
+    std::vector<std::pair<uint64_t, uint64_t>> node_colors = ca.interval_colors(tree, node_offsets);
+    ASSERT_EQ(sa.local_SA.size()+1, node_offsets.size());
+    for (size_t i = 0; i < sa.local_SA.size(); ++i) {
+        std::map<uint64_t, uint64_t> exp;
+        if (tree.is_node(i)) {
+            for (size_t j = tree.node_lb[i]; j <= tree.node_rb[i]; ++j)
+                ++exp[gca[j]];
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> exp_listing(exp.begin(), exp.end());
+        std::vector<std::pair<uint64_t, uint64_t>> res(node_colors.begin() + node_offsets[i], node_colors.begin() + node_offsets[i+1]);
+        EXPECT_EQ(exp_listing, res) << "node " << i;
+    }
+
+    // the same color sets when listed in small batches
+    std::vector<size_t> batch_offsets;
+    std::vector<std::pair<uint64_t, uint64_t>> batch_colors = ca.interval_colors(tree, batch_offsets, 7);
+    EXPECT_EQ(node_offsets, batch_offsets);
+    EXPECT_EQ(node_colors, batch_colors);
+}
+
+TEST(PsacColorArray, PanGenome) {
+    mxx::comm c;
+    // 5 genomes of several contigs each, sharing most of their sequence
+    std::string base = rand_dna(120, 3);
+    std::vector<std::string> docs;
+    std::vector<uint64_t> doc_colors;
+    std::srand(7);
+    for (size_t g = 0; g < 5; ++g) {
+        std::string genome = base;
+        for (size_t j = 0; j < 4; ++j)
+            genome[std::rand() % genome.size()] = "ACGT"[std::rand() % 4];
+        for (size_t pos = 0; pos < genome.size(); pos += 40) {
+            docs.push_back(genome.substr(pos, 40));
+            doc_colors.push_back(g);
+        }
+    }
+    test_color_listing(docs, doc_colors, c);
+}
+
+TEST(PsacColorArray, ManyColors) {
+    mxx::comm c;
+    // colors which do not fit a power of two number of bits
+    std::vector<std::string> docs;
+    std::vector<uint64_t> doc_colors;
+    for (size_t i = 0; i < 40; ++i) {
+        docs.push_back(rand_dna(3 + (i*29) % 50, i+1));
+        doc_colors.push_back((i * 7) % 37);
+    }
+    test_color_listing(docs, doc_colors, c);
+}
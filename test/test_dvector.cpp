@@ -0,0 +1,295 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for general (unequal) distributions.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <dvector.hpp>
+#include <shifting.hpp>
+#include <bulk_permute.hpp>
+#include <bulk_rma.hpp>
+#include <par_rmq.hpp>
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+
+TEST(PsacDist, GenDist) {
+    mxx::comm c;
+
+    // unequal, with empty processors
+    size_t local_size = (c.rank() % 3 == 1) ? 0 : 3*c.rank() + 2;
+    gen_dist d(c, local_size);
+    std::vector<size_t> sizes = mxx::allgather(local_size, c);
+    size_t n = std::accumulate(sizes.begin(), sizes.end(), static_cast<size_t>(0));
+    EXPECT_EQ(n, d.global_size());
+    EXPECT_EQ(local_size, d.local_size());
+    EXPECT_EQ(mxx::exscan(local_size, c), d.eprefix());
+    size_t gidx = 0;
+    for (int r = 0; r < c.size(); ++r) {
+        EXPECT_EQ(sizes[r], d.local_size(r));
+        EXPECT_EQ(gidx, d.excl_prefix_size(r));
+        for (size_t i = 0; i < sizes[r]; ++i, ++gidx) {
+            EXPECT_EQ(r, d.rank_of(gidx));
+            EXPECT_EQ(r, d.target_processor(gidx));
+            EXPECT_EQ(i, d.lidx_of(gidx));
+            EXPECT_EQ(gidx, d.gidx_of(r, i));
+        }
+        EXPECT_EQ(gidx, d.prefix_size(r));
+    }
+
+    // the block distribution is detected
+    gen_dist b(c, 10 + (c.rank() < 2 ? 1 : 0));
+    EXPECT_TRUE(b.is_blk_dist());
+    mxx::partition::block_decomposition_buffered<size_t> part(b.global_size(), c.size(), c.rank());
+    for (size_t i = 0; i < b.global_size(); ++i) {
+        EXPECT_EQ(part.target_processor(i), b.target_processor(i));
+    }
+}
+
+TEST(PsacDist, RankOfMany) {
+    // block distributions of all sizes, including fewer elements than processors
+    for (size_t p : {1, 2, 3, 7, 64, 1000}) {
+        for (size_t n : {1ul, 2ul, 5ul, 63ul, 64ul, 999ul, 1000ul, 1001ul, 123457ul}) {
+            blk_dist d(n, p, 0);
+            std::vector<size_t> gidx(n);
+            std::iota(gidx.begin(), gidx.end(), 0);
+            std::vector<int> ranks(n);
+            rank_of_many(d, gidx.begin(), gidx.end(), ranks.begin());
+            size_t g = 0;
+            for (size_t r = 0; r < p; ++r) {
+                ASSERT_EQ(g, d.eprefix(r));
+                for (size_t i = 0; i < d.local_size(r); ++i, ++g) {
+                    ASSERT_EQ(static_cast<int>(r), ranks[g]) << "n=" << n << ", p=" << p;
+                    ASSERT_EQ(r, d.rank_of(g));
+                    ASSERT_EQ(i, d.lidx_of(g));
+                }
+            }
+            ASSERT_EQ(n, g);
+        }
+    }
+
+    // any other partition
+    mxx::comm c;
+    mxx::partition::block_decomposition_buffered<size_t> part(1234, c.size(), c.rank());
+    std::vector<size_t> gidx = {0, 17, 617, 1233};
+    std::vector<int> ranks(gidx.size());
+    rank_of_many(part, gidx.begin(), gidx.end(), ranks.begin());
+    for (size_t i = 0; i < gidx.size(); ++i) {
+        EXPECT_EQ(part.target_processor(gidx[i]), ranks[i]);
+    }
+
+    // unequal distributions
+    gen_dist gd(c, (c.rank() % 2 == 0) ? 3 : 0);
+    gidx.resize(gd.global_size());
+    std::iota(gidx.begin(), gidx.end(), 0);
+    ranks.resize(gidx.size());
+    rank_of_many(gd, gidx.begin(), gidx.end(), ranks.begin());
+    for (size_t i = 0; i < gidx.size(); ++i) {
+        EXPECT_EQ(static_cast<int>(2*(i/3)), ranks[i]);
+    }
+}
+
+TEST(PsacDist, WeightedRedistribute) {
+    mxx::comm c;
+
+    size_t n = 10007;
+    size_t local_size = weighted_local_size(n, c.rank() + 1.0, c);
+    EXPECT_EQ(n, mxx::allreduce(local_size, c));
+    if (c.size() > 1) {
+        // proportional to the weights (up to rounding)
+        double expected = n * (c.rank() + 1.0) / (c.size()*(c.size()+1)/2.0);
+        EXPECT_NEAR(expected, local_size, 1.0);
+    }
+    // equal weights result in the block distribution
+    EXPECT_TRUE(gen_dist(c, weighted_local_size(n, 2.0, c)).is_blk_dist());
+
+    std::vector<size_t> vec(n / c.size() + (static_cast<size_t>(c.rank()) < n % c.size() ? 1 : 0));
+    size_t prefix = mxx::exscan(vec.size(), c);
+    std::iota(vec.begin(), vec.end(), prefix);
+    std::vector<size_t> result = redistribute(vec, local_size, c);
+    ASSERT_EQ(local_size, result.size());
+    size_t new_prefix = mxx::exscan(local_size, c);
+    for (size_t i = 0; i < result.size(); ++i) {
+        EXPECT_EQ(new_prefix + i, result[i]);
+    }
+}
+
+TEST(PsacDist, ShiftPermute) {
+    mxx::comm c;
+
+    std::vector<size_t> vec((c.rank()*5) % 7 + 1);
+    gen_dist d(c, vec.size());
+    size_t n = d.global_size();
+    std::iota(vec.begin(), vec.end(), d.eprefix());
+
+    // shifting across multiple processors
+    for (size_t shift_by : {1ul, 3ul, 8ul, n/2, n-1, n}) {
+        std::vector<size_t> shifted = shift_vector(vec, d, shift_by, c);
+        ASSERT_EQ(vec.size(), shifted.size());
+        for (size_t i = 0; i < vec.size(); ++i) {
+            size_t g = d.eprefix() + i + shift_by;
+            EXPECT_EQ(g < n ? g : 0, shifted[i]);
+        }
+    }
+
+    // reverse permutation
+    std::vector<size_t> idx(vec.size());
+    for (size_t i = 0; i < vec.size(); ++i) {
+        idx[i] = n - 1 - (d.eprefix() + i);
+    }
+    std::vector<size_t> values(vec);
+    bulk_permute_inplace(values, idx, d, c);
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(n - 1 - (d.eprefix() + i), values[i]);
+    }
+}
+
+TEST(PsacDist, BulkPermuteBatches) {
+    mxx::comm c;
+
+    // several batches of target processors per processor
+    std::vector<size_t> vec(5000 + 1001*c.rank());
+    gen_dist d(c, vec.size());
+    size_t n = d.global_size();
+    ASSERT_NE(0u, n % 7919);
+    std::iota(vec.begin(), vec.end(), d.eprefix());
+    std::vector<size_t> idx(vec.size());
+    for (size_t i = 0; i < vec.size(); ++i) {
+        idx[i] = (vec[i] * 7919) % n;
+    }
+    bulk_permute_inplace(vec, idx, d, c);
+    for (size_t i = 0; i < vec.size(); ++i) {
+        EXPECT_EQ(d.eprefix() + i, (vec[i] * 7919) % n);
+    }
+}
+
+TEST(PsacDist, DRanges) {
+    mxx::comm c;
+
+    // equal, block and unequal distributions
+    std::vector<size_t> vec(10);
+    eq_dist ed(c, vec.size());
+    EXPECT_EQ(10u*c.size(), ed.global_size());
+    EXPECT_EQ(c.rank(), ed.target_processor(10*c.rank() + 3));
+    EXPECT_EQ(3u, ed.lidx_of(10*c.rank() + 3));
+
+    std::vector<size_t> blk_vec(13 / c.size() + (static_cast<size_t>(c.rank()) < 13 % c.size() ? 1 : 0));
+    blk_dist bd(c, blk_vec.size());
+    EXPECT_EQ(13u, bd.global_size());
+    EXPECT_EQ(bd.eprefix(), bd.excl_prefix_size());
+    gen_dist gd(c, blk_vec.size());
+    ASSERT_TRUE(gd.is_blk_dist());
+    blk_dist bd2 = gd.to_blk_dist();
+    for (int r = 0; r < c.size(); ++r) {
+        EXPECT_EQ(gd.eprefix(r), bd2.eprefix(r));
+        EXPECT_EQ(gd.local_size(r), bd2.local_size(r));
+    }
+
+    // ranges over an unequal distribution
+    std::vector<size_t> local((c.rank()*3) % 5 + 2);
+    gen_dist d(c, local.size());
+    size_t n = d.global_size();
+    std::iota(local.begin(), local.end(), d.eprefix());
+    dvector_wrapper<size_t, gen_dist> src(local, d, c);
+    EXPECT_EQ(c.rank(), src.rank_of(d.eprefix()));
+
+    dvector<size_t, gen_dist> shifted = left_shift_drange(src, 3);
+    ASSERT_EQ(local.size(), shifted.local().size());
+    for (size_t i = 0; i < local.size(); ++i) {
+        EXPECT_EQ(d.eprefix() + i + 3 < n ? d.eprefix() + i + 3 : 0, shifted[i]);
+    }
+
+    // rma of every second element, in reverse order
+    std::vector<size_t> idx;
+    for (size_t i = 0; i < n; i += 2)
+        idx.push_back(n - 1 - i);
+    std::vector<size_t> values = bulk_rma(dvector_const_wrapper<size_t, gen_dist>(local, d, c), idx);
+    EXPECT_EQ(idx, values);
+
+    // range minimum over the whole array
+    std::vector<std::tuple<size_t, size_t, size_t> > ranges;
+    if (c.rank() == 0)
+        ranges.emplace_back(0, n/3, n);
+    bulk_rmq(src, ranges);
+    if (c.rank() == 0) {
+        EXPECT_EQ(n/3, std::get<2>(ranges[0]));
+    }
+
+    // reverse permutation
+    dvector<size_t, gen_dist> perm(c, d);
+    for (size_t i = 0; i < local.size(); ++i)
+        perm[i] = n - 1 - (d.eprefix() + i);
+    bulk_permute_inplace(src, perm);
+    for (size_t i = 0; i < local.size(); ++i) {
+        EXPECT_EQ(n - 1 - (d.eprefix() + i), local[i]);
+    }
+}
+
+TEST(PsacDist, WeightedConstruction) {
+    mxx::comm c;
+
+    std::string str;
+    if (c.rank() == 0) {
+        // a few long repeats remain unresolved for the bucket chasing phase
+        std::string rep = rand_dna(700, 11);
+        str = rand_dna(15000, 12) + rep + rand_dna(15000, 13) + rep;
+    }
+    std::string local_str = mxx::stable_distribute(str, c);
+
+    // reference on the block distribution
+    suffix_array<char, uint64_t, true> ref(c);
+    ref.construct(local_str.begin(), local_str.end(), false, 2);
+    std::vector<uint64_t> gsa = mxx::gatherv(ref.local_SA, 0, c);
+    std::vector<uint64_t> gisa = mxx::gatherv(ref.local_B, 0, c);
+    std::vector<uint64_t> glcp = mxx::gatherv(ref.local_LCP, 0, c);
+
+    // larger blocks on higher ranks
+    size_t weighted_size = weighted_local_size(mxx::allreduce(local_str.size(), c), 1.0 + c.rank(), c);
+    std::vector<char> wvec = redistribute(std::vector<char>(local_str.begin(), local_str.end()), weighted_size, c);
+    std::string wstr(wvec.begin(), wvec.end());
+    for (bool fast_resolval : {false, true}) {
+        suffix_array<char, uint64_t, true> sa(c);
+        sa.construct(wstr.begin(), wstr.end(), fast_resolval, 2);
+        EXPECT_EQ(wstr.size(), sa.local_SA.size());
+        EXPECT_EQ(wstr.size(), sa.local_LCP.size());
+        std::vector<uint64_t> wsa = mxx::gatherv(sa.local_SA, 0, c);
+        std::vector<uint64_t> wisa = mxx::gatherv(sa.local_B, 0, c);
+        std::vector<uint64_t> wlcp = mxx::gatherv(sa.local_LCP, 0, c);
+        if (c.rank() == 0) {
+            EXPECT_EQ(gsa, wsa);
+            EXPECT_EQ(gisa, wisa);
+            EXPECT_EQ(glcp, wlcp);
+        }
+    }
+
+    // construction methods which require the block decomposition
+    if (c.size() > 1) {
+        suffix_array<char, uint64_t, false> sa(c);
+        EXPECT_THROW(sa.construct_arr<2>(wstr.begin(), wstr.end()), std::runtime_error);
+    }
+}
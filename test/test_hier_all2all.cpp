@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the topology aware two-level all2all.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+#include <hier_all2all.hpp>
+#include <all2all.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+TEST(PsacHierAll2all, NodeTopology) {
+    mxx::comm c;
+    const hier_comm& topo = hier_comm::get(c);
+    // the topology is only detected once per group
+    EXPECT_EQ(&topo, &hier_comm::get(c));
+    EXPECT_EQ(c.size(), (int)topo.rank_node.size());
+    EXPECT_EQ(topo.node_idx, topo.rank_node[c.rank()]);
+    EXPECT_EQ(topo.node_comm.rank(), topo.rank_local[c.rank()]);
+    size_t total = 0;
+    for (int d = 0; d < topo.num_nodes; ++d) {
+        total += topo.node_ranks[d].size();
+        for (size_t r = 0; r < topo.node_ranks[d].size(); ++r) {
+            EXPECT_EQ(d, topo.rank_node[topo.node_ranks[d][r]]);
+            EXPECT_EQ((int)r, topo.rank_local[topo.node_ranks[d][r]]);
+        }
+    }
+    EXPECT_EQ((size_t)c.size(), total);
+}
+
+TEST(PsacHierAll2all, EmulatedNodes) {
+    mxx::comm c;
+    std::srand(13 + c.rank());
+    for (int ranks_per_node : {1, 2, 3, 4}) {
+        hier_comm topo(c, ranks_per_node);
+        EXPECT_EQ((c.size() + ranks_per_node - 1) / ranks_per_node, topo.num_nodes);
+
+        // random message sizes, including empty ones
+        std::vector<size_t> send_counts(c.size());
+        std::vector<std::pair<int, size_t> > msgs;
+        for (int i = 0; i < c.size(); ++i) {
+            send_counts[i] = (std::rand() % 3 == 0) ? 0 : std::rand() % 100;
+            for (size_t j = 0; j < send_counts[i]; ++j)
+                msgs.emplace_back(c.rank(), 1000*i + j);
+        }
+
+        std::vector<size_t> expected_counts = mxx::all2all(send_counts, c);
+        std::vector<std::pair<int, size_t> > expected = mxx::all2allv(msgs, send_counts, expected_counts, c);
+
+        std::vector<size_t> recv_counts;
+        std::vector<std::pair<int, size_t> > result = hier_all2allv(msgs, send_counts, recv_counts, topo, c);
+        EXPECT_EQ(expected_counts, recv_counts);
+        EXPECT_EQ(expected, result);
+
+        // forwarded in rounds of a few elements per processor
+        result = hier_all2allv(msgs, send_counts, recv_counts, topo, c, 17 * sizeof(std::pair<int, size_t>) * ranks_per_node);
+        EXPECT_EQ(expected_counts, recv_counts);
+        EXPECT_EQ(expected, result);
+    }
+}
+
+TEST(PsacHierAll2all, DropIn) {
+    mxx::comm c;
+    std::vector<size_t> send_counts(c.size());
+    std::vector<int> msgs;
+    for (int i = 0; i < c.size(); ++i) {
+        send_counts[i] = (c.rank() + i) % 4;
+        for (size_t j = 0; j < send_counts[i]; ++j)
+            msgs.push_back(c.rank());
+    }
+    std::vector<size_t> recv_counts = auto_all2all(send_counts, c);
+    std::vector<int> result = auto_all2allv(msgs, send_counts, recv_counts, c);
+    size_t pos = 0;
+    for (int i = 0; i < c.size(); ++i) {
+        ASSERT_EQ((size_t)(c.rank() + i) % 4, recv_counts[i]);
+        for (size_t j = 0; j < recv_counts[i]; ++j, ++pos)
+            EXPECT_EQ(i, result[pos]);
+    }
+    EXPECT_EQ(pos, result.size());
+}
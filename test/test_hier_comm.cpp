@@ -0,0 +1,106 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the hierarchical communicator and the shared
+ *          memory windows using it.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/collective.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <hier_comm.hpp>
+#include <bulk_rma.hpp>
+
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+
+TEST(PsacHierComm, Grid) {
+    mxx::comm c;
+    const hier_comm& hc = hier_comm::get(c);
+    for (int rows = 1; rows <= c.size() + 1; ++rows) {
+        const grid_comm& g = hc.grid(rows);
+        // grids are only created once
+        EXPECT_EQ(&g, &hc.grid(rows));
+        EXPECT_EQ(std::min(rows, c.size()), g.rows);
+        EXPECT_EQ(g.col, g.row_comm.rank());
+
+        // rows are blocks of consecutive ranks of nearly equal size
+        std::vector<int> row_of = mxx::allgather(g.row, c);
+        std::vector<int> col_of = mxx::allgather(g.col, c);
+        std::vector<int> row_sizes(g.rows, 0);
+        for (int i = 0; i < c.size(); ++i) {
+            ++row_sizes[row_of[i]];
+            if (i > 0) {
+                EXPECT_TRUE(row_of[i] == row_of[i-1] || row_of[i] == row_of[i-1] + 1);
+                EXPECT_EQ(row_of[i] == row_of[i-1] ? col_of[i-1] + 1 : 0, col_of[i]);
+            }
+        }
+        EXPECT_EQ(row_sizes[g.row], g.row_comm.size());
+        EXPECT_LE(*std::max_element(row_sizes.begin(), row_sizes.end()) - *std::min_element(row_sizes.begin(), row_sizes.end()), 1);
+        if (g.col == 0) {
+            EXPECT_EQ(g.row, g.col_comm.rank());
+            EXPECT_EQ(g.rows, g.col_comm.size());
+        }
+    }
+
+    // the default grid has one row per node if nodes are contiguous
+    const grid_comm& g = hc.grid();
+    if (hc.nodes_contiguous()) {
+        EXPECT_EQ(hc.num_nodes, g.rows);
+        EXPECT_EQ(hc.node_comm.size(), g.row_comm.size());
+    }
+
+    std::stringstream ss;
+    hc.print_node_distribution(ss);
+    EXPECT_EQ(c.rank() == 0, !ss.str().empty());
+}
+
+TEST(PsacHierComm, ShmemWindows) {
+    mxx::comm c;
+    std::srand(7 + c.rank());
+    std::vector<size_t> local(c.rank() % 3 == 1 ? 0 : 10 + std::rand() % 50);
+    size_t prefix = mxx::exscan(local.size(), c);
+    if (c.rank() == 0)
+        prefix = 0;
+    for (size_t i = 0; i < local.size(); ++i)
+        local[i] = 3*(prefix + i) + 1;
+    size_t n = mxx::allreduce(local.size(), c);
+    std::vector<size_t> idx;
+    for (size_t i = 0; i < 100; ++i)
+        idx.push_back(std::rand() % n);
+
+    std::vector<size_t> result = bulk_rma_shm_posix_split(local.begin(), local.end(), idx, c);
+    for (size_t i = 0; i < idx.size(); ++i) {
+        EXPECT_EQ(3*idx[i] + 1, result[i]);
+    }
+
+#if MPI_VERSION > 2
+    // emulated nodes, each with its own copy of the window
+    for (int ranks_per_node : {1, 2, 3, c.size()}) {
+        hier_comm hc(c, ranks_per_node);
+        shmem_window_mpi<size_t> win(local.begin(), local.end(), hc, c);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(3*i + 1, win.get(i));
+        }
+    }
+#endif
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for distributed k-mer counting.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+#include <alphabet.hpp>
+#include <kmer_count.hpp>
+
+#include <map>
+#include <vector>
+#include <string>
+
+void test_kmer_count(const std::string& str, unsigned int k, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    kmer_index<char, size_t> idx(c);
+    idx.construct(local_str.begin(), local_str.end(), k);
+
+    // sequential k-mer counts
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+    std::map<std::string, size_t> exp_counts;
+    for (size_t i = 0; i + k <= gstr.size(); ++i) {
+        ++exp_counts[gstr.substr(i, k)];
+    }
+
+    // local_SA is sorted by k-mer
+    std::vector<size_t> gsa = mxx::allgatherv(idx.local_SA, c);
+    ASSERT_EQ(gstr.size(), gsa.size());
+    for (size_t i = 1; i < gsa.size(); ++i) {
+        EXPECT_LE(gstr.compare(gsa[i-1], k, gstr, gsa[i], k), 0);
+    }
+
+    // emitted (k-mer, count) runs
+    std::vector<std::pair<size_t, size_t>> local_counts = idx.local_counts();
+    std::vector<std::string> local_kmers = idx.local_kmers();
+    ASSERT_EQ(local_counts.size(), local_kmers.size());
+    for (size_t i = 0; i < local_counts.size(); ++i) {
+        EXPECT_EQ(gstr.substr(local_counts[i].first, k), local_kmers[i]);
+        EXPECT_EQ(exp_counts[local_kmers[i]], local_counts[i].second);
+    }
+    EXPECT_EQ(exp_counts.size(), mxx::allreduce(local_counts.size(), c));
+    EXPECT_EQ(exp_counts.size(), idx.num_distinct());
+
+    // queries: existing k-mers and random k-mers
+    std::vector<std::string> queries;
+    std::srand(7 + c.rank());
+    for (size_t i = 0; i < 50; ++i) {
+        if (i % 3 == 0)
+            queries.push_back(rand_dna(k, std::rand()));
+        else
+            queries.push_back(gstr.substr(std::rand() % (gstr.size() - k + 1), k));
+    }
+    std::vector<std::pair<size_t, size_t>> intervals = idx.sa_intervals(queries);
+    std::vector<size_t> counts = idx.counts(queries);
+    ASSERT_EQ(queries.size(), intervals.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        size_t exp = exp_counts.count(queries[i]) ? exp_counts[queries[i]] : 0;
+        EXPECT_EQ(exp, counts[i]);
+        for (size_t j = intervals[i].first; j < intervals[i].second; ++j) {
+            EXPECT_EQ(queries[i], gstr.substr(gsa[j], k));
+        }
+    }
+}
+
+TEST(PsacKmerCount, RandDNA) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0)
+        str = rand_dna(2000, 3);
+    test_kmer_count(str, 1, c);
+    test_kmer_count(str, 5, c);
+    test_kmer_count(str, 31, c);
+    test_kmer_count(str, 64, c);
+}
+
+TEST(PsacKmerCount, Repeats) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0) {
+        for (size_t i = 0; i < 200; ++i)
+            str += (i % 7 == 0) ? "acgt" : "ac";
+    }
+    test_kmer_count(str, 4, c);
+    test_kmer_count(str, 17, c);
+}
+
+TEST(PsacKmerCount, FewerCharsThanProcessors) {
+    mxx::comm c;
+    if (c.size() == 1)
+        return;
+    std::string str;
+    if (c.rank() == 0)
+        str = rand_dna(c.size() - 1, 5);
+    std::string local_str = mxx::stable_distribute(str, c);
+    kmer_index<char, size_t> idx(c);
+    EXPECT_THROW(idx.construct(local_str.begin(), local_str.end(), 1), std::runtime_error);
+}
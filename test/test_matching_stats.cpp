@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the matching statistics and MEM finder.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <sampled_index.hpp>
+#include <matching_stats.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+void test_matching_stats(const std::string& str, size_t sample_rate, size_t init_window, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, false> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+    sampled_index<char, size_t> idx(sa.local_SA, local_str.begin(), local_str.end(), sample_rate, 4, c);
+
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+    size_t n = gstr.size();
+
+    // reads with errors: pieces of the string joined by random characters,
+    // and some queries which do not occur at all
+    std::vector<std::string> queries;
+    std::srand(17 + c.rank());
+    for (size_t i = 0; i < 20; ++i) {
+        std::string q;
+        if (i % 7 == 3) {
+            q = "NNN" + gstr.substr(std::rand() % n, 5);
+        } else {
+            while (q.size() < 60) {
+                size_t len = 1 + std::rand() % 25;
+                q += gstr.substr(std::rand() % n, len);
+                q += rand_dna(1, std::rand());
+            }
+        }
+        queries.push_back(q);
+    }
+    // the last suffix of the string continues in the query
+    queries.push_back(gstr.substr(n - 3) + "ACGT");
+
+    matching_statistics<size_t> ms = bulk_matching_statistics(sa.local_SA, local_str.begin(), local_str.end(), idx, queries, c, init_window);
+    ASSERT_EQ(queries.size(), ms.size());
+
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const std::string& Q = queries[q];
+        ASSERT_EQ(Q.size(), ms.offsets[q+1] - ms.offsets[q]);
+        for (size_t i = 0; i < Q.size(); ++i) {
+            // longest match by brute force
+            size_t exp = 0;
+            for (size_t p = 0; p < n; ++p) {
+                size_t l = 0;
+                while (p + l < n && i + l < Q.size() && gstr[p+l] == Q[i+l])
+                    ++l;
+                exp = std::max(exp, l);
+            }
+            size_t len = ms.length[ms.offsets[q] + i];
+            size_t pos = ms.pos[ms.offsets[q] + i];
+            EXPECT_EQ(exp, len) << "query " << Q << ", position " << i;
+            if (len > 0) {
+                ASSERT_LT(pos, n);
+                EXPECT_EQ(Q.substr(i, len), gstr.substr(pos, len));
+            }
+        }
+    }
+
+    // MEMs can't be extended to the left
+    std::vector<mem_hit> mems = find_mems(ms, 4);
+    size_t num_mems = 0;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        for (size_t i = 0; i < queries[q].size(); ++i) {
+            size_t len = ms.length[ms.offsets[q] + i];
+            if (len >= 4 && (i == 0 || ms.length[ms.offsets[q] + i - 1] <= len))
+                ++num_mems;
+        }
+    }
+    EXPECT_EQ(num_mems, mems.size());
+    for (const mem_hit& h : mems) {
+        EXPECT_GE(h.len, 4u);
+        EXPECT_EQ(queries[h.query].substr(h.qpos, h.len), gstr.substr(h.tpos, h.len));
+        if (h.qpos > 0 && h.tpos > 0) {
+            EXPECT_NE(queries[h.query][h.qpos-1], gstr[h.tpos-1]);
+        }
+    }
+}
+
+TEST(PsacMatchingStats, Mississippi) {
+    mxx::comm c;
+    if (c.size() <= 11) {
+        test_matching_stats("mississippi", 2, 1, c);
+    }
+}
+
+TEST(PsacMatchingStats, RandomDNA) {
+    mxx::comm c;
+    std::string str = rand_dna(3000, 11);
+    // repeats longer than the initial window
+    str += str.substr(100, 200);
+    test_matching_stats(str, 16, 4, c);
+    test_matching_stats(str, 1, 64, c);
+}
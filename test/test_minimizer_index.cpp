@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the minimizer index.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <minimizer_index.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+void test_minimizer_index(const std::string& str, unsigned int k, unsigned int w, size_t chunk_size, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    minimizer_index<char, size_t> idx(c);
+    idx.construct(local_str.begin(), local_str.end(), k, w, chunk_size);
+
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+    size_t n = gstr.size();
+    unsigned int bits = idx.alpha.bits_per_char() * k;
+    uint64_t mask = bits >= 64 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << bits) - 1;
+
+    // minimizers by brute force
+    std::vector<uint64_t> hashes;
+    for (size_t i = 0; i + k <= n; ++i) {
+        std::vector<uint64_t> kmer = kmer_generation<uint64_t>(gstr.begin() + i, gstr.begin() + i + k, k, idx.alpha);
+        hashes.push_back(minimizer_hash(kmer[0], mask));
+    }
+    typedef std::pair<uint64_t, size_t> entry;
+    std::set<entry> exp;
+    for (size_t i = 0; i + w <= hashes.size(); ++i) {
+        size_t m = i;
+        for (size_t j = i; j < i + w; ++j)
+            if (hashes[j] < hashes[m])
+                m = j;
+        exp.insert(entry(hashes[m], m));
+    }
+
+    // the sequential minimizers are the same
+    std::vector<std::pair<uint64_t, size_t>> seq = sequence_minimizers(gstr.begin(), gstr.end(), k, w, idx.alpha);
+    EXPECT_EQ(exp, std::set<entry>(seq.begin(), seq.end()));
+    EXPECT_EQ(exp.size(), seq.size());
+
+    // the table is the sorted set of minimizers
+    std::vector<std::pair<uint64_t, size_t>> table = mxx::allgatherv(idx.local_table, c);
+    EXPECT_EQ(std::vector<entry>(exp.begin(), exp.end()), table);
+    EXPECT_EQ(exp.size(), idx.num_minimizers());
+
+    // lookups of existing and random minimizers
+    std::map<uint64_t, std::vector<size_t>> occ;
+    for (const std::pair<uint64_t, size_t>& m : exp)
+        occ[m.first].push_back(m.second);
+    std::vector<uint64_t> keys;
+    std::srand(31 + c.rank());
+    for (size_t i = 0; i < 40; ++i) {
+        if (i % 4 == 0 || table.empty())
+            keys.push_back(std::rand() & mask);
+        else
+            keys.push_back(table[std::rand() % table.size()].first);
+    }
+    minimizer_hits<size_t> hits = idx.lookup(keys);
+    ASSERT_EQ(keys.size(), hits.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std::vector<size_t> pos(hits.pos.begin() + hits.offsets[i], hits.pos.begin() + hits.offsets[i+1]);
+        EXPECT_EQ(occ[keys[i]], pos) << "key " << keys[i];
+    }
+
+    // reads from the string are seeded at their origin
+    std::vector<std::string> reads;
+    std::vector<size_t> origin;
+    for (size_t i = 0; i < 10 && n >= 60; ++i) {
+        size_t len = 30 + std::rand() % 30;
+        origin.push_back(std::rand() % (n - len + 1));
+        reads.push_back(gstr.substr(origin.back(), len));
+    }
+    std::vector<minimizer_seed> seeds = idx.seeds(reads);
+    for (size_t r = 0; r < reads.size(); ++r) {
+        std::vector<std::pair<uint64_t, size_t>> mins = sequence_minimizers(reads[r].begin(), reads[r].end(), k, w, idx.alpha);
+        for (const std::pair<uint64_t, size_t>& m : mins) {
+            size_t found = 0;
+            for (const minimizer_seed& s : seeds) {
+                if (s.read == r && s.qpos == m.second) {
+                    EXPECT_EQ(reads[r].substr(s.qpos, k), gstr.substr(s.tpos, k));
+                    if (s.tpos == origin[r] + m.second)
+                        ++found;
+                }
+            }
+            // interior minimizers of the read are minimizers of the string
+            if (m.second + 1 >= w && m.second + w + k <= reads[r].size() + 1) {
+                EXPECT_EQ(1u, found) << "read " << r << ", qpos " << m.second;
+            }
+        }
+    }
+}
+
+TEST(PsacMinimizerIndex, RandomDNA) {
+    mxx::comm c;
+    std::string str = rand_dna(2000, 5);
+    // repeated minimizers
+    str += str.substr(300, 400);
+    test_minimizer_index(str, 11, 5, 1 << 20, c);
+    test_minimizer_index(str, 15, 10, 7, c);
+    test_minimizer_index(str, 5, 1, 100, c);
+}
+
+TEST(PsacMinimizerIndex, LargeWindow) {
+    mxx::comm c;
+    // windows span several blocks
+    std::string str;
+    for (size_t i = 0; i < 40; ++i)
+        str += (i % 5 == 0) ? "acgta" : "ac";
+    test_minimizer_index(str, 3, 40, 4, c);
+    test_minimizer_index(str, 4, 2, 1, c);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for batched distributed pattern count and locate.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <sampled_index.hpp>
+#include <pattern_search.hpp>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+void test_pattern_search(const std::string& str, size_t sample_rate, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, false> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+    sampled_index<char, size_t> idx(sa.local_SA, local_str.begin(), local_str.end(), sample_rate, 4, c);
+
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+
+    // patterns of different lengths (also longer than the sampled prefixes)
+    std::vector<std::string> patterns;
+    std::srand(31 + c.rank());
+    for (size_t i = 0; i < 60; ++i) {
+        size_t len = 1 + std::rand() % 12;
+        if (i % 5 == 0)
+            patterns.push_back(rand_dna(len, std::rand()));
+        else
+            patterns.push_back(gstr.substr(std::rand() % gstr.size(), len));
+    }
+    // the last suffix is a prefix of the pattern
+    patterns.push_back(gstr.substr(gstr.size()-2) + "A");
+
+    std::vector<std::pair<size_t, size_t>> ranges = bulk_sa_ranges(sa.local_SA, local_str.begin(), local_str.end(), idx, patterns, c);
+    std::vector<size_t> counts = bulk_count(sa.local_SA, local_str.begin(), local_str.end(), idx, patterns, c);
+    std::vector<size_t> offsets;
+    std::vector<size_t> positions = bulk_locate(sa.local_SA, ranges, offsets, c);
+    ASSERT_EQ(patterns.size(), ranges.size());
+    ASSERT_EQ(patterns.size()+1, offsets.size());
+
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        std::vector<size_t> exp_pos;
+        for (size_t j = 0; j < gstr.size(); ++j) {
+            if (gstr.compare(j, patterns[i].size(), patterns[i]) == 0)
+                exp_pos.push_back(j);
+        }
+        EXPECT_EQ(exp_pos.size(), counts[i]);
+        std::vector<size_t> pos(positions.begin() + offsets[i], positions.begin() + offsets[i+1]);
+        std::sort(pos.begin(), pos.end());
+        EXPECT_EQ(exp_pos, pos);
+    }
+
+    // limited number of occurrences
+    std::vector<size_t> lim_offsets;
+    std::vector<size_t> lim_positions = bulk_locate(sa.local_SA, ranges, lim_offsets, c, 2);
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        EXPECT_EQ(std::min<size_t>(counts[i], 2), lim_offsets[i+1] - lim_offsets[i]);
+    }
+}
+
+TEST(PsacPatternSearch, RandDNA) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0)
+        str = rand_dna(1234, 5);
+    test_pattern_search(str, 32, c);
+    test_pattern_search(str, 1000, c);
+}
+
+TEST(PsacPatternSearch, Repeats) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0) {
+        for (size_t i = 0; i < 250; ++i)
+            str += "ACA";
+    }
+    test_pattern_search(str, 16, c);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the r-index construction and loader.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <r_index.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+const std::string test_prefix = "test_r_index";
+
+void test_r_index(const std::string& str, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, false> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+    size_t r = write_r_index(test_prefix, sa, local_str.begin(), local_str.end(), c);
+
+    std::vector<size_t> SA = mxx::allgatherv(sa.local_SA, c);
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+    size_t n = gstr.size();
+    c.barrier();
+
+    // runs of the BWT
+    std::string bwt(n, '\0');
+    for (size_t i = 0; i < n; ++i)
+        if (SA[i] > 0)
+            bwt[i] = gstr[SA[i]-1];
+    size_t exp_runs = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (i == 0 || bwt[i] != bwt[i-1])
+            ++exp_runs;
+    EXPECT_EQ(exp_runs, r);
+
+    r_index<size_t> ri(test_prefix);
+    ASSERT_EQ(n, ri.size());
+    EXPECT_EQ(exp_runs, ri.num_runs());
+    for (size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(bwt[i], ri.bwt(i)) << "i=" << i;
+    }
+
+    // patterns: substrings (including suffixes), single characters, and
+    // patterns which do not occur
+    std::vector<std::string> patterns;
+    std::srand(3);
+    for (size_t i = 0; i < 40; ++i) {
+        size_t len = 1 + std::rand() % 12;
+        size_t pos = (i % 5 == 0) ? n - std::min(len, n) : std::rand() % n;
+        patterns.push_back(gstr.substr(pos, len));
+    }
+    patterns.push_back(gstr.substr(n-1));
+    patterns.push_back(gstr);
+    patterns.push_back("zz");
+    patterns.push_back(gstr.substr(0, 3) + "z");
+    for (const std::string& P : patterns) {
+        std::vector<size_t> exp;
+        for (size_t i = 0; i < n; ++i)
+            if (gstr.compare(SA[i], P.size(), P) == 0)
+                exp.push_back(SA[i]);
+        EXPECT_EQ(exp.size(), ri.count(P)) << "P=" << P;
+        EXPECT_EQ(exp, ri.locate(P)) << "P=" << P;
+    }
+
+    c.barrier();
+    if (c.rank() == 0)
+        std::remove(r_index_impl::meta_file(test_prefix).c_str());
+    std::remove(r_index_impl::block_file(test_prefix, c.rank()).c_str());
+}
+
+TEST(PsacRIndex, Mississippi) {
+    mxx::comm c;
+    if (c.size() <= 11)
+        test_r_index("mississippi", c);
+}
+
+TEST(PsacRIndex, RepetitiveCollection) {
+    mxx::comm c;
+    // near-identical copies of a random genome
+    std::string genome = rand_dna(300, 21);
+    std::string str;
+    std::srand(5);
+    for (size_t i = 0; i < 12; ++i) {
+        std::string copy = genome;
+        for (size_t j = 0; j < 3; ++j)
+            copy[std::rand() % copy.size()] = "acgt"[std::rand() % 4];
+        str += copy;
+    }
+    test_r_index(str, c);
+}
+
+TEST(PsacRIndex, RandomDNA) {
+    mxx::comm c;
+    test_r_index(rand_dna(1500, 9), c);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the substring statistics.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <sa_stats.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+TEST(PsacStats, Brute) {
+    for (size_t n : {11, 300, 5000}) {
+        mxx::comm comm;
+        comm.barrier();
+        mxx::comm c = comm.split((size_t)comm.rank() < n);
+        if ((size_t)comm.rank() >= n)
+           continue;
+        std::string str;
+        if (c.rank() == 0) {
+            if (n == 11) {
+                str = "mississippi";
+            } else {
+                std::string rep = rand_dna(n/10, 8);
+                str = rand_dna(n/2, 9) + rep + rand_dna(n - n/2 - 2*(n/10), 10) + rep;
+            }
+        }
+        std::string local_str = mxx::stable_distribute(str, c);
+
+        suffix_array<char, size_t, true> sa(c);
+        sa.construct(local_str.begin(), local_str.end());
+        size_t max_k = 12;
+        sa_statistics stats = compute_sa_statistics(sa, max_k, c);
+
+        std::vector<size_t> lcp = mxx::gatherv(sa.local_LCP, 0, c);
+        if (c.rank() == 0) {
+            EXPECT_EQ(n, stats.n);
+            // all distinct substrings (only for short strings)
+            if (n <= 300) {
+                std::set<std::string> substrings;
+                for (size_t i = 0; i < n; ++i)
+                    for (size_t l = 1; i + l <= n; ++l)
+                        substrings.insert(str.substr(i, l));
+                EXPECT_EQ(substrings.size(), stats.distinct_substrings);
+            }
+            // k-mer counts
+            for (size_t k = 1; k <= max_k; ++k) {
+                std::map<std::string, size_t> kmers;
+                for (size_t i = 0; i + k <= n; ++i)
+                    ++kmers[str.substr(i, k)];
+                size_t repeated = 0, positions = 0;
+                for (auto& km : kmers) {
+                    if (km.second > 1) {
+                        ++repeated;
+                        positions += km.second;
+                    }
+                }
+                EXPECT_EQ(kmers.size(), stats.distinct_kmers[k]) << "k = " << k;
+                EXPECT_EQ(repeated, stats.repeated_kmers[k]) << "k = " << k;
+                EXPECT_EQ(positions, stats.repeat_positions[k]) << "k = " << k;
+            }
+            // LCP histogram and summary
+            std::vector<uint64_t> hist(max_k + 1, 0);
+            size_t max_lcp = 0;
+            uint64_t sum = 0;
+            for (size_t i = 1; i < n; ++i) {
+                ++hist[std::min(lcp[i], max_k)];
+                max_lcp = std::max(max_lcp, lcp[i]);
+                sum += lcp[i];
+            }
+            EXPECT_EQ(hist, stats.lcp_hist);
+            EXPECT_EQ(max_lcp, stats.max_lcp);
+            EXPECT_EQ(sum, stats.lcp_sum);
+            if (n > 11) {
+                EXPECT_LE(n/10, stats.max_lcp);
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the sampled top-level index and query routing.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <sampled_index.hpp>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// brute force: SA range of all suffixes prefixed by `P`
+std::pair<size_t, size_t> naive_sa_range(const std::string& str, const std::vector<size_t>& sa, const std::string& P) {
+    auto lo = std::lower_bound(sa.begin(), sa.end(), P, [&str](size_t s, const std::string& p) {
+        return str.compare(s, p.size(), p) < 0;
+    });
+    auto hi = std::upper_bound(sa.begin(), sa.end(), P, [&str](const std::string& p, size_t s) {
+        return str.compare(s, p.size(), p) > 0;
+    });
+    return std::pair<size_t, size_t>(lo - sa.begin(), hi - sa.begin());
+}
+
+void test_sampled_index(const std::string& str, size_t sample_rate, size_t prefix_len, const mxx::comm& c) {
+    std::string local_str = mxx::stable_distribute(str, c);
+    suffix_array<char, size_t, false> sa(c);
+    sa.construct(local_str.begin(), local_str.end());
+
+    sampled_index<char, size_t> idx(sa.local_SA, local_str.begin(), local_str.end(), sample_rate, prefix_len, c);
+
+    // replicate string and SA for checking
+    std::vector<char> gstr_vec = mxx::allgatherv(std::vector<char>(local_str.begin(), local_str.end()), c);
+    std::string gstr(gstr_vec.begin(), gstr_vec.end());
+    std::vector<size_t> gsa = mxx::allgatherv(sa.local_SA, c);
+    ASSERT_EQ(gsa.size(), idx.global_size());
+    mxx::partition::block_decomposition_buffered<size_t> part(gsa.size(), c.size(), c.rank());
+
+    // patterns: substrings of different lengths and some random strings
+    std::vector<std::string> patterns;
+    std::srand(13 + c.rank());
+    for (size_t i = 0; i < 100; ++i) {
+        size_t len = 1 + std::rand() % (2*prefix_len);
+        if (i % 4 == 0) {
+            patterns.push_back(rand_dna(len, std::rand()));
+        } else {
+            size_t start = std::rand() % gstr.size();
+            patterns.push_back(gstr.substr(start, len));
+        }
+    }
+
+    // single characters: their SA ranges cover the whole SA, so with fewer
+    // characters than processors at least one of them spans a boundary
+    std::string chars = gstr;
+    std::sort(chars.begin(), chars.end());
+    chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+    for (char x : chars) {
+        patterns.push_back(std::string(1, x));
+    }
+
+    bool spans = false;
+    for (const std::string& P : patterns) {
+        std::pair<size_t, size_t> exp = naive_sa_range(gstr, gsa, P);
+        std::pair<size_t, size_t> r = idx.sa_range(P);
+        EXPECT_LE(r.first, exp.first);
+        EXPECT_GE(r.second, exp.second);
+        if (exp.first < exp.second) {
+            std::pair<int, int> procs = idx.target_processors(P);
+            EXPECT_LE(procs.first, part.target_processor(exp.first));
+            EXPECT_GE(procs.second, part.target_processor(exp.second - 1));
+            if (part.target_processor(exp.first) != part.target_processor(exp.second - 1))
+                spans = true;
+        }
+    }
+    if (chars.size() < static_cast<size_t>(c.size())) {
+        EXPECT_TRUE(spans);
+    }
+
+    // route patterns to all owning processors and count the occurrences
+    // in each local block
+    std::vector<size_t> counts = bulk_pattern_query(idx, patterns, [&](const std::string& P) {
+        size_t cnt = 0;
+        for (size_t i = 0; i < sa.local_SA.size(); ++i) {
+            if (gstr.compare(sa.local_SA[i], P.size(), P) == 0)
+                ++cnt;
+        }
+        return cnt;
+    }, [](size_t a, size_t b) { return a + b; }, c);
+    // the answering processors, merged in processor order
+    std::vector<std::pair<int, int>> owners = bulk_pattern_query(idx, patterns, [&c](const std::string&) {
+        return std::pair<int, int>(c.rank(), c.rank());
+    }, [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return std::pair<int, int>(a.second + 1 == b.first ? a.first : -1, b.second);
+    }, c);
+    ASSERT_EQ(patterns.size(), counts.size());
+    ASSERT_EQ(patterns.size(), owners.size());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        std::pair<size_t, size_t> exp = naive_sa_range(gstr, gsa, patterns[i]);
+        EXPECT_EQ(exp.second - exp.first, counts[i]) << "pattern " << patterns[i];
+        EXPECT_EQ(idx.target_processors(patterns[i]), owners[i]);
+    }
+}
+
+TEST(PsacSampledIndex, RandDNA) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0)
+        str = rand_dna(1537, 7);
+    test_sampled_index(str, 16, 8, c);
+    test_sampled_index(str, 1, 4, c);
+    test_sampled_index(str, 200, 3, c);
+}
+
+TEST(PsacSampledIndex, Repeats) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0) {
+        for (size_t i = 0; i < 300; ++i)
+            str += "acg";
+    }
+    test_sampled_index(str, 7, 5, c);
+
+    // a single character: every pattern range spans all processors
+    std::string unary;
+    if (c.rank() == 0)
+        unary = std::string(500, 'a');
+    test_sampled_index(unary, 7, 5, c);
+}
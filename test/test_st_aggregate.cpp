@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016 Georgia Institute of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief   Unit tests for the bottom-up aggregation over the suffix tree.
+ */
+
+#include <gtest/gtest.h>
+#include <mxx/comm.hpp>
+#include <mxx/distribution.hpp>
+
+// disable timer output during testing
+#define MXX_DISABLE_TIMER 1
+
+#include <alphabet.hpp>
+#include <suffix_array.hpp>
+#include <suffix_tree.hpp>
+#include <st_aggregate.hpp>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+TEST(PsacStAggregate, SumAndMax) {
+    for (size_t n : {11, 1000, 23713}) {
+        mxx::comm comm;
+        comm.barrier();
+        mxx::comm c = comm.split((size_t)comm.rank() < n);
+        if ((size_t)comm.rank() >= n)
+           continue;
+        std::string str;
+        if (c.rank() == 0) {
+            if (n == 11) {
+                str = "mississippi";
+            } else {
+                // long repeats result in deep trees
+                std::string rep = rand_dna(n/8, 3);
+                str = rand_dna(n/2, 4) + rep + rep + rand_dna(n - n/2 - 2*(n/8), 5);
+            }
+        }
+        std::string local_str = mxx::stable_distribute(str, c);
+
+        suffix_array<char, size_t, true> sa(c);
+        sa.construct(local_str.begin(), local_str.end());
+        lcp_interval_tree tree = construct_lcp_interval_tree(sa, c);
+        size_t local_size = sa.local_SA.size();
+        size_t prefix = mxx::exscan(local_size, c);
+
+        // leaf counts are given by the SA-intervals
+        std::vector<size_t> counts = subtree_leaf_counts(tree, c);
+        for (size_t i = 0; i < local_size; ++i) {
+            if (tree.is_node(i))
+                EXPECT_EQ(tree.node_rb[i] - tree.node_lb[i] + 1, counts[i]);
+            else
+                EXPECT_EQ(0u, counts[i]);
+        }
+
+        // sum of leaf and node values, and max of the leaf suffix positions
+        std::vector<size_t> leaf_vals(local_size);
+        std::vector<size_t> node_vals(local_size);
+        for (size_t i = 0; i < local_size; ++i) {
+            leaf_vals[i] = (prefix + i) % 7 + 1;
+            node_vals[i] = 1000 * ((prefix + i) % 3);
+        }
+        std::vector<size_t> sums = subtree_aggregate(tree, leaf_vals, node_vals, [](size_t x, size_t y) { return x + y; }, size_t(0), c);
+        std::vector<size_t> max_pos = subtree_aggregate(tree, sa.local_SA, std::vector<size_t>(local_size, 0),
+                                                        [](size_t x, size_t y) { return std::max(x, y); }, size_t(0), c);
+
+        // compare against a sequential bottom-up pass
+        std::vector<size_t> leaf_parent = mxx::gatherv(tree.leaf_parent, 0, c);
+        std::vector<size_t> node_parent = mxx::gatherv(tree.node_parent, 0, c);
+        std::vector<size_t> node_rb = mxx::gatherv(tree.node_rb, 0, c);
+        std::vector<size_t> node_lb = mxx::gatherv(tree.node_lb, 0, c);
+        std::vector<size_t> all_leaf_vals = mxx::gatherv(leaf_vals, 0, c);
+        std::vector<size_t> all_node_vals = mxx::gatherv(node_vals, 0, c);
+        std::vector<size_t> all_sa = mxx::gatherv(sa.local_SA, 0, c);
+        std::vector<size_t> all_sums = mxx::gatherv(sums, 0, c);
+        std::vector<size_t> all_max_pos = mxx::gatherv(max_pos, 0, c);
+        if (c.rank() == 0) {
+            const size_t none = lcp_interval_tree::none();
+            std::vector<size_t> exp_sums(n, 0);
+            std::vector<size_t> exp_max(n, 0);
+            std::vector<size_t> nodes;
+            for (size_t i = 0; i < n; ++i) {
+                if (node_rb[i] != none) {
+                    exp_sums[i] = all_node_vals[i];
+                    nodes.push_back(i);
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                exp_sums[leaf_parent[i]] += all_leaf_vals[i];
+                exp_max[leaf_parent[i]] = std::max(exp_max[leaf_parent[i]], all_sa[i]);
+            }
+            std::sort(nodes.begin(), nodes.end(), [&](size_t x, size_t y) {
+                return node_rb[x] - node_lb[x] < node_rb[y] - node_lb[y];
+            });
+            for (size_t i : nodes) {
+                if (node_parent[i] != none) {
+                    exp_sums[node_parent[i]] += exp_sums[i];
+                    exp_max[node_parent[i]] = std::max(exp_max[node_parent[i]], exp_max[i]);
+                }
+            }
+            EXPECT_EQ(exp_sums, all_sums);
+            EXPECT_EQ(exp_max, all_max_pos);
+            // the root covers everything
+            EXPECT_EQ(n - 1, all_max_pos[0]);
+        }
+    }
+}
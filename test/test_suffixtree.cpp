@@ -26,6 +26,7 @@
 #include <suffix_array.hpp>
 #include <alphabet.hpp>
 #include <rmq.hpp>
+#include <document_array.hpp>
 #include <mxx/distribution.hpp>
 #include <vector>
 #include <algorithm>
@@ -160,3 +161,260 @@ TEST(PsacST, Repeats3Test) {
         }
     }
 }
+
+// TEST pipelined construction against the bulk synchronous one
+TEST(PsacST, Pipelined) {
+    for (size_t n : {11, 1000, 23713}) {
+        mxx::comm comm;
+        comm.barrier();
+        mxx::comm c = comm.split((size_t)comm.rank() < n);
+        if ((size_t)comm.rank() >= n)
+           continue;
+        std::string str;
+        if (c.rank() == 0) {
+            str = (n == 11) ? std::string("mississippi") : rand_dna(n, 17);
+        }
+        std::string local_str = mxx::stable_distribute(str, c);
+
+        // build SA and LCP
+        suffix_array<char, size_t, true> sa(c);
+        sa.construct(local_str.begin(), local_str.end());
+
+        std::vector<size_t> local_nodes = construct_suffix_tree(sa, local_str.begin(), local_str.end(), c);
+        std::vector<size_t> nodes = mxx::gatherv(local_nodes, 0, c);
+        for (size_t chunk_size : {(size_t)1, (size_t)7, (size_t)1000, st_pipeline_chunk_size}) {
+            std::vector<size_t> local_pnodes = construct_suffix_tree_pipelined(sa, local_str.begin(), local_str.end(), c, chunk_size);
+            std::vector<size_t> pnodes = mxx::gatherv(local_pnodes, 0, c);
+            if (c.rank() == 0) {
+                EXPECT_EQ(nodes, pnodes) << "n = " << n << ", chunk size = " << chunk_size;
+            }
+        }
+    }
+}
+
+// TEST combined SA+LCP+ST construction, also for unequal distributions
+TEST(PsacST, CombinedDriver) {
+    mxx::comm c;
+    std::string str;
+    if (c.rank() == 0) {
+        str = rand_dna(15000, 21);
+    }
+    std::string local_str = mxx::stable_distribute(str, c);
+
+    // reference
+    suffix_array<char, size_t, true> ref(c);
+    ref.construct(local_str.begin(), local_str.end());
+    std::vector<size_t> nodes = mxx::gatherv(construct_suffix_tree(ref, local_str.begin(), local_str.end(), c), 0, c);
+
+    suffix_array<char, size_t, true> sa(c);
+    double sa_time = -1.0;
+    std::vector<size_t> local_nodes = construct_sa_lcp_st(sa, local_str.begin(), local_str.end(), c, sa_time);
+    EXPECT_LE(0.0, sa_time);
+    EXPECT_TRUE(sa.local_B.empty());
+    EXPECT_EQ(ref.local_SA, sa.local_SA);
+    std::vector<size_t> nodes2 = mxx::gatherv(local_nodes, 0, c);
+
+    // weighted distribution: rank i holds a share proportional to i+1
+    size_t n = 15000;
+    size_t total_weight = c.size()*(c.size()+1)/2;
+    size_t begin = n * (c.rank()*(c.rank()+1)/2) / total_weight;
+    size_t end = n * ((c.rank()+1)*(c.rank()+2)/2) / total_weight;
+    std::string wlocal_str = rand_dna(n, 21).substr(begin, end - begin);
+    suffix_array<char, size_t, true> wsa(c);
+    std::vector<size_t> local_wnodes = construct_sa_lcp_st(wsa, wlocal_str.begin(), wlocal_str.end(), c, sa_time, true, 100);
+    EXPECT_EQ(end - begin, wsa.local_B.size());
+    std::vector<size_t> wnodes = mxx::gatherv(local_wnodes, 0, c);
+    // the bulk synchronous construction on the same (non block) distribution
+    std::vector<size_t> wnodes2 = mxx::gatherv(construct_suffix_tree(wsa, wlocal_str.begin(), wlocal_str.end(), c), 0, c);
+    if (c.rank() == 0) {
+        EXPECT_EQ(nodes, nodes2);
+        EXPECT_EQ(nodes, wnodes);
+        EXPECT_EQ(nodes, wnodes2);
+    }
+}
+
+// TEST LCP-interval tree against the full suffix tree
+TEST(PsacST, LcpIntervalTree) {
+    for (size_t n : {11, 116, 1000, 23713}) {
+        mxx::comm comm;
+        comm.barrier();
+        mxx::comm c = comm.split((size_t)comm.rank() < n);
+        if ((size_t)comm.rank() >= n)
+           continue;
+        std::string str;
+        if (c.rank() == 0) {
+            str = (n == 11) ? std::string("mississippi") : rand_dna(n, 7);
+        }
+        std::string local_str = mxx::stable_distribute(str, c);
+
+        // build SA and LCP
+        suffix_array<char, size_t, true> sa(c);
+        sa.construct(local_str.begin(), local_str.end());
+
+        // build full ST and LCP-interval tree
+        std::vector<size_t> local_nodes = construct_suffix_tree(sa, local_str.begin(), local_str.end(), c);
+        lcp_interval_tree tree = construct_lcp_interval_tree(sa, c);
+
+        // gather on master
+        std::vector<size_t> nodes = mxx::gatherv(local_nodes, 0, c);
+        std::vector<size_t> lcp = mxx::gatherv(sa.local_LCP, 0, c);
+        std::vector<size_t> leaf_parent = mxx::gatherv(tree.leaf_parent, 0, c);
+        std::vector<size_t> node_parent = mxx::gatherv(tree.node_parent, 0, c);
+        std::vector<size_t> node_lb = mxx::gatherv(tree.node_lb, 0, c);
+        std::vector<size_t> node_rb = mxx::gatherv(tree.node_rb, 0, c);
+
+        if (c.rank() == 0) {
+            size_t sigma = sa.alpha.sigma() + 1;
+            ASSERT_EQ(n, leaf_parent.size());
+            ASSERT_EQ(lcp_interval_tree::none(), node_parent[0]);
+            for (size_t i = 0; i < n; ++i) {
+                // same set of internal nodes with the same children
+                bool is_node = false;
+                for (size_t a = 0; a < sigma; ++a) {
+                    size_t child = nodes[sigma*i + a];
+                    if (child == 0)
+                        continue;
+                    is_node = true;
+                    if (child >= n)
+                        EXPECT_EQ(i, leaf_parent[child - n]);
+                    else
+                        EXPECT_EQ(i, node_parent[child]);
+                }
+                EXPECT_EQ(is_node, node_rb[i] != lcp_interval_tree::none());
+                if (!is_node)
+                    continue;
+
+                // [lb, rb] is the maximal interval with LCP values >= LCP[i]
+                size_t lb = node_lb[i];
+                size_t rb = node_rb[i];
+                ASSERT_LT(lb, i + (i == 0));
+                ASSERT_LE(i, rb);
+                ASSERT_LT(rb, n);
+                for (size_t j = lb + 1; j <= rb; ++j) {
+                    EXPECT_LE(lcp[i], lcp[j]);
+                }
+                if (i > 0) {
+                    EXPECT_LT(lcp[lb], lcp[i]);
+                }
+                if (rb + 1 < n) {
+                    EXPECT_LT(lcp[rb+1], lcp[i]);
+                }
+            }
+        }
+    }
+}
+
+// sequential check of the generalized suffix tree, following
+// `check_suffix_tree()` with the edge labels ending at the sequence ends
+void check_gst(const std::string& s, const std::vector<size_t>& seq_end, const alphabet<char>& alpha,
+               const std::vector<size_t>& sa, const std::vector<size_t>& lcp,
+               const std::vector<size_t>& nodes, const std::vector<size_t>& num_terminals) {
+    size_t n = s.size();
+    size_t sigma = alpha.sigma() + 1;
+    ASSERT_EQ(sigma*n, nodes.size());
+    ASSERT_EQ(n, num_terminals.size());
+    rmq<std::vector<size_t>::const_iterator> minquery(lcp.cbegin(), lcp.cend());
+    std::vector<bool> edges_visited(nodes.size(), false);
+    std::vector<std::vector<size_t>> terminals(n);
+
+    std::vector<std::tuple<size_t, size_t, size_t, size_t>> q;
+    q.emplace_back(1, n, 0, 0);
+    while (!q.empty()) {
+        size_t range_left, range_right, prev_min, prev_pos;
+        std::tie(range_left, range_right, prev_min, prev_pos) = q.back();
+        q.pop_back();
+        if (range_left == range_right) {
+            size_t i = range_left - 1;
+            ASSERT_LE(sa[i] + prev_min, seq_end[sa[i]]);
+            if (sa[i] + prev_min == seq_end[sa[i]]) {
+                terminals[prev_pos].push_back(i);
+            } else {
+                size_t c = alpha.encode(s[sa[i] + prev_min]);
+                edges_visited[sigma*prev_pos + c] = true;
+                ASSERT_EQ(i + n, nodes[sigma*prev_pos + c]);
+            }
+        } else {
+            ASSERT_LT(range_left, range_right);
+            size_t split = minquery.query(lcp.cbegin() + range_left, lcp.cbegin() + range_right) - lcp.cbegin();
+            size_t m = lcp[split];
+            if (m == prev_min) {
+                q.emplace_back(split + 1, range_right, prev_min, prev_pos);
+                q.emplace_back(range_left, split, prev_min, prev_pos);
+            } else {
+                ASSERT_LT(prev_min, m);
+                q.emplace_back(split + 1, range_right, m, split);
+                q.emplace_back(range_left, split, m, split);
+                ASSERT_LT(sa[split] + prev_min, seq_end[sa[split]]);
+                size_t c = alpha.encode(s[sa[split] + prev_min]);
+                edges_visited[sigma*prev_pos + c] = true;
+                ASSERT_EQ(split, nodes[sigma*prev_pos + c]);
+            }
+        }
+    }
+
+    // the terminator leaves of each node are consecutive, starting at cell 0
+    for (size_t v = 0; v < n; ++v) {
+        ASSERT_EQ(terminals[v].size(), num_terminals[v]) << "node " << v;
+        if (!terminals[v].empty()) {
+            std::sort(terminals[v].begin(), terminals[v].end());
+            EXPECT_EQ(terminals[v].front() + n, nodes[sigma*v]);
+            EXPECT_EQ(terminals[v].front() + terminals[v].size() - 1, terminals[v].back());
+            edges_visited[sigma*v] = true;
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i] != 0) {
+            ASSERT_TRUE(edges_visited[i]) << "cell " << i;
+        }
+    }
+}
+
+void test_gst(const std::vector<std::string>& docs, const mxx::comm& c) {
+    std::string flatstrs;
+    if (c.rank() == 0)
+        flatstrs = flatten_strings(docs);
+    flatstrs = mxx::stable_distribute(flatstrs, c);
+    simple_dstringset ss(flatstrs.begin(), flatstrs.end(), c);
+    alphabet<char> a = alphabet<char>::from_string("ACGT", c);
+    suffix_array<char, size_t, true> sa(c);
+    sa.construct_ss(ss, a);
+    std::string local_str = concat_stringset(ss, c);
+
+    std::vector<size_t> gsa = mxx::gatherv(sa.local_SA, 0, c);
+    std::vector<size_t> glcp = mxx::gatherv(sa.local_LCP, 0, c);
+    for (size_t chunk_size : {(size_t)3, st_pipeline_chunk_size}) {
+        generalized_suffix_tree gst = construct_generalized_suffix_tree(sa, ss, local_str.begin(), local_str.end(), c, chunk_size);
+        std::vector<size_t> nodes = mxx::gatherv(gst.internal_nodes, 0, c);
+        std::vector<size_t> num_terminals = mxx::gatherv(gst.num_terminals, 0, c);
+        if (c.rank() == 0) {
+            std::string s;
+            std::vector<size_t> seq_end;
+            for (const std::string& d : docs) {
+                s += d;
+                seq_end.insert(seq_end.end(), d.size(), s.size());
+            }
+            check_gst(s, seq_end, a, gsa, glcp, nodes, num_terminals);
+        }
+    }
+}
+
+// TEST generalized suffix tree with per-sequence terminators
+TEST(PsacST, GeneralizedSuffixTree) {
+    mxx::comm comm;
+    comm.with_subset(comm.rank() < 4, [](const mxx::comm& c) {
+        test_gst({"ACGT", "ACG", "ACGT", "T", "GATTACA", "ACG", "CA"}, c);
+    });
+
+    // overlapping reads of a short reference, with duplicates
+    mxx::comm c;
+    std::string ref = rand_dna(400, 23);
+    std::vector<std::string> docs;
+    std::srand(23);
+    for (size_t i = 0; i < 150; ++i) {
+        size_t len = 1 + std::rand() % 40;
+        docs.push_back(ref.substr(std::rand() % (ref.size() - len), len));
+        if (i % 10 == 0)
+            docs.push_back(docs.back());
+    }
+    test_gst(docs, c);
+}